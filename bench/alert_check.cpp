@@ -0,0 +1,119 @@
+// Runs the webhook dispatcher against a local HTTP stand-in and checks the
+// delivery behaviour it promises:
+//   - alerts share one kept-alive connection
+//   - a 5xx is retried with exponential backoff
+//   - repeated alerts for a metric are coalesced while queued, and one
+//     delivered recently is suppressed
+//   - submit() stays fast while the endpoint is slow
+//
+//   make -C bench check
+
+#include "alert_dispatcher.h"
+#include "stand_in.h"
+
+static Alert makeAlert(const std::string& rule, const std::string& metric, double value) {
+    Alert alert;
+    alert.rule = rule;
+    alert.metric = metric;
+    alert.value = value;
+    alert.threshold = 90;
+    alert.severity = "warning";
+    alert.timestamp = 1700000000;
+    return alert;
+}
+
+static double payloadValue(const std::string& body) {
+    size_t pos = body.find("\"value\": ");
+    return pos == std::string::npos ? -1 : atof(body.c_str() + pos + 9);
+}
+
+static void keepAlive() {
+    printf("keep-alive\n");
+    HttpStandIn endpoint;
+    if (!check(endpoint.start(), "stand-in listens")) return;
+    AlertDispatcher dispatcher(endpoint.url("/hook"));
+    check(dispatcher.start(), "dispatcher starts");
+    for (int i = 0; i < 5; i++) {
+        dispatcher.submit(makeAlert("rule" + std::to_string(i), "cpu_usage", 95));
+        endpoint.waitFor(i + 1, 2);
+    }
+    dispatcher.stop();
+
+    std::vector<StandInRequest> requests = endpoint.getRequests();
+    check(requests.size() == 5, "five alerts delivered");
+    check(endpoint.connections() == 1, "over one connection");
+    for (const auto& request : requests) {
+        check(request.method == "POST" && request.target == "/hook", "POST to the webhook path");
+        check(request.header("content-type") == "application/json", "JSON body");
+    }
+    printf("  %zu requests over %d connection(s)\n", requests.size(), endpoint.connections());
+}
+
+static void backoff() {
+    printf("backoff on 5xx\n");
+    HttpStandIn endpoint;
+    if (!check(endpoint.start(), "stand-in listens")) return;
+    int failures = 3;
+    endpoint.setResponder([&failures](const StandInRequest&) { return failures-- > 0 ? 503 : 200; });
+
+    AlertDispatcherOptions options;
+    options.retry_base_ms = 100;
+    options.retry_max_ms = 1000;
+    AlertDispatcher dispatcher(endpoint.url("/hook"), options);
+    check(dispatcher.start(), "dispatcher starts");
+    dispatcher.submit(makeAlert("cpu", "cpu_usage", 97));
+    check(endpoint.waitFor(4, 5), "retried until accepted");
+    usleep(300000);    // Nothing more may follow the 200
+    dispatcher.stop();
+
+    std::vector<StandInRequest> requests = endpoint.getRequests();
+    check(requests.size() == 4, "three failures and one success, then nothing");
+    // Backoff doubles from retry_base_ms, plus up to a quarter of jitter
+    for (size_t i = 1; i < requests.size() && i < 4; i++) {
+        double gap_ms = (requests[i].at - requests[i - 1].at) * 1000;
+        double expected = 100.0 * (1 << (i - 1));
+        printf("  attempt %zu after %.0f ms (backoff %.0f..%.0f ms)\n", i + 1, gap_ms, expected, expected * 1.25);
+        check(gap_ms >= expected - 5 && gap_ms <= expected * 1.25 + 100, "gap follows the backoff");
+    }
+}
+
+static void coalescing() {
+    printf("coalescing and suppression\n");
+    HttpStandIn endpoint;
+    if (!check(endpoint.start(), "stand-in listens")) return;
+    endpoint.setDelay(300);    // A slow endpoint: the dispatcher is busy with the first alert
+
+    AlertDispatcher dispatcher(endpoint.url("/hook"));
+    check(dispatcher.start(), "dispatcher starts");
+    dispatcher.submit(makeAlert("disk", "disk_usage:/", 91));
+    endpoint.waitFor(1, 2);
+
+    // An alert storm for one metric while the first delivery is in flight
+    double started = standInSeconds();
+    for (int i = 1; i <= 1000; i++) dispatcher.submit(makeAlert("cpu", "cpu_usage", 90 + i / 100.0));
+    double storm_ms = (standInSeconds() - started) * 1000;
+    check(endpoint.waitFor(2, 3), "the storm is delivered");
+    usleep(500000);
+
+    // The same alert again: delivered moments ago, so suppressed
+    dispatcher.submit(makeAlert("cpu", "cpu_usage", 99));
+    usleep(500000);
+    dispatcher.stop();
+
+    std::vector<StandInRequest> requests = endpoint.getRequests();
+    printf("  1000 submits in %.2f ms, %zu request(s) delivered\n", storm_ms, requests.size());
+    check(storm_ms < 100, "submit() does not wait on the endpoint");
+    check(requests.size() == 2, "storm coalesced into one request, repeat suppressed");
+    if (requests.size() >= 2) {
+        check(requests[1].body.find("\"rule\": \"cpu\"") != std::string::npos, "second request is the storm");
+        check(payloadValue(requests[1].body) == 100.0, "coalesced alert carries the latest value");
+    }
+}
+
+int main() {
+    keepAlive();
+    backoff();
+    coalescing();
+    printf("alert_check: %s\n", check_failures == 0 ? "ok" : "FAILED");
+    return check_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,319 @@
+// Round-trips known data through the columnar exports: a binary sample
+// log (plain and changed-only) and a history store are exported to Arrow
+// IPC and Parquet, read back with the built-in ArrowIpcReader and
+// ParquetReader, and compared with what went in, value by value,
+// including nulls and batch boundaries. A history store whose last flush
+// was torn by a crash must still read back the flush before it.
+//
+//   make -C bench check
+
+#include "arrow_ipc.h"
+#include "columnar.h"
+#include "delta_export.h"
+#include "history_store.h"
+#include "parquet.h"
+#include "sample_log.h"
+#include "stand_in.h"
+#include <cmath>
+#include <fstream>
+
+struct Table {
+    std::vector<std::string> names;       // Series columns, timestamp excluded
+    std::vector<int64_t> timestamps;
+    std::vector<std::vector<double>> columns;
+    size_t batches = 0;
+};
+
+template <typename Reader>
+static bool readTable(const std::string& path, Table& table) {
+    Reader reader;
+    if (!reader.open(path)) {
+        printf("  %s: %s\n", path.c_str(), reader.getError().c_str());
+        return false;
+    }
+    for (const auto& column : reader.getSchema()) {
+        if (!column.timestamp) table.names.push_back(column.name);
+    }
+    table.columns.assign(table.names.size(), std::vector<double>());
+    std::vector<int64_t> timestamps;
+    std::vector<std::vector<double>> values;
+    while (reader.next(timestamps, values)) {
+        table.batches++;
+        table.timestamps.insert(table.timestamps.end(), timestamps.begin(), timestamps.end());
+        for (size_t c = 0; c < values.size() && c < table.columns.size(); c++) {
+            table.columns[c].insert(table.columns[c].end(), values[c].begin(), values[c].end());
+        }
+    }
+    if (!reader.getError().empty()) {
+        printf("  %s: %s\n", path.c_str(), reader.getError().c_str());
+        return false;
+    }
+    return true;
+}
+
+static int columnOf(const Table& table, const std::string& prefix) {
+    for (size_t c = 0; c < table.names.size(); c++) {
+        if (table.names[c].compare(0, prefix.size(), prefix) == 0) return static_cast<int>(c);
+    }
+    return -1;
+}
+
+static bool same(double a, double b) {
+    return (std::isnan(a) && std::isnan(b)) || std::fabs(a - b) < 1e-9;
+}
+
+// Both files hold identical tables
+static void compareFormats(const Table& arrow, const Table& parquet) {
+    check(arrow.names == parquet.names, "same columns in Arrow and Parquet");
+    check(arrow.timestamps == parquet.timestamps, "same timestamps in Arrow and Parquet");
+    check(arrow.batches == parquet.batches, "one Parquet row group per Arrow batch");
+    bool equal = arrow.columns.size() == parquet.columns.size();
+    for (size_t c = 0; equal && c < arrow.columns.size(); c++) {
+        equal = arrow.columns[c].size() == parquet.columns[c].size();
+        for (size_t r = 0; equal && r < arrow.columns[c].size(); r++) {
+            equal = same(arrow.columns[c][r], parquet.columns[c][r]);
+        }
+    }
+    check(equal, "same values and nulls in Arrow and Parquet");
+}
+
+// --- Binary sample log ------------------------------------------------------
+
+static const int LOG_SAMPLES = 2500;
+static const int64_t LOG_START_MS = 1700000000000LL;
+
+static double logCpu(int i) { return (i * 37 % 10000) / 100.0; }
+
+static UtilizationInfo logSample(int i) {
+    UtilizationInfo util = UtilizationInfo();
+    util.cpu_percent = logCpu(i);
+    util.cpu_per_core = {logCpu(i + 1), logCpu(i + 2)};
+    util.ram_percent = 40 + (i % 50) / 10.0;
+    // A disk that is mounted halfway through: nulls before
+    if (i >= LOG_SAMPLES / 2) {
+        DiskInfo disk = {"/data", "/dev/sdb", 1000, 100 + i % 7, 900 - i % 7, (100 + i % 7) / 10.0};
+        util.disks.push_back(disk);
+    }
+    return util;
+}
+
+static void sampleLog(const std::string& dir) {
+    printf("binary sample log\n");
+    std::string log = dir + "/samples.log";
+    {
+        std::ofstream out(log, std::ios::binary);
+        SampleLogEncoder encoder;
+        out << SampleLogEncoder::fileHeader();
+        for (int i = 0; i < LOG_SAMPLES; i++) out << encoder.encode(logSample(i), LOG_START_MS + i * 1000LL);
+    }
+
+    check(exportSampleLog(log, dir + "/log.arrow", "arrow", 1000) == 0, "exports to Arrow");
+    check(exportSampleLog(log, dir + "/log.parquet", "parquet", 1000) == 0, "exports to Parquet");
+    Table arrow, parquet;
+    if (!check(readTable<ArrowIpcReader>(dir + "/log.arrow", arrow), "Arrow reads back") ||
+        !check(readTable<ParquetReader>(dir + "/log.parquet", parquet), "Parquet reads back")) {
+        return;
+    }
+    printf("  %zu rows x %zu series in %zu batches\n", arrow.timestamps.size(), arrow.names.size(), arrow.batches);
+    compareFormats(arrow, parquet);
+
+    bool timestamps = arrow.timestamps.size() == LOG_SAMPLES;
+    for (int i = 0; timestamps && i < LOG_SAMPLES; i++) timestamps = arrow.timestamps[i] == LOG_START_MS + i * 1000LL;
+    check(timestamps, "every sample's timestamp");
+    check(arrow.batches == 3, "batch_rows rows per batch");
+
+    int cpu = columnOf(arrow, "cpu_usage_percent");
+    int disk = columnOf(arrow, "disk_usage_percent{");
+    if (!check(cpu >= 0 && disk >= 0, "cpu and disk columns")) return;
+    bool values = true, nulls = true;
+    for (int i = 0; timestamps && i < LOG_SAMPLES; i++) {
+        values = values && same(arrow.columns[cpu][i], logCpu(i));
+        double expected = i >= LOG_SAMPLES / 2 ? (100 + i % 7) / 10.0 : NAN;
+        nulls = nulls && same(arrow.columns[disk][i], expected);
+    }
+    check(values, "cpu values as logged");
+    check(nulls, "disk null until mounted, then as logged");
+}
+
+// Changed-only log: values within the deadband of zero must still be
+// written when a series is defined, at the start and at every keyframe
+static void deltaLog(const std::string& dir) {
+    printf("changed-only sample log\n");
+    std::string log = dir + "/delta.log";
+    const int samples = 250;
+    {
+        DeltaOptions delta;
+        delta.enabled = true;
+        delta.deadband = 1;
+        delta.keyframe_every = 100;
+        std::ofstream out(log, std::ios::binary);
+        SampleLogEncoder encoder;
+        encoder.setDelta(delta);
+        out << SampleLogEncoder::fileHeader();
+        for (int i = 0; i < samples; i++) {
+            UtilizationInfo util = UtilizationInfo();
+            util.cpu_percent = logCpu(i);
+            util.load_avg_1 = i < 150 ? 0.41 : 0.25;    // Always within the deadband of 0
+            out << encoder.encode(util, LOG_START_MS + i * 1000LL);
+        }
+    }
+
+    check(exportSampleLog(log, dir + "/delta.arrow", "arrow", 1000) == 0, "exports to Arrow");
+    Table table;
+    if (!check(readTable<ArrowIpcReader>(dir + "/delta.arrow", table), "Arrow reads back")) return;
+    int cpu = columnOf(table, "cpu_usage_percent");
+    int load = columnOf(table, "cpu_load_average_1m");
+    if (!check(cpu >= 0 && load >= 0 && table.timestamps.size() == samples, "one row per sample")) return;
+    bool small = true, within = true;
+    for (int i = 0; i < samples; i++) {
+        // 0.41 from the first sample, 0.25 from the keyframe at 200
+        double expected = i < 200 ? 0.41 : 0.25;
+        small = small && same(table.columns[load][i], expected);
+        within = within && std::fabs(table.columns[cpu][i] - logCpu(i)) <= 1 + 1e-9;
+    }
+    check(small, "sub-deadband value read back from the first sample and keyframes");
+    check(within, "other values within their deadband");
+}
+
+// --- History store ----------------------------------------------------------
+
+static const int STORE_SAMPLES = 5000;
+static const int64_t STORE_START_MS = 1700000040000LL;    // On a minute
+
+static double storeValue(int series, int i) {
+    return std::round((50 + 30 * std::sin(i / (60.0 + series * 13)) + (i * 7 % 13) / 10.0) * 100) / 100;
+}
+
+static void historyStore(const std::string& dir) {
+    printf("history store\n");
+    std::string path = dir + "/history.tsdb";
+    HistoryStoreOptions options;
+    std::string error;
+    parseHistoryTiers("1m:0", options.rollups, error);
+    {
+        HistoryStore store;
+        if (!check(store.open(path, options), "store opens")) return;
+        HistoryStore::SeriesId a = store.series("memory_usage_percent", 2);
+        HistoryStore::SeriesId b = store.series("cpu_core_usage_percent{core=\"0\"}", 2);
+        for (int i = 0; i < STORE_SAMPLES; i++) {
+            int64_t timestamp = STORE_START_MS + i * 1000LL;
+            store.append(a, timestamp, storeValue(0, i));
+            if (i >= 1000) store.append(b, timestamp, storeValue(1, i));   // Starts later
+        }
+        store.close();
+    }
+
+    check(exportHistoryStore(path, dir + "/raw.arrow", "arrow", 2048) == 0, "raw export to Arrow");
+    check(exportHistoryStore(path, dir + "/raw.parquet", "parquet", 2048) == 0, "raw export to Parquet");
+    Table arrow, parquet;
+    if (check(readTable<ArrowIpcReader>(dir + "/raw.arrow", arrow), "Arrow reads back") &&
+        check(readTable<ParquetReader>(dir + "/raw.parquet", parquet), "Parquet reads back")) {
+        printf("  raw: %zu rows x %zu series in %zu batches\n", arrow.timestamps.size(), arrow.names.size(), arrow.batches);
+        compareFormats(arrow, parquet);
+        int memory = columnOf(arrow, "memory_usage_percent");
+        int core = columnOf(arrow, "cpu_core_usage_percent{");
+        bool rows = arrow.timestamps.size() == STORE_SAMPLES && memory >= 0 && core >= 0;
+        check(rows, "one row per sample, both series");
+        bool values = rows;
+        for (int i = 0; values && i < STORE_SAMPLES; i++) {
+            values = arrow.timestamps[i] == STORE_START_MS + i * 1000LL &&
+                     same(arrow.columns[memory][i], storeValue(0, i)) &&
+                     same(arrow.columns[core][i], i >= 1000 ? storeValue(1, i) : NAN);
+        }
+        check(values, "values and nulls as stored");
+    }
+
+    // Per-minute buckets from the 1m tier against the same buckets computed here
+    check(exportHistoryStore(path, dir + "/1m.parquet", "parquet", 2048, 60000) == 0, "1m export to Parquet");
+    Table buckets;
+    if (!check(readTable<ParquetReader>(dir + "/1m.parquet", buckets), "1m Parquet reads back")) return;
+    int average = columnOf(buckets, "memory_usage_percent");
+    int minimum = columnOf(buckets, "memory_usage_percent@min");
+    int maximum = columnOf(buckets, "memory_usage_percent@max");
+    size_t minutes = (STORE_SAMPLES + 59) / 60;
+    bool shape = buckets.timestamps.size() == minutes && average >= 0 && minimum >= 0 && maximum >= 0;
+    check(shape, "one row per minute with average, @min and @max");
+    bool values = shape;
+    for (size_t m = 0; values && m < minutes; m++) {
+        double sum = 0, low = INFINITY, high = -INFINITY;
+        int count = 0;
+        for (int i = static_cast<int>(m) * 60; i < STORE_SAMPLES && i < static_cast<int>(m + 1) * 60; i++) {
+            double value = storeValue(0, i);
+            sum += value;
+            low = std::min(low, value);
+            high = std::max(high, value);
+            count++;
+        }
+        values = buckets.timestamps[m] == STORE_START_MS + static_cast<int64_t>(m) * 60000 &&
+                 std::fabs(buckets.columns[average][m] - sum / count) < 1e-6 &&
+                 same(buckets.columns[minimum][m], low) && same(buckets.columns[maximum][m], high);
+    }
+    check(values, "bucket averages, minima and maxima");
+}
+
+// A crash tearing a flush of the open block must leave what the flush
+// before it wrote: the store is copied as it is on disk after three
+// flushes, the newest copy of the block is torn, and the copy read back
+static void tornFlush(const std::string& dir) {
+    printf("history store with a torn flush\n");
+    std::string path = dir + "/torn.tsdb";
+    std::string crashed = dir + "/crashed.tsdb";
+    HistoryStore store;
+    if (!check(store.open(path, HistoryStoreOptions()), "store opens")) return;
+    HistoryStore::SeriesId id = store.series("memory_usage_percent", 2);
+    int flushed[] = {100, 150, 170};
+    int next = 0;
+    for (int upto : flushed) {
+        for (; next < upto; next++) store.append(id, STORE_START_MS + next * 1000LL, storeValue(0, next));
+        store.flush();
+    }
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::ofstream out(crashed, std::ios::binary);
+        out << in.rdbuf();
+    }
+    store.close();
+
+    HistoryStoreReader reader;
+    if (!check(reader.open(crashed), "crashed copy opens") || !check(reader.sampleCount() == 170, "all flushed samples")) {
+        return;
+    }
+    uint64_t newest = reader.getBlocks(0)[0].offset;
+    reader.close();
+    {
+        std::fstream file(crashed, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(newest + 200));
+        file.write("torn", 4);
+    }
+
+    std::vector<int64_t> timestamps;
+    std::vector<double> values;
+    if (!check(reader.open(crashed), "torn copy opens")) return;
+    reader.read(0, INT64_MIN, INT64_MAX, timestamps, values);
+    bool kept = timestamps.size() == 150;
+    for (int i = 0; kept && i < 150; i++) {
+        kept = timestamps[i] == STORE_START_MS + i * 1000LL && same(values[i], storeValue(0, i));
+    }
+    printf("  %zu of 170 samples read back\n", timestamps.size());
+    check(kept, "samples of the flush before the torn one survive");
+}
+
+int main() {
+    char dir_template[] = "/tmp/sysreport_columnar_check.XXXXXX";
+    if (!mkdtemp(dir_template)) return 1;
+    std::string dir = dir_template;
+
+    sampleLog(dir);
+    deltaLog(dir);
+    historyStore(dir);
+    tornFlush(dir);
+
+    for (const char* name : {"samples.log", "log.arrow", "log.parquet", "delta.log", "delta.arrow",
+                             "history.tsdb", "history.tsdb.1m", "torn.tsdb", "crashed.tsdb",
+                             "raw.arrow", "raw.parquet", "1m.parquet"}) {
+        unlink((dir + "/" + name).c_str());
+    }
+    rmdir(dir.c_str());
+    printf("columnar_check: %s\n", check_failures == 0 ? "ok" : "FAILED");
+    return check_failures == 0 ? 0 : 1;
+}
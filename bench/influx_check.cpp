@@ -0,0 +1,217 @@
+// Runs the InfluxDB push sink against local listeners and checks:
+//   - every datagram and POST body is whole, well-formed line protocol,
+//     including tag values with spaces, commas, '=' and newlines
+//   - UDP datagrams stay within MAX_DATAGRAM and never split a point
+//   - HTTP batches are gzip-compressed POSTs to /write, sized by
+//     batch_size, and batches that failed are retried in order
+//
+//   make -C bench check
+
+#include "influx_push.h"
+#include "exporters.h"
+#include "stand_in.h"
+
+struct Point {
+    std::string measurement;
+    std::vector<std::pair<std::string, std::string>> tags;
+    std::vector<std::pair<std::string, std::string>> fields;
+    std::string timestamp;
+};
+
+// Reads up to an unescaped stop character, unescaping as it goes
+static std::string token(const std::string& line, size_t& pos, const char* stops) {
+    std::string out;
+    while (pos < line.size() && !strchr(stops, line[pos])) {
+        if (line[pos] == '\\' && pos + 1 < line.size()) pos++;
+        out += line[pos++];
+    }
+    return out;
+}
+
+// measurement[,tag=value...] field=value[,field=value...] timestamp
+static bool parsePoint(const std::string& line, Point& point) {
+    size_t pos = 0;
+    point = Point();
+    point.measurement = token(line, pos, ", ");
+    if (point.measurement.empty()) return false;
+    while (pos < line.size() && line[pos] == ',') {
+        pos++;
+        std::string key = token(line, pos, "=");
+        if (pos >= line.size() || key.empty()) return false;
+        pos++;
+        std::string value = token(line, pos, ", ");
+        if (value.empty()) return false;
+        point.tags.emplace_back(key, value);
+    }
+    if (pos >= line.size() || line[pos] != ' ') return false;
+    pos++;
+    do {
+        if (line[pos] == ',') pos++;
+        std::string key = token(line, pos, "=");
+        if (pos >= line.size() || key.empty()) return false;
+        pos++;
+        size_t start = pos;
+        while (pos < line.size() && line[pos] != ',' && line[pos] != ' ') pos++;
+        if (pos == start) return false;
+        point.fields.emplace_back(key, line.substr(start, pos - start));
+    } while (pos < line.size() && line[pos] == ',');
+    if (pos >= line.size() || line[pos] != ' ') return false;
+    point.timestamp = line.substr(pos + 1);
+    return !point.timestamp.empty() &&
+           point.timestamp.find_first_not_of("0123456789") == std::string::npos;
+}
+
+// Every line of a payload; false if any is malformed or the last is unterminated
+static bool parsePayload(const std::string& payload, std::vector<Point>& points) {
+    size_t pos = 0;
+    while (pos < payload.size()) {
+        size_t eol = payload.find('\n', pos);
+        if (eol == std::string::npos) return false;
+        Point point;
+        if (!parsePoint(payload.substr(pos, eol - pos), point)) {
+            printf("  malformed: %s\n", payload.substr(pos, eol - pos).c_str());
+            return false;
+        }
+        points.push_back(point);
+        pos = eol + 1;
+    }
+    return true;
+}
+
+static const char* AWKWARD_MOUNT = "/mnt/My Disk,1=a\nb";
+
+static UtilizationInfo awkwardHost(int i) {
+    UtilizationInfo util = UtilizationInfo();
+    util.cpu_percent = i;
+    util.cpu_per_core = {10, 20, 30, 40};
+    util.ram_percent = 50;
+    DiskInfo disk = {AWKWARD_MOUNT, "/dev/sd b", 100, 40, 60, 40.0};
+    util.disks.push_back(disk);
+    for (int n = 0; n < 40; n++) {
+        NetworkInfo net = {"veth " + std::to_string(n), 1000L * n, 2000L * n, 0.5, 0.25};
+        util.network.push_back(net);
+    }
+    ProcessInfo process = {4242, "evil name,x=1\nnext", 12.5, 64};
+    util.top_processes.push_back(process);
+    return util;
+}
+
+static void writeSample(Sink& sink, int i) {
+    SinkSample sample;
+    sample.util = awkwardHost(i);
+    sample.timestamp_ms = 1700000000000LL + i * 1000LL;
+    sink.write(sample);
+}
+
+static size_t linesPerSample() {
+    std::string lines = InfluxDBExporter::exportMetrics(awkwardHost(0), "sysreport", 1);
+    size_t count = 0;
+    for (char c : lines) count += c == '\n';
+    return count;
+}
+
+static void checkPoints(const std::vector<Point>& points) {
+    bool mount = false, process = false;
+    for (const Point& point : points) {
+        for (const auto& tag : point.tags) {
+            mount = mount || (tag.first == "mount" && tag.second == "/mnt/My Disk,1=a b");
+            process = process || (tag.first == "name" && tag.second == "evil name,x=1 next");
+        }
+    }
+    check(mount, "mount tag with space, comma, '=' and newline survives");
+    check(process, "process name tag survives");
+}
+
+static void udp(size_t lines_per_sample) {
+    printf("udp\n");
+    UdpStandIn listener;
+    if (!check(listener.start(), "UDP listener binds")) return;
+    SinkOptions options;
+    options.type = "influxdb";
+    options.target = "udp://127.0.0.1:" + std::to_string(listener.getPort());
+    options.batch_size = lines_per_sample * 2;
+    options.batch_age_seconds = 60;
+
+    InfluxPushSink sink(options);
+    std::string error;
+    if (!check(sink.open(error), "sink opens")) return;
+    for (int i = 0; i < 6; i++) writeSample(sink, i);
+    sink.close();
+
+    std::vector<std::string> datagrams = listener.drain(200);
+    std::vector<Point> points;
+    bool whole = true, small = true;
+    for (const std::string& datagram : datagrams) {
+        small = small && datagram.size() <= InfluxPushSink::MAX_DATAGRAM;
+        whole = parsePayload(datagram, points) && whole;
+    }
+    printf("  %zu datagrams, %zu points\n", datagrams.size(), points.size());
+    check(small, "datagrams within MAX_DATAGRAM");
+    check(whole, "every datagram is whole lines of valid line protocol");
+    check(points.size() == lines_per_sample * 6, "every point arrives");
+    checkPoints(points);
+}
+
+static void http(size_t lines_per_sample) {
+    printf("http\n");
+    HttpStandIn listener;
+    if (!check(listener.start(), "HTTP listener listens")) return;
+    std::atomic<int> status(200);
+    listener.setResponder([&status](const StandInRequest&) { return status.load(); });
+
+    SinkOptions options;
+    options.type = "influxdb";
+    options.target = listener.url("/write?db=sysreport");
+    options.batch_size = lines_per_sample * 3;
+    options.batch_age_seconds = 60;
+    options.gzip = true;
+
+    InfluxPushSink sink(options);
+    std::string error;
+    if (!check(sink.open(error), "sink opens")) return;
+    for (int i = 0; i < 9; i++) writeSample(sink, i);
+    check(listener.getRequests().size() == 3, "one POST per batch_size lines");
+
+    // An outage: the failed batch and the next one wait, then go in order
+    status = 503;
+    for (int i = 9; i < 15; i++) writeSample(sink, i);
+    size_t during = listener.getRequests().size();
+    check(during == 4, "nothing more is posted until the backoff passes");
+    status = 200;
+    usleep(1100000);
+    for (int i = 15; i < 18; i++) writeSample(sink, i);
+    sink.close();
+
+    std::vector<StandInRequest> requests = listener.getRequests();
+    std::vector<Point> points;
+    bool valid = true, gzip = true, target = true;
+    std::string previous_timestamp;
+    bool ordered = true;
+    for (size_t r = 0; r < requests.size(); r++) {
+        if (r == 3) continue;   // The 503
+        std::string body;
+        gzip = gzip && requests[r].header("content-encoding") == "gzip" && gunzip(requests[r].body, body);
+        target = target && requests[r].method == "POST" && requests[r].target == "/write?db=sysreport";
+        size_t before = points.size();
+        valid = parsePayload(body, points) && valid;
+        for (size_t p = before; p < points.size(); p++) {
+            if (points[p].timestamp < previous_timestamp) ordered = false;
+            previous_timestamp = points[p].timestamp;
+        }
+    }
+    printf("  %zu requests, %zu points delivered\n", requests.size(), points.size());
+    check(gzip, "bodies are gzip-compressed");
+    check(target, "POSTs go to /write?db=");
+    check(valid, "every body is valid line protocol");
+    check(ordered, "retried batches arrive in order");
+    check(points.size() == lines_per_sample * 18, "every point delivered once");
+    checkPoints(points);
+}
+
+int main() {
+    size_t lines_per_sample = linesPerSample();
+    udp(lines_per_sample);
+    http(lines_per_sample);
+    printf("influx_check: %s\n", check_failures == 0 ? "ok" : "FAILED");
+    return check_failures == 0 ? 0 : 1;
+}
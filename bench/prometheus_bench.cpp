@@ -0,0 +1,95 @@
+// Renders a synthetic large host's Prometheus exposition repeatedly and
+// reports the time per scrape. Build the main tree first, then:
+//
+//   make -C bench run
+//   bench/build/prometheus_bench [iterations] [cores] [interfaces]
+
+#include "exporters.h"
+#include "system_info.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static UtilizationInfo syntheticHost(int cores, int interfaces) {
+    UtilizationInfo util = UtilizationInfo();
+    util.cpu_percent = 37.5;
+    for (int i = 0; i < cores; i++) {
+        util.cpu_per_core.push_back((i * 7919) % 10000 / 100.0);
+    }
+    util.used_ram_mb = 812345;
+    util.available_ram_mb = 211231;
+    util.ram_percent = 79.36;
+    util.used_swap_mb = 1024;
+    util.available_swap_mb = 7168;
+    util.swap_percent = 12.5;
+    util.uptime_seconds = 8640000;
+    util.load_avg_1 = 180.12;
+    util.load_avg_5 = 175.40;
+    util.load_avg_15 = 170.03;
+    for (int i = 0; i < 16; i++) {
+        DiskInfo disk = {"/data" + std::to_string(i), "/dev/nvme" + std::to_string(i) + "n1",
+                         3840, 1200 + i * 10, 2640 - i * 10, 31.25 + i};
+        util.disks.push_back(disk);
+    }
+    for (int i = 0; i < interfaces; i++) {
+        NetworkInfo net = {"veth" + std::to_string(i), 123456789L * (i + 1), 98765432L * (i + 1),
+                           i * 0.25, i * 0.125};
+        util.network.push_back(net);
+    }
+    for (int i = 0; i < 10; i++) {
+        ProcessInfo proc = {1000 + i, "worker-" + std::to_string(i), 95.0 - i, 2048L + i};
+        util.top_processes.push_back(proc);
+    }
+    for (int i = 0; i < 32; i++) util.temperatures.push_back(45.0 + i % 20);
+    for (int i = 0; i < 8; i++) {
+        GPUInfo gpu = {"Accelerator \"" + std::to_string(i) + "\"", "nvidia", 88.5, 40960, 81920, 71, true};
+        util.gpus.push_back(gpu);
+    }
+    for (int i = 0; i < 12; i++) {
+        FanInfo fan = {"fan" + std::to_string(i + 1), 4200 + i * 10};
+        util.fans.push_back(fan);
+    }
+    return util;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    int cores = argc > 2 ? atoi(argv[2]) : 256;
+    int interfaces = argc > 3 ? atoi(argv[3]) : 500;
+    if (iterations <= 0) iterations = 1;
+
+    UtilizationInfo util = syntheticHost(cores, interfaces);
+
+    // Warm-up, and the size of one scrape
+    std::string text = PrometheusExporter::exportMetrics(util, false);
+    size_t lines = 0;
+    for (char c : text) lines += c == '\n';
+
+    auto start = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (int i = 0; i < iterations; i++) {
+        total += PrometheusExporter::exportMetrics(util, false).size();
+    }
+    double returned_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / iterations;
+
+    // The same, appending into one buffer that is reused across scrapes
+    std::string buffer;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        buffer.clear();
+        PrometheusExporter::exportMetrics(util, buffer, false);
+        total += buffer.size();
+    }
+    double reused_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / iterations;
+
+    printf("prometheus: %d cores, %d interfaces: %zu bytes, %zu lines\n",
+           cores, interfaces, text.size(), lines);
+    printf("  returned string  %10.1f us/scrape  %8.1f MB/s\n",
+           returned_us, text.size() / returned_us);
+    printf("  reused buffer    %10.1f us/scrape  %8.1f MB/s\n",
+           reused_us, text.size() / reused_us);
+    return total == 0;
+}
@@ -0,0 +1,118 @@
+// Builds a 30-day, 1-second history store (with the default rollup tiers)
+// and times `sysreport query` expressions over it, on one thread and on
+// all cores. Build the main tree first, then:
+//
+//   make -C bench run
+//   bench/build/query_bench [days] [series] [store path]
+
+#include "history_query.h"
+#include "history_store.h"
+#include "history_tiers.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+static double seconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Slow waves plus noise and the odd spike, at 2 decimals like a real host
+static double sampleValue(uint64_t& state, int series, int64_t second) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    double noise = static_cast<double>(state >> 40) / (1 << 24);
+    double value = 35 + 20 * std::sin(second / (3600.0 + 600 * series)) + 8 * noise;
+    if ((state >> 20) % 5000 == 0) value = 99 + noise;
+    return std::round(std::min(value, 100.0) * 100) / 100;
+}
+
+int main(int argc, char** argv) {
+    int days = argc > 1 ? atoi(argv[1]) : 30;
+    int series_count = argc > 2 ? atoi(argv[2]) : 8;
+    std::string path = argc > 3 ? argv[3] : "/tmp/sysreport_query_bench.tsdb";
+    if (days <= 0) days = 1;
+    if (series_count < 2) series_count = 2;
+
+    HistoryStoreOptions options;
+    std::string error;
+    parseHistoryTiers("1m:90d, 1h:5y", options.rollups, error);
+    for (const HistoryTier& tier : options.rollups) unlink(historyTierPath(path, tier).c_str());
+    unlink(path.c_str());
+
+    // One series for memory, the rest per core
+    const int64_t end_ms = 1790000000000LL;
+    const int64_t samples = static_cast<int64_t>(days) * 86400;
+    const int64_t start_ms = end_ms - samples * 1000;
+    auto start = std::chrono::steady_clock::now();
+    {
+        HistoryStore store;
+        if (!store.open(path, options)) {
+            fprintf(stderr, "%s\n", store.getError().c_str());
+            return 1;
+        }
+        std::vector<HistoryStore::SeriesId> ids;
+        ids.push_back(store.series("memory_usage_percent", 2));
+        for (int i = 1; i < series_count; i++) {
+            ids.push_back(store.series("cpu_core_usage_percent{core=\"" + std::to_string(i - 1) + "\"}", 2));
+        }
+        uint64_t state = 42;
+        for (int64_t second = 0; second < samples; second++) {
+            for (int i = 0; i < series_count; i++) {
+                store.append(ids[i], start_ms + second * 1000, sampleValue(state, i, second));
+            }
+        }
+        store.close();
+    }
+    double build_s = seconds(start);
+
+    HistoryTiers store;
+    if (!store.open(path)) {
+        fprintf(stderr, "%s\n", store.getError().c_str());
+        return 1;
+    }
+    const HistoryStoreReader& raw = *store.getReader(0);
+    printf("query: %d day(s) x %d series at 1s: %llu samples, %zu blocks, %.1f MB raw (%.2f bytes/sample)\n",
+           days, series_count, static_cast<unsigned long long>(raw.sampleCount()), raw.blockCount(),
+           raw.fileSize() / 1e6, static_cast<double>(raw.fileSize()) / raw.sampleCount());
+    printf("  written in %.2f s (%.1f M samples/s, rollups included)\n",
+           build_s, raw.sampleCount() / build_s / 1e6);
+
+    static const char* const QUERIES[] = {
+        "p95(cpu_core_usage_percent{core=\"0\"})",
+        "p95(cpu_core_usage_percent)",
+        "max(memory_usage_percent) step 1d",
+        "avg(cpu_core_usage_percent)[-2h..-1h] step 1m",
+        "max(cpu_core_usage_percent)[7d]",
+        "count(*)",
+    };
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    printf("  %-48s %8s %10s %12s %12s\n", "expression", "tier", "samples", "1 thread", "threads");
+    for (const char* expression : QUERIES) {
+        HistoryQuery query;
+        if (!parseHistoryQuery(expression, end_ms, query, error)) {
+            fprintf(stderr, "%s: %s\n", expression, error.c_str());
+            return 1;
+        }
+        QueryResult result;
+        double best[2] = {1e9, 1e9};
+        unsigned thread_counts[2] = {1, cores};
+        for (int mode = 0; mode < 2; mode++) {
+            for (int run = 0; run < 3; run++) {
+                if (!runHistoryQuery(store, query, thread_counts[mode], result, error)) {
+                    fprintf(stderr, "%s: %s\n", expression, error.c_str());
+                    return 1;
+                }
+                best[mode] = std::min(best[mode], result.elapsed_ms);
+            }
+        }
+        printf("  %-48s %8s %10llu %9.1f ms %9.1f ms (%u)\n", expression, result.tier.c_str(),
+               static_cast<unsigned long long>(result.samples), best[0], best[1], cores);
+    }
+
+    for (const HistoryTier& tier : options.rollups) unlink(historyTierPath(path, tier).c_str());
+    unlink(path.c_str());
+    return 0;
+}
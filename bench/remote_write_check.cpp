@@ -0,0 +1,277 @@
+// Runs the remote-write sink against a local stub receiver that
+// snappy-decodes and protobuf-parses every request, and checks:
+//   - the headers and WriteRequest layout (labels sorted, __name__, job,
+//     instance) and that every sample arrives exactly once
+//   - during an outage batches go to the disk spool and are replayed in
+//     order once the receiver is back
+//   - batches still spooled at shutdown are replayed, in order, by the
+//     next sink using the same spool
+//   - a 4xx batch is dropped rather than retried
+//
+//   make -C bench check
+
+#include "remote_write.h"
+#include "stand_in.h"
+#include <dirent.h>
+#include <map>
+
+// Snappy block format: varint length, then literal and copy elements
+static bool snappyDecode(const std::string& in, std::string& out) {
+    size_t pos = 0;
+    uint64_t length = 0;
+    for (int shift = 0; pos < in.size(); shift += 7) {
+        uint8_t byte = in[pos++];
+        length |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    out.clear();
+    while (pos < in.size()) {
+        uint8_t tag = in[pos++];
+        size_t offset = 0, count = 0;
+        switch (tag & 3) {
+        case 0: {
+            count = (tag >> 2) + 1;
+            if (count > 60) {
+                size_t bytes = count - 60;
+                count = 0;
+                for (size_t i = 0; i < bytes && pos < in.size(); i++) {
+                    count |= static_cast<size_t>(static_cast<uint8_t>(in[pos++])) << (8 * i);
+                }
+                count++;
+            }
+            if (pos + count > in.size()) return false;
+            out.append(in, pos, count);
+            pos += count;
+            continue;
+        }
+        case 1:
+            if (pos >= in.size()) return false;
+            count = ((tag >> 2) & 7) + 4;
+            offset = (static_cast<size_t>(tag >> 5) << 8) | static_cast<uint8_t>(in[pos++]);
+            break;
+        case 2:
+        case 3: {
+            size_t bytes = (tag & 3) == 2 ? 2 : 4;
+            if (pos + bytes > in.size()) return false;
+            count = (tag >> 2) + 1;
+            for (size_t i = 0; i < bytes; i++) offset |= static_cast<size_t>(static_cast<uint8_t>(in[pos++])) << (8 * i);
+            break;
+        }
+        }
+        if (offset == 0 || offset > out.size()) return false;
+        size_t from = out.size() - offset;
+        for (size_t i = 0; i < count; i++) out += out[from + i];   // May overlap itself
+    }
+    return out.size() == length;
+}
+
+struct ProtoField {
+    int number;
+    int wire;
+    uint64_t varint;        // Wire types 0 and 1 (fixed64 bits)
+    std::string bytes;      // Wire type 2
+};
+
+static bool readVarint(const std::string& in, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; pos < in.size() && shift < 64; shift += 7) {
+        uint8_t byte = in[pos++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+static bool parseMessage(const std::string& in, std::vector<ProtoField>& fields) {
+    fields.clear();
+    size_t pos = 0;
+    while (pos < in.size()) {
+        uint64_t key;
+        if (!readVarint(in, pos, key)) return false;
+        ProtoField field = {static_cast<int>(key >> 3), static_cast<int>(key & 7), 0, ""};
+        if (field.wire == 0) {
+            if (!readVarint(in, pos, field.varint)) return false;
+        } else if (field.wire == 1) {
+            if (pos + 8 > in.size()) return false;
+            for (int i = 0; i < 8; i++) field.varint |= static_cast<uint64_t>(static_cast<uint8_t>(in[pos++])) << (8 * i);
+        } else if (field.wire == 2) {
+            uint64_t length;
+            if (!readVarint(in, pos, length) || pos + length > in.size()) return false;
+            field.bytes = in.substr(pos, length);
+            pos += length;
+        } else {
+            return false;
+        }
+        fields.push_back(field);
+    }
+    return true;
+}
+
+// What the receiver saw: cpu_usage_percent samples in arrival order
+struct Receiver {
+    std::vector<int64_t> cpu_timestamps;
+    size_t series = 0;
+    bool decoded = true;
+    bool labels_sorted = true;
+    bool host_labels = true;
+    bool headers = true;
+};
+
+static void receive(const std::vector<StandInRequest>& requests, int status_of_interest, Receiver& seen,
+                    const std::vector<int>& statuses) {
+    for (size_t r = 0; r < requests.size(); r++) {
+        if (statuses[r] != status_of_interest) continue;
+        const StandInRequest& request = requests[r];
+        seen.headers = seen.headers && request.method == "POST" &&
+                       request.header("content-encoding") == "snappy" &&
+                       request.header("content-type") == "application/x-protobuf" &&
+                       request.header("x-prometheus-remote-write-version") == "0.1.0";
+        std::string raw;
+        std::vector<ProtoField> timeseries, parts, label, sample;
+        if (!snappyDecode(request.body, raw) || !parseMessage(raw, timeseries)) {
+            seen.decoded = false;
+            continue;
+        }
+        for (const ProtoField& entry : timeseries) {
+            if (entry.number != 1 || !parseMessage(entry.bytes, parts)) {
+                seen.decoded = false;
+                continue;
+            }
+            seen.series++;
+            std::string name, previous;
+            bool job = false, instance = false;
+            std::vector<int64_t> timestamps;
+            for (const ProtoField& part : parts) {
+                if (part.number == 1 && parseMessage(part.bytes, label) && label.size() == 2) {
+                    if (label[0].bytes < previous) seen.labels_sorted = false;
+                    previous = label[0].bytes;
+                    if (label[0].bytes == "__name__") name = label[1].bytes;
+                    job = job || (label[0].bytes == "job" && label[1].bytes == "sysreport");
+                    instance = instance || label[0].bytes == "instance";
+                } else if (part.number == 2 && parseMessage(part.bytes, sample) && sample.size() == 2) {
+                    timestamps.push_back(static_cast<int64_t>(sample[1].varint));
+                } else {
+                    seen.decoded = false;
+                }
+            }
+            seen.host_labels = seen.host_labels && job && instance;
+            if (name == "cpu_usage_percent") {
+                seen.cpu_timestamps.insert(seen.cpu_timestamps.end(), timestamps.begin(), timestamps.end());
+            }
+        }
+    }
+}
+
+static size_t spooled(const std::string& dir) {
+    size_t count = 0;
+    if (DIR* d = opendir(dir.c_str())) {
+        while (struct dirent* entry = readdir(d)) count += strstr(entry->d_name, ".rw") != nullptr;
+        closedir(d);
+    }
+    return count;
+}
+
+static const int64_t BASE_MS = 1700000000000LL;
+
+static void writeSample(Sink& sink, int i) {
+    SinkSample sample;
+    sample.util = UtilizationInfo();
+    sample.util.cpu_percent = i;
+    sample.timestamp_ms = BASE_MS + i * 1000LL;
+    sink.write(sample);
+}
+
+int main() {
+    char dir_template[] = "/tmp/sysreport_remote_write_check.XXXXXX";
+    if (!mkdtemp(dir_template)) return 1;
+    std::string spool_dir = dir_template;
+
+    HttpStandIn receiver;
+    if (!check(receiver.start(), "stub receiver listens")) return 1;
+    std::atomic<int> status(200);
+    std::vector<int> statuses;     // Per request, in arrival order
+    receiver.setResponder([&](const StandInRequest&) {
+        statuses.push_back(status);
+        return status.load();
+    });
+
+    SinkOptions options;
+    options.name = "check";
+    options.type = "remote_write";
+    options.target = receiver.url("/api/v1/write");
+    options.spool_dir = spool_dir;
+    options.batch_size = 1;       // Every sample is its own batch
+    options.batch_age_seconds = 60;
+    options.timeout_ms = 2000;
+
+    std::string error;
+    {
+        RemoteWriteSink sink(options);
+        check(sink.open(error), "sink opens");
+
+        printf("delivery\n");
+        for (int i = 0; i < 10; i++) writeSample(sink, i);
+        printf("  %zu requests\n", receiver.getRequests().size());
+
+        printf("outage\n");
+        status = 503;
+        for (int i = 10; i < 15; i++) writeSample(sink, i);
+        size_t during = spooled(spool_dir);
+        printf("  %zu batches spooled\n", during);
+        check(during == 5, "batches spooled while the receiver is down");
+        status = 200;
+        writeSample(sink, 15);           // Queues behind the spool until the retry is due
+        usleep(1100000);                 // First backoff is 1 s
+        writeSample(sink, 16);
+        check(spooled(spool_dir) == 0, "spool drained after the outage");
+
+        printf("shutdown with batches spooled\n");
+        status = 503;
+        writeSample(sink, 17);
+        writeSample(sink, 18);
+        sink.close();
+        check(spooled(spool_dir) == 2, "undelivered batches left in the spool");
+    }
+    {
+        status = 200;
+        RemoteWriteSink sink(options);
+        check(sink.open(error), "next sink opens the spool");
+        writeSample(sink, 19);
+        check(spooled(spool_dir) == 0, "spool replayed on the next start");
+
+        printf("rejection\n");
+        status = 400;
+        writeSample(sink, 20);
+        check(spooled(spool_dir) == 0, "a 4xx batch is not spooled");
+        status = 200;
+        writeSample(sink, 21);
+        sink.close();
+    }
+    receiver.stop();
+
+    std::vector<StandInRequest> requests = receiver.getRequests();
+    Receiver seen;
+    receive(requests, 200, seen, statuses);
+    printf("  %zu requests, %zu accepted series, cpu samples:", requests.size(), seen.series);
+    for (int64_t timestamp : seen.cpu_timestamps) printf(" %lld", static_cast<long long>((timestamp - BASE_MS) / 1000));
+    printf("\n");
+
+    check(seen.headers, "remote-write headers on every request");
+    check(seen.decoded, "every body snappy-decodes and parses as a WriteRequest");
+    check(seen.labels_sorted, "labels sorted by name");
+    check(seen.host_labels, "job and instance labels on every series");
+    std::vector<int64_t> expected;
+    for (int i = 0; i < 22; i++) {
+        if (i != 20) expected.push_back(BASE_MS + i * 1000LL);
+    }
+    check(seen.cpu_timestamps == expected, "every accepted sample once, in order, the rejected one dropped");
+
+    Receiver rejected;
+    receive(requests, 400, rejected, statuses);
+    check(rejected.cpu_timestamps.size() == 1 && rejected.cpu_timestamps[0] == BASE_MS + 20000,
+          "the rejected batch was sent once");
+
+    rmdir(spool_dir.c_str());
+    printf("remote_write_check: %s\n", check_failures == 0 ? "ok" : "FAILED");
+    return check_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+// Load-tests the daemon's /metrics endpoint: a forked child serves a
+// synthetic host's exposition from MetricsServer while kept-alive client
+// connections scrape it as fast as they can. Reports scrapes per second and
+// the server's CPU time per scrape (from /proc/PID/stat). Build the main
+// tree first, then:
+//
+//   make -C bench run
+//   bench/build/scrape_bench [seconds] [connections] [port]
+
+#include "exporters.h"
+#include "metrics_server.h"
+#include "system_info.h"
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <signal.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static UtilizationInfo syntheticHost() {
+    UtilizationInfo util = UtilizationInfo();
+    util.cpu_percent = 37.5;
+    for (int i = 0; i < 64; i++) util.cpu_per_core.push_back((i * 7919) % 10000 / 100.0);
+    util.used_ram_mb = 81234;
+    util.available_ram_mb = 21123;
+    util.ram_percent = 79.36;
+    util.uptime_seconds = 8640000;
+    util.load_avg_1 = 18.12;
+    for (int i = 0; i < 8; i++) {
+        DiskInfo disk = {"/data" + std::to_string(i), "/dev/nvme" + std::to_string(i) + "n1",
+                         3840, 1200 + i * 10, 2640 - i * 10, 31.25 + i};
+        util.disks.push_back(disk);
+    }
+    for (int i = 0; i < 16; i++) {
+        NetworkInfo net = {"eth" + std::to_string(i), 123456789L * (i + 1), 98765432L * (i + 1),
+                           i * 0.25, i * 0.125};
+        util.network.push_back(net);
+    }
+    return util;
+}
+
+// utime + stime of a process, in seconds
+static double cpuSeconds(pid_t pid) {
+    std::ifstream in("/proc/" + std::to_string(pid) + "/stat");
+    std::string stat((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    size_t pos = stat.rfind(')');
+    if (pos == std::string::npos) return 0;
+    // Fields after the command name start at field 3; utime is 14, stime 15
+    std::vector<std::string> fields;
+    size_t start = pos + 2;
+    while (start < stat.size()) {
+        size_t end = stat.find(' ', start);
+        if (end == std::string::npos) end = stat.size();
+        fields.push_back(stat.substr(start, end - start));
+        start = end + 1;
+    }
+    if (fields.size() < 13) return 0;
+    return (atof(fields[11].c_str()) + atof(fields[12].c_str())) / sysconf(_SC_CLK_TCK);
+}
+
+static int connectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int attempt = 0; attempt < 100; attempt++) {
+        if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            return fd;
+        }
+        usleep(20000);   // The child may still be binding
+    }
+    close(fd);
+    return -1;
+}
+
+// One kept-alive connection scraping until stop; returns scrapes completed
+static uint64_t scrapeLoop(int port, bool gzip, const std::atomic<bool>& stop, uint64_t& bytes) {
+    int fd = connectTo(port);
+    if (fd < 0) return 0;
+    std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n";
+    if (gzip) request += "Accept-Encoding: gzip\r\n";
+    request += "\r\n";
+
+    std::vector<char> buffer(1 << 20);
+    uint64_t scrapes = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) break;
+        // Read the header, then Content-Length bytes of body
+        size_t have = 0;
+        size_t header_end = std::string::npos;
+        size_t body_length = 0;
+        while (true) {
+            ssize_t r = recv(fd, buffer.data() + have, buffer.size() - have, 0);
+            if (r <= 0) {
+                close(fd);
+                return scrapes;
+            }
+            have += r;
+            if (header_end == std::string::npos) {
+                std::string head(buffer.data(), have);
+                header_end = head.find("\r\n\r\n");
+                if (header_end == std::string::npos) continue;
+                size_t length = head.find("Content-Length: ");
+                body_length = length < header_end ? strtoul(head.c_str() + length + 16, nullptr, 10) : 0;
+                header_end += 4;
+            }
+            if (have >= header_end + body_length) break;
+        }
+        bytes += body_length;
+        scrapes++;
+    }
+    close(fd);
+    return scrapes;
+}
+
+static void run(int port, int connections, double seconds, bool gzip, pid_t server) {
+    std::atomic<bool> stop(false);
+    std::vector<uint64_t> scrapes(connections, 0);
+    std::vector<uint64_t> bytes(connections, 0);
+    std::vector<std::thread> clients;
+
+    double cpu_before = cpuSeconds(server);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < connections; i++) {
+        clients.emplace_back([&, i]() { scrapes[i] = scrapeLoop(port, gzip, stop, bytes[i]); });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto& client : clients) client.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cpu = cpuSeconds(server) - cpu_before;
+
+    uint64_t total = 0, total_bytes = 0;
+    for (int i = 0; i < connections; i++) {
+        total += scrapes[i];
+        total_bytes += bytes[i];
+    }
+    printf("  %-8s %10.0f scrapes/s %8.1f KB/scrape   server CPU %6.2f us/scrape (%4.1f%% of a core)\n",
+           gzip ? "gzip" : "identity", total / elapsed,
+           total > 0 ? total_bytes / 1024.0 / total : 0.0,
+           total > 0 ? cpu * 1e6 / total : 0.0, cpu * 100 / elapsed);
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 3;
+    int connections = argc > 2 ? atoi(argv[2]) : 8;
+    int port = argc > 3 ? atoi(argv[3]) : 19109;
+    if (seconds <= 0) seconds = 1;
+    if (connections <= 0) connections = 1;
+
+    std::string exposition = PrometheusExporter::exportMetrics(syntheticHost(), false);
+
+    int ready[2];
+    if (pipe(ready) != 0) return 1;
+    pid_t server = fork();
+    if (server == 0) {
+        close(ready[0]);
+        MetricsServer metrics("127.0.0.1:" + std::to_string(port));
+        char status = metrics.start() ? 1 : 0;
+        if (status) metrics.publish(exposition);
+        ssize_t ignored = write(ready[1], &status, 1);
+        (void)ignored;
+        if (!status) _exit(1);
+        pause();   // Until the parent's SIGTERM
+        _exit(0);
+    }
+    close(ready[1]);
+    char status = 0;
+    if (read(ready[0], &status, 1) != 1 || !status) {
+        fprintf(stderr, "scrape_bench: cannot listen on 127.0.0.1:%d\n", port);
+        waitpid(server, nullptr, 0);
+        return 1;
+    }
+
+    printf("scrape: %d kept-alive connections for %.1f s, %zu-byte exposition, %u core(s)\n",
+           connections, seconds, exposition.size(), std::thread::hardware_concurrency());
+    run(port, connections, seconds, false, server);
+    run(port, connections, seconds, true, server);
+
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+    return 0;
+}
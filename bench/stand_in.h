@@ -0,0 +1,275 @@
+#ifndef STAND_IN_H
+#define STAND_IN_H
+
+// Local stand-ins for the endpoints the push paths talk to, and a tiny
+// check helper, shared by the *_check programs. Header-only because each
+// bench program is built from a single file.
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int check_failures = 0;
+
+// Prints and counts a failed expectation; the programs exit non-zero if any failed
+inline bool check(bool ok, const char* what) {
+    if (!ok) {
+        printf("  FAIL %s\n", what);
+        check_failures++;
+    }
+    return ok;
+}
+
+inline double standInSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline int bindLoopback(int type, int& port) {
+    int fd = socket(AF_INET, type, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;    // Any free port
+    socklen_t length = sizeof(addr);
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &length) != 0) {
+        close(fd);
+        return -1;
+    }
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// gzip or zlib stream -> bytes; false if it does not decode
+inline bool gunzip(const std::string& input, std::string& output) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) return false;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    output.clear();
+    char chunk[16384];
+    int status;
+    do {
+        stream.next_out = reinterpret_cast<Bytef*>(chunk);
+        stream.avail_out = sizeof(chunk);
+        status = inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END) break;
+        output.append(chunk, sizeof(chunk) - stream.avail_out);
+    } while (status != Z_STREAM_END);
+    inflateEnd(&stream);
+    return status == Z_STREAM_END;
+}
+
+struct StandInRequest {
+    int connection;                 // 0, 1, ... in accept order
+    double at;                      // standInSeconds() when the body was complete
+    std::string method;
+    std::string target;
+    std::vector<std::pair<std::string, std::string>> headers;   // Names lowercased
+    std::string body;
+
+    std::string header(const std::string& name) const {
+        for (const auto& h : headers) {
+            if (h.first == name) return h.second;
+        }
+        return "";
+    }
+};
+
+// HTTP/1.1 server on 127.0.0.1 that records every request and answers with
+// the status the responder returns (200 by default), after an optional
+// delay, keeping connections alive. Bodies must carry a Content-Length.
+class HttpStandIn {
+private:
+    int listen_fd;
+    int port;
+    std::atomic<bool> running;
+    std::thread acceptor;
+    std::vector<std::thread> handlers;
+    std::vector<int> client_fds;
+    std::mutex mutex;
+    std::vector<StandInRequest> requests;
+    std::function<int(const StandInRequest&)> responder;
+    int delay_ms;
+
+public:
+    HttpStandIn() : listen_fd(-1), port(0), running(false), delay_ms(0) {}
+    ~HttpStandIn() { stop(); }
+
+    void setResponder(const std::function<int(const StandInRequest&)>& fn) {
+        std::lock_guard<std::mutex> lock(mutex);
+        responder = fn;
+    }
+    void setDelay(int ms) { delay_ms = ms; }
+
+    bool start() {
+        listen_fd = bindLoopback(SOCK_STREAM, port);
+        if (listen_fd < 0 || listen(listen_fd, 64) != 0) return false;
+        running = true;
+        acceptor = std::thread([this]() { acceptLoop(); });
+        return true;
+    }
+
+    void stop() {
+        if (!running.exchange(false)) return;
+        shutdown(listen_fd, SHUT_RDWR);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int fd : client_fds) shutdown(fd, SHUT_RDWR);
+        }
+        acceptor.join();
+        for (auto& handler : handlers) handler.join();
+        close(listen_fd);
+    }
+
+    int getPort() const { return port; }
+    std::string url(const std::string& path) const {
+        return "http://127.0.0.1:" + std::to_string(port) + path;
+    }
+
+    std::vector<StandInRequest> getRequests() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return requests;
+    }
+    int connections() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return static_cast<int>(client_fds.size());
+    }
+
+    // Wait until at least count requests arrived, or timeout
+    bool waitFor(size_t count, double timeout_seconds) {
+        double deadline = standInSeconds() + timeout_seconds;
+        while (standInSeconds() < deadline) {
+            if (getRequests().size() >= count) return true;
+            usleep(5000);
+        }
+        return false;
+    }
+
+private:
+    void acceptLoop() {
+        while (running) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                if (!running) return;
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            int connection = static_cast<int>(client_fds.size());
+            client_fds.push_back(fd);
+            handlers.emplace_back([this, fd, connection]() { serve(fd, connection); });
+        }
+    }
+
+    void serve(int fd, int connection) {
+        std::string in;
+        char chunk[65536];
+        while (running) {
+            size_t head_end = in.find("\r\n\r\n");
+            if (head_end == std::string::npos) {
+                ssize_t r = recv(fd, chunk, sizeof(chunk), 0);
+                if (r <= 0) break;
+                in.append(chunk, r);
+                continue;
+            }
+
+            StandInRequest request;
+            request.connection = connection;
+            size_t line_end = in.find("\r\n");
+            std::string line = in.substr(0, line_end);
+            size_t space = line.find(' ');
+            request.method = line.substr(0, space);
+            request.target = line.substr(space + 1, line.find(' ', space + 1) - space - 1);
+            size_t pos = line_end + 2;
+            while (pos < head_end) {
+                size_t end = in.find("\r\n", pos);
+                std::string header = in.substr(pos, end - pos);
+                size_t colon = header.find(':');
+                std::string name = header.substr(0, colon);
+                std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                size_t value = header.find_first_not_of(' ', colon + 1);
+                request.headers.emplace_back(name, value == std::string::npos ? "" : header.substr(value));
+                pos = end + 2;
+            }
+            size_t length = strtoul(request.header("content-length").c_str(), nullptr, 10);
+            while (in.size() < head_end + 4 + length) {
+                ssize_t r = recv(fd, chunk, sizeof(chunk), 0);
+                if (r <= 0) break;
+                in.append(chunk, r);
+            }
+            if (in.size() < head_end + 4 + length) break;
+            request.body = in.substr(head_end + 4, length);
+            in.erase(0, head_end + 4 + length);
+            request.at = standInSeconds();
+
+            int status = 200;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (responder) status = responder(request);
+                requests.push_back(request);
+            }
+            if (delay_ms > 0) usleep(delay_ms * 1000);
+            std::string response = "HTTP/1.1 " + std::to_string(status) + " Stand-in\r\n"
+                                   "Content-Length: 0\r\n\r\n";
+            if (send(fd, response.data(), response.size(), MSG_NOSIGNAL) < 0) break;
+        }
+        close(fd);
+    }
+};
+
+// UDP socket on 127.0.0.1 collecting datagrams
+class UdpStandIn {
+private:
+    int fd;
+    int port;
+
+public:
+    UdpStandIn() : fd(-1), port(0) {}
+    ~UdpStandIn() {
+        if (fd >= 0) close(fd);
+    }
+
+    bool start() {
+        fd = bindLoopback(SOCK_DGRAM, port);
+        if (fd < 0) return false;
+        int size = 4 << 20;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        return true;
+    }
+
+    int getPort() const { return port; }
+
+    // Everything that arrives until the socket has been quiet for quiet_ms
+    std::vector<std::string> drain(int quiet_ms) {
+        std::vector<std::string> datagrams;
+        char buffer[65536];
+        struct pollfd pfd = {fd, POLLIN, 0};
+        while (poll(&pfd, 1, quiet_ms) > 0) {
+            ssize_t r = recv(fd, buffer, sizeof(buffer), 0);
+            if (r < 0) break;
+            datagrams.emplace_back(buffer, r);
+        }
+        return datagrams;
+    }
+};
+
+#endif // STAND_IN_H
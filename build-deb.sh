@@ -40,7 +40,7 @@ Version: 0.7.0
 Section: utils
 Priority: optional
 Architecture: amd64
-Depends: libc6 (>= 2.34), libstdc++6 (>= 11), libncurses6 (>= 6)
+Depends: libc6 (>= 2.34), libstdc++6 (>= 11), libncurses6 (>= 6), zlib1g
 Maintainer: Your Name <you@example.com>
 Description: System monitoring and reporting tool
  A comprehensive command-line tool for monitoring system vital statistics
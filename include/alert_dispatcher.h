@@ -0,0 +1,89 @@
+#ifndef ALERT_DISPATCHER_H
+#define ALERT_DISPATCHER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+struct Alert {
+    std::string rule;       // Name of the [alert.NAME] rule
+    std::string metric;     // Series key, e.g. "cpu_usage" or "disk_usage:/home"
+    double value;
+    double threshold;
+    std::string severity;   // info, warning, critical
+    std::string status;     // firing or resolved
+    long timestamp;
+
+    Alert() : value(0), threshold(0), status("firing"), timestamp(0) {}
+};
+
+struct AlertDispatcherOptions {
+    size_t queue_capacity;
+    int timeout_ms;          // Per HTTP request
+    int max_retries;
+    int retry_base_ms;       // First backoff; doubles per attempt
+    int retry_max_ms;
+    int repeat_interval;     // Seconds before an unchanged alert is re-sent
+
+    AlertDispatcherOptions();
+};
+
+// Delivers alerts to a webhook from its own thread.
+//
+// submit() only touches an in-memory queue, so the collection loop never
+// waits on DNS or the network. Alerts for a rule and metric that are
+// already queued are coalesced into the queued entry (latest value wins),
+// an alert that was delivered recently with the same severity and status
+// is suppressed until repeat_interval has passed, and failed deliveries
+// are retried with exponential backoff over one kept-alive connection.
+class AlertDispatcher {
+private:
+    struct Pending {
+        Alert alert;
+        int attempts;
+        long next_attempt_ms;
+    };
+
+    struct Delivered {
+        std::string severity;
+        std::string status;
+        long at_ms;
+    };
+
+    std::string url;
+    AlertDispatcherOptions options;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Pending> queue;
+    std::unordered_map<std::string, Delivered> delivered;
+    std::thread worker;
+    bool stopping;
+    std::string error;
+
+public:
+    AlertDispatcher(const std::string& webhook_url,
+                    const AlertDispatcherOptions& opts = AlertDispatcherOptions());
+    ~AlertDispatcher();
+
+    // Fails (with getError()) if the URL is unusable
+    bool start();
+    void stop();
+
+    // Never blocks on the network. Returns false if the alert was dropped.
+    bool submit(const Alert& alert);
+
+    const std::string& getError() const { return error; }
+
+    // JSON body posted for an alert
+    static std::string formatPayload(const Alert& alert);
+
+private:
+    void run();
+    static std::string keyOf(const Alert& alert);
+};
+
+#endif // ALERT_DISPATCHER_H
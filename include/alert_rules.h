@@ -0,0 +1,114 @@
+#ifndef ALERT_RULES_H
+#define ALERT_RULES_H
+
+#include "system_info.h"
+#include <cmath>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct MetricData;
+
+// One [alert.NAME] section of the config file
+struct AlertRule {
+    std::string name;
+    std::string metric;        // Series key or fnmatch pattern, e.g. "disk_usage:*"
+    double trigger;            // Level that starts the alert
+    double clear;              // Level that ends it (NaN: same as trigger)
+    bool below;                // Alert when the value drops to/below trigger
+    int for_seconds;           // Must stay past trigger this long to fire
+    int clear_for_seconds;     // Must stay past clear this long to resolve
+    std::string severity;
+    bool notify_resolved;
+
+    AlertRule()
+        : trigger(0), clear(NAN), below(false), for_seconds(0), clear_for_seconds(0),
+          severity("warning"), notify_resolved(true) {}
+
+    bool operator==(const AlertRule& other) const;
+    bool operator!=(const AlertRule& other) const { return !(*this == other); }
+};
+
+enum class AlertState {
+    INACTIVE,
+    PENDING,    // Past trigger, waiting out for_seconds
+    FIRING,
+    RESOLVED    // Reported once, then treated as INACTIVE
+};
+
+struct AlertEvent {
+    const AlertRule* rule;
+    std::string series;
+    AlertState state;          // FIRING or RESOLVED
+    double value;
+    bool transition;           // False for the per-sample reminder of a FIRING alert
+};
+
+// Per-series alert state machines.
+//
+// The first time a series key is seen it is matched against every rule
+// pattern once; after that each reading costs one hash lookup plus one
+// transition per matching rule. Non-inactive states are persisted so a
+// restart neither re-fires an ongoing alert nor forgets to resolve it.
+class AlertEngine {
+private:
+    struct RuleState {
+        size_t rule;
+        AlertState state;
+        long since;            // When the current breach (or clear) started
+        long clear_since;      // 0 unless FIRING and past the clear level
+        double value;
+    };
+
+    struct SeriesEntry {
+        std::vector<RuleState> rules;
+    };
+
+    std::vector<AlertRule> rules;
+    std::unordered_map<std::string, SeriesEntry> series;
+    std::vector<AlertEvent> events;
+    bool dirty;
+
+public:
+    explicit AlertEngine(const std::vector<AlertRule>& alert_rules);
+
+    // Feed one reading (now in epoch seconds); transitions are queued
+    void observe(const std::string& key, double value, long now);
+
+    // Transitions since the last call. Every FIRING series is re-reported
+    // on each sample so the dispatcher can send reminders.
+    std::vector<AlertEvent> takeEvents();
+
+    // State persistence (tab-separated text, written atomically)
+    bool loadState(const std::string& path);
+    bool saveState(const std::string& path);
+    bool isDirty() const { return dirty; }
+
+    // Carry pending/firing state over from an engine with older rules
+    // (matched by rule name), e.g. after a config reload
+    void adoptState(const AlertEngine& previous);
+
+    size_t firingCount() const;
+    const std::vector<AlertRule>& getRules() const { return rules; }
+
+    static const char* stateName(AlertState state);
+
+private:
+    SeriesEntry& entryFor(const std::string& key);
+};
+
+// Enumerate every alertable series of a sample: cpu_usage, memory_usage,
+// swap_usage, load_1/5/15, cpu_core:N, disk_usage:MOUNT, net_rx_mbps:IFACE,
+// net_tx_mbps:IFACE, temperature:N, gpu_usage:N, gpu_temperature:N,
+// gpu_memory:N, battery_percent, fan_rpm:LABEL and plugin:PLUGIN:METRIC
+// for numeric plugin values.
+void forEachAlertSeries(const UtilizationInfo& util,
+                        const std::map<std::string, std::vector<MetricData>>* plugin_metrics,
+                        const std::function<void(const std::string&, double)>& fn);
+
+// Rules equivalent to the fixed thresholds used before rules existed
+std::vector<AlertRule> defaultAlertRules(double cpu, double memory, double disk, double gpu);
+
+#endif // ALERT_RULES_H
@@ -0,0 +1,65 @@
+#ifndef ARROW_IPC_H
+#define ARROW_IPC_H
+
+#include "columnar.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Apache Arrow IPC streaming format, written without libarrow.
+//
+// Every message is a flatbuffer (Schema.fbs/Message.fbs, metadata V5)
+// behind the 0xFFFFFFFF continuation marker and its padded length,
+// followed by an 8-byte aligned body:
+//
+//   Schema | RecordBatch | RecordBatch | ... | 0xFFFFFFFF 0x00000000
+//
+// Batches hold a timestamp[ms, UTC] column and float64 columns with a
+// validity bitmap (omitted when a column has no nulls), uncompressed.
+// pyarrow.ipc.open_stream(), pandas and DuckDB read it directly.
+class ArrowIpcWriter : public ColumnarWriter {
+protected:
+    bool writeHeader() override;
+    bool writeBatch() override;
+    bool writeTrailer() override;
+
+private:
+    bool writeMessage(const std::string& metadata);
+};
+
+// Reads back the subset of the stream format ArrowIpcWriter produces:
+// timestamp or int64 columns and float64 columns, no dictionaries or
+// compression. Enough to verify an export and inspect a file.
+class ArrowIpcReader {
+public:
+    struct Column {
+        std::string name;
+        bool timestamp;         // timestamp/int64 rather than float64
+        bool nullable;
+    };
+
+private:
+    std::ifstream in;
+    std::vector<Column> schema;
+    std::string metadata;
+    std::string body;
+    std::string error;
+
+public:
+    bool open(const std::string& path);
+
+    const std::vector<Column>& getSchema() const { return schema; }
+
+    // Next record batch: timestamps from the first timestamp column and
+    // every float64 column, NaN where null. False at the end of the stream
+    // or on error (then getError() is set).
+    bool next(std::vector<int64_t>& timestamps, std::vector<std::vector<double>>& values);
+
+    const std::string& getError() const { return error; }
+
+private:
+    // Type 0 at the end-of-stream marker
+    bool readMessage(uint8_t& header_type);
+};
+
+#endif // ARROW_IPC_H
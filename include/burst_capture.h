@@ -0,0 +1,81 @@
+#ifndef BURST_CAPTURE_H
+#define BURST_CAPTURE_H
+
+#include "system_info.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BurstOptions {
+    bool enabled;
+    int interval_ms;           // Burst cadence (clamped to 10..1000)
+    double window_seconds;     // How long a burst samples after the trigger
+    size_t pre_samples;        // Regular samples kept from before the trigger
+    size_t top_processes;      // Process table size recorded at the peak
+    std::string dir;           // Capture files land here
+
+    BurstOptions();
+};
+
+// Memory, CPU and load at one instant of a burst (or a regular cycle)
+struct BurstSample {
+    int64_t timestamp_ms;
+    double cpu_percent;
+    double ram_percent;
+    double swap_percent;
+    double load_avg_1;
+};
+
+// High-frequency capture around an alert.
+//
+// Outside a burst the only cost is record() copying four numbers from each
+// regular sample into a short pre-trigger ring. trigger() starts a thread
+// that samples CPU (from /proc/stat deltas), memory and load every
+// interval_ms for window_seconds, scanning the process table whenever the
+// triggering metric reaches a new peak and again one interval later, so each
+// process's CPU share comes from its utime + stime delta. The peak's
+// processes are ranked by CPU for a cpu* series and by memory otherwise. The
+// pre-trigger ring, the burst and the peak's processes are written as one
+// JSON file in dir, after which the thread exits and the daemon is back to
+// its normal cadence.
+//
+// record(), trigger() and takeFinished() are called from the collection
+// thread only.
+class BurstCapture {
+private:
+    BurstOptions options;
+    std::deque<BurstSample> pre_trigger;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping;
+    bool running;
+    std::vector<std::string> finished;   // One summary line per completed burst
+
+public:
+    explicit BurstCapture(const BurstOptions& opts);
+    ~BurstCapture();
+
+    void record(const UtilizationInfo& util, int64_t timestamp_ms);
+
+    // Starts a burst for an alert on series; false if one is already running
+    bool trigger(const std::string& rule, const std::string& series, double value);
+
+    // Summaries of bursts completed since the last call, for the daemon log
+    std::vector<std::string> takeFinished();
+
+    // Cuts a running burst short (it is still written out)
+    void stop();
+
+private:
+    void run(std::string rule, std::string series, double value,
+             std::deque<BurstSample> before);
+    bool sleepFor(int64_t milliseconds);
+};
+
+#endif // BURST_CAPTURE_H
@@ -0,0 +1,77 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Column-oriented export for offline analysis (pandas, DuckDB, Polars).
+//
+// A table is a non-null "timestamp" column (milliseconds since the epoch,
+// UTC) followed by one nullable float64 column per series, named by its
+// Prometheus series key, e.g. disk_usage_percent{mount="/",device="/dev/sda1"}.
+// Rows are buffered column-major and written every batch_rows rows, so
+// memory stays at batch_rows x columns values however long the range is.
+class ColumnarWriter {
+protected:
+    std::ofstream out;
+    std::vector<std::string> names;           // Series columns (timestamp excluded)
+    size_t batch_rows;
+    std::vector<int64_t> timestamps;          // The pending batch
+    std::vector<std::vector<double>> columns; // NaN marks a missing value
+    uint64_t rows_written;
+    uint64_t bytes_written;
+    std::string error;
+
+public:
+    ColumnarWriter();
+    virtual ~ColumnarWriter() {}
+
+    bool open(const std::string& path, const std::vector<std::string>& column_names,
+              size_t rows_per_batch);
+    // values[i] belongs to column i; NaN where the series had no value
+    bool append(int64_t timestamp_ms, const std::vector<double>& values);
+    // Writes the last batch and the trailer
+    bool close();
+
+    uint64_t rowCount() const { return rows_written + timestamps.size(); }
+    const std::string& getError() const { return error; }
+
+protected:
+    virtual bool writeHeader() = 0;
+    virtual bool writeBatch() = 0;          // timestamps/columns -> file
+    virtual bool writeTrailer() = 0;
+
+    bool write(const void* data, size_t length);
+    bool writePadding(size_t length);
+
+private:
+    bool flushBatch();
+};
+
+// "arrow" (Arrow IPC stream) or "parquet"; null for anything else
+std::unique_ptr<ColumnarWriter> createColumnarWriter(const std::string& format);
+
+// Format implied by a file name: "parquet" for *.parquet, else "arrow"
+std::string columnarFormatFor(const std::string& path);
+
+// `sysreport export LOG -o FILE`: a binary sample log as a columnar table.
+// The log is read twice (it is mmapped): once to collect the series, once
+// to write the rows. The output is read back to check it.
+int exportSampleLog(const std::string& log_path, const std::string& out_path,
+                    const std::string& format, size_t batch_rows);
+
+// The same for a history store (history_store.h), read an hour of samples
+// at a time and merged into rows by timestamp. With a step, one row per
+// step_ms bucket from the coarsest rollup tier that has it (history_tiers.h):
+// each series' average, then KEY@min and KEY@max.
+int exportHistoryStore(const std::string& store_path, const std::string& out_path,
+                       const std::string& format, size_t batch_rows, int64_t step_ms = 0);
+
+// `sysreport export --inspect FILE`: schema and row count of an Arrow stream
+// or Parquet file
+int inspectColumnarFile(const std::string& path);
+
+#endif // COLUMNAR_H
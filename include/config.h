@@ -3,7 +3,10 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include "system_info.h"
+#include "alert_rules.h"
+#include "sink.h"
 
 struct Config {
     // Display defaults
@@ -37,11 +40,82 @@ struct Config {
     
     // Process display
     int top_process_count = 5;
+    
+    // Daemon defaults ([daemon] section)
+    double daemon_interval = 60.0;
+    std::string daemon_log_file = "/var/log/sysreport.log";
+    std::string daemon_format = "json";
+    std::string metrics_listen;
+    std::string shm_name = "/sysreport";     // Empty disables the snapshot segment
+    int self_stats_interval = 300;
+    
+    // Daemon log writer
+    int log_flush_interval_ms = 1000;
+    std::string log_durability = "none";     // none, periodic, every
+    int log_sync_interval_ms = 5000;
+    int log_sync_every = 100;
+    int log_queue_size = 4096;
+    std::string log_overflow = "drop";       // drop, block
+    
+    // Daemon log rotation (0 disables a trigger; off unless configured)
+    double log_rotate_size_mb = 0.0;
+    double log_rotate_age_hours = 0.0;
+    int log_retention = 0;
+    std::string log_compression = "gzip";    // gzip, none
+    
+    // Alert webhook ([webhook] section)
+    std::string webhook_url;
+    int webhook_timeout_ms = 5000;
+    int webhook_queue_size = 64;
+    int webhook_max_retries = 5;
+    int webhook_repeat_interval = 300;
+    
+    // Alert rules ([alert.NAME] sections; empty uses the built-in thresholds)
+    std::vector<AlertRule> alert_rules;
+    std::string alert_state_file = "/var/lib/sysreport/alerts.state";
+    bool watch_config = false;   // Reload on change (inotify), besides SIGHUP
+    
+    // Burst capture around alerts
+    bool burst_capture = false;
+    int burst_interval_ms = 100;
+    double burst_window = 10.0;
+    int burst_pre_samples = 10;
+    int burst_top_processes = 10;
+    std::string burst_dir = "/var/lib/sysreport/bursts";
+    
+    // Self-throttling (0 disables a limit)
+    double cpu_budget_percent = 0.0;
+    double rss_budget_mb = 0.0;
+    bool collector_sched_idle = false;
+    std::string collector_cpus;
+    
+    // Changed-only daemon log (json, influxdb and binary formats)
+    bool delta_export = false;
+    int delta_keyframe_every = 60;
+    double delta_deadband = 0.0;
+    std::string delta_deadbands;
+    
+    // Long-term compressed history (empty disables)
+    std::string history_store;
+    int history_precision = 2;               // Decimals kept; negative: exact
+    int history_flush_interval = 10;         // Seconds between durable flushes
+    std::string history_retention = "14d";   // Raw samples; 0 keeps them
+    std::string history_rollups = "1m:90d, 1h:5y";   // step:retention tiers
+    
+    // Extra outputs fed from the same samples ([sink.NAME] sections)
+    std::vector<SinkOptions> sinks;
 };
 
 // Load configuration from file
 Config loadConfig(const std::string& config_path = "");
 
+// Re-read the config file for a live reload. On failure (unreadable file or
+// a value validateConfig rejects) config is left untouched.
+bool reloadConfig(const std::string& config_path, Config& config, std::string& error);
+
+// Check values that would otherwise be silently replaced by defaults
+bool validateConfig(const Config& config, std::string& error);
+
 // Get default config file path (~/.config/sysreport/config.conf)
 std::string getDefaultConfigPath();
 
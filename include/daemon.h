@@ -3,31 +3,108 @@
 
 #include "system_info.h"
 #include "config.h"
+#include "scheduler.h"
+#include "metrics_server.h"
+#include "log_writer.h"
+#include "sample_log.h"
+#include "alert_dispatcher.h"
+#include "alert_rules.h"
+#include "sink.h"
+#include "shm_snapshot.h"
+#include "burst_capture.h"
+#include "resource_budget.h"
+#include "metric_registry.h"
+#include "delta_export.h"
+#include "history_store.h"
 #include <string>
-#include <fstream>
+#include <memory>
+#include <functional>
+
+class PluginManager;
 
 struct DaemonConfig {
-    int interval_seconds;
+    double interval_seconds;   // Fractional values give sub-second cadence
+    bool align_to_wall_clock;  // Tick on wall-clock multiples of the interval
     std::string log_file;
     std::string pid_file;
-    std::string export_format; // "prometheus", "influxdb", "json", "csv"
+    std::string export_format; // "prometheus", "influxdb", "json", "csv", "binary"
     bool enable_webhooks;
     std::string webhook_url;
+    std::string metrics_listen;  // HTTP /metrics address, empty disables
+    std::string shm_name;        // Shared-memory snapshot segment, empty disables
     
-    // Alert thresholds
+    // Alert thresholds, used when no alert rules are configured
     double cpu_threshold;
     double memory_threshold;
     double disk_threshold;
     double gpu_threshold;
     
+    // [alert.NAME] rules and where their state survives restarts
+    std::vector<AlertRule> alert_rules;
+    std::string alert_state_file;
+    
+    // Also reload when the config file changes (SIGHUP always reloads)
+    bool watch_config;
+    
+    // Additional outputs, each formatted on its own thread
+    std::vector<SinkOptions> sinks;
+    
+    // Seconds between self-stats dumps to the log (0 disables)
+    int self_stats_interval;
+    
+    // Batching/durability of the log writer thread
+    LogWriterOptions log_options;
+    
+    // Queueing/retry behaviour of webhook delivery
+    AlertDispatcherOptions webhook_options;
+    
+    // High-frequency capture when an alert fires
+    BurstOptions burst_options;
+    
+    // The daemon's own CPU/RSS limits and collection thread scheduling
+    BudgetOptions budget_options;
+    
+    // Changed-only log entries (json, influxdb and binary formats)
+    DeltaOptions delta_options;
+    
+    // Compressed long-term history, empty path disables
+    std::string history_store;
+    int history_precision;
+    int history_flush_interval;
+    std::string history_retention;
+    std::string history_rollups;
+    
     DaemonConfig();
 };
 
+// Apply the [daemon] section of the config file (CLI flags override afterwards)
+void applyConfigToDaemonConfig(const Config& config, DaemonConfig& daemon_cfg);
+
 class DaemonMode {
 private:
     DaemonConfig config;
-    std::ofstream log_stream;
+    std::unique_ptr<LogWriter> log_writer;
     bool running;
+    Scheduler scheduler;
+    std::unique_ptr<MetricsServer> metrics_server;
+    SampleLogEncoder sample_encoder;   // Used when export_format is "binary"
+    std::unique_ptr<DeltaFilter> log_delta;   // Changed-only json/influxdb log
+    std::unique_ptr<AlertDispatcher> alert_dispatcher;
+    std::unique_ptr<AlertEngine> alert_engine;
+    SinkFanout sinks;
+    ShmPublisher shm_publisher;
+    HistoryStore history_store;
+    std::unique_ptr<BurstCapture> burst_capture;
+    std::unique_ptr<ResourceBudget> budget;
+    std::vector<ProcessInfo> last_processes;   // Reused between slowed-down scans
+    MetricRegistry metrics;            // Sample plus plugin metrics, for /metrics
+    UtilizationMetrics metric_recorder;
+    PluginManager* plugin_manager;     // Not owned; may be null
+    
+    // Where SIGHUP reloads settings from
+    std::string config_path;
+    std::function<void(DaemonConfig&)> cli_overrides;
+    int inotify_fd;
     
 public:
     DaemonMode(const DaemonConfig& cfg);
@@ -37,15 +114,35 @@ public:
     void stop();
     bool isRunning() const;
     
+    // Plugin metrics are collected each cycle so rules can alert on them
+    void setPluginManager(PluginManager* manager) { plugin_manager = manager; }
+    
+    // Config file re-read on SIGHUP; overrides re-applies command-line flags
+    // on top of it so they keep taking precedence after a reload
+    void setConfigSource(const std::string& path,
+                         const std::function<void(DaemonConfig&)>& overrides);
+    
     static bool daemonize();
     static bool writePidFile(const std::string& pid_file);
     static bool removePidFile(const std::string& pid_file);
     
 private:
     void run();
-    void checkAlerts(const UtilizationInfo& util);
+    void collectOnce();
+    void handleHangup();
+    void reloadConfig();
+    void startAlertDispatcher();
+    std::vector<AlertRule> effectiveAlertRules() const;
+    void watchConfigFile(bool enable);
+    bool configFileChanged();
+    void logLine(const std::string& line);
+    void checkAlerts(const UtilizationInfo& util,
+                     const std::map<std::string, std::vector<MetricData>>* plugin_metrics);
+    void logFinishedBursts();
     void logMetrics(const UtilizationInfo& util);
+    void logSelfStats();
     std::string formatLogEntry(const UtilizationInfo& util);
+    std::string formatDeltaEntry(const UtilizationInfo& util);
 };
 
 #endif // DAEMON_H
@@ -0,0 +1,84 @@
+#ifndef DELTA_EXPORT_H
+#define DELTA_EXPORT_H
+
+#include "metric_registry.h"
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Changed-only export ("delta", "keyframe_every", "deadband" and
+// "deadbands" in a [sink.NAME] section, delta_* in [daemon])
+struct DeltaOptions {
+    bool enabled;
+    int keyframe_every;        // Full sample every N samples (0: first sample only)
+    double deadband;           // Change a series must exceed to be sent again
+    std::string deadbands;     // Per metric, e.g. "cpu_*:2, disk_*_bytes:1073741824"
+
+    DeltaOptions();
+
+    bool operator==(const DeltaOptions& other) const;
+    bool operator!=(const DeltaOptions& other) const { return !(*this == other); }
+};
+
+typedef std::vector<std::pair<std::string, double>> DeadbandPatterns;
+
+// "pattern:value" entries separated by commas; patterns are shell globs
+// over metric family names (as in the Prometheus output)
+bool parseDeadbands(const std::string& spec, DeadbandPatterns& out, std::string& error);
+
+// Deadband for a family: the first matching pattern, else the default
+double deadbandFor(const DeltaOptions& options, const DeadbandPatterns& patterns,
+                   const std::string& family);
+
+// Decides, series by series, what a changed-only stream sends.
+//
+// A series is sent when it is new or has moved by more than its deadband
+// from the value last sent (not the previous sample's, so slow drifts are
+// still reported once they add up). Every keyframe_every samples, and
+// whenever forceKeyframe() is called (a new log segment, a lost batch),
+// everything is sent so consumers can resynchronize. One filter per
+// stream; not thread-safe.
+class DeltaFilter {
+private:
+    struct Sent {
+        double value;
+        uint64_t sample;       // Last sample the series was live in
+        std::string key;       // name{labels}, for the removal list
+    };
+
+    DeltaOptions options;
+    DeadbandPatterns patterns;
+    std::unordered_map<uint64_t, Sent> sent;    // Series id -> last sent
+    std::vector<double> family_deadbands;       // By family id, NaN until resolved
+    uint64_t samples;
+    bool keyframe;
+    bool force_keyframe;
+    std::vector<std::string> removed;
+
+public:
+    explicit DeltaFilter(const DeltaOptions& opts);
+
+    // Starts a sample; true if it is a keyframe
+    bool begin(const MetricRegistry& metrics);
+    // The key of a live series if it is to be sent this sample (and is then
+    // remembered as sent), else null
+    const std::string* pass(const MetricRegistry& metrics, uint32_t handle);
+    // Ends the sample: series sent earlier that were not live in it
+    const std::vector<std::string>& end();
+
+    void forceKeyframe() { force_keyframe = true; }
+    bool isKeyframe() const { return keyframe; }
+};
+
+// Prometheus-style series key, e.g. disk_usage_percent{mount="/",device="/dev/sda1"}
+std::string seriesKey(const MetricRegistry& metrics, uint32_t handle);
+
+// One JSON line of a changed-only stream:
+// {"timestamp":T,"keyframe":true,"values":{"cpu_usage_percent":3.25,...},"removed":["..."]}
+// "keyframe" and "removed" only appear when set.
+std::string formatDeltaJson(const MetricRegistry& metrics, DeltaFilter& filter, time_t timestamp);
+
+#endif // DELTA_EXPORT_H
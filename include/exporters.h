@@ -1,13 +1,49 @@
 #ifndef EXPORTERS_H
 #define EXPORTERS_H
 
+#include "metric_registry.h"
 #include "system_info.h"
 #include <string>
 
+class DeltaFilter;
+
+// Appends Prometheus text exposition to a caller-owned buffer.
+//
+// Numbers go through std::to_chars and label values are escaped straight
+// into the buffer, so a buffer reused across cycles stops allocating once
+// it has grown to the exposition's size. family() writes HELP and TYPE;
+// every sample of that family must follow before the next family().
+class PrometheusWriter {
+private:
+    std::string& out;
+    bool has_labels;
+
+public:
+    explicit PrometheusWriter(std::string& buffer) : out(buffer), has_labels(false) {}
+
+    void family(const char* name, const char* type, const char* help);
+
+    // One sample: begin(), any number of label(), then value()
+    void begin(const char* name);
+    void label(const char* key, const std::string& value);
+    void label(const char* key, long value);
+    void value(double value);    // Two decimals
+    void value(long value);
+
+    void sample(const char* name, double v) { begin(name); value(v); }
+    void sample(const char* name, long v) { begin(name); value(v); }
+};
+
 // Prometheus text format exporter
 class PrometheusExporter {
 public:
-    static std::string exportMetrics(const UtilizationInfo& util);
+    static std::string exportMetrics(const UtilizationInfo& util, bool include_self_stats = true);
+    // Same, appended to out
+    static void exportMetrics(const UtilizationInfo& util, std::string& out,
+                              bool include_self_stats);
+    // Every live series of a registry (util plus e.g. plugin metrics)
+    static void exportMetrics(const MetricRegistry& metrics, std::string& out,
+                              bool include_self_stats);
     static std::string formatMetric(const std::string& name, double value, 
                                     const std::string& labels = "");
     static std::string formatMetric(const std::string& name, long value, 
@@ -17,8 +53,20 @@ public:
 // InfluxDB line protocol exporter
 class InfluxDBExporter {
 public:
+    // timestamp_ns of 0 stamps points with the current time. Tag values
+    // are escaped; tags with empty values are omitted.
     static std::string exportMetrics(const UtilizationInfo& util, 
-                                     const std::string& measurement = "sysreport");
+                                     const std::string& measurement = "sysreport",
+                                     long timestamp_ns = 0);
+    // Same, appended to out (lets batching senders reuse one buffer)
+    static void exportMetrics(const UtilizationInfo& util, std::string& out,
+                              const std::string& measurement, long timestamp_ns);
+    // One point per registry group and label set. With a filter, only the
+    // fields it passes are written and points left without fields are
+    // skipped (one filter sample per call).
+    static void exportMetrics(const MetricRegistry& metrics, std::string& out,
+                              const std::string& measurement, long timestamp_ns,
+                              DeltaFilter* filter = nullptr);
     static std::string formatPoint(const std::string& measurement,
                                    const std::string& fields,
                                    const std::string& tags = "",
@@ -3,12 +3,15 @@
 
 #include <vector>
 #include <string>
-#include <deque>
 #include <map>
+#include <unordered_map>
 #include <chrono>
+#include <cstdint>
+
+struct UtilizationInfo;
 
 struct MetricSnapshot {
-    std::chrono::time_point<std::chrono::steady_clock> timestamp;
+    std::chrono::time_point<std::chrono::system_clock> timestamp;
     double cpu_percent;
     double ram_percent;
     double swap_percent;
@@ -20,37 +23,115 @@ struct MetricSnapshot {
     double gpu_temp;
 };
 
+// Oldest-first view into a ring buffer without copying it. Once the ring
+// has wrapped the values sit in two contiguous pieces.
+template <typename T>
+struct RingSpan {
+    const T* first;
+    size_t first_size;
+    const T* second;
+    size_t second_size;
+
+    size_t size() const { return first_size + second_size; }
+    bool empty() const { return size() == 0; }
+    const T& operator[](size_t i) const {
+        return i < first_size ? first[i] : second[i - first_size];
+    }
+};
+
+typedef RingSpan<double> HistorySpan;
+
+// Recent samples as one fixed-capacity circular buffer per series (SoA):
+// a shared timestamp ring and, per series, capacity contiguous doubles
+// allocated once when the series is first seen. Every series has a slot
+// for every sample, NaN where it had no value, so memory is
+// capacity x (series + 1) x 8 bytes whatever the sampling rate, and
+// recording never allocates once all series exist.
 class MetricHistory {
+public:
+    typedef uint32_t SeriesId;
+    static const SeriesId NO_SERIES = UINT32_MAX;
+
 private:
-    std::deque<MetricSnapshot> snapshots;
-    size_t max_history;
+    size_t capacity;
+    size_t max_series;
+    size_t count;                       // Samples held, up to capacity
+    size_t head;                        // Slot of the newest sample
+    std::vector<int64_t> timestamps;    // Unix ms, one per slot
+    std::vector<std::vector<double>> rings;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, SeriesId> by_name;
+
+    // Snapshot fields, resolved once
+    SeriesId cpu_id, ram_id, swap_id, gpu_id, gpu_temp_id;
+    std::vector<SeriesId> core_ids;
+    std::unordered_map<std::string, SeriesId> disk_ids, rx_ids, tx_ids;
+
     MetricSnapshot baseline;
     bool has_baseline;
-    
+
 public:
-    MetricHistory(size_t max_samples = 60);
-    
+    MetricHistory(size_t max_samples = 60, size_t series_limit = 4096);
+
+    // Starts a new sample, evicting the oldest once full; values are then
+    // set per series
+    void beginSample(int64_t timestamp_ms);
+    // Existing or new series; NO_SERIES beyond the series limit
+    SeriesId addSeries(const std::string& name);
+    SeriesId findSeries(const std::string& name) const;
+    void set(SeriesId id, double value) {
+        if (id < rings.size() && count > 0) rings[id][head] = value;
+    }
+
     void addSnapshot(const MetricSnapshot& snapshot);
+    // Same series as a snapshot, straight from a sample; the first GPU
+    // reads 0 when there is none
+    void addUtilization(int64_t timestamp_ms, const UtilizationInfo& util);
     void setBaseline(const MetricSnapshot& snapshot);
     void clearBaseline();
     bool hasBaseline() const;
-    
-    std::vector<double> getCpuHistory(size_t count = 20) const;
-    std::vector<double> getRamHistory(size_t count = 20) const;
-    std::vector<double> getGpuHistory(size_t count = 20) const;
-    
-    double getCpuTrend() const;
-    double getRamTrend() const;
-    double getGpuTrend() const;
-    
+
+    size_t size() const { return count; }
+    size_t getCapacity() const { return capacity; }
+    size_t seriesCount() const { return names.size(); }
+    const std::string& seriesName(SeriesId id) const { return names[id]; }
+
+    // The newest samples, oldest first
+    HistorySpan getSeries(SeriesId id, size_t samples) const;
+    RingSpan<int64_t> getTimestamps(size_t samples) const;
+
+    HistorySpan getCpuHistory(size_t samples = 20) const { return getSeries(cpu_id, samples); }
+    HistorySpan getRamHistory(size_t samples = 20) const { return getSeries(ram_id, samples); }
+    HistorySpan getGpuHistory(size_t samples = 20) const { return getSeries(gpu_id, samples); }
+
+    // Least-squares slope per sample, ignoring gaps
+    static double getTrend(const HistorySpan& data);
+    double getCpuTrend() const { return getTrend(getCpuHistory(10)); }
+    double getRamTrend() const { return getTrend(getRamHistory(10)); }
+    double getGpuTrend() const { return getTrend(getGpuHistory(10)); }
+
     MetricSnapshot getBaseline() const;
     MetricSnapshot getLatest() const;
-    
-    std::string renderSparkline(const std::vector<double>& data) const;
+
+    std::string renderSparkline(const HistorySpan& data) const;
     std::string getTrendArrow(double trend) const;
-    
+
     bool saveToFile(const std::string& filepath) const;
     bool loadFromFile(const std::string& filepath);
+
+    // Replaces the samples with the last range_ms of a history store
+    // (history_store.h) as points bucket averages, read from the coarsest
+    // rollup tier that has that resolution
+    bool loadFromStore(const std::string& path, int64_t range_ms, size_t points, std::string& error);
+
+    // Arrow IPC or Parquet (see columnar.h), one column per series
+    bool exportColumnar(const std::string& filepath, const std::string& format,
+                        std::string& error) const;
+
+private:
+    void setCores(const std::vector<double>& cores);
+    double latest(SeriesId id) const;
+    void clear();
 };
 
 #endif
@@ -0,0 +1,88 @@
+#ifndef HISTORY_QUERY_H
+#define HISTORY_QUERY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class HistoryTiers;
+
+// `sysreport query EXPR`: one aggregation over a range of stored history
+// (history_store.h), per matching series and optionally per step:
+//
+//   AGG(SELECTOR)[RANGE] step DURATION
+//
+//   AGG       min, max, avg, sum, count, first, last, median or pNN
+//             (p95, p99.9); a bare selector means avg
+//   SELECTOR  metric name, * and ? as wildcards, optionally with label
+//             matchers: disk_usage_percent{mount="/",device!="tmpfs*"}
+//   RANGE     DURATION (the last 7d up to now) or FROM..TO, each of now,
+//             -DURATION, HH:MM[:SS] (the latest one that has passed) or
+//             YYYY-MM-DD[ HH:MM[:SS]] in local time; TO is exclusive.
+//             Without a range, everything stored.
+//   step      One value per bucket of DURATION, aligned to local time
+//             (step 1d: calendar days); without it, one per series
+//
+// e.g. p95(cpu_usage_percent)[02:00..03:00], max(memory_usage_percent)[7d] step 1d
+enum class QueryAggregation { MIN, MAX, AVG, SUM, COUNT, FIRST, LAST, PERCENTILE };
+
+struct QueryLabelMatcher {
+    std::string name;
+    std::string pattern;    // fnmatch
+    bool negate;
+};
+
+struct HistoryQuery {
+    std::string expression;
+    std::string aggregation_name;
+    QueryAggregation aggregation;
+    double percentile;          // 0..100, PERCENTILE only
+    std::string metric;         // fnmatch over the family name
+    std::vector<QueryLabelMatcher> labels;
+    bool has_range;
+    int64_t from_ms;            // Inclusive
+    int64_t to_ms;              // Inclusive
+    int64_t step_ms;            // 0: one value over the whole range
+};
+
+struct QuerySeries {
+    std::string name;
+    std::vector<int64_t> timestamps;    // Bucket starts (the range start without a step)
+    std::vector<double> values;
+};
+
+struct QueryResult {
+    std::vector<QuerySeries> series;
+    std::string tier;           // "raw" or the rollup step read
+    bool edges_rounded;         // Rollup buckets only partly in the range counted whole
+    int64_t from_ms;
+    int64_t to_ms;
+    size_t blocks_total;        // Of the matching series in that tier
+    size_t blocks_scanned;      // Overlapping the range, decoded
+    uint64_t samples;           // Decoded inside the range
+    unsigned threads;
+    bool intact;                // No block failed its CRC
+    double elapsed_ms;
+};
+
+// Resolves relative times against now_ms
+bool parseHistoryQuery(const std::string& expression, int64_t now_ms, HistoryQuery& query,
+                       std::string& error);
+
+// Decodes every block of the matching series that overlaps the range on
+// up to threads threads (0: one per core). min, max, sum, count and avg
+// read the coarsest rollup tier whose buckets tile the query's (or, when
+// raw samples no longer reach back, the finest one that does); the rest
+// need raw samples.
+bool runHistoryQuery(const HistoryTiers& store, const HistoryQuery& query, unsigned threads,
+                     QueryResult& result, std::string& error);
+
+// text, json or csv
+std::string formatQueryResult(const HistoryQuery& query, const QueryResult& result,
+                              const std::string& format);
+
+// The subcommand: 0 on success
+int queryHistoryStore(const std::string& store_path, const std::string& expression,
+                      const std::string& format, unsigned threads);
+
+#endif // HISTORY_QUERY_H
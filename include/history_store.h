@@ -0,0 +1,252 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class MetricRegistry;
+
+// One resolution of history: raw samples (step 0) or a rollup tier of
+// step_ms buckets. Blocks older than retention_ms (0 keeps everything)
+// behind the newest sample have their slots reused.
+struct HistoryTier {
+    int64_t step_ms;
+    int64_t retention_ms;
+};
+
+struct HistoryStoreOptions {
+    int precision = 2;                  // Decimals kept; negative: exact
+    int flush_interval_seconds = 10;
+    int64_t retention_ms = 0;           // Raw samples, 0 keeps them all
+    std::vector<HistoryTier> rollups;   // Ascending steps
+};
+
+// "90s", "5m", "1h", "7d", "2w", "1y"; a bare number is seconds
+bool parseDuration(const std::string& text, int64_t& ms);
+std::string formatDuration(int64_t ms);
+
+// [daemon] history_rollups: "STEP:RETENTION, ..." in ascending steps,
+// e.g. "1m:7d, 1h:1y"; a missing retention keeps the tier forever
+bool parseHistoryTiers(const std::string& spec, std::vector<HistoryTier>& tiers, std::string& error);
+
+// File of a rollup tier next to the raw store: history.tsdb.1m
+std::string historyTierPath(const std::string& base, const HistoryTier& tier);
+
+// Series of a rollup tier for a source series: field 0..3 = min, max, sum,
+// count
+std::string historyRollupSeries(const std::string& key, int field);
+
+// Long-term history on disk ([daemon] history_store), compressed the way
+// Facebook's Gorilla does it: delta-of-delta timestamps and XOR'd values,
+// a bit stream per series. All little-endian:
+//
+//   header block | block | block | ...
+//
+//   header  magic "SYSRTSDB", u32 version, u32 block_size, u32 tiers,
+//           tiers x (i64 step_ms, i64 retention_ms)
+//   block   u32 magic, u8 kind, u8 sealed, u16 tag, u32 series,
+//           u32 count, i64 first_ms, i64 last_ms, u32 payload_bits,
+//           u32 crc32, payload
+//
+// Every block is block_size bytes at a block_size-aligned offset. NAMES
+// blocks hold (u32 id, i8 decimals, u16 length, name) entries; DATA blocks
+// hold count samples of one series. The block headers are the time index:
+// a range read looks at every header but only decodes the blocks that
+// overlap the range, straight from the mmap'd file.
+//
+// Values are kept as round(value x 10^decimals), integers a double holds
+// exactly with mostly zero low mantissa bits, so an unchanged value costs
+// one bit and a small change a dozen. Series of integral metrics keep 0
+// decimals; a negative precision stores values as they are.
+//
+// Appends go to each series' open block in memory. Two slots in the file
+// are reserved when it starts, and flush() writes it to them in turn, then
+// fdatasync()s; a full block is written a last time, as sealed, to the
+// slot not holding the newest copy. Both copies carry the block's tag, and
+// readers take the fuller of the ones that pass their CRC, so a write torn
+// by a crash leaves the previous flush's copy: a crash loses at most the
+// samples since the last flush. The older copy's slot is given up once a
+// flush has synced the sealed one. Nothing else is ever rewritten. Once
+// retention is set, a data block whose last sample has aged out gives its
+// slot to the next new block, so the file stops growing.
+//
+// The header lists the tiers: this file's own first, then for the raw
+// store its rollups. Each rollup tier is a store of its own (same format)
+// next to the raw one, fed by append() as samples arrive: per source series
+// an in-memory bucket collects min, max, sum and count, and is appended to
+// the tier as KEY@min, KEY@max, KEY@sum and KEY@count at the bucket's start
+// once a sample lands in the next bucket. close() writes out the partial
+// buckets; a bucket continued after a restart is then stored twice under
+// the same timestamp, which readers merge like any other two buckets.
+class HistoryStore {
+public:
+    typedef uint32_t SeriesId;
+    static const SeriesId NO_SERIES = UINT32_MAX;
+    static const size_t BLOCK_SIZE = 4096;
+
+private:
+    struct OpenBlock {
+        uint64_t slots[2];          // Reserved slots the copies alternate between
+        int current;                // Slot holding the newest copy, -1 if none
+        uint16_t tag;               // Shared by both copies
+        std::vector<uint8_t> data;  // The whole block, header included
+        size_t bits;                // Payload bits used
+        uint32_t count;
+        int64_t first_ms;
+        int64_t last_ms;
+        int64_t last_delta;
+        uint64_t last_value;        // Bit pattern of the last stored value
+        uint8_t leading;            // XOR window of the last control-11 value
+        uint8_t trailing;
+        bool dirty;                 // Samples not yet flushed
+    };
+    struct Series {
+        std::string name;
+        int decimals;
+        double scale;
+        OpenBlock block;
+    };
+    struct Bucket {
+        int64_t start_ms;
+        double min;
+        double max;
+        double sum;
+        uint32_t count;             // 0: nothing collected yet
+    };
+    struct Rollup {
+        HistoryTier tier;
+        std::unique_ptr<HistoryStore> store;
+        std::vector<Bucket> buckets;                    // Per source series
+        std::vector<std::array<SeriesId, 4>> ids;       // min, max, sum, count
+    };
+
+    int fd;
+    uint64_t next_slot;
+    std::vector<uint64_t> free_slots;                       // Expired blocks'
+    std::vector<uint64_t> unsynced_free;                    // Free after the next fdatasync
+    uint16_t next_tag;
+    std::deque<std::pair<int64_t, uint64_t>> expiring;      // (last_ms, offset), oldest first
+    int64_t retention_ms;
+    int64_t newest_ms;
+    std::vector<Rollup> rollups;
+    std::vector<Series> series_table;
+    std::unordered_map<std::string, SeriesId> by_name;
+    std::vector<SeriesId> unnamed;                        // Not yet in a NAMES block
+    std::unordered_map<uint64_t, SeriesId> by_registry_id;
+    int precision;
+    int64_t flush_interval_ms;
+    int64_t last_flush_ms;
+    std::string error;
+
+public:
+    HistoryStore();
+    ~HistoryStore();
+
+    // Creates the store and its rollup tiers or continues existing ones;
+    // new series keep precision decimals. Fails if another process has it
+    // open.
+    bool open(const std::string& file, const HistoryStoreOptions& options);
+    bool isOpen() const { return fd >= 0; }
+
+    // Existing or new series
+    SeriesId series(const std::string& name, int decimals);
+    void append(SeriesId id, int64_t timestamp_ms, double value);
+
+    // Every live series of a registry sample, under its Prometheus-style
+    // key; flushes once flush_interval has passed
+    void record(const MetricRegistry& metrics, int64_t timestamp_ms);
+
+    bool flush();
+    void close();
+
+    const std::string& getError() const { return error; }
+
+private:
+    bool openFile(const std::string& file, const std::vector<HistoryTier>& tiers);
+    SeriesId addSeries(const std::string& name, int decimals);
+    void rollUp(Rollup& rollup, SeriesId id, int64_t timestamp_ms, double value);
+    void emitBucket(Rollup& rollup, SeriesId id);
+    void releaseExpired();
+    uint64_t reserveSlot();
+    bool writeNames();
+    bool writeBlock(SeriesId id, bool sealed);
+    bool writeAt(uint64_t offset, const uint8_t* data, size_t length);
+};
+
+// Read side, over an mmap of the file. Safe to use while a daemon appends:
+// it sees the blocks that existed at open(), as far as they were written.
+class HistoryStoreReader {
+public:
+    struct Series {
+        std::string name;
+        int decimals;
+        uint64_t samples;
+    };
+    struct Block {
+        uint64_t offset;
+        uint64_t twin;              // Other copy of an open block, 0 if none
+        uint16_t tag;
+        uint32_t count;
+        uint32_t payload_bits;
+        int64_t first_ms;
+        int64_t last_ms;
+    };
+
+private:
+    int fd;
+    const uint8_t* data;
+    size_t size;
+    std::vector<HistoryTier> tiers;
+    std::vector<Series> series;
+    std::unordered_map<std::string, uint32_t> by_name;
+    std::vector<std::vector<Block>> blocks;   // Per series, by first_ms
+    uint64_t total_samples;
+    size_t total_blocks;
+    int64_t first_ms;
+    int64_t last_ms;
+    std::string error;
+
+public:
+    HistoryStoreReader();
+    ~HistoryStoreReader();
+
+    bool open(const std::string& file);
+    void close();
+
+    // This file's own tier first, then (raw store) its rollups
+    const std::vector<HistoryTier>& getTiers() const { return tiers; }
+    const std::vector<Series>& getSeries() const { return series; }
+    uint32_t findSeries(const std::string& name) const;
+
+    // Blocks of a series in time order, for callers that split a scan
+    const std::vector<Block>& getBlocks(uint32_t id) const { return blocks[id]; }
+
+    // Appends the samples with from_ms <= t <= to_ms, in time order; only
+    // the overlapping blocks are decoded. False if a block fails its CRC
+    // (its samples are skipped, the rest still read); a block whose slot
+    // was reused since open() is skipped quietly, its samples expired.
+    bool read(uint32_t id, int64_t from_ms, int64_t to_ms,
+              std::vector<int64_t>& timestamps, std::vector<double>& values) const;
+    bool readBlock(uint32_t id, const Block& block, int64_t from_ms, int64_t to_ms,
+                   std::vector<int64_t>& timestamps, std::vector<double>& values) const;
+
+    uint64_t sampleCount() const { return total_samples; }
+    size_t blockCount() const { return total_blocks; }
+    size_t fileSize() const { return size; }
+    int64_t firstTime() const { return first_ms; }
+    int64_t lastTime() const { return last_ms; }
+    const std::string& getError() const { return error; }
+};
+
+// True if path starts with the store's magic
+bool isHistoryStore(const std::string& path);
+
+// `sysreport export --inspect STORE`: size, compression, tiers and series
+int inspectHistoryStore(const std::string& path);
+
+#endif // HISTORY_STORE_H
@@ -0,0 +1,62 @@
+#ifndef HISTORY_TIERS_H
+#define HISTORY_TIERS_H
+
+#include "history_store.h"
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Samples of one series in [start_ms, start_ms + step)
+struct HistoryBucket {
+    int64_t start_ms;
+    double min;
+    double max;
+    double sum;
+    uint64_t count;
+
+    double average() const { return count > 0 ? sum / count : NAN; }
+};
+
+// A history store and its rollup tiers, read at the resolution a caller
+// asks for from the coarsest tier that still has it
+class HistoryTiers {
+private:
+    std::vector<HistoryTier> tiers;                             // Finest first
+    std::vector<std::unique_ptr<HistoryStoreReader>> readers;   // Null where a tier file is missing
+    std::vector<std::string> names;                             // Source series, raw store ids
+    int64_t first_ms;
+    int64_t last_ms;
+    std::string error;
+
+public:
+    HistoryTiers();
+
+    // The raw store (or a single tier's file); its rollups are found from
+    // the tiers in its header
+    bool open(const std::string& file);
+
+    const std::vector<HistoryTier>& getTiers() const { return tiers; }
+    const HistoryStoreReader* getReader(size_t tier) const { return readers[tier].get(); }
+    const std::vector<std::string>& getNames() const { return names; }
+
+    // Coarsest tier whose step divides step_ms (raw samples always do;
+    // step 0 wants them) that still reaches back to from_ms. A range older
+    // than every such tier falls back to the finest tier that reaches it.
+    size_t pick(int64_t step_ms, int64_t from_ms) const;
+
+    // Buckets of step_ms over [from_ms, to_ms] in time order, aligned to
+    // multiples of step_ms (0: one per sample, or per bucket of a rollup
+    // tier) and merged from the tier pick() chooses, or the given one.
+    // False if a block failed its CRC.
+    bool read(const std::string& name, int64_t from_ms, int64_t to_ms, int64_t step_ms,
+              std::vector<HistoryBucket>& buckets, size_t* tier_used = nullptr) const;
+    bool readTier(size_t tier, const std::string& name, int64_t from_ms, int64_t to_ms,
+                  int64_t step_ms, std::vector<HistoryBucket>& buckets) const;
+
+    int64_t firstTime() const { return first_ms; }
+    int64_t lastTime() const { return last_ms; }
+    const std::string& getError() const { return error; }
+};
+
+#endif // HISTORY_TIERS_H
@@ -0,0 +1,79 @@
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <sys/socket.h>
+#include <string>
+#include <vector>
+
+// Parsed http:// URL
+struct HttpUrl {
+    std::string host;   // Without brackets for IPv6 literals
+    int port;
+    std::string path;
+
+    HttpUrl() : port(80), path("/") {}
+
+    // Only plain http:// is supported; returns false for anything else
+    bool parse(const std::string& url);
+    // Value for the Host: header
+    std::string hostHeader() const;
+};
+
+struct HttpResponse {
+    int status;
+    std::string body;
+
+    HttpResponse() : status(0) {}
+};
+
+// Blocking HTTP/1.1 client for one origin that keeps its connection alive
+// between requests and caches the resolved addresses, so a sender posting
+// every few seconds pays for DNS and the TCP handshake once. All socket
+// operations are bounded by the request timeout. Not thread-safe: each
+// sender thread owns its client.
+class HttpClient {
+private:
+    HttpUrl url;
+    bool valid;
+    int timeout_ms;
+    int fd;
+    bool reused;   // Current connection already served a request
+
+    std::vector<struct sockaddr_storage> addresses;
+    std::vector<socklen_t> address_lengths;
+    long resolved_at;
+
+    std::string last_error;
+
+public:
+    static const int DNS_CACHE_SECONDS = 300;
+    static const size_t MAX_RESPONSE_BYTES = 1024 * 1024;
+
+    explicit HttpClient(const std::string& target_url, int timeout = 5000);
+    ~HttpClient();
+
+    bool isValid() const { return valid; }
+    const HttpUrl& getUrl() const { return url; }
+    const std::string& getLastError() const { return last_error; }
+
+    // POST to the URL's path. Returns false on transport errors only; the
+    // HTTP status is in response.status.
+    bool post(const std::string& body, const std::string& content_type,
+              HttpResponse& response,
+              const std::vector<std::string>& extra_headers = std::vector<std::string>());
+
+    void disconnect();
+
+private:
+    bool attempt(const std::string& head, const std::string& body,
+                 HttpResponse& response, bool& response_started);
+    bool resolve();
+    bool connectSocket(long deadline_ms);
+    bool sendAll(const std::string& head, const std::string& body, long deadline_ms);
+    bool readResponse(HttpResponse& response, bool& keep_alive,
+                      bool& response_started, long deadline_ms);
+    bool fill(std::string& buffer, long deadline_ms);
+    bool waitFor(short events, long deadline_ms);
+};
+
+#endif // HTTP_CLIENT_H
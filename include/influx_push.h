@@ -0,0 +1,71 @@
+#ifndef INFLUX_PUSH_H
+#define INFLUX_PUSH_H
+
+#include "sink.h"
+#include "http_client.h"
+#include <sys/socket.h>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+
+// Pushes InfluxDB line protocol over UDP or HTTP.
+//
+// Points from each sample are appended to one buffer and flushed once
+// batch_size lines or batch_age seconds have accumulated.
+//  - udp://host:port   lines are packed into datagrams of at most
+//                      MAX_DATAGRAM bytes and sent with MSG_DONTWAIT; a
+//                      full socket buffer drops (and counts) the datagram.
+//  - http://host:port/write?db=NAME (or /api/v2/write?...)
+//                      one gzip-compressed POST per batch over a kept-alive
+//                      connection; failed batches are retried with backoff
+//                      from a small in-memory queue.
+// With delta set only changed fields are sent, and whenever points are
+// lost the next sample is sent in full.
+class InfluxPushSink : public Sink {
+private:
+    SinkOptions options;
+    bool use_udp;
+    std::unique_ptr<HttpClient> client;
+
+    // UDP destination
+    std::string udp_host;
+    std::string udp_port;
+    int udp_fd;
+    struct sockaddr_storage udp_addr;
+    socklen_t udp_addr_len;
+
+    std::string buffer;
+    size_t buffered_lines;
+    int64_t batch_started_ms;
+
+    std::deque<std::string> retry_queue;   // HTTP bodies awaiting another attempt
+    int64_t retry_at_ms;
+    int backoff_ms;
+
+    std::unique_ptr<DeltaFilter> delta;     // Changed-only mode
+
+public:
+    static const size_t MAX_DATAGRAM = 1400;   // Stays below a typical path MTU
+    static const size_t MAX_RETRY_BATCHES = 16;
+
+    explicit InfluxPushSink(const SinkOptions& opts);
+    ~InfluxPushSink();
+
+    bool open(std::string& error) override;
+    void write(const SinkSample& sample) override;
+    void close() override;
+
+    // True for the URL forms this sink accepts
+    static bool supportsUrl(const std::string& url);
+
+private:
+    void flush(int64_t now_ms);
+    void sendUdp(const std::string& lines);
+    void sendHttp(std::string body, int64_t now_ms);
+    void retryHttp(int64_t now_ms);
+    // 1: delivered, 0: retry later, -1: rejected for good
+    int postHttp(const std::string& body);
+};
+
+#endif // INFLUX_PUSH_H
@@ -0,0 +1,67 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Appends a JSON string literal (quotes included) with RFC 8259 escaping
+void appendJsonString(std::string& out, const std::string& str);
+
+// Streams a JSON document into a caller-owned buffer.
+//
+// Nothing is built up front: every call appends straight to out, commas
+// and indentation are tracked on a small stack, and numbers go through
+// to_chars, so a buffer reused across samples stops allocating once it
+// has grown to the document's size. Compact output has no whitespace at
+// all (one NDJSON line per document); pretty output puts every member on
+// its own indented line, except inside containers opened with
+// inline_items, which stay on one line. Misuse (a value without a key
+// inside an object, unbalanced ends) is not detected.
+class JsonWriter {
+private:
+    struct Level {
+        bool inline_items;
+        bool empty;
+    };
+
+    std::string& out;
+    bool pretty;
+    std::vector<Level> stack;
+    bool after_key;
+
+public:
+    JsonWriter(std::string& buffer, bool pretty_print);
+
+    void beginObject(bool inline_items = false);
+    void endObject();
+    void beginArray(bool inline_items = false);
+    void endArray();
+
+    void key(const std::string& name);
+
+    void value(const std::string& str);
+    void value(const char* str);
+    void value(bool flag);
+    void integer(long long number);
+    // Fixed-point with the given decimals; NaN and infinities become null
+    void number(double number, int decimals = 2);
+    void null();
+
+    // key() followed by a value
+    void member(const std::string& name, const std::string& str) { key(name); value(str); }
+    void member(const std::string& name, const char* str) { key(name); value(str); }
+    void member(const std::string& name, bool flag) { key(name); value(flag); }
+    void memberInteger(const std::string& name, long long number) { key(name); integer(number); }
+    void memberNumber(const std::string& name, double number, int decimals = 2) {
+        key(name);
+        this->number(number, decimals);
+    }
+
+private:
+    void separate();
+    void newline(size_t depth);
+    void close(char bracket);
+};
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,207 @@
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bounded single-producer/single-consumer ring. push() is only called from
+// one thread and pop() from one other thread; neither takes a lock.
+template <typename T>
+class SpscRing {
+private:
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;  // Next slot to pop (consumer owned)
+    alignas(64) std::atomic<size_t> tail;  // Next slot to push (producer owned)
+
+public:
+    explicit SpscRing(size_t capacity) : head(0), tail(0) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    bool push(T&& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) {
+            return false;  // Full
+        }
+        slots[t & mask] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;  // Empty
+        }
+        value = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return mask + 1; }
+};
+
+// When to fdatasync() the log
+enum class LogDurability {
+    NONE,       // Leave it to the page cache
+    PERIODIC,   // At most every sync_interval_ms
+    EVERY_N     // After every sync_every entries
+};
+
+// What write() does when the ring is full
+enum class LogOverflowPolicy {
+    BLOCK,  // Wait for the writer thread (backpressure on the caller)
+    DROP    // Discard the entry and count it
+};
+
+// How rotated segments are compressed
+enum class LogCompression {
+    NONE,
+    GZIP
+};
+
+struct LogWriterOptions {
+    size_t queue_capacity;
+    int flush_interval_ms;
+    LogDurability durability;
+    int sync_interval_ms;
+    int sync_every;
+    LogOverflowPolicy overflow;
+
+    // Rotation (0 disables each trigger)
+    uint64_t rotate_bytes;
+    int rotate_seconds;
+    int retention;             // Rotated segments to keep (0 keeps all)
+    LogCompression compression;
+
+    LogWriterOptions();
+};
+
+// One slot in the writer queue. Control records travel through the same
+// ring as data so rotation happens exactly between two entries.
+struct LogRecord {
+    enum Kind {
+        DATA,
+        HEADER,   // Written only at the start of an empty segment
+        ROTATE,   // Close, rename and reopen the log
+        REOPEN    // Reopen the path (after external rotation)
+    };
+
+    Kind kind;
+    std::string data;
+
+    LogRecord() : kind(DATA) {}
+    LogRecord(Kind k, std::string d) : kind(k), data(std::move(d)) {}
+};
+
+// Asynchronous append-only log. The caller only moves a string into the ring;
+// a dedicated thread batches queued entries into writev() calls every
+// flush_interval_ms (or sooner when the ring fills up), so a slow disk never
+// stalls the thread that produces entries.
+//
+// Rotation is decided on the producer side (by size and age) and executed by
+// the writer thread as rename + reopen, so no entry is lost or split. Rotated
+// segments are named <path>.<YYYYmmdd-HHMMSS>, gzip-compressed by a low
+// priority background thread and pruned down to the retention count.
+class LogWriter {
+private:
+    std::string path;
+    LogWriterOptions options;
+    SpscRing<LogRecord> ring;
+    int fd;
+    uint64_t file_size;          // Writer thread's view of the open segment
+
+    // Producer-side rotation bookkeeping
+    uint64_t segment_bytes;
+    uint64_t segment_entries;
+    long long segment_started_ms;
+    std::function<std::string()> header_provider;
+
+    std::thread worker;
+    std::atomic<bool> running;
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+    std::mutex space_mutex;
+    std::condition_variable space_cv;
+
+    std::atomic<uint64_t> dropped_count;
+    uint64_t unsynced_entries;
+    long long last_sync_ms;
+
+    // Background compression of rotated segments
+    std::thread compressor;
+    std::mutex compress_mutex;
+    std::condition_variable compress_cv;
+    std::deque<std::string> compress_queue;
+    std::atomic<bool> compress_stop;
+
+public:
+    LogWriter(const std::string& log_path, const LogWriterOptions& opts = LogWriterOptions());
+    ~LogWriter();
+
+    bool open();
+    // Drain everything queued, sync according to policy and stop the thread
+    void close();
+    bool isOpen() const { return running; }
+
+    // Queue one entry; a trailing newline is added unless raw is set.
+    // Returns false if the entry was dropped.
+    bool write(std::string entry, bool raw = false);
+
+    // Start a new segment if the current one is over its size or age limit.
+    // write() does this itself; encoders whose output depends on the segment
+    // (see setHeaderProvider) call it before encoding the next entry.
+    void rotateIfDue();
+
+    // Ask the writer to reopen the path (SIGHUP after external rotation)
+    void requestReopen();
+    // Rotate now regardless of size/age
+    void requestRotate();
+
+    // Called on the producer thread whenever a new segment starts; its
+    // output is written first if the segment is empty (e.g. a file header
+    // for binary logs). Must be set before open().
+    void setHeaderProvider(std::function<std::string()> provider);
+
+    uint64_t dropped() const { return dropped_count.load(std::memory_order_relaxed); }
+    const std::string& getPath() const { return path; }
+
+    static bool parseDurability(const std::string& name, LogDurability& out);
+    static bool parseOverflowPolicy(const std::string& name, LogOverflowPolicy& out);
+    static bool parseCompression(const std::string& name, LogCompression& out);
+
+private:
+    void run();
+    size_t drain();
+    bool writeBatch(std::vector<LogRecord>& batch);
+    void maybeSync(size_t written, bool force);
+
+    void pushControl(LogRecord record);
+    void startSegment();
+    bool openFile();
+    void rotateFile();
+    void reopenFile();
+
+    void compressLoop();
+    void queueCompression(const std::string& rotated_path);
+    bool compressFile(const std::string& rotated_path);
+    void pruneRotated();
+    std::vector<std::string> listRotated() const;
+};
+
+#endif // LOG_WRITER_H
@@ -0,0 +1,161 @@
+#ifndef METRIC_REGISTRY_H
+#define METRIC_REGISTRY_H
+
+#include "system_info.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct MetricData;
+
+enum class MetricType {
+    GAUGE,
+    COUNTER
+};
+
+// How the point formats (InfluxDB, JSON, CSV) write a family's value,
+// where their long-standing fields differ from the Prometheus series
+enum class FieldFormat {
+    VALUE,          // As is (integral families without decimals)
+    MEGABYTES,      // Bytes as megabytes, e.g. the GPU's memory_used_mb
+    BOOLEAN         // true when non-zero, e.g. battery charging
+};
+
+// Label name/value pairs, in the order they are exported
+typedef std::vector<std::pair<std::string, std::string>> MetricLabels;
+
+// One metric name. Besides its Prometheus name every family belongs to a
+// group (the InfluxDB measurement suffix, JSON section and CSV category)
+// under a field name, so the point-oriented formats can merge the families
+// of a group that share a label set into one point.
+struct MetricFamily {
+    std::string name;               // e.g. "disk_usage_percent"
+    MetricType type;
+    std::string unit;               // "percent", "bytes", ... ("" if none)
+    std::string help;
+    std::string group;              // e.g. "disk"
+    std::string field;              // e.g. "usage_percent"
+    bool integral;                  // Exported without decimals
+    FieldFormat field_format;
+    std::vector<uint32_t> series;   // In the order they first appeared
+};
+
+struct MetricSeries {
+    uint64_t id;                    // Never reused, and kept across compaction
+    uint32_t family;
+    uint32_t labels;                // Interned label set
+    double value;
+    uint64_t updated;               // Cycle of the last set()
+};
+
+// Central table of every series an output path can emit.
+//
+// Families are registered once by name. A series is a family plus an
+// interned label set and is updated through its handle, so a steady-state
+// cycle is a store per value and no strings are built. Only the series set
+// during the current cycle are live; exporters skip the rest, and once
+// dead series outnumber the live ones endCycle() compacts the tables and
+// bumps the epoch, invalidating handles cached by recorders.
+class MetricRegistry {
+private:
+    std::vector<MetricFamily> families;
+    std::unordered_map<std::string, uint32_t> family_index;
+    std::vector<MetricLabels> label_sets;
+    std::unordered_map<std::string, uint32_t> label_index;    // Encoded set -> id
+    std::vector<MetricSeries> all_series;
+    std::unordered_map<uint64_t, uint32_t> series_index;      // (family, labels) -> handle
+    uint64_t cycle;
+    uint64_t epoch;
+    uint64_t next_id;
+    std::string scratch;
+
+public:
+    static const uint32_t NO_LABELS = 0;
+    static const uint32_t NONE = 0xffffffffu;
+
+    MetricRegistry();
+
+    // Registers a family, or returns the existing one of that name
+    uint32_t family(const std::string& name, MetricType type, const std::string& unit,
+                    const std::string& help, const std::string& group,
+                    const std::string& field, bool integral = false,
+                    FieldFormat field_format = FieldFormat::VALUE);
+
+    // Interned id of a label set; equal sets get the same id
+    uint32_t labels(const MetricLabels& set);
+
+    // Handle of (family, label set), created on first use
+    uint32_t series(uint32_t family, uint32_t labels = NO_LABELS);
+    uint32_t findSeries(uint32_t family, uint32_t labels) const;
+
+    void set(uint32_t handle, double value) {
+        all_series[handle].value = value;
+        all_series[handle].updated = cycle;
+    }
+
+    // Brackets one sample's updates
+    void beginCycle() { cycle++; }
+    void endCycle();
+
+    bool isLive(uint32_t handle) const { return all_series[handle].updated == cycle; }
+    uint64_t getEpoch() const { return epoch; }
+
+    // One call per group and live label set, with that set's live series
+    // in family order: the points of the InfluxDB, JSON and CSV outputs
+    void forEachPoint(const std::function<void(const std::string& group, const MetricLabels& labels,
+                                               const std::vector<uint32_t>& series)>& fn) const;
+
+    const std::vector<MetricFamily>& getFamilies() const { return families; }
+    const MetricSeries& getSeries(uint32_t handle) const { return all_series[handle]; }
+    const MetricLabels& getLabels(uint32_t id) const { return label_sets[id]; }
+    size_t labelSetCount() const { return label_sets.size(); }
+
+private:
+    void compact();
+};
+
+// Registers the UtilizationInfo families and copies a sample into them.
+// Per-entity handles (cores, disks, interfaces...) are cached by position
+// and only looked up again when the entity at that position changes.
+class UtilizationMetrics {
+private:
+    struct Entity {
+        std::vector<std::string> key;       // Label values it was looked up with
+        std::vector<uint32_t> handles;      // One per family of its kind
+    };
+
+    uint64_t epoch;
+    bool registered;
+    MetricRegistry* registry;
+    std::vector<uint32_t> scalar_families;
+    std::vector<uint32_t> scalar_handles;
+    std::vector<uint32_t> core_families, disk_families, net_families, gpu_families;
+    std::vector<uint32_t> temp_families, fan_families, process_families;
+    std::vector<Entity> cores, disks, nets, gpus, temps, fans, processes;
+    std::vector<std::string> key;
+
+public:
+    UtilizationMetrics();
+
+    // Sets every series util has; call between beginCycle() and endCycle()
+    void record(MetricRegistry& metrics, const UtilizationInfo& util);
+
+private:
+    void registerFamilies(MetricRegistry& metrics);
+    uint32_t scalar(size_t index);
+    Entity& entity(std::vector<Entity>& slots, size_t index,
+                   const std::vector<uint32_t>& families, const char* const* names);
+};
+
+// Numeric plugin metrics as plugin_<name>{plugin="..."} (group "plugin")
+void recordPluginMetrics(MetricRegistry& metrics,
+                         const std::map<std::string, std::vector<MetricData>>& plugin_metrics);
+
+// A per-thread registry holding just util, for callers without their own
+const MetricRegistry& utilizationRegistry(const UtilizationInfo& util);
+
+#endif // METRIC_REGISTRY_H
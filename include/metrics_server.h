@@ -0,0 +1,77 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// One rendered exposition, shared read-only by every connection serving it
+struct MetricsPayload {
+    std::string body;
+    std::string gzip_body;  // Empty if compression failed
+};
+
+// Minimal HTTP/1.1 server for Prometheus scraping.
+//
+// The daemon renders the exposition once per collection cycle and publishes
+// it with publish(); the epoll thread only ever serves the latest published
+// buffer, so scrapes never trigger collection and cost a write of bytes that
+// already exist. Supports keep-alive, pipelined requests, HEAD and gzip.
+class MetricsServer {
+private:
+    struct Connection {
+        std::string in;
+        std::string header;
+        std::shared_ptr<const MetricsPayload> payload;  // Keeps body alive while writing
+        const std::string* body;
+        size_t sent;
+        bool close_after;
+        long last_active;
+    };
+
+    std::string address;
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+    std::thread worker;
+    std::atomic<bool> running;
+    std::shared_ptr<const MetricsPayload> payload;
+    std::unordered_map<int, Connection> connections;
+
+public:
+    static const size_t MAX_REQUEST_BYTES = 8192;
+    static const size_t MAX_CONNECTIONS = 512;
+    static const int IDLE_TIMEOUT_SECONDS = 60;
+
+    // address is "host:port", ":port" or "[v6addr]:port"
+    explicit MetricsServer(const std::string& listen_address);
+    ~MetricsServer();
+
+    bool start();
+    void stop();
+
+    // Swap in a freshly rendered exposition (called once per cycle)
+    void publish(const std::string& body);
+
+    const std::string& getAddress() const { return address; }
+
+private:
+    void serve();
+    void acceptConnections();
+    void handleReadable(int fd);
+    void handleWritable(int fd);
+    bool processRequests(int fd, Connection& conn);
+    void queueResponse(Connection& conn, int status, const std::string& reason,
+                       bool head_only, bool gzip, const std::string& content_type,
+                       const std::string* body);
+    bool flush(int fd, Connection& conn);
+    void closeConnection(int fd);
+    void expireIdle(long now);
+};
+
+// gzip-compress a buffer (used for pre-compressing published payloads)
+bool gzipCompress(const std::string& input, std::string& output, int level = 6);
+
+#endif // METRICS_SERVER_H
@@ -0,0 +1,97 @@
+#ifndef PARQUET_H
+#define PARQUET_H
+
+#include "columnar.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Apache Parquet files, written without libparquet.
+//
+//   "PAR1" | row group | row group | ... | FileMetaData | u32 length | "PAR1"
+//
+// Each batch becomes one row group holding one uncompressed, PLAIN
+// encoded data page (v1) per column. The timestamp column is a required
+// INT64 TIMESTAMP(MILLIS, UTC); series are optional DOUBLEs whose nulls
+// are RLE/bit-packed definition levels. The Thrift compact-protocol footer
+// is built once the last row group is written; it grows with row groups x
+// columns, so large exports want a large batch size.
+class ParquetWriter : public ColumnarWriter {
+private:
+    struct Chunk {
+        int64_t offset;                 // Of the column's data page
+        int64_t size;                   // Page header plus data
+        int64_t values;
+    };
+    struct RowGroup {
+        int64_t rows;
+        std::vector<Chunk> chunks;      // Timestamp first
+    };
+
+    std::vector<RowGroup> row_groups;
+    std::string page;                   // Reused page buffer
+
+protected:
+    bool writeHeader() override;
+    bool writeBatch() override;
+    bool writeTrailer() override;
+
+private:
+    bool writePage(Chunk& chunk, size_t rows);
+};
+
+// Reads back the subset of Parquet that ParquetWriter produces: a flat
+// schema of INT64 and DOUBLE columns in uncompressed, PLAIN encoded v1
+// data pages (optional columns with RLE/bit-packed definition levels). No
+// dictionaries, compression or nesting; those files are refused, not
+// misread. Enough to verify an export and inspect a file.
+class ParquetReader {
+public:
+    struct Column {
+        std::string name;
+        bool timestamp;         // INT64 rather than DOUBLE
+        bool nullable;
+    };
+
+private:
+    struct Chunk {
+        int64_t offset;         // Of the first page
+        int64_t size;
+        int32_t codec;
+    };
+    struct RowGroup {
+        int64_t rows;
+        std::vector<Chunk> chunks;
+    };
+
+    std::ifstream in;
+    std::vector<Column> schema;
+    std::vector<RowGroup> row_groups;
+    size_t next_group;
+    int64_t rows;
+    std::string buffer;
+    std::string error;
+
+public:
+    ParquetReader();
+
+    bool open(const std::string& path);
+
+    const std::vector<Column>& getSchema() const { return schema; }
+    int64_t rowCount() const { return rows; }
+
+    // Next row group: timestamps from the first INT64 column and every
+    // DOUBLE column, NaN where null. False after the last row group or on
+    // error (then getError() is set).
+    bool next(std::vector<int64_t>& timestamps, std::vector<std::vector<double>>& values);
+
+    const std::string& getError() const { return error; }
+
+private:
+    bool readFooter(const std::string& footer);
+    // The column chunk's values; nulls are NaN (doubles) or 0 (INT64)
+    bool readChunk(const Column& column, const Chunk& chunk, int64_t rows,
+                   std::vector<int64_t>* ints, std::vector<double>* doubles);
+};
+
+#endif // PARQUET_H
@@ -0,0 +1,110 @@
+#ifndef REMOTE_WRITE_H
+#define REMOTE_WRITE_H
+
+#include "sink.h"
+#include "http_client.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+typedef std::vector<std::pair<std::string, std::string>> PromLabels;
+
+// Walk the samples of a Prometheus text exposition. Comments are skipped;
+// label values are unescaped.
+void parsePrometheusText(const std::string& text,
+                         const std::function<void(const std::string& name,
+                                                  const PromLabels& labels,
+                                                  double value)>& fn);
+
+// Accumulates samples into a remote-write WriteRequest (prometheus/prompb).
+// Samples of the same series across cycles share one TimeSeries entry.
+class RemoteWriteBatch {
+private:
+    struct Series {
+        std::string labels;    // Encoded Label messages, sorted by name
+        std::vector<std::pair<double, int64_t>> samples;
+    };
+
+    PromLabels extra_labels;
+    std::vector<Series> series;
+    std::unordered_map<std::string, size_t> index;   // Encoded labels -> series
+    size_t sample_count;
+
+public:
+    explicit RemoteWriteBatch(const PromLabels& extra = PromLabels());
+
+    // Add every sample of an exposition, stamped with timestamp_ms
+    void addExposition(const std::string& text, int64_t timestamp_ms);
+    void add(const std::string& name, const PromLabels& labels, double value, int64_t timestamp_ms);
+
+    size_t sampleCount() const { return sample_count; }
+    bool empty() const { return sample_count == 0; }
+    void clear();
+
+    // Serialized WriteRequest (uncompressed protobuf)
+    std::string encode() const;
+};
+
+// Bounded directory of payloads waiting to be sent, oldest first. Each
+// payload is one file written atomically, so a crash loses at most the
+// batch being written; past max_bytes the oldest payloads are dropped.
+class DiskSpool {
+private:
+    std::string dir;
+    uint64_t max_bytes;
+    std::deque<std::pair<std::string, uint64_t>> files;   // Name, size
+    uint64_t total_bytes;
+    uint64_t sequence;
+
+public:
+    DiskSpool(const std::string& directory, uint64_t max_size_bytes);
+
+    // Create the directory and index what an earlier run left behind
+    bool open(std::string& error);
+
+    bool push(const std::string& payload);
+    bool front(std::string& payload) const;
+    void pop();
+
+    bool empty() const { return files.empty(); }
+    size_t count() const { return files.size(); }
+    uint64_t bytes() const { return total_bytes; }
+};
+
+// Pushes samples to a Prometheus remote-write endpoint.
+//
+// Samples are batched until batch_size samples or batch_age seconds have
+// accumulated, then encoded, snappy-compressed and POSTed. A batch that
+// cannot be delivered goes to the disk spool, and while anything is spooled
+// new batches queue behind it so the receiver sees samples in order.
+class RemoteWriteSink : public Sink {
+private:
+    SinkOptions options;
+    HttpClient client;
+    RemoteWriteBatch batch;
+    DiskSpool spool;
+    int64_t batch_started_ms;
+    int64_t retry_at_ms;
+    int backoff_ms;
+
+public:
+    static const int MAX_REPLAY_PER_CYCLE = 16;
+
+    explicit RemoteWriteSink(const SinkOptions& opts);
+
+    bool open(std::string& error) override;
+    void write(const SinkSample& sample) override;
+    void close() override;
+
+private:
+    void flushBatch(int64_t now_ms);
+    void drainSpool(int64_t now_ms);
+    // 1: delivered, 0: retry later, -1: rejected for good
+    int send(const std::string& payload);
+};
+
+#endif // REMOTE_WRITE_H
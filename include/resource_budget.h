@@ -0,0 +1,72 @@
+#ifndef RESOURCE_BUDGET_H
+#define RESOURCE_BUDGET_H
+
+#include "system_info.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+struct BudgetOptions {
+    double cpu_percent;        // Of one core, averaged over a cycle (0: unlimited)
+    double rss_mb;             // Resident set size (0: unlimited)
+    bool sched_idle;           // Run collection under SCHED_IDLE
+    std::string cpus;          // Pin collection to these CPUs, e.g. "0,2-3"
+
+    BudgetOptions();
+};
+
+// Keeps the daemon inside its own CPU and memory budget.
+//
+// update() is called once per cycle: it reads the process's CPU time with
+// getrusage(RUSAGE_SELF) and its RSS from /proc/self/statm. Three cycles in
+// a row over either limit step up one degradation level, ten cycles below
+// 70% of both step back down:
+//
+//   0  everything
+//   1  process table every 4th cycle, top 3 only
+//   2  also no per-core usage, GPUs (nvidia-smi) or sensors
+//   3  no process table at all
+//
+// Usage and the current level are exported as gauges.
+class ResourceBudget {
+private:
+    BudgetOptions options;
+    int level;
+    int over_cycles;
+    int under_cycles;
+    uint64_t cycle;
+
+    bool measured;
+    uint64_t last_cpu_us;
+    std::chrono::steady_clock::time_point last_time;
+    double cpu_percent;
+    double rss_mb;
+
+public:
+    static const int MAX_LEVEL = 3;
+    static const int ESCALATE_AFTER = 3;
+    static const int RELAX_AFTER = 10;
+    static const int SLOW_PROCESS_EVERY = 4;
+
+    explicit ResourceBudget(const BudgetOptions& opts);
+
+    // Measure the cycle that just ended; true if the level changed
+    bool update();
+
+    // What the next cycle may collect
+    CollectionOptions collectionOptions() const;
+
+    // Limits can change on reload without losing the measurements
+    void setLimits(double cpu_limit, double rss_limit);
+
+    int getLevel() const { return level; }
+    double cpuPercent() const { return cpu_percent; }
+    double rssMb() const { return rss_mb; }
+    bool limited() const { return options.cpu_percent > 0 || options.rss_mb > 0; }
+
+    // Applies sched_idle/cpus to the calling thread; threads it starts later
+    // inherit them. Returns false with error set on the first failure.
+    static bool applyScheduling(const BudgetOptions& opts, std::string& error);
+};
+
+#endif // RESOURCE_BUDGET_H
@@ -0,0 +1,134 @@
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include "system_info.h"
+#include "delta_export.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Binary append-only sample log (daemon format "binary").
+//
+// The file is a stream of records, all little-endian:
+//
+//   u8 type | u32 payload_length | payload
+//
+//   HEADER  magic "SYSRPTBL", u16 version, u16 flags, i64 created_ms, hostname
+//   SERIES  u32 id, u8 kind, name                 (dictionary entry)
+//   TEXT    u32 id, bytes                         (new value of a text series)
+//   SAMPLE  i64 timestamp_ms, u32 count, count x (u32 id, i64 delta)
+//   NOTE    free text (daemon start/stop lines, overruns, self stats)
+//
+// Numeric series are integers (INT) or thousandths (MILLI). A SAMPLE only
+// carries the series whose value changed since the previous sample, as a
+// fixed-width delta against it. Vectors (disks, cores, processes...) are
+// flattened by position, e.g. "disk[1].used_gb", with a "disk_count" series
+// giving their length. A HEADER or a SERIES record for an existing id resets
+// the affected state, so segments can be concatenated or appended to.
+enum class SampleRecordType : uint8_t {
+    HEADER = 1,
+    SERIES = 2,
+    TEXT = 3,
+    SAMPLE = 4,
+    NOTE = 5
+};
+
+enum class SampleSeriesKind : uint8_t {
+    INT = 1,
+    MILLI = 2,
+    TEXT = 3
+};
+
+static const uint16_t SAMPLE_LOG_VERSION = 1;
+
+// Producer side: turns UtilizationInfo snapshots into records
+class SampleLogEncoder {
+private:
+    std::unordered_map<uint64_t, uint32_t> ids;   // (field, index) -> series id
+    std::vector<int64_t> last_values;
+    std::vector<std::string> last_texts;
+    std::vector<char> entries;                    // SAMPLE body being built
+    uint32_t entry_count;
+    std::string out;
+    std::vector<double> deadbands;                // By field, in stored units
+    int keyframe_every;
+    uint64_t samples;
+
+public:
+    SampleLogEncoder();
+
+    // Changed-only mode: values within their deadband of the last one
+    // written are skipped, and every keyframe_every samples the dictionary
+    // and all values are written again
+    void setDelta(const DeltaOptions& options);
+
+    // Forget the dictionary; the next sample redefines every series
+    void reset();
+
+    // HEADER record that starts every segment
+    static std::string fileHeader();
+
+    // Dictionary updates, changed text values and one SAMPLE record
+    std::string encode(const UtilizationInfo& util, int64_t timestamp_ms);
+
+    // NOTE record
+    static std::string note(const std::string& text);
+
+private:
+    // fresh: defined by this call, so its value must be written in full
+    uint32_t seriesId(int field, uint32_t index, SampleSeriesKind kind, bool& fresh);
+    void number(int field, uint32_t index, double value);
+    void integer(int field, uint32_t index, int64_t value);
+    void text(int field, uint32_t index, const std::string& value);
+};
+
+// Reader over an mmap()ed log; each next() reconstructs one snapshot
+class SampleLogReader {
+private:
+    struct Series {
+        std::string name;
+        int field = -1;     // -1 for names this build does not know
+        uint32_t index = 0;
+        SampleSeriesKind kind = SampleSeriesKind::INT;
+        int64_t value = 0;
+        std::string text;
+        bool defined = false;
+    };
+
+    int fd;
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+    std::string inflated;   // Decompressed contents of a .gz segment
+    std::vector<Series> series;
+    std::string error;
+    std::string hostname;
+
+public:
+    SampleLogReader();
+    ~SampleLogReader();
+
+    bool open(const std::string& path);
+    void close();
+
+    // Advance to the next SAMPLE; NOTE records are handed to notes if given
+    bool next(UtilizationInfo& util, int64_t& timestamp_ms,
+              std::vector<std::string>* notes = nullptr);
+
+    // Empty unless reading stopped at a malformed record
+    const std::string& getError() const { return error; }
+    const std::string& getHostname() const { return hostname; }
+
+    // Names of the series defined so far, indexed by id
+    std::vector<std::string> seriesNames() const;
+
+private:
+    void build(UtilizationInfo& util) const;
+};
+
+// `sysreport replay FILE`: stream a binary log through the formatters
+int replaySampleLog(const std::string& path, const std::string& format,
+                    bool realtime, const DisplayOptions& display);
+
+#endif // SAMPLE_LOG_H
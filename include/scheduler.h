@@ -0,0 +1,71 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <cstdint>
+#include <signal.h>
+#include <vector>
+
+// What woke Scheduler::wait()
+enum class SchedulerEvent {
+    TICK,       // Interval deadline reached
+    TERMINATE,  // SIGTERM or SIGINT
+    HANGUP,     // SIGHUP
+    FD_READY,   // One of the extra watched fds is readable (see readyFd())
+    ERROR
+};
+
+// Drift-free interval scheduler for the daemon loop.
+//
+// Deadlines come from a CLOCK_MONOTONIC timerfd armed with absolute expiry
+// times, so the time spent collecting never shifts the next sample. The first
+// deadline is aligned to a wall-clock multiple of the interval (a 60s daemon
+// ticks on the minute), which keeps series from different hosts aligned.
+// SIGTERM/SIGINT/SIGHUP are delivered through a signalfd so the loop reacts
+// immediately instead of finishing a sleep.
+class Scheduler {
+private:
+    int epoll_fd;
+    int timer_fd;
+    int signal_fd;
+    long interval_ms;
+    bool align;
+    sigset_t old_mask;
+    bool mask_saved;
+
+    uint64_t tick_count;
+    uint64_t skipped_total;
+    uint64_t skipped_last;
+    int ready_fd;
+    std::vector<int> watched_fds;
+
+public:
+    Scheduler();
+    ~Scheduler();
+
+    // Must be called before any other thread is started so the blocked
+    // signal mask is inherited and signals only arrive via the signalfd.
+    bool start(long interval_ms, bool align_to_wall_clock = true);
+    void stop();
+
+    // Re-arm with a new interval (next deadline realigned)
+    bool setInterval(long interval_ms);
+    long getInterval() const { return interval_ms; }
+
+    // Block until the next event
+    SchedulerEvent wait();
+
+    // Add a readable fd to the wait set; wait() reports it as FD_READY
+    bool watchFd(int fd);
+    void unwatchFd(int fd);
+    int readyFd() const { return ready_fd; }
+
+    // Overrun accounting
+    uint64_t ticks() const { return tick_count; }
+    uint64_t skippedTicks() const { return skipped_total; }
+    uint64_t lastSkipped() const { return skipped_last; }
+
+private:
+    bool armTimer();
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,129 @@
+#ifndef SELF_STATS_H
+#define SELF_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// What a histogram is timing. Each kind is exported as its own metric family
+// (sysreport_<kind>_duration_seconds{<kind>="name"}).
+enum class StageKind {
+    COLLECTOR,
+    FORMATTER,
+    EXPORTER
+};
+
+// Fixed-bucket latency histogram. Bounds are shared by every instance and
+// recording is a short linear scan plus a few relaxed atomic adds, so it is
+// safe to call from any thread on every sample.
+class LatencyHistogram {
+public:
+    static const size_t NUM_BUCKETS = 19;
+    static const uint64_t BUCKET_BOUNDS_NS[NUM_BUCKETS];
+
+    LatencyHistogram();
+
+    void record(uint64_t nanoseconds);
+
+    uint64_t count() const;
+    uint64_t sumNs() const;
+    uint64_t maxNs() const;
+    // Non-cumulative count for bucket i; i == NUM_BUCKETS is the +Inf bucket
+    uint64_t bucketCount(size_t i) const;
+    // Quantile estimate (upper bound of the bucket holding the q-th sample)
+    uint64_t quantileNs(double q) const;
+
+private:
+    std::atomic<uint64_t> buckets[NUM_BUCKETS + 1];
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> max_ns;
+};
+
+// RAII timer that records its lifetime into a histogram
+class ScopedTimer {
+public:
+    explicit ScopedTimer(LatencyHistogram& hist)
+        : histogram(hist), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    LatencyHistogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Process-wide registry of sysreport's own timings
+class SelfStats {
+public:
+    // Histograms are created on first use and live for the whole process,
+    // so callers may cache the returned reference.
+    static LatencyHistogram& histogram(StageKind kind, const std::string& name);
+
+    // Monotonic event counters, exported as sysreport_<name> (type counter).
+    // Same lifetime rules as histogram().
+    static std::atomic<uint64_t>& counter(const std::string& name, const std::string& help);
+
+    // Point-in-time values, exported as sysreport_<name> (type gauge)
+    static std::atomic<double>& gauge(const std::string& name, const std::string& help);
+
+    // Prometheus histogram families for every stage that has samples
+    static std::string exportPrometheus();
+
+    // Human-readable table for the --self-stats section
+    static std::string formatText(bool use_colors = true);
+
+    // One compact line per stage, for the daemon log
+    static std::vector<std::string> formatLogLines();
+
+    static const char* kindName(StageKind kind);
+
+private:
+    struct Entry {
+        StageKind kind;
+        std::string name;
+        LatencyHistogram* hist;
+    };
+
+    struct CounterEntry {
+        std::string name;
+        std::string help;
+        std::atomic<uint64_t>* value;
+    };
+
+    struct GaugeEntry {
+        std::string name;
+        std::string help;
+        std::atomic<double>* value;
+    };
+
+    static std::mutex& registryMutex();
+    static std::vector<Entry>& registry();
+    static std::vector<CounterEntry>& counterRegistry();
+    static std::vector<GaugeEntry>& gaugeRegistry();
+    static std::vector<Entry> snapshotEntries();
+    static std::vector<CounterEntry> snapshotCounters();
+    static std::vector<GaugeEntry> snapshotGauges();
+};
+
+#define SELF_STATS_CONCAT_INNER(a, b) a##b
+#define SELF_STATS_CONCAT(a, b) SELF_STATS_CONCAT_INNER(a, b)
+
+// Time the rest of the enclosing scope. The histogram lookup happens once
+// per call site (function-local static), so the steady-state cost is two
+// clock reads and the atomic updates in record().
+#define SELF_STATS_SCOPE(kind, name) \
+    static LatencyHistogram& SELF_STATS_CONCAT(self_stats_hist_, __LINE__) = \
+        SelfStats::histogram(kind, name); \
+    ScopedTimer SELF_STATS_CONCAT(self_stats_timer_, __LINE__)( \
+        SELF_STATS_CONCAT(self_stats_hist_, __LINE__))
+
+#endif // SELF_STATS_H
@@ -0,0 +1,46 @@
+#ifndef SHM_SNAPSHOT_H
+#define SHM_SNAPSHOT_H
+
+#include "system_info.h"
+#include "sysreport_shm.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Publishes the daemon's latest sample into a POSIX shared-memory segment
+// (layout and seqlock protocol in sysreport_shm.h). Single writer: only the
+// collection thread calls publish().
+class ShmPublisher {
+private:
+    std::string name;
+    struct sysreport_shm* shm;
+    int64_t interval_ms;
+    // Filled outside the write window so readers retry as little as possible
+    std::unique_ptr<struct sysreport_shm_snapshot> staged;
+
+public:
+    ShmPublisher();
+    ~ShmPublisher();
+
+    // Replaces any segment left behind under the same name
+    bool open(const std::string& segment_name, int64_t cadence_ms, std::string& error);
+    // Unmaps and unlinks the segment so readers stop trusting it
+    void close();
+    bool isOpen() const { return shm != nullptr; }
+
+    void publish(const UtilizationInfo& util, int64_t timestamp_ms);
+    void setInterval(int64_t cadence_ms) { interval_ms = cadence_ms; }
+};
+
+// Fixed layout <-> UtilizationInfo; vectors and strings are truncated to
+// the layout's limits
+void utilizationToSnapshot(const UtilizationInfo& util, struct sysreport_shm_snapshot& snap);
+UtilizationInfo snapshotToUtilization(const struct sysreport_shm_snapshot& snap);
+
+// Latest sample of a running daemon. False (with reason set) when there is
+// no segment, its writer is gone or is not the daemon named by pid_file, or
+// the sample is older than two daemon intervals.
+bool readDaemonSnapshot(const std::string& segment_name, const std::string& pid_file,
+                        UtilizationInfo& util, std::string& reason);
+
+#endif // SHM_SNAPSHOT_H
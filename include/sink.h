@@ -0,0 +1,120 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include "system_info.h"
+#include "delta_export.h"
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class LatencyHistogram;
+
+// One collection cycle, shared read-only by every sink
+struct SinkSample {
+    UtilizationInfo util;
+    int64_t timestamp_ms;      // Wall clock
+};
+
+// One [sink.NAME] section of the config file
+struct SinkOptions {
+    std::string name;
+    std::string type;          // file, http, remote_write, influxdb
+    std::string format;        // file: json, csv, prometheus, influxdb, binary
+    std::string target;        // File path, listen address or URL
+    double interval_seconds;   // Minimum spacing between samples (0: every cycle)
+    size_t queue_size;         // Samples buffered while the sink is busy
+
+    // Push sinks
+    size_t batch_size;         // Flush after this many samples...
+    double batch_age_seconds;  // ...or once the oldest is this old
+    int timeout_ms;
+    std::string spool_dir;     // Undelivered batches (default /var/lib/sysreport/spool/NAME)
+    double spool_max_mb;
+    bool gzip;                 // Compress HTTP request bodies
+
+    // Changed-only output (file json/influxdb/binary, influxdb)
+    DeltaOptions delta;
+
+    SinkOptions();
+
+    bool operator==(const SinkOptions& other) const;
+    bool operator!=(const SinkOptions& other) const { return !(*this == other); }
+};
+
+// A destination for samples. open(), write() and close() are all called
+// from the sink's own worker thread, so implementations need no locking and
+// may block without holding up collection or other sinks.
+class Sink {
+public:
+    virtual ~Sink() {}
+    virtual bool open(std::string& error) = 0;
+    virtual void write(const SinkSample& sample) = 0;
+    virtual void close() {}
+};
+
+// Build the sink for options.type; null (with error set) if unsupported
+std::unique_ptr<Sink> createSink(const SinkOptions& options, std::string& error);
+
+// Runs one sink on a dedicated thread behind a bounded queue.
+//
+// submit() only appends a pointer to the shared sample, so a sink that is
+// slow (or stuck on the network) falls behind on its own: once its queue is
+// full the oldest queued sample is dropped and counted.
+class SinkWorker {
+private:
+    SinkOptions options;
+    std::unique_ptr<Sink> sink;
+    LatencyHistogram* histogram;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::shared_ptr<const SinkSample>> queue;
+    std::thread worker;
+    bool stopping;
+    int64_t last_accepted_ms;
+
+public:
+    SinkWorker(const SinkOptions& opts, std::unique_ptr<Sink> sink_impl);
+    ~SinkWorker();
+
+    // Opens the sink on the worker thread and waits for the result
+    bool start(std::string& error);
+    // Writes out what is still queued, then closes the sink
+    void stop();
+
+    // Never blocks; skips samples that come sooner than the sink's interval
+    void submit(const std::shared_ptr<const SinkSample>& sample);
+
+    const SinkOptions& getOptions() const { return options; }
+
+private:
+    void run();
+};
+
+// Every configured sink, fed from one snapshot per collection cycle
+class SinkFanout {
+private:
+    std::vector<std::unique_ptr<SinkWorker>> workers;
+
+public:
+    ~SinkFanout();
+
+    bool add(const SinkOptions& options, std::string& error);
+    void publish(const UtilizationInfo& util, int64_t timestamp_ms);
+    void stop();
+
+    size_t size() const { return workers.size(); }
+};
+
+// One sample as a single log entry in json, csv, prometheus or influxdb
+// format (binary is handled by SampleLogEncoder)
+std::string formatSampleEntry(const std::string& format, const UtilizationInfo& util,
+                              time_t timestamp);
+
+#endif // SINK_H
@@ -0,0 +1,19 @@
+#ifndef SNAPPY_H
+#define SNAPPY_H
+
+#include <cstddef>
+#include <string>
+
+// Snappy block-format compression (https://github.com/google/snappy,
+// format_description.txt), as required by Prometheus remote write. Greedy
+// single-probe matcher: not as tight as the reference encoder, but output
+// is valid for any conforming decoder and the cost is one pass.
+void snappyCompress(const char* data, size_t size, std::string& out);
+
+inline std::string snappyCompress(const std::string& input) {
+    std::string out;
+    snappyCompress(input.data(), input.size(), out);
+    return out;
+}
+
+#endif // SNAPPY_H
@@ -0,0 +1,191 @@
+/*
+ * sysreport_shm.h - layout of the daemon's shared-memory snapshot
+ *
+ * The daemon publishes its latest sample into the POSIX shared-memory
+ * segment SYSREPORT_SHM_NAME (see [daemon] shm_name). The segment holds one
+ * struct sysreport_shm: fixed-size, native byte order, no pointers.
+ *
+ * Writes are guarded by a seqlock. The daemon makes `sequence` odd, copies
+ * the new snapshot in, then makes it even again. A reader copies the
+ * snapshot out and keeps the copy only if `sequence` was the same even
+ * value before and after. Readers never block the daemon or each other.
+ *
+ * This header is plain C99 (GCC/Clang __atomic builtins) so other tools
+ * can read the segment without linking against sysreport:
+ *
+ *     struct sysreport_shm *shm = sysreport_shm_attach(SYSREPORT_SHM_NAME);
+ *     struct sysreport_shm_snapshot snap;
+ *     if (shm && sysreport_shm_read(shm, &snap) == 0)
+ *         printf("cpu %.1f%%\n", snap.cpu_percent);
+ *     sysreport_shm_detach(shm);
+ *
+ * Bump SYSREPORT_SHM_VERSION whenever the layout changes.
+ */
+#ifndef SYSREPORT_SHM_H
+#define SYSREPORT_SHM_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SYSREPORT_SHM_NAME     "/sysreport"
+#define SYSREPORT_SHM_MAGIC    0x4d485352u   /* "SRHM" */
+#define SYSREPORT_SHM_VERSION  1
+
+/* Vectors beyond these sizes are truncated */
+#define SYSREPORT_SHM_MAX_CORES      256
+#define SYSREPORT_SHM_MAX_DISKS      32
+#define SYSREPORT_SHM_MAX_NETS       32
+#define SYSREPORT_SHM_MAX_PROCESSES  32
+#define SYSREPORT_SHM_MAX_TEMPS      32
+#define SYSREPORT_SHM_MAX_GPUS       8
+#define SYSREPORT_SHM_MAX_FANS       16
+
+/* Strings are NUL-terminated and truncated to fit */
+struct sysreport_shm_disk {
+    char mount_point[64];
+    char device[64];
+    int64_t total_gb;
+    int64_t used_gb;
+    int64_t available_gb;
+    double percent;
+};
+
+struct sysreport_shm_net {
+    char interface[32];
+    int64_t rx_bytes;
+    int64_t tx_bytes;
+    double rx_mbps;
+    double tx_mbps;
+};
+
+struct sysreport_shm_process {
+    char name[64];
+    int32_t pid;
+    int32_t reserved;
+    double cpu_percent;
+    int64_t mem_mb;
+};
+
+struct sysreport_shm_gpu {
+    char name[64];
+    char vendor[16];
+    double utilization_percent;
+    double memory_used_mb;
+    double memory_total_mb;
+    double temperature;
+    int32_t available;
+    int32_t reserved;
+};
+
+struct sysreport_shm_fan {
+    char label[32];
+    int32_t rpm;
+    int32_t reserved;
+};
+
+struct sysreport_shm_battery {
+    int32_t present;
+    int32_t charging;
+    double percent;
+    double capacity_percent;
+    char status[16];
+    int32_t time_remaining_minutes;   /* -1 if unknown */
+    int32_t reserved;
+};
+
+struct sysreport_shm_snapshot {
+    int64_t timestamp_ms;     /* Wall clock of the collection */
+    int64_t interval_ms;      /* Daemon cadence; older than ~2x means stale */
+
+    double cpu_percent;
+    int64_t used_ram_mb;
+    int64_t available_ram_mb;
+    double ram_percent;
+    int64_t used_swap_mb;
+    int64_t available_swap_mb;
+    double swap_percent;
+    int64_t uptime_seconds;
+    double load_avg_1;
+    double load_avg_5;
+    double load_avg_15;
+    struct sysreport_shm_battery battery;
+
+    uint32_t core_count;
+    uint32_t disk_count;
+    uint32_t net_count;
+    uint32_t process_count;
+    uint32_t temp_count;
+    uint32_t gpu_count;
+    uint32_t fan_count;
+    uint32_t reserved;
+
+    double cpu_per_core[SYSREPORT_SHM_MAX_CORES];
+    struct sysreport_shm_disk disks[SYSREPORT_SHM_MAX_DISKS];
+    struct sysreport_shm_net network[SYSREPORT_SHM_MAX_NETS];
+    struct sysreport_shm_process top_processes[SYSREPORT_SHM_MAX_PROCESSES];
+    double temperatures[SYSREPORT_SHM_MAX_TEMPS];
+    struct sysreport_shm_gpu gpus[SYSREPORT_SHM_MAX_GPUS];
+    struct sysreport_shm_fan fans[SYSREPORT_SHM_MAX_FANS];
+};
+
+struct sysreport_shm {
+    uint32_t magic;           /* SYSREPORT_SHM_MAGIC */
+    uint32_t version;         /* SYSREPORT_SHM_VERSION */
+    uint32_t size;            /* sizeof(struct sysreport_shm) of the writer */
+    int32_t writer_pid;
+    uint64_t sequence;        /* Seqlock; 0 until the first snapshot */
+    uint64_t reserved[5];     /* Keeps the snapshot on its own cache line */
+    struct sysreport_shm_snapshot snapshot;
+};
+
+/* Map the segment read-only; NULL if missing or of another version */
+static inline struct sysreport_shm *sysreport_shm_attach(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct sysreport_shm)) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, sizeof(struct sysreport_shm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    struct sysreport_shm *shm = (struct sysreport_shm *)map;
+    if (shm->magic != SYSREPORT_SHM_MAGIC || shm->version != SYSREPORT_SHM_VERSION ||
+        shm->size != sizeof(struct sysreport_shm)) {
+        munmap(map, sizeof(struct sysreport_shm));
+        return NULL;
+    }
+    return shm;
+}
+
+static inline void sysreport_shm_detach(struct sysreport_shm *shm) {
+    if (shm) munmap(shm, sizeof(struct sysreport_shm));
+}
+
+/*
+ * Copy out a consistent snapshot. Returns 0 on success, -1 if nothing has
+ * been published yet or the writer kept overtaking the copy.
+ */
+static inline int sysreport_shm_read(const struct sysreport_shm *shm,
+                                     struct sysreport_shm_snapshot *out) {
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        uint64_t before = __atomic_load_n(&shm->sequence, __ATOMIC_ACQUIRE);
+        if (before == 0) return -1;
+        if (before & 1) continue;
+
+        memcpy(out, &shm->snapshot, sizeof(*out));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shm->sequence, __ATOMIC_RELAXED) == before) return 0;
+    }
+    return -1;
+}
+
+#endif /* SYSREPORT_SHM_H */
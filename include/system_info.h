@@ -1,6 +1,7 @@
 #ifndef SYSTEM_INFO_H
 #define SYSTEM_INFO_H
 
+#include <ctime>
 #include <string>
 #include <vector>
 #include <map>
@@ -84,6 +85,7 @@ struct UtilizationInfo {
     std::vector<NetworkInfo> network;
     std::vector<ProcessInfo> top_processes;
     std::string uptime;
+    long uptime_seconds;
     double load_avg_1;
     double load_avg_5;
     double load_avg_15;
@@ -95,6 +97,7 @@ struct UtilizationInfo {
 
 // Forward declaration
 class MetricHistory;
+class MetricRegistry;
 
 // Display options
 struct DisplayOptions {
@@ -104,7 +107,7 @@ struct DisplayOptions {
     bool show_progress_bars;
     bool show_timestamp;
     bool show_alerts;
-    std::string format; // text, json, csv
+    std::string format; // text, json, ndjson, csv
     
     // Filters
     bool cpu_only;
@@ -117,15 +120,60 @@ struct DisplayOptions {
     bool show_history;
     bool show_baseline_comparison;
     MetricHistory* metric_history;
+    const MetricRegistry* metrics;   // JSON/CSV source; util alone if null
+    time_t sample_time;              // Timestamp shown for the sample (0: now)
+};
+
+// Aggregate jiffies from the first line of /proc/stat
+struct CpuTimes {
+    long busy;
+    long total;
+};
+
+// One process from a /proc scan, with its CPU time (utime + stime) so far
+struct ProcessTimes {
+    int pid;
+    std::string name;
+    long mem_mb;
+    unsigned long long cpu_ticks;
+};
+
+// Which of the costlier collectors getUtilizationInfo() runs
+struct CollectionOptions {
+    bool processes;        // Scan /proc for the top processes
+    int top_processes;
+    bool per_core;         // Per-core usage (a second 100ms measurement)
+    bool gpus;             // May fork nvidia-smi
+    bool sensors;          // Temperatures, fans and battery
+
+    CollectionOptions()
+        : processes(true), top_processes(5), per_core(true), gpus(true), sensors(true) {}
 };
 
 // Functions to gather system information
 HardwareInfo getHardwareInfo();
-UtilizationInfo getUtilizationInfo();
+UtilizationInfo getUtilizationInfo(const CollectionOptions& collect = CollectionOptions());
+// Memory, swap, uptime and load only: no sleeps and no scans, cheap enough
+// to call every few milliseconds (CPU is derived from two readCpuTimes())
+UtilizationInfo getQuickUtilizationInfo();
+CpuTimes readCpuTimes();
+std::vector<ProcessInfo> getTopProcesses(int count = 5);
+// Every process's resident memory and CPU time; two scans make CPU usage
+std::vector<ProcessTimes> readProcessTimes();
+// The top count of the later scan, cpu_percent from the CPU time used since
+// the earlier one (100 per busy core), ordered by CPU or by memory
+std::vector<ProcessInfo> rankProcesses(const std::vector<ProcessTimes>& earlier,
+                                       const std::vector<ProcessTimes>& later,
+                                       double elapsed_seconds, size_t count, bool by_cpu);
 
 // Formatting functions
 std::string formatOutput(const HardwareInfo& hw, const UtilizationInfo& util, const DisplayOptions& opts);
-std::string getTimestamp();
+// json (indented) or ndjson (one line) document appended to out
+void appendJson(std::string& out, const HardwareInfo& hw, const UtilizationInfo& util,
+                const DisplayOptions& opts);
+// Local time, "YYYY-MM-DD HH:MM:SS" (when 0: now)
+std::string getTimestamp(time_t when = 0);
+std::string formatUptime(long seconds);
 std::string colorize(const std::string& text, const std::string& color);
 std::string getProgressBar(double percent, int width = 20);
 std::string getColorForPercent(double percent);
@@ -0,0 +1,215 @@
+#include "alert_dispatcher.h"
+#include "http_client.h"
+#include "json_writer.h"
+#include "self_stats.h"
+#include <unistd.h>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+static long monotonicMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AlertDispatcherOptions::AlertDispatcherOptions()
+    : queue_capacity(64),
+      timeout_ms(5000),
+      max_retries(5),
+      retry_base_ms(1000),
+      retry_max_ms(60000),
+      repeat_interval(300) {
+}
+
+AlertDispatcher::AlertDispatcher(const std::string& webhook_url, const AlertDispatcherOptions& opts)
+    : url(webhook_url), options(opts), stopping(false) {
+}
+
+AlertDispatcher::~AlertDispatcher() {
+    stop();
+}
+
+bool AlertDispatcher::start() {
+    if (worker.joinable()) return false;
+
+    HttpUrl parsed;
+    if (!parsed.parse(url)) {
+        error = url.compare(0, 8, "https://") == 0 ? "https URLs are not supported"
+                                                   : "invalid webhook URL: " + url;
+        return false;
+    }
+
+    stopping = false;
+    worker = std::thread(&AlertDispatcher::run, this);
+    return true;
+}
+
+void AlertDispatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+bool AlertDispatcher::submit(const Alert& alert) {
+    static std::atomic<uint64_t>& suppressed = SelfStats::counter(
+        "webhook_alerts_suppressed_total", "Alerts not sent because the same alert was delivered recently");
+    static std::atomic<uint64_t>& coalesced = SelfStats::counter(
+        "webhook_alerts_coalesced_total", "Alerts merged into an alert already queued for the metric");
+    static std::atomic<uint64_t>& dropped = SelfStats::counter(
+        "webhook_alerts_dropped_total", "Alerts discarded because the webhook queue was full");
+
+    long now = monotonicMillis();
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::string key = keyOf(alert);
+    auto last = delivered.find(key);
+    if (last != delivered.end() && last->second.severity == alert.severity &&
+        last->second.status == alert.status &&
+        now - last->second.at_ms < options.repeat_interval * 1000L) {
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    for (auto& pending : queue) {
+        // A resolution is never folded into the firing alert it ends
+        if (keyOf(pending.alert) == key && pending.alert.status == alert.status) {
+            // Keep the retry schedule, report the latest reading
+            pending.alert = alert;
+            coalesced.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    bool kept = true;
+    if (queue.size() >= options.queue_capacity) {
+        queue.pop_front();  // Oldest alert is the least useful one
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        kept = false;
+    }
+    queue.push_back(Pending{alert, 0, now});
+    cv.notify_one();
+    return kept;
+}
+
+void AlertDispatcher::run() {
+    static std::atomic<uint64_t>& sent = SelfStats::counter(
+        "webhook_alerts_sent_total", "Alerts delivered to the webhook");
+    static std::atomic<uint64_t>& failed = SelfStats::counter(
+        "webhook_alerts_failed_total", "Alerts abandoned after exhausting retries or on a 4xx response");
+    static std::atomic<uint64_t>& retries = SelfStats::counter(
+        "webhook_retries_total", "Webhook deliveries retried after a failure");
+
+    HttpClient client(url, options.timeout_ms);
+    std::minstd_rand jitter(static_cast<unsigned>(monotonicMillis() ^ getpid()));
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        if (queue.empty()) {
+            cv.wait(lock);
+            continue;
+        }
+
+        // Earliest due entry; the queue is small so a scan is fine
+        auto next = queue.begin();
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if (it->next_attempt_ms < next->next_attempt_ms) next = it;
+        }
+        long now = monotonicMillis();
+        if (next->next_attempt_ms > now) {
+            cv.wait_for(lock, std::chrono::milliseconds(next->next_attempt_ms - now));
+            continue;
+        }
+
+        Pending pending = *next;
+        queue.erase(next);
+        lock.unlock();
+
+        std::string payload = formatPayload(pending.alert);
+        HttpResponse response;
+        bool transport_ok;
+        {
+            SELF_STATS_SCOPE(StageKind::EXPORTER, "webhook");
+            transport_ok = client.post(payload, "application/json", response);
+        }
+        int status = transport_ok ? response.status : 0;
+        bool success = status >= 200 && status < 300;
+        // Client errors other than timeouts/throttling will not improve on retry
+        bool permanent = status >= 400 && status < 500 && status != 408 && status != 429;
+
+        lock.lock();
+        now = monotonicMillis();
+        if (success) {
+            delivered[keyOf(pending.alert)] = Delivered{pending.alert.severity, pending.alert.status, now};
+            sent.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        pending.attempts++;
+        if (permanent || pending.attempts > options.max_retries) {
+            failed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        // A newer alert for the rule and metric arrived meanwhile; it supersedes this one
+        std::string key = keyOf(pending.alert);
+        bool superseded = false;
+        for (auto& queued : queue) {
+            if (keyOf(queued.alert) == key) {
+                queued.attempts = pending.attempts;
+                superseded = true;
+                break;
+            }
+        }
+
+        long backoff = options.retry_base_ms;
+        for (int i = 1; i < pending.attempts && backoff < options.retry_max_ms; i++) {
+            backoff *= 2;
+        }
+        if (backoff > options.retry_max_ms) backoff = options.retry_max_ms;
+        backoff += jitter() % (backoff / 4 + 1);   // Spread out retries from many hosts
+        retries.fetch_add(1, std::memory_order_relaxed);
+
+        if (superseded) {
+            for (auto& queued : queue) {
+                if (keyOf(queued.alert) == key) {
+                    queued.next_attempt_ms = std::max(queued.next_attempt_ms, now + backoff);
+                }
+            }
+        } else {
+            pending.next_attempt_ms = now + backoff;
+            queue.push_back(pending);
+        }
+    }
+}
+
+std::string AlertDispatcher::keyOf(const Alert& alert) {
+    return alert.rule + '\t' + alert.metric;
+}
+
+std::string AlertDispatcher::formatPayload(const Alert& alert) {
+    std::string payload;
+    JsonWriter json(payload, true);
+    json.beginObject();
+    if (!alert.rule.empty()) json.member("rule", alert.rule);
+    json.member("metric", alert.metric);
+    json.memberNumber("value", alert.value);
+    json.memberNumber("threshold", alert.threshold);
+    json.member("severity", alert.severity);
+    json.member("status", alert.status);
+    json.memberInteger("timestamp", alert.timestamp);
+    char hostname[256];
+    if (gethostname(hostname, sizeof(hostname)) == 0) {
+        hostname[sizeof(hostname) - 1] = '\0';
+    } else {
+        hostname[0] = '\0';
+    }
+    json.member("hostname", static_cast<const char*>(hostname));
+    json.endObject();
+    return payload;
+}
@@ -0,0 +1,294 @@
+#include "alert_rules.h"
+#include "plugin.h"
+#include <sys/stat.h>
+#include <fnmatch.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+bool AlertRule::operator==(const AlertRule& other) const {
+    bool same_clear = (std::isnan(clear) && std::isnan(other.clear)) || clear == other.clear;
+    return name == other.name && metric == other.metric && trigger == other.trigger &&
+           same_clear && below == other.below && for_seconds == other.for_seconds &&
+           clear_for_seconds == other.clear_for_seconds && severity == other.severity &&
+           notify_resolved == other.notify_resolved;
+}
+
+AlertEngine::AlertEngine(const std::vector<AlertRule>& alert_rules)
+    : rules(alert_rules), dirty(false) {
+    for (auto& rule : rules) {
+        if (std::isnan(rule.clear)) rule.clear = rule.trigger;
+    }
+}
+
+AlertEngine::SeriesEntry& AlertEngine::entryFor(const std::string& key) {
+    auto it = series.find(key);
+    if (it != series.end()) return it->second;
+
+    // Pattern matching happens once per series, not once per sample
+    SeriesEntry entry;
+    for (size_t i = 0; i < rules.size(); i++) {
+        if (fnmatch(rules[i].metric.c_str(), key.c_str(), 0) == 0) {
+            entry.rules.push_back(RuleState{i, AlertState::INACTIVE, 0, 0, 0.0});
+        }
+    }
+    return series.emplace(key, std::move(entry)).first->second;
+}
+
+void AlertEngine::observe(const std::string& key, double value, long now) {
+    SeriesEntry& entry = entryFor(key);
+
+    for (RuleState& rs : entry.rules) {
+        const AlertRule& rule = rules[rs.rule];
+        bool breached = rule.below ? value <= rule.trigger : value >= rule.trigger;
+        bool cleared = rule.below ? value > rule.clear : value < rule.clear;
+        rs.value = value;
+
+        bool fire = false;
+        switch (rs.state) {
+            case AlertState::RESOLVED:
+                rs.state = AlertState::INACTIVE;
+                dirty = true;
+                // fall through
+            case AlertState::INACTIVE:
+                if (breached) {
+                    rs.since = now;
+                    if (rule.for_seconds > 0) {
+                        rs.state = AlertState::PENDING;
+                        dirty = true;
+                    } else {
+                        fire = true;
+                    }
+                }
+                break;
+
+            case AlertState::PENDING:
+                if (!breached) {
+                    rs.state = AlertState::INACTIVE;
+                    dirty = true;
+                } else if (now - rs.since >= rule.for_seconds) {
+                    fire = true;
+                }
+                break;
+
+            case AlertState::FIRING:
+                // Between clear and trigger the alert keeps firing (hysteresis)
+                if (cleared) {
+                    if (rs.clear_since == 0) {
+                        rs.clear_since = now;
+                        dirty = true;
+                    }
+                    if (now - rs.clear_since >= rule.clear_for_seconds) {
+                        rs.state = AlertState::RESOLVED;
+                        rs.since = now;
+                        rs.clear_since = 0;
+                        dirty = true;
+                        if (rule.notify_resolved) {
+                            events.push_back(AlertEvent{&rule, key, AlertState::RESOLVED, value, true});
+                        }
+                        break;
+                    }
+                } else if (rs.clear_since != 0) {
+                    rs.clear_since = 0;
+                    dirty = true;
+                }
+                events.push_back(AlertEvent{&rule, key, AlertState::FIRING, value, false});
+                break;
+        }
+
+        if (fire) {
+            rs.state = AlertState::FIRING;
+            rs.clear_since = 0;
+            dirty = true;
+            events.push_back(AlertEvent{&rule, key, AlertState::FIRING, value, true});
+        }
+    }
+}
+
+std::vector<AlertEvent> AlertEngine::takeEvents() {
+    std::vector<AlertEvent> out;
+    out.swap(events);
+    return out;
+}
+
+size_t AlertEngine::firingCount() const {
+    size_t count = 0;
+    for (const auto& kv : series) {
+        for (const auto& rs : kv.second.rules) {
+            if (rs.state == AlertState::FIRING) count++;
+        }
+    }
+    return count;
+}
+
+const char* AlertEngine::stateName(AlertState state) {
+    switch (state) {
+        case AlertState::INACTIVE: return "inactive";
+        case AlertState::PENDING: return "pending";
+        case AlertState::FIRING: return "firing";
+        case AlertState::RESOLVED: return "resolved";
+    }
+    return "inactive";
+}
+
+bool AlertEngine::loadState(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) return false;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        // rule \t series \t state \t since \t clear_since \t value
+        std::vector<std::string> fields;
+        std::istringstream iss(line);
+        std::string field;
+        while (std::getline(iss, field, '\t')) fields.push_back(field);
+        if (fields.size() != 6) continue;
+
+        AlertState state;
+        if (fields[2] == "pending") state = AlertState::PENDING;
+        else if (fields[2] == "firing") state = AlertState::FIRING;
+        else continue;
+
+        // Rules that were removed or no longer match the series are dropped
+        SeriesEntry& entry = entryFor(fields[1]);
+        for (RuleState& rs : entry.rules) {
+            if (rules[rs.rule].name != fields[0]) continue;
+            rs.state = state;
+            rs.since = atol(fields[3].c_str());
+            rs.clear_since = atol(fields[4].c_str());
+            rs.value = atof(fields[5].c_str());
+        }
+    }
+    dirty = false;
+    return true;
+}
+
+void AlertEngine::adoptState(const AlertEngine& previous) {
+    for (const auto& kv : previous.series) {
+        for (const RuleState& old : kv.second.rules) {
+            if (old.state != AlertState::PENDING && old.state != AlertState::FIRING) continue;
+
+            const std::string& name = previous.rules[old.rule].name;
+            SeriesEntry& entry = entryFor(kv.first);
+            for (RuleState& rs : entry.rules) {
+                if (rules[rs.rule].name != name) continue;
+                size_t index = rs.rule;
+                rs = old;
+                rs.rule = index;
+            }
+        }
+    }
+}
+
+bool AlertEngine::saveState(const std::string& path) {
+    size_t slash = path.rfind('/');
+    if (slash != std::string::npos && slash > 0) {
+        mkdir(path.substr(0, slash).c_str(), 0755);  // Usually /var/lib/sysreport
+    }
+
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        if (!out.is_open()) return false;
+
+        out << "# sysreport alert state: rule, series, state, since, clear_since, value\n";
+        for (const auto& kv : series) {
+            for (const auto& rs : kv.second.rules) {
+                if (rs.state != AlertState::PENDING && rs.state != AlertState::FIRING) continue;
+                out << rules[rs.rule].name << '\t' << kv.first << '\t' << stateName(rs.state)
+                    << '\t' << rs.since << '\t' << rs.clear_since << '\t' << rs.value << '\n';
+            }
+        }
+        out.flush();
+        if (!out.good()) return false;
+    }
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+void forEachAlertSeries(const UtilizationInfo& util,
+                        const std::map<std::string, std::vector<MetricData>>* plugin_metrics,
+                        const std::function<void(const std::string&, double)>& fn) {
+    fn("cpu_usage", util.cpu_percent);
+    fn("memory_usage", util.ram_percent);
+    fn("swap_usage", util.swap_percent);
+    fn("load_1", util.load_avg_1);
+    fn("load_5", util.load_avg_5);
+    fn("load_15", util.load_avg_15);
+
+    for (size_t i = 0; i < util.cpu_per_core.size(); i++) {
+        fn("cpu_core:" + std::to_string(i), util.cpu_per_core[i]);
+    }
+    for (const auto& disk : util.disks) {
+        fn("disk_usage:" + disk.mount_point, disk.percent);
+    }
+    for (const auto& net : util.network) {
+        fn("net_rx_mbps:" + net.interface, net.rx_mbps);
+        fn("net_tx_mbps:" + net.interface, net.tx_mbps);
+    }
+    for (size_t i = 0; i < util.temperatures.size(); i++) {
+        fn("temperature:" + std::to_string(i), util.temperatures[i]);
+    }
+    for (size_t i = 0; i < util.gpus.size(); i++) {
+        const GPUInfo& gpu = util.gpus[i];
+        if (!gpu.available) continue;
+        std::string idx = std::to_string(i);
+        fn("gpu_usage:" + idx, gpu.utilization_percent);
+        fn("gpu_temperature:" + idx, gpu.temperature);
+        if (gpu.memory_total_mb > 0) {
+            fn("gpu_memory:" + idx, gpu.memory_used_mb * 100.0 / gpu.memory_total_mb);
+        }
+    }
+    if (util.battery.present) {
+        fn("battery_percent", util.battery.percent);
+    }
+    for (const auto& fan : util.fans) {
+        fn("fan_rpm:" + fan.label, fan.rpm);
+    }
+
+    if (plugin_metrics) {
+        for (const auto& plugin : *plugin_metrics) {
+            for (const auto& metric : plugin.second) {
+                const char* begin = metric.value.c_str();
+                char* end = nullptr;
+                double value = strtod(begin, &end);
+                if (end == begin) continue;  // Not numeric
+                fn("plugin:" + plugin.first + ":" + metric.name, value);
+            }
+        }
+    }
+}
+
+std::vector<AlertRule> defaultAlertRules(double cpu, double memory, double disk, double gpu) {
+    std::vector<AlertRule> defaults(4);
+
+    defaults[0].name = "cpu";
+    defaults[0].metric = "cpu_usage";
+    defaults[0].trigger = cpu;
+
+    defaults[1].name = "memory";
+    defaults[1].metric = "memory_usage";
+    defaults[1].trigger = memory;
+
+    defaults[2].name = "disk";
+    defaults[2].metric = "disk_usage:*";
+    defaults[2].trigger = disk;
+
+    defaults[3].name = "gpu";
+    defaults[3].metric = "gpu_usage:0";
+    defaults[3].trigger = gpu;
+    defaults[3].severity = "info";
+
+    // A little hysteresis so a reading hovering at the threshold doesn't flap
+    for (auto& rule : defaults) {
+        rule.clear = rule.trigger - 5.0;
+    }
+    return defaults;
+}
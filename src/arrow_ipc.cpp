@@ -0,0 +1,493 @@
+#include "arrow_ipc.h"
+#include "self_stats.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Flatbuffer enums and union tags used here (format/Schema.fbs, Message.fbs)
+static const int16_t METADATA_V5 = 4;
+static const uint8_t HEADER_SCHEMA = 1;
+static const uint8_t HEADER_RECORD_BATCH = 3;
+static const uint8_t TYPE_INT = 2;
+static const uint8_t TYPE_FLOATING_POINT = 3;
+static const uint8_t TYPE_TIMESTAMP = 10;
+static const int16_t PRECISION_DOUBLE = 2;
+static const int16_t TIME_UNIT_MILLISECOND = 1;
+static const uint32_t CONTINUATION = 0xffffffffu;
+
+static size_t padded8(size_t length) {
+    return (length + 7) & ~static_cast<size_t>(7);
+}
+
+// ---------------------------------------------------------------------------
+// Flatbuffer building
+//
+// Like the reference builder this fills its buffer from the back, so
+// children are finished before the tables that point at them and every
+// uoffset points forward. Only what Schema and RecordBatch messages need:
+// scalars, strings, vectors of offsets or structs, and tables. Values are
+// stored in host order, which flatbuffers (and these files) assume is
+// little-endian.
+
+class FlatBuilder {
+private:
+    std::vector<uint8_t> buf;   // Data occupies buf[head, end)
+    size_t head;
+    size_t minalign;
+    uint32_t table_start;
+    std::vector<std::pair<uint16_t, uint32_t>> fields;   // Slot, position of its value
+
+public:
+    FlatBuilder() : buf(1024), head(1024), minalign(1), table_start(0) {}
+
+    // Positions count from the end of the buffer, as uoffsets need
+    uint32_t size() const { return static_cast<uint32_t>(buf.size() - head); }
+
+    void startTable() {
+        fields.clear();
+        table_start = size();
+    }
+
+    template <typename T>
+    void addScalar(uint16_t slot, T value) {
+        push(value);
+        fields.emplace_back(slot, size());
+    }
+
+    void addOffset(uint16_t slot, uint32_t target) {
+        pushOffset(target);
+        fields.emplace_back(slot, size());
+    }
+
+    uint32_t endTable() {
+        push<int32_t>(0);           // soffset to the vtable, patched below
+        uint32_t table = size();
+        uint16_t slots = 0;
+        for (const auto& field : fields) slots = std::max<uint16_t>(slots, field.first + 1);
+        std::vector<uint16_t> offsets(slots, 0);
+        for (const auto& field : fields) offsets[field.first] = static_cast<uint16_t>(table - field.second);
+
+        for (size_t i = slots; i-- > 0; ) push<uint16_t>(offsets[i]);
+        push<uint16_t>(static_cast<uint16_t>(table - table_start));
+        push<uint16_t>(static_cast<uint16_t>((2 + slots) * 2));
+        int32_t to_vtable = static_cast<int32_t>(size() - table);
+        memcpy(&buf[buf.size() - table], &to_vtable, sizeof(to_vtable));
+        fields.clear();
+        return table;
+    }
+
+    uint32_t createString(const std::string& str) {
+        prealign(str.size() + 1, 4);
+        pad(1);
+        prepend(str.data(), str.size());
+        push<uint32_t>(static_cast<uint32_t>(str.size()));
+        return size();
+    }
+
+    uint32_t createOffsetVector(const std::vector<uint32_t>& targets) {
+        prealign(targets.size() * 4, 4);
+        for (size_t i = targets.size(); i-- > 0; ) pushOffset(targets[i]);
+        push<uint32_t>(static_cast<uint32_t>(targets.size()));
+        return size();
+    }
+
+    // count structs of 8-byte aligned fields, already laid out in order
+    uint32_t createStructVector(const void* data, size_t struct_size, size_t count) {
+        prealign(count * struct_size, 4);
+        prealign(count * struct_size, 8);
+        prepend(data, count * struct_size);
+        push<uint32_t>(static_cast<uint32_t>(count));
+        return size();
+    }
+
+    // Root offset; the result is padded to a multiple of 8 bytes
+    std::string finish(uint32_t root) {
+        prealign(4, std::max<size_t>(minalign, 8));
+        pushOffset(root);
+        std::string out(reinterpret_cast<const char*>(&buf[head]), size());
+        out.resize(padded8(out.size()), '\0');
+        return out;
+    }
+
+private:
+    void reserve(size_t length) {
+        if (head >= length) return;
+        size_t used = size();
+        size_t capacity = std::max(buf.size() * 2, used + length + 1024);
+        std::vector<uint8_t> bigger(capacity);
+        memcpy(&bigger[capacity - used], &buf[head], used);
+        buf.swap(bigger);
+        head = capacity - used;
+    }
+
+    void prepend(const void* data, size_t length) {
+        reserve(length);
+        head -= length;
+        if (length > 0) memcpy(&buf[head], data, length);
+    }
+
+    void pad(size_t length) {
+        reserve(length);
+        head -= length;
+        memset(&buf[head], 0, length);
+    }
+
+    // Pad so that length more bytes end on an alignment boundary
+    void prealign(size_t length, size_t alignment) {
+        minalign = std::max(minalign, alignment);
+        pad((alignment - (size() + length) % alignment) % alignment);
+    }
+
+    template <typename T>
+    void push(T value) {
+        prealign(sizeof(T), sizeof(T));
+        prepend(&value, sizeof(T));
+    }
+
+    void pushOffset(uint32_t target) {
+        prealign(4, 4);
+        push<uint32_t>(size() + 4 - target);
+    }
+};
+
+// Message { version, header_type, header, bodyLength }
+static std::string messageMetadata(FlatBuilder& fb, uint8_t header_type, uint32_t header,
+                                   int64_t body_length) {
+    fb.startTable();
+    fb.addScalar<int64_t>(3, body_length);
+    fb.addOffset(2, header);
+    fb.addScalar<int16_t>(0, METADATA_V5);
+    fb.addScalar<uint8_t>(1, header_type);
+    return fb.finish(fb.endTable());
+}
+
+// Field { name, nullable, type_type, type, children }
+static uint32_t schemaField(FlatBuilder& fb, const std::string& name, bool timestamp) {
+    uint32_t type;
+    if (timestamp) {
+        uint32_t timezone = fb.createString("UTC");
+        fb.startTable();
+        fb.addOffset(1, timezone);
+        fb.addScalar<int16_t>(0, TIME_UNIT_MILLISECOND);
+        type = fb.endTable();
+    } else {
+        fb.startTable();
+        fb.addScalar<int16_t>(0, PRECISION_DOUBLE);
+        type = fb.endTable();
+    }
+    uint32_t name_offset = fb.createString(name);
+    uint32_t children = fb.createOffsetVector({});    // Readers insist on it
+
+    fb.startTable();
+    fb.addOffset(0, name_offset);
+    fb.addOffset(3, type);
+    fb.addOffset(5, children);
+    fb.addScalar<uint8_t>(1, timestamp ? 0 : 1);
+    fb.addScalar<uint8_t>(2, timestamp ? TYPE_TIMESTAMP : TYPE_FLOATING_POINT);
+    return fb.endTable();
+}
+
+// ---------------------------------------------------------------------------
+// Writer
+
+// Continuation marker, metadata length and the metadata; the body follows
+bool ArrowIpcWriter::writeMessage(const std::string& metadata) {
+    uint32_t marker = CONTINUATION;
+    int32_t length = static_cast<int32_t>(metadata.size());
+    return write(&marker, 4) && write(&length, 4) && write(metadata.data(), metadata.size());
+}
+
+bool ArrowIpcWriter::writeHeader() {
+    FlatBuilder fb;
+    std::vector<uint32_t> fields;
+    fields.reserve(names.size() + 1);
+    fields.push_back(schemaField(fb, "timestamp", true));
+    for (const auto& name : names) {
+        fields.push_back(schemaField(fb, name, false));
+    }
+    uint32_t field_vector = fb.createOffsetVector(fields);
+
+    fb.startTable();
+    fb.addOffset(1, field_vector);
+    uint32_t schema = fb.endTable();
+    return writeMessage(messageMetadata(fb, HEADER_SCHEMA, schema, 0));
+}
+
+bool ArrowIpcWriter::writeBatch() {
+    SELF_STATS_SCOPE(StageKind::EXPORTER, "arrow_batch");
+    const size_t rows = timestamps.size();
+    const size_t data_length = rows * 8;
+    const size_t bitmap_length = (rows + 7) / 8;
+
+    // Layout first: FieldNode {length, null_count} and Buffer {offset, length}
+    std::vector<int64_t> nodes;
+    std::vector<int64_t> buffers;
+    std::vector<bool> has_bitmap;
+    int64_t body = 0;
+    auto addBuffer = [&](size_t length) {
+        buffers.push_back(body);
+        buffers.push_back(static_cast<int64_t>(length));
+        body += padded8(length);
+    };
+
+    nodes.push_back(rows);
+    nodes.push_back(0);
+    addBuffer(0);
+    addBuffer(data_length);
+    for (const auto& column : columns) {
+        int64_t nulls = 0;
+        for (double value : column) nulls += std::isnan(value);
+        nodes.push_back(rows);
+        nodes.push_back(nulls);
+        has_bitmap.push_back(nulls > 0);
+        addBuffer(nulls > 0 ? bitmap_length : 0);
+        addBuffer(data_length);
+    }
+
+    FlatBuilder fb;
+    uint32_t buffer_vector = fb.createStructVector(buffers.data(), 16, buffers.size() / 2);
+    uint32_t node_vector = fb.createStructVector(nodes.data(), 16, nodes.size() / 2);
+    fb.startTable();
+    fb.addScalar<int64_t>(0, static_cast<int64_t>(rows));
+    fb.addOffset(1, node_vector);
+    fb.addOffset(2, buffer_vector);
+    uint32_t batch = fb.endTable();
+    if (!writeMessage(messageMetadata(fb, HEADER_RECORD_BATCH, batch, body))) return false;
+
+    // Then the body, straight from the column buffers; the values under a
+    // null slot are NaN, which is as good as anything
+    if (!write(timestamps.data(), data_length) || !writePadding(padded8(data_length) - data_length)) {
+        return false;
+    }
+    std::vector<uint8_t> bitmap(padded8(bitmap_length));
+    for (size_t c = 0; c < columns.size(); c++) {
+        const std::vector<double>& column = columns[c];
+        if (has_bitmap[c]) {
+            std::fill(bitmap.begin(), bitmap.end(), 0);
+            for (size_t row = 0; row < rows; row++) {
+                if (!std::isnan(column[row])) bitmap[row / 8] |= static_cast<uint8_t>(1u << (row % 8));
+            }
+            if (!write(bitmap.data(), bitmap.size())) return false;
+        }
+        if (!write(column.data(), data_length) ||
+            !writePadding(padded8(data_length) - data_length)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ArrowIpcWriter::writeTrailer() {
+    uint32_t end[2] = {CONTINUATION, 0};
+    return write(end, sizeof(end));
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+
+namespace {
+
+// Bounds-checked access to one flatbuffer; any bad offset clears ok
+struct FlatView {
+    const std::string& data;
+    bool ok;
+
+    explicit FlatView(const std::string& buffer) : data(buffer), ok(true) {}
+
+    template <typename T>
+    T get(size_t pos) {
+        T value = T();
+        if (pos > data.size() || data.size() - pos < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, data.data() + pos, sizeof(T));
+        return value;
+    }
+
+    size_t deref(size_t pos) { return pos + get<uint32_t>(pos); }
+
+    // Position of a table field's value, 0 if absent
+    size_t field(size_t table, uint16_t slot) {
+        size_t vtable = table - get<int32_t>(table);
+        uint16_t vtable_size = get<uint16_t>(vtable);
+        if (4u + slot * 2u + 2u > vtable_size) return 0;
+        uint16_t offset = get<uint16_t>(vtable + 4 + slot * 2);
+        return offset ? table + offset : 0;
+    }
+
+    template <typename T>
+    T scalar(size_t table, uint16_t slot, T fallback = T()) {
+        size_t pos = field(table, slot);
+        return pos ? get<T>(pos) : fallback;
+    }
+
+    size_t table(size_t parent, uint16_t slot) {
+        size_t pos = field(parent, slot);
+        return pos ? deref(pos) : 0;
+    }
+
+    std::string string(size_t parent, uint16_t slot) {
+        size_t pos = table(parent, slot);
+        if (!pos) return "";
+        uint32_t length = get<uint32_t>(pos);
+        if (!ok || data.size() - pos - 4 < length) {
+            ok = false;
+            return "";
+        }
+        return data.substr(pos + 4, length);
+    }
+};
+
+} // namespace
+
+bool ArrowIpcReader::open(const std::string& path) {
+    in.open(path, std::ios::binary);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    uint8_t type = 0;
+    if (!readMessage(type)) return false;
+    if (type != HEADER_SCHEMA) {
+        error = "stream does not start with a schema";
+        return false;
+    }
+
+    FlatView fb(metadata);
+    size_t message = fb.deref(0);
+    size_t header = fb.table(message, 2);
+    size_t fields = fb.table(header, 1);
+    uint32_t count = fields ? fb.get<uint32_t>(fields) : 0;
+    for (uint32_t i = 0; i < count && fb.ok; i++) {
+        size_t field = fb.deref(fields + 4 + i * 4);
+        Column column;
+        column.name = fb.string(field, 0);
+        column.nullable = fb.scalar<uint8_t>(field, 1) != 0;
+        uint8_t type_type = fb.scalar<uint8_t>(field, 2);
+        size_t type_table = fb.table(field, 3);
+        if (type_type == TYPE_TIMESTAMP || type_type == TYPE_INT) {
+            if (type_type == TYPE_INT && fb.scalar<int32_t>(type_table, 0) != 64) {
+                error = "column " + column.name + ": only 64-bit integers are supported";
+                return false;
+            }
+            column.timestamp = true;
+        } else if (type_type == TYPE_FLOATING_POINT &&
+                   fb.scalar<int16_t>(type_table, 0) == PRECISION_DOUBLE) {
+            column.timestamp = false;
+        } else {
+            error = "column " + column.name + ": unsupported type";
+            return false;
+        }
+        schema.push_back(column);
+    }
+    if (!fb.ok) {
+        error = "malformed schema";
+        return false;
+    }
+    return true;
+}
+
+bool ArrowIpcReader::readMessage(uint8_t& header_type) {
+    uint32_t marker = 0;
+    int32_t length = 0;
+    if (!in.read(reinterpret_cast<char*>(&marker), 4)) {
+        header_type = 0;    // Streams may also just end
+        return true;
+    }
+    if (marker == CONTINUATION) {
+        if (!in.read(reinterpret_cast<char*>(&length), 4)) {
+            error = "truncated message";
+            return false;
+        }
+    } else {
+        length = static_cast<int32_t>(marker);     // Pre-0.15 framing
+    }
+    if (length == 0) {
+        header_type = 0;
+        return true;
+    }
+    if (length < 0 || length > (64 << 20)) {
+        error = "bad message length";
+        return false;
+    }
+    metadata.resize(length);
+    if (!in.read(&metadata[0], length)) {
+        error = "truncated message";
+        return false;
+    }
+
+    FlatView fb(metadata);
+    size_t message = fb.deref(0);
+    header_type = fb.scalar<uint8_t>(message, 1);
+    int64_t body_length = fb.scalar<int64_t>(message, 3);
+    if (!fb.ok || body_length < 0 || body_length > (int64_t(1) << 34)) {
+        error = "malformed message";
+        return false;
+    }
+    body.resize(body_length);
+    if (body_length > 0 && !in.read(&body[0], body_length)) {
+        error = "truncated message body";
+        return false;
+    }
+    return true;
+}
+
+bool ArrowIpcReader::next(std::vector<int64_t>& timestamps, std::vector<std::vector<double>>& values) {
+    uint8_t type = 0;
+    do {
+        if (!readMessage(type) || type == 0) return false;
+    } while (type != HEADER_RECORD_BATCH);     // Skips anything else
+
+    FlatView fb(metadata);
+    size_t batch = fb.table(fb.deref(0), 2);
+    int64_t rows = fb.scalar<int64_t>(batch, 0);
+    size_t nodes = fb.table(batch, 1);
+    size_t buffers = fb.table(batch, 2);
+    if (!fb.ok || !nodes || !buffers || fb.field(batch, 3) != 0 || rows < 0 ||
+        fb.get<uint32_t>(nodes) != schema.size() ||
+        fb.get<uint32_t>(buffers) != schema.size() * 2) {
+        error = fb.field(batch, 3) ? "compressed batches are not supported" : "malformed record batch";
+        return false;
+    }
+
+    timestamps.clear();
+    values.assign(0, std::vector<double>());
+    bool have_timestamps = false;
+    for (size_t c = 0; c < schema.size(); c++) {
+        int64_t nulls = fb.get<int64_t>(nodes + 4 + c * 16 + 8);
+        int64_t bitmap_offset = fb.get<int64_t>(buffers + 4 + c * 32);
+        int64_t bitmap_length = fb.get<int64_t>(buffers + 4 + c * 32 + 8);
+        int64_t data_offset = fb.get<int64_t>(buffers + 4 + c * 32 + 16);
+        int64_t data_length = fb.get<int64_t>(buffers + 4 + c * 32 + 24);
+        if (!fb.ok || data_offset < 0 || data_length < rows * 8 ||
+            data_offset + rows * 8 > static_cast<int64_t>(body.size()) ||
+            (nulls > 0 && (bitmap_offset < 0 || bitmap_length < (rows + 7) / 8 ||
+                           bitmap_offset + (rows + 7) / 8 > static_cast<int64_t>(body.size())))) {
+            error = "record batch buffers out of range";
+            return false;
+        }
+        const char* data = body.data() + data_offset;
+        const uint8_t* bitmap = nulls > 0 ?
+            reinterpret_cast<const uint8_t*>(body.data() + bitmap_offset) : nullptr;
+
+        if (schema[c].timestamp) {
+            if (have_timestamps) continue;
+            timestamps.resize(rows);
+            memcpy(timestamps.data(), data, rows * 8);
+            have_timestamps = true;
+            continue;
+        }
+        values.emplace_back(rows);
+        std::vector<double>& column = values.back();
+        memcpy(column.data(), data, rows * 8);
+        if (bitmap) {
+            for (int64_t row = 0; row < rows; row++) {
+                if (!(bitmap[row / 8] & (1u << (row % 8)))) {
+                    column[row] = std::numeric_limits<double>::quiet_NaN();
+                }
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,272 @@
+#include "burst_capture.h"
+#include "json_writer.h"
+#include "self_stats.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+static int64_t wallMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static bool makeDirs(const std::string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        if (slash == std::string::npos) return true;
+    }
+}
+
+// The quick sample that tracks what the alert is about; CPU otherwise
+static double peakValue(const std::string& series, const BurstSample& sample) {
+    if (series == "memory_usage") return sample.ram_percent;
+    if (series == "swap_usage") return sample.swap_percent;
+    if (series.compare(0, 5, "load_") == 0) return sample.load_avg_1;
+    return sample.cpu_percent;
+}
+
+static double secondsBetween(std::chrono::steady_clock::time_point from,
+                             std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double>(to - from).count();
+}
+
+// Members only, so the peak can carry its process table too
+static void appendSampleFields(JsonWriter& json, const BurstSample& sample) {
+    json.memberInteger("t", sample.timestamp_ms);
+    json.memberNumber("cpu", sample.cpu_percent);
+    json.memberNumber("memory", sample.ram_percent);
+    json.memberNumber("swap", sample.swap_percent);
+    json.memberNumber("load_1", sample.load_avg_1);
+}
+
+BurstOptions::BurstOptions()
+    : enabled(false),
+      interval_ms(100),
+      window_seconds(10),
+      pre_samples(10),
+      top_processes(10),
+      dir("/var/lib/sysreport/bursts") {
+}
+
+BurstCapture::BurstCapture(const BurstOptions& opts)
+    : options(opts), stopping(false), running(false) {
+    options.interval_ms = std::max(10, std::min(options.interval_ms, 1000));
+}
+
+BurstCapture::~BurstCapture() {
+    stop();
+}
+
+void BurstCapture::record(const UtilizationInfo& util, int64_t timestamp_ms) {
+    if (options.pre_samples == 0) return;
+    BurstSample sample = {timestamp_ms, util.cpu_percent, util.ram_percent,
+                          util.swap_percent, util.load_avg_1};
+    pre_trigger.push_back(sample);
+    if (pre_trigger.size() > options.pre_samples) {
+        pre_trigger.pop_front();
+    }
+}
+
+bool BurstCapture::trigger(const std::string& rule, const std::string& series, double value) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (running) return false;
+        running = true;
+        stopping = false;
+    }
+    // The previous burst's thread has finished but may not be joined yet
+    if (worker.joinable()) worker.join();
+    worker = std::thread(&BurstCapture::run, this, rule, series, value, pre_trigger);
+    return true;
+}
+
+std::vector<std::string> BurstCapture::takeFinished() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> done;
+    done.swap(finished);
+    return done;
+}
+
+void BurstCapture::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+bool BurstCapture::sleepFor(int64_t milliseconds) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return !cv.wait_for(lock, std::chrono::milliseconds(milliseconds), [this]() { return stopping; });
+}
+
+void BurstCapture::run(std::string rule, std::string series, double value,
+                       std::deque<BurstSample> before) {
+    static std::atomic<uint64_t>& bursts = SelfStats::counter(
+        "bursts_total", "High-frequency captures started by an alert");
+    static std::atomic<uint64_t>& burst_samples = SelfStats::counter(
+        "burst_samples_total", "Samples taken during high-frequency captures");
+    bursts.fetch_add(1, std::memory_order_relaxed);
+
+    int64_t started_ms = wallMillis();
+    std::vector<BurstSample> samples;
+    samples.reserve(static_cast<size_t>(options.window_seconds * 1000 / options.interval_ms) + 1);
+    BurstSample peak = {0, 0, 0, 0, 0};
+    bool have_peak = false;
+    std::vector<ProcessInfo> peak_processes;
+    // A CPU alert wants the processes burning CPU, anything else the largest
+    bool by_cpu = series.compare(0, 3, "cpu") == 0;
+    std::vector<ProcessTimes> peak_scan;
+    std::chrono::steady_clock::time_point peak_scan_at;
+    bool peak_scan_pending = false;
+
+    // Absolute deadlines so the cadence doesn't drift by the sampling cost
+    auto next = std::chrono::steady_clock::now();
+    auto end = next + std::chrono::milliseconds(static_cast<int64_t>(options.window_seconds * 1000));
+    CpuTimes previous = readCpuTimes();
+    bool interrupted = false;
+
+    while (!interrupted) {
+        next += std::chrono::milliseconds(options.interval_ms);
+        if (next > end) break;
+        int64_t wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            next - std::chrono::steady_clock::now()).count();
+        if (wait_ms > 0 && !sleepFor(wait_ms)) interrupted = true;
+
+        CpuTimes current = readCpuTimes();
+        UtilizationInfo quick = getQuickUtilizationInfo();
+        long total_delta = current.total - previous.total;
+        BurstSample sample;
+        sample.timestamp_ms = wallMillis();
+        sample.cpu_percent = total_delta > 0 ?
+            static_cast<double>(current.busy - previous.busy) / total_delta * 100.0 : 0.0;
+        sample.ram_percent = quick.ram_percent;
+        sample.swap_percent = quick.swap_percent;
+        sample.load_avg_1 = quick.load_avg_1;
+        previous = current;
+        samples.push_back(sample);
+        burst_samples.fetch_add(1, std::memory_order_relaxed);
+
+        // Only a new high is worth the cost of a /proc scan; its process CPU
+        // comes from a second scan one interval later, unless a higher peak
+        // has superseded it by then
+        bool new_peak = !have_peak || peakValue(series, sample) > peakValue(series, peak);
+        if (new_peak || peak_scan_pending) {
+            std::vector<ProcessTimes> scan = readProcessTimes();
+            auto scanned_at = std::chrono::steady_clock::now();
+            if (new_peak) {
+                peak = sample;
+                have_peak = true;
+                peak_scan.swap(scan);
+                peak_scan_at = scanned_at;
+                peak_scan_pending = true;
+            } else {
+                peak_processes = rankProcesses(peak_scan, scan, secondsBetween(peak_scan_at, scanned_at),
+                                               options.top_processes, by_cpu);
+                peak_scan_pending = false;
+            }
+        }
+    }
+    if (peak_scan_pending) {
+        // The window closed (or stop() came) right after the peak
+        std::this_thread::sleep_until(peak_scan_at + std::chrono::milliseconds(options.interval_ms));
+        std::vector<ProcessTimes> scan = readProcessTimes();
+        peak_processes = rankProcesses(peak_scan, scan,
+                                       secondsBetween(peak_scan_at, std::chrono::steady_clock::now()),
+                                       options.top_processes, by_cpu);
+    }
+
+    // burst-YYYYmmdd-HHMMSS-RULE.json, written under a temporary name first
+    time_t started = static_cast<time_t>(started_ms / 1000);
+    struct tm tm_buf;
+    localtime_r(&started, &tm_buf);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm_buf);
+    std::string safe_rule = rule;
+    std::replace_if(safe_rule.begin(), safe_rule.end(),
+                    [](char c) { return !isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_'; },
+                    '_');
+    std::string path = options.dir + "/burst-" + stamp + "-" + safe_rule + ".json";
+
+    std::string out;
+    JsonWriter json(out, false);
+    json.beginObject();
+    json.member("rule", rule);
+    json.member("series", series);
+    json.memberNumber("trigger_value", value);
+    json.memberInteger("triggered_ms", started_ms);
+    json.memberInteger("interval_ms", options.interval_ms);
+    json.member("complete", !interrupted);
+    json.key("pre_trigger");
+    json.beginArray();
+    for (const BurstSample& sample : before) {
+        json.beginObject();
+        appendSampleFields(json, sample);
+        json.endObject();
+    }
+    json.endArray();
+    json.key("samples");
+    json.beginArray();
+    for (const BurstSample& sample : samples) {
+        json.beginObject();
+        appendSampleFields(json, sample);
+        json.endObject();
+    }
+    json.endArray();
+    json.key("peak");
+    if (have_peak) {
+        json.beginObject();
+        appendSampleFields(json, peak);
+        json.key("processes");
+        json.beginArray();
+        for (const ProcessInfo& proc : peak_processes) {
+            json.beginObject();
+            json.memberInteger("pid", proc.pid);
+            json.member("name", proc.name);
+            json.memberNumber("cpu_percent", proc.cpu_percent);
+            json.memberInteger("mem_mb", proc.mem_mb);
+            json.endObject();
+        }
+        json.endArray();
+        json.endObject();
+    } else {
+        json.null();
+    }
+    json.endObject();
+    out += '\n';
+
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(2);
+    std::string tmp = path + ".tmp";
+    bool written = false;
+    if (makeDirs(options.dir)) {
+        std::ofstream file(tmp);
+        file << out;
+        file.close();
+        written = file && rename(tmp.c_str(), path.c_str()) == 0;
+        if (!written) unlink(tmp.c_str());
+    }
+    if (written) {
+        summary << "# burst " << rule << " " << series << ": " << samples.size()
+                << " samples at " << options.interval_ms << "ms";
+        if (have_peak) summary << ", peak " << peakValue(series, peak);
+        summary << " -> " << path;
+    } else {
+        summary << "# burst " << rule << " " << series << ": cannot write " << path;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    finished.push_back(summary.str());
+    running = false;
+}
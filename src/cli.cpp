@@ -32,13 +32,15 @@ void printHelp() {
               << "  --process-only      Show only process information\n"
               << "\n"
               << "Output Format:\n"
-              << "  -f, --format FMT    Output format: text, json, csv (default: text)\n"
+              << "  -f, --format FMT    Output format: text, json, ndjson, csv (default: text)\n"
               << "  -o, --output FILE   Write output to file instead of stdout\n"
               << "  -c, --color         Enable colored output (default)\n"
               << "  --no-color          Disable colored output\n"
               << "  -p, --progress      Show progress bars for percentages\n"
               << "  -t, --timestamp     Include timestamp in output\n"
               << "  --alerts            Show threshold alerts/warnings\n"
+              << "  --self-stats        Show time spent in sysreport's own collectors\n"
+              << "  --fresh             Sample locally even if a daemon is running\n"
               << "\n"
               << "Watch Mode:\n"
               << "  -w, --watch         Continuous monitoring mode\n"
@@ -52,6 +54,9 @@ void printHelp() {
               << "  --baseline          Compare current metrics to baseline\n"
               << "  --save-baseline FILE Save current metrics as baseline\n"
               << "  --load-baseline FILE Load baseline from file for comparison\n"
+              << "  --export-history FILE Write the history as Arrow IPC (.parquet: Parquet)\n"
+              << "  --history-range D   Sparklines over the stored history's last D (e.g. 24h)\n"
+              << "  --history-store FILE History store to read (default: [daemon] history_store)\n"
               << "\n"
               << "Export Formats:\n"
               << "  --prometheus        Export metrics in Prometheus text format\n"
@@ -60,8 +65,29 @@ void printHelp() {
               << "Daemon Mode:\n"
               << "  --daemon            Run as background daemon\n"
               << "  --daemon-log FILE   Daemon log file (default: /var/log/sysreport.log)\n"
-              << "  --daemon-interval N Daemon polling interval in seconds (default: 60)\n"
+              << "  --daemon-interval N Daemon polling interval in seconds, fractions allowed\n"
+              << "                      (default: 60, ticks aligned to wall-clock multiples)\n"
               << "  --webhook URL       Send alerts to webhook URL\n"
+              << "  --metrics-listen ADDR Serve Prometheus /metrics over HTTP (e.g. :9100)\n"
+              << "  -f binary           Write the daemon log in the compact binary format\n"
+              << "\n"
+              << "Replay:\n"
+              << "  replay FILE         Print a binary daemon log (.gz segments accepted)\n"
+              << "    -f FMT            text, json, ndjson, csv, prometheus or influxdb (default: text)\n"
+              << "    --realtime        Pace output by the recorded timestamps\n"
+              << "  export FILE -o OUT  Convert a binary daemon log or history store to Arrow IPC\n"
+              << "                      or Parquet\n"
+              << "    --format FMT      arrow or parquet (default: from the OUT extension)\n"
+              << "    --batch-rows N    Rows per record batch / row group (default: 4096)\n"
+              << "    --step D          History store: one row per D bucket (avg, min, max),\n"
+              << "                      read from the coarsest rollup tier that has it\n"
+              << "  export --inspect F  Describe an Arrow, Parquet or history store file\n"
+              << "  query EXPR          Aggregate the history store: AGG(SELECTOR)[RANGE] step D,\n"
+              << "                      AGG min/max/avg/sum/count/first/last/median/pNN,\n"
+              << "                      RANGE 7d, -2h..-1h, 02:00..03:00 or 2024-05-01..2024-05-08\n"
+              << "    --store FILE      History store (default: [daemon] history_store)\n"
+              << "    -f FMT            text, json or csv (default: text)\n"
+              << "    --threads N       Blocks decoded in parallel (default: one per core)\n"
               << "\n"
               << "Plugin System:\n"
               << "  --plugin FILE       Load a plugin from file (.so)\n"
@@ -92,7 +118,9 @@ void printHelp() {
               << "  " << PROGRAM_NAME << " --cpu-only -w -i 1    # Watch CPU usage every second\n"
               << "  " << PROGRAM_NAME << " -s -f json -o hw.json # Save hardware info to JSON\n"
               << "  " << PROGRAM_NAME << " -d -t --alerts        # Dynamic with timestamps and alerts\n"
+              << "  " << PROGRAM_NAME << " -d -f ndjson -w -i 5  # One JSON line per sample, for pipes\n"
               << "  " << PROGRAM_NAME << " -w --history          # Watch mode with sparklines\n"
+              << "  " << PROGRAM_NAME << " --history-range 7d -d # Sparklines over the last week\n"
               << "  " << PROGRAM_NAME << " --plugin ./myplugin.so # Load signed plugin\n"
               << "  " << PROGRAM_NAME << " --plugin-dir /opt/plugins # Load all signed plugins\n"
               << "  " << PROGRAM_NAME << " --plugin-security permissive # Use relaxed security\n"
@@ -101,6 +129,11 @@ void printHelp() {
               << "  " << PROGRAM_NAME << " --prometheus          # Export metrics for Prometheus\n"
               << "  " << PROGRAM_NAME << " --influxdb            # Export in InfluxDB format\n"
               << "  " << PROGRAM_NAME << " --daemon --daemon-log /tmp/metrics.log # Run as daemon\n"
+              << "  " << PROGRAM_NAME << " --daemon --metrics-listen 127.0.0.1:9100 # Scrape endpoint\n"
+              << "  " << PROGRAM_NAME << " replay /var/log/sysreport.log -f influxdb # Re-export a binary log\n"
+              << "  " << PROGRAM_NAME << " export /var/log/sysreport.log -o week.parquet # For pandas/DuckDB\n"
+              << "  " << PROGRAM_NAME << " query 'p95(cpu_usage_percent)[02:00..03:00]' # Last night's p95\n"
+              << "  " << PROGRAM_NAME << " query 'max(memory_usage_percent)[7d] step 1d' -f csv # Daily peaks\n"
               << std::endl;
 }
 
@@ -0,0 +1,416 @@
+#include "columnar.h"
+#include "arrow_ipc.h"
+#include "delta_export.h"
+#include "history_store.h"
+#include "history_tiers.h"
+#include "metric_registry.h"
+#include "parquet.h"
+#include "sample_log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+
+ColumnarWriter::ColumnarWriter() : batch_rows(0), rows_written(0), bytes_written(0) {
+}
+
+bool ColumnarWriter::open(const std::string& path, const std::vector<std::string>& column_names,
+                          size_t rows_per_batch) {
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "cannot write " + path;
+        return false;
+    }
+    names = column_names;
+    batch_rows = rows_per_batch > 0 ? rows_per_batch : 1;
+    timestamps.reserve(batch_rows);
+    columns.assign(names.size(), std::vector<double>());
+    for (auto& column : columns) column.reserve(batch_rows);
+    return writeHeader();
+}
+
+bool ColumnarWriter::append(int64_t timestamp_ms, const std::vector<double>& values) {
+    timestamps.push_back(timestamp_ms);
+    for (size_t i = 0; i < columns.size(); i++) {
+        columns[i].push_back(i < values.size() ? values[i] : std::numeric_limits<double>::quiet_NaN());
+    }
+    return timestamps.size() < batch_rows || flushBatch();
+}
+
+bool ColumnarWriter::flushBatch() {
+    if (timestamps.empty()) return true;
+    bool ok = writeBatch();
+    rows_written += timestamps.size();
+    timestamps.clear();
+    for (auto& column : columns) column.clear();
+    return ok;
+}
+
+bool ColumnarWriter::close() {
+    bool ok = flushBatch() && writeTrailer();
+    out.close();
+    if (ok && out.fail()) {
+        ok = false;
+        error = "write failed";
+    }
+    return ok;
+}
+
+bool ColumnarWriter::write(const void* data, size_t length) {
+    out.write(static_cast<const char*>(data), length);
+    bytes_written += length;
+    if (!out) {
+        error = "write failed";
+        return false;
+    }
+    return true;
+}
+
+bool ColumnarWriter::writePadding(size_t length) {
+    static const char zeros[8] = {0};
+    return length == 0 || write(zeros, length);
+}
+
+std::unique_ptr<ColumnarWriter> createColumnarWriter(const std::string& format) {
+    if (format == "arrow") return std::unique_ptr<ColumnarWriter>(new ArrowIpcWriter());
+    if (format == "parquet") return std::unique_ptr<ColumnarWriter>(new ParquetWriter());
+    return nullptr;
+}
+
+std::string columnarFormatFor(const std::string& path) {
+    static const std::string suffix = ".parquet";
+    if (path.size() >= suffix.size() &&
+        path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        return "parquet";
+    }
+    return "arrow";
+}
+
+// Series key -> column, resolved once per registry series id
+class SeriesColumns {
+private:
+    std::unordered_map<std::string, size_t> by_key;
+    std::unordered_map<uint64_t, size_t> by_id;
+
+public:
+    std::vector<std::string> names;
+
+    // Column of a live series; new keys get a column only when add is set
+    size_t column(const MetricRegistry& metrics, uint32_t handle, bool add) {
+        uint64_t id = metrics.getSeries(handle).id;
+        auto cached = by_id.find(id);
+        if (cached != by_id.end()) return cached->second;
+
+        std::string key = seriesKey(metrics, handle);
+        auto found = by_key.find(key);
+        size_t index;
+        if (found != by_key.end()) {
+            index = found->second;
+        } else if (add) {
+            index = names.size();
+            by_key.emplace(key, index);
+            names.push_back(std::move(key));
+        } else {
+            index = SIZE_MAX;
+        }
+        by_id.emplace(id, index);
+        return index;
+    }
+};
+
+// Empty if the file reads back with rows rows and series + 1 columns
+template <typename Reader>
+static std::string readBack(const std::string& path, uint64_t rows, size_t series) {
+    Reader check;
+    std::vector<int64_t> timestamps;
+    std::vector<std::vector<double>> values;
+    uint64_t read_rows = 0;
+    if (check.open(path)) {
+        while (check.next(timestamps, values)) read_rows += timestamps.size();
+    }
+    if (!check.getError().empty()) return check.getError();
+    if (read_rows != rows || check.getSchema().size() != series + 1) return "row or column count differs";
+    return "";
+}
+
+int exportSampleLog(const std::string& log_path, const std::string& out_path,
+                    const std::string& format, size_t batch_rows) {
+    std::unique_ptr<ColumnarWriter> writer = createColumnarWriter(format);
+    if (!writer) {
+        std::cerr << "Error: unknown export format '" << format << "'. Use arrow or parquet." << std::endl;
+        return 1;
+    }
+
+    // First pass: every series that appears anywhere, in order of appearance
+    SeriesColumns columns;
+    UtilizationInfo util;
+    int64_t timestamp_ms = 0;
+    {
+        SampleLogReader reader;
+        if (!reader.open(log_path)) {
+            std::cerr << "Error: cannot read " << log_path << ": " << reader.getError() << std::endl;
+            return 1;
+        }
+        MetricRegistry metrics;
+        UtilizationMetrics recorder;
+        while (reader.next(util, timestamp_ms)) {
+            metrics.beginCycle();
+            recorder.record(metrics, util);
+            metrics.endCycle();
+            for (const MetricFamily& family : metrics.getFamilies()) {
+                for (uint32_t handle : family.series) {
+                    if (metrics.isLive(handle)) columns.column(metrics, handle, true);
+                }
+            }
+        }
+    }
+
+    if (!writer->open(out_path, columns.names, batch_rows)) {
+        std::cerr << "Error: " << writer->getError() << std::endl;
+        return 1;
+    }
+
+    // Second pass: the rows, batch_rows at a time
+    SampleLogReader reader;
+    reader.open(log_path);
+    MetricRegistry metrics;
+    UtilizationMetrics recorder;
+    std::vector<double> row;
+    SeriesColumns lookup = columns;
+    bool ok = true;
+    while (ok && reader.next(util, timestamp_ms)) {
+        metrics.beginCycle();
+        recorder.record(metrics, util);
+        metrics.endCycle();
+        row.assign(columns.names.size(), std::numeric_limits<double>::quiet_NaN());
+        for (const MetricFamily& family : metrics.getFamilies()) {
+            for (uint32_t handle : family.series) {
+                if (!metrics.isLive(handle)) continue;
+                size_t column = lookup.column(metrics, handle, false);
+                if (column != SIZE_MAX) row[column] = metrics.getSeries(handle).value;
+            }
+        }
+        ok = writer->append(timestamp_ms, row);
+    }
+    uint64_t rows = writer->rowCount();
+    if (!writer->close() || !ok) {
+        std::cerr << "Error: " << out_path << ": " << writer->getError() << std::endl;
+        return 1;
+    }
+    if (!reader.getError().empty()) {
+        std::cerr << "Warning: " << log_path << ": stopped after " << rows << " sample(s): "
+                  << reader.getError() << std::endl;
+    }
+
+    // The output is read back as a check of what was just written
+    std::string problem = format == "parquet" ? readBack<ParquetReader>(out_path, rows, columns.names.size())
+                                              : readBack<ArrowIpcReader>(out_path, rows, columns.names.size());
+    if (!problem.empty()) {
+        std::cerr << "Error: " << out_path << " does not read back: " << problem << std::endl;
+        return 1;
+    }
+
+    std::cout << "Exported " << rows << " sample(s) x " << columns.names.size() << " series to "
+              << out_path << " (" << format << ")" << std::endl;
+    return 0;
+}
+
+// Rows of step_ms buckets, a thousand steps of every series at a time
+static int exportHistoryBuckets(const std::string& store_path, const std::string& out_path,
+                                ColumnarWriter& writer, const std::string& format,
+                                size_t batch_rows, int64_t step_ms) {
+    HistoryTiers store;
+    if (!store.open(store_path)) {
+        std::cerr << "Error: " << store.getError() << std::endl;
+        return 1;
+    }
+    const std::vector<std::string>& series = store.getNames();
+    std::vector<std::string> names;
+    for (const std::string& name : series) {
+        names.push_back(name);
+        names.push_back(historyRollupSeries(name, 0));
+        names.push_back(historyRollupSeries(name, 1));
+    }
+    if (!writer.open(out_path, names, batch_rows)) {
+        std::cerr << "Error: " << writer.getError() << std::endl;
+        return 1;
+    }
+
+    const int64_t window_ms = step_ms * 1024;
+    std::vector<std::vector<HistoryBucket>> buckets(series.size());
+    std::vector<bool> tiers_used(store.getTiers().size(), false);
+    std::vector<int64_t> rows;
+    std::vector<double> row;
+    bool ok = true, intact = true;
+    int64_t start = store.firstTime() - ((store.firstTime() % step_ms) + step_ms) % step_ms;
+    for (int64_t from = start; ok && from <= store.lastTime(); from += window_ms) {
+        int64_t to = from + window_ms - 1;
+        rows.clear();
+        for (size_t i = 0; i < series.size(); i++) {
+            buckets[i].clear();
+            size_t tier = 0;
+            intact = store.read(series[i], from, to, step_ms, buckets[i], &tier) && intact;
+            if (!buckets[i].empty()) tiers_used[tier] = true;
+            for (const HistoryBucket& bucket : buckets[i]) rows.push_back(bucket.start_ms);
+        }
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+        std::vector<size_t> next(series.size(), 0);
+        for (int64_t timestamp : rows) {
+            row.assign(names.size(), std::numeric_limits<double>::quiet_NaN());
+            for (size_t i = 0; i < series.size(); i++) {
+                size_t& at = next[i];
+                while (at < buckets[i].size() && buckets[i][at].start_ms < timestamp) at++;
+                if (at < buckets[i].size() && buckets[i][at].start_ms == timestamp) {
+                    row[3 * i] = buckets[i][at].average();
+                    row[3 * i + 1] = buckets[i][at].min;
+                    row[3 * i + 2] = buckets[i][at].max;
+                }
+            }
+            ok = writer.append(timestamp, row);
+            if (!ok) break;
+        }
+    }
+    uint64_t written = writer.rowCount();
+    if (!writer.close() || !ok) {
+        std::cerr << "Error: " << out_path << ": " << writer.getError() << std::endl;
+        return 1;
+    }
+    if (!intact) {
+        std::cerr << "Warning: " << store_path << ": skipped blocks that failed their checksum" << std::endl;
+    }
+    std::string sources;
+    for (size_t tier = 0; tier < tiers_used.size(); tier++) {
+        if (!tiers_used[tier]) continue;
+        int64_t tier_step = store.getTiers()[tier].step_ms;
+        sources += (sources.empty() ? "" : ", ") + (tier_step == 0 ? std::string("raw") : formatDuration(tier_step));
+    }
+    std::cout << "Exported " << written << " " << formatDuration(step_ms) << " bucket(s) x " << series.size()
+              << " series to " << out_path << " (" << format << ", from "
+              << (sources.empty() ? std::string("no") : sources) << " tier)" << std::endl;
+    return 0;
+}
+
+int exportHistoryStore(const std::string& store_path, const std::string& out_path,
+                       const std::string& format, size_t batch_rows, int64_t step_ms) {
+    std::unique_ptr<ColumnarWriter> writer = createColumnarWriter(format);
+    if (!writer) {
+        std::cerr << "Error: unknown export format '" << format << "'. Use arrow or parquet." << std::endl;
+        return 1;
+    }
+    if (step_ms > 0) {
+        return exportHistoryBuckets(store_path, out_path, *writer, format, batch_rows, step_ms);
+    }
+    HistoryStoreReader store;
+    if (!store.open(store_path)) {
+        std::cerr << "Error: " << store.getError() << std::endl;
+        return 1;
+    }
+    std::vector<std::string> names;
+    for (const auto& series : store.getSeries()) names.push_back(series.name);
+    if (!writer->open(out_path, names, batch_rows)) {
+        std::cerr << "Error: " << writer->getError() << std::endl;
+        return 1;
+    }
+
+    const int64_t WINDOW_MS = 3600 * 1000;
+    std::vector<std::vector<int64_t>> times(names.size());
+    std::vector<std::vector<double>> values(names.size());
+    std::vector<int64_t> rows;
+    std::vector<double> row;
+    bool ok = true, intact = true;
+    for (int64_t from = store.firstTime(); ok && store.sampleCount() > 0 && from <= store.lastTime();
+         from += WINDOW_MS) {
+        int64_t to = from + WINDOW_MS - 1;
+        rows.clear();
+        for (uint32_t id = 0; id < names.size(); id++) {
+            times[id].clear();
+            values[id].clear();
+            intact = store.read(id, from, to, times[id], values[id]) && intact;
+            rows.insert(rows.end(), times[id].begin(), times[id].end());
+        }
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+        // Series are sampled together, so each one's next sample is
+        // usually the row's
+        std::vector<size_t> next(names.size(), 0);
+        for (int64_t timestamp : rows) {
+            row.assign(names.size(), std::numeric_limits<double>::quiet_NaN());
+            for (uint32_t id = 0; id < names.size(); id++) {
+                size_t& at = next[id];
+                while (at < times[id].size() && times[id][at] < timestamp) at++;
+                if (at < times[id].size() && times[id][at] == timestamp) row[id] = values[id][at];
+            }
+            ok = writer->append(timestamp, row);
+            if (!ok) break;
+        }
+    }
+    uint64_t written = writer->rowCount();
+    if (!writer->close() || !ok) {
+        std::cerr << "Error: " << out_path << ": " << writer->getError() << std::endl;
+        return 1;
+    }
+    if (!intact) {
+        std::cerr << "Warning: " << store_path << ": skipped blocks that failed their checksum" << std::endl;
+    }
+    std::cout << "Exported " << written << " sample(s) x " << names.size() << " series to "
+              << out_path << " (" << format << ")" << std::endl;
+    return 0;
+}
+
+template <typename Reader>
+static int inspectWith(const std::string& path) {
+    Reader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Error: " << reader.getError() << std::endl;
+        return 1;
+    }
+    std::vector<int64_t> timestamps;
+    std::vector<std::vector<double>> values;
+    uint64_t rows = 0, batches = 0;
+    int64_t first = 0, last = 0;
+    std::vector<uint64_t> present;
+    while (reader.next(timestamps, values)) {
+        if (!timestamps.empty()) {
+            if (rows == 0) first = timestamps.front();
+            last = timestamps.back();
+        }
+        rows += timestamps.size();
+        batches++;
+        present.resize(values.size(), 0);
+        for (size_t c = 0; c < values.size(); c++) {
+            for (double value : values[c]) present[c] += !std::isnan(value);
+        }
+    }
+    if (!reader.getError().empty()) {
+        std::cerr << "Error: " << reader.getError() << std::endl;
+        return 1;
+    }
+
+    std::cout << path << ": " << rows << " row(s) in " << batches << " batch(es)";
+    if (rows > 0) std::cout << ", timestamps " << first << " .. " << last << " ms";
+    std::cout << "\n";
+    size_t value_column = 0;
+    for (const auto& column : reader.getSchema()) {
+        std::cout << "  " << column.name << ": " << (column.timestamp ? "timestamp[ms]" : "double");
+        if (!column.timestamp) {
+            uint64_t count = value_column < present.size() ? present[value_column] : 0;
+            std::cout << " (" << count << " non-null)";
+            value_column++;
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
+
+int inspectColumnarFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[4] = {0, 0, 0, 0};
+    in.read(magic, sizeof(magic));
+    return memcmp(magic, "PAR1", 4) == 0 ? inspectWith<ParquetReader>(path)
+                                         : inspectWith<ArrowIpcReader>(path);
+}
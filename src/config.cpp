@@ -1,8 +1,11 @@
 #include "config.h"
+#include "history_store.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <cstdlib>
+#include <cmath>
+#include <initializer_list>
 #include <sys/stat.h>
 
 // Trim whitespace from both ends
@@ -45,14 +48,11 @@ std::string getDefaultConfigPath() {
     return config_dir + "/config.conf";
 }
 
-Config loadConfig(const std::string& config_path) {
-    Config config; // Start with defaults
-    
-    std::string path = config_path.empty() ? getDefaultConfigPath() : config_path;
-    
+// Parse a config file over the values already in config
+static bool parseConfigFile(const std::string& path, Config& config) {
     std::ifstream file(path);
     if (!file.is_open()) {
-        return config; // Return defaults if file doesn't exist
+        return false;
     }
     
     std::string line;
@@ -69,6 +69,16 @@ Config loadConfig(const std::string& config_path) {
         // Section header
         if (line[0] == '[' && line[line.length() - 1] == ']') {
             current_section = line.substr(1, line.length() - 2);
+            if (current_section.compare(0, 6, "alert.") == 0) {
+                AlertRule rule;
+                rule.name = current_section.substr(6);
+                rule.metric = rule.name;   // [alert.cpu_usage] needs no metric key
+                config.alert_rules.push_back(rule);
+            } else if (current_section.compare(0, 5, "sink.") == 0) {
+                SinkOptions sink;
+                sink.name = current_section.substr(5);
+                config.sinks.push_back(sink);
+            }
             continue;
         }
         
@@ -108,6 +118,81 @@ Config loadConfig(const std::string& config_path) {
             else if (key == "temp_warning") config.temp_warning_threshold = parseDouble(value);
             else if (key == "temp_critical") config.temp_critical_threshold = parseDouble(value);
         }
+        else if (current_section == "daemon") {
+            if (key == "interval") config.daemon_interval = parseDouble(value);
+            else if (key == "log_file") config.daemon_log_file = value;
+            else if (key == "format") config.daemon_format = value;
+            else if (key == "metrics_listen") config.metrics_listen = value;
+            else if (key == "shm_name") config.shm_name = value;
+            else if (key == "self_stats_interval") config.self_stats_interval = parseInt(value);
+            else if (key == "log_flush_interval_ms") config.log_flush_interval_ms = parseInt(value);
+            else if (key == "log_durability") config.log_durability = value;
+            else if (key == "log_sync_interval_ms") config.log_sync_interval_ms = parseInt(value);
+            else if (key == "log_sync_every") config.log_sync_every = parseInt(value);
+            else if (key == "log_queue_size") config.log_queue_size = parseInt(value);
+            else if (key == "log_overflow") config.log_overflow = value;
+            else if (key == "log_rotate_size_mb") config.log_rotate_size_mb = parseDouble(value);
+            else if (key == "log_rotate_age_hours") config.log_rotate_age_hours = parseDouble(value);
+            else if (key == "log_retention") config.log_retention = parseInt(value);
+            else if (key == "log_compression") config.log_compression = value;
+            else if (key == "alert_state_file") config.alert_state_file = value;
+            else if (key == "watch_config") config.watch_config = parseBool(value);
+            else if (key == "burst_capture") config.burst_capture = parseBool(value);
+            else if (key == "burst_interval_ms") config.burst_interval_ms = parseInt(value);
+            else if (key == "burst_window") config.burst_window = parseDouble(value);
+            else if (key == "burst_pre_samples") config.burst_pre_samples = parseInt(value);
+            else if (key == "burst_top_processes") config.burst_top_processes = parseInt(value);
+            else if (key == "burst_dir") config.burst_dir = value;
+            else if (key == "cpu_budget_percent") config.cpu_budget_percent = parseDouble(value);
+            else if (key == "rss_budget_mb") config.rss_budget_mb = parseDouble(value);
+            else if (key == "collector_sched_idle") config.collector_sched_idle = parseBool(value);
+            else if (key == "collector_cpus") config.collector_cpus = value;
+            else if (key == "delta_export") config.delta_export = parseBool(value);
+            else if (key == "delta_keyframe_every") config.delta_keyframe_every = parseInt(value);
+            else if (key == "delta_deadband") config.delta_deadband = parseDouble(value);
+            else if (key == "delta_deadbands") config.delta_deadbands = value;
+            else if (key == "history_store") config.history_store = value;
+            else if (key == "history_precision") config.history_precision = parseInt(value);
+            else if (key == "history_flush_interval") config.history_flush_interval = parseInt(value);
+            else if (key == "history_retention") config.history_retention = value;
+            else if (key == "history_rollups") config.history_rollups = value;
+        }
+        else if (current_section == "webhook") {
+            if (key == "url") config.webhook_url = value;
+            else if (key == "timeout_ms") config.webhook_timeout_ms = parseInt(value);
+            else if (key == "queue_size") config.webhook_queue_size = parseInt(value);
+            else if (key == "max_retries") config.webhook_max_retries = parseInt(value);
+            else if (key == "repeat_interval") config.webhook_repeat_interval = parseInt(value);
+        }
+        else if (current_section.compare(0, 6, "alert.") == 0) {
+            AlertRule& rule = config.alert_rules.back();
+            if (key == "metric") rule.metric = value;
+            else if (key == "trigger") rule.trigger = parseDouble(value);
+            else if (key == "clear") rule.clear = parseDouble(value);
+            else if (key == "direction") rule.below = (value == "below");
+            else if (key == "for") rule.for_seconds = parseInt(value);
+            else if (key == "clear_for") rule.clear_for_seconds = parseInt(value);
+            else if (key == "severity") rule.severity = value;
+            else if (key == "notify_resolved") rule.notify_resolved = parseBool(value);
+        }
+        else if (current_section.compare(0, 5, "sink.") == 0) {
+            SinkOptions& sink = config.sinks.back();
+            if (key == "type") sink.type = value;
+            else if (key == "format") sink.format = value;
+            else if (key == "path" || key == "listen" || key == "url") sink.target = value;
+            else if (key == "interval") sink.interval_seconds = parseDouble(value);
+            else if (key == "queue_size") sink.queue_size = parseInt(value);
+            else if (key == "batch_size") sink.batch_size = parseInt(value);
+            else if (key == "batch_age") sink.batch_age_seconds = parseDouble(value);
+            else if (key == "timeout_ms") sink.timeout_ms = parseInt(value);
+            else if (key == "spool_dir") sink.spool_dir = value;
+            else if (key == "spool_max_mb") sink.spool_max_mb = parseDouble(value);
+            else if (key == "gzip") sink.gzip = parseBool(value);
+            else if (key == "delta") sink.delta.enabled = parseBool(value);
+            else if (key == "keyframe_every") sink.delta.keyframe_every = parseInt(value);
+            else if (key == "deadband") sink.delta.deadband = parseDouble(value);
+            else if (key == "deadbands") sink.delta.deadbands = value;
+        }
         else if (current_section == "filters") {
             if (key == "cpu_only") config.cpu_only = parseBool(value);
             else if (key == "memory_only") config.memory_only = parseBool(value);
@@ -117,9 +202,121 @@ Config loadConfig(const std::string& config_path) {
         }
     }
     
+    return true;
+}
+
+Config loadConfig(const std::string& config_path) {
+    Config config; // Start with defaults
+    
+    std::string path = config_path.empty() ? getDefaultConfigPath() : config_path;
+    parseConfigFile(path, config); // Defaults if the file doesn't exist
+    
     return config;
 }
 
+static bool oneOf(const std::string& value, std::initializer_list<const char*> allowed) {
+    for (const char* candidate : allowed) {
+        if (value == candidate) return true;
+    }
+    return false;
+}
+
+static bool validDeltaOptions(int keyframe_every, double deadband, const std::string& deadbands,
+                              std::string& error) {
+    DeadbandPatterns patterns;
+    if (keyframe_every < 0) {
+        error = "keyframe_every cannot be negative";
+    } else if (!(deadband >= 0)) {
+        error = "deadband cannot be negative";
+    } else if (!parseDeadbands(deadbands, patterns, error)) {
+        return false;
+    }
+    return error.empty();
+}
+
+bool validateConfig(const Config& config, std::string& error) {
+    int64_t retention_ms = 0;
+    std::vector<HistoryTier> rollups;
+    if (config.default_interval < 1) {
+        error = "interval must be at least 1 second";
+    } else if (config.daemon_interval <= 0) {
+        error = "[daemon] interval must be positive";
+    } else if (!oneOf(config.daemon_format, {"json", "csv", "prometheus", "influxdb", "binary"})) {
+        error = "[daemon] unknown format '" + config.daemon_format + "'";
+    } else if (!oneOf(config.log_durability, {"none", "periodic", "every"})) {
+        error = "[daemon] unknown log_durability '" + config.log_durability + "'";
+    } else if (!oneOf(config.log_overflow, {"drop", "block"})) {
+        error = "[daemon] unknown log_overflow '" + config.log_overflow + "'";
+    } else if (!oneOf(config.log_compression, {"none", "gzip", "gz"})) {
+        error = "[daemon] unknown log_compression '" + config.log_compression + "'";
+    } else if (!config.webhook_url.empty() && config.webhook_url.compare(0, 7, "http://") != 0) {
+        error = "[webhook] url must start with http://";
+    } else if (config.delta_export &&
+               !oneOf(config.daemon_format, {"json", "influxdb", "binary"})) {
+        error = "[daemon] delta_export needs the json, influxdb or binary format";
+    } else if (!validDeltaOptions(config.delta_keyframe_every, config.delta_deadband,
+                                  config.delta_deadbands, error)) {
+        error = "[daemon] " + error;
+    } else if (config.history_precision > 9) {
+        error = "[daemon] history_precision cannot exceed 9 decimals";
+    } else if (config.history_flush_interval < 1) {
+        error = "[daemon] history_flush_interval must be at least 1 second";
+    } else if (!parseDuration(config.history_retention, retention_ms)) {
+        error = "[daemon] bad history_retention '" + config.history_retention + "'";
+    } else if (!parseHistoryTiers(config.history_rollups, rollups, error)) {
+        error = "[daemon] history_rollups: " + error;
+    }
+    if (!error.empty()) return false;
+    
+    for (const auto& rule : config.alert_rules) {
+        std::string where = "[alert." + rule.name + "] ";
+        if (rule.name.empty() || rule.metric.empty()) {
+            error = where + "needs a name and a metric";
+        } else if (rule.for_seconds < 0 || rule.clear_for_seconds < 0) {
+            error = where + "durations cannot be negative";
+        } else if (!std::isnan(rule.clear) &&
+                   (rule.below ? rule.clear < rule.trigger : rule.clear > rule.trigger)) {
+            error = where + "clear level is on the wrong side of trigger";
+        } else if (!oneOf(rule.severity, {"info", "warning", "critical"})) {
+            error = where + "unknown severity '" + rule.severity + "'";
+        }
+        if (!error.empty()) return false;
+    }
+    
+    for (const auto& sink : config.sinks) {
+        std::string where = "[sink." + sink.name + "] ";
+        if (sink.interval_seconds < 0) {
+            error = where + "interval cannot be negative";
+            return false;
+        }
+        if (!validDeltaOptions(sink.delta.keyframe_every, sink.delta.deadband,
+                               sink.delta.deadbands, error)) {
+            error = where + error;
+            return false;
+        }
+        if (!createSink(sink, error)) {
+            error = where + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool reloadConfig(const std::string& config_path, Config& config, std::string& error) {
+    std::string path = config_path.empty() ? getDefaultConfigPath() : config_path;
+    
+    Config fresh;
+    if (!parseConfigFile(path, fresh)) {
+        error = "cannot read " + path;
+        return false;
+    }
+    if (!validateConfig(fresh, error)) {
+        return false;
+    }
+    config = std::move(fresh);
+    return true;
+}
+
 void applyConfigToDisplayOptions(const Config& config, DisplayOptions& opts) {
     // Only apply config values that haven't been explicitly set by CLI
     // Note: In practice, we'd need to track which options were set via CLI
@@ -143,4 +340,6 @@ void applyConfigToDisplayOptions(const Config& config, DisplayOptions& opts) {
     opts.show_history = false;
     opts.show_baseline_comparison = false;
     opts.metric_history = nullptr;
+    opts.metrics = nullptr;
+    opts.sample_time = 0;
 }
@@ -1,51 +1,253 @@
 #include "daemon.h"
 #include "exporters.h"
+#include "self_stats.h"
+#include "plugin.h"
 #include <iostream>
+#include <fstream>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/inotify.h>
 #include <signal.h>
 #include <ctime>
 #include <sstream>
 #include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
 
 DaemonConfig::DaemonConfig() 
     : interval_seconds(60),
+      align_to_wall_clock(true),
       log_file("/var/log/sysreport.log"),
       pid_file("/var/run/sysreport.pid"),
       export_format("json"),
       enable_webhooks(false),
+      shm_name(SYSREPORT_SHM_NAME),
       cpu_threshold(90.0),
       memory_threshold(90.0),
       disk_threshold(90.0),
-      gpu_threshold(90.0) {
+      gpu_threshold(90.0),
+      alert_state_file("/var/lib/sysreport/alerts.state"),
+      watch_config(false),
+      self_stats_interval(300),
+      history_precision(2),
+      history_flush_interval(10),
+      history_retention("0") {
+}
+
+void applyConfigToDaemonConfig(const Config& config, DaemonConfig& daemon_cfg) {
+    if (config.daemon_interval > 0) {
+        daemon_cfg.interval_seconds = config.daemon_interval;
+    }
+    daemon_cfg.log_file = config.daemon_log_file;
+    daemon_cfg.export_format = config.daemon_format;
+    daemon_cfg.metrics_listen = config.metrics_listen;
+    daemon_cfg.shm_name = config.shm_name;
+    daemon_cfg.self_stats_interval = config.self_stats_interval;
+    
+    LogWriterOptions& log = daemon_cfg.log_options;
+    if (config.log_flush_interval_ms > 0) log.flush_interval_ms = config.log_flush_interval_ms;
+    if (config.log_sync_interval_ms > 0) log.sync_interval_ms = config.log_sync_interval_ms;
+    if (config.log_sync_every > 0) log.sync_every = config.log_sync_every;
+    if (config.log_queue_size > 0) log.queue_capacity = config.log_queue_size;
+    LogWriter::parseDurability(config.log_durability, log.durability);
+    LogWriter::parseOverflowPolicy(config.log_overflow, log.overflow);
+    
+    if (config.log_rotate_size_mb >= 0) {
+        log.rotate_bytes = static_cast<uint64_t>(config.log_rotate_size_mb * 1024 * 1024);
+    }
+    if (config.log_rotate_age_hours >= 0) {
+        log.rotate_seconds = static_cast<int>(config.log_rotate_age_hours * 3600);
+    }
+    if (config.log_retention >= 0) log.retention = config.log_retention;
+    if (!LogWriter::parseCompression(config.log_compression, log.compression)) {
+        std::cerr << "Warning: unsupported log_compression '" << config.log_compression
+                  << "', using gzip" << std::endl;
+    }
+    
+    if (!config.webhook_url.empty()) {
+        daemon_cfg.enable_webhooks = true;
+        daemon_cfg.webhook_url = config.webhook_url;
+    }
+    AlertDispatcherOptions& hook = daemon_cfg.webhook_options;
+    if (config.webhook_timeout_ms > 0) hook.timeout_ms = config.webhook_timeout_ms;
+    if (config.webhook_queue_size > 0) hook.queue_capacity = config.webhook_queue_size;
+    if (config.webhook_max_retries >= 0) hook.max_retries = config.webhook_max_retries;
+    if (config.webhook_repeat_interval >= 0) hook.repeat_interval = config.webhook_repeat_interval;
+    
+    daemon_cfg.alert_rules = config.alert_rules;
+    daemon_cfg.alert_state_file = config.alert_state_file;
+    daemon_cfg.watch_config = config.watch_config;
+    daemon_cfg.sinks = config.sinks;
+    
+    BurstOptions& burst = daemon_cfg.burst_options;
+    burst.enabled = config.burst_capture;
+    if (config.burst_interval_ms > 0) burst.interval_ms = config.burst_interval_ms;
+    if (config.burst_window > 0) burst.window_seconds = config.burst_window;
+    if (config.burst_pre_samples >= 0) burst.pre_samples = config.burst_pre_samples;
+    if (config.burst_top_processes > 0) burst.top_processes = config.burst_top_processes;
+    if (!config.burst_dir.empty()) burst.dir = config.burst_dir;
+    
+    BudgetOptions& budget = daemon_cfg.budget_options;
+    budget.cpu_percent = config.cpu_budget_percent > 0 ? config.cpu_budget_percent : 0;
+    budget.rss_mb = config.rss_budget_mb > 0 ? config.rss_budget_mb : 0;
+    budget.sched_idle = config.collector_sched_idle;
+    budget.cpus = config.collector_cpus;
+    
+    DeltaOptions& delta = daemon_cfg.delta_options;
+    delta.enabled = config.delta_export;
+    delta.keyframe_every = config.delta_keyframe_every;
+    delta.deadband = config.delta_deadband;
+    delta.deadbands = config.delta_deadbands;
+    
+    daemon_cfg.history_store = config.history_store;
+    daemon_cfg.history_precision = config.history_precision;
+    daemon_cfg.history_flush_interval = config.history_flush_interval;
+    daemon_cfg.history_retention = config.history_retention;
+    daemon_cfg.history_rollups = config.history_rollups;
 }
 
 DaemonMode::DaemonMode(const DaemonConfig& cfg) 
-    : config(cfg), running(false) {
+    : config(cfg), running(false), plugin_manager(nullptr), inotify_fd(-1) {
 }
 
 DaemonMode::~DaemonMode() {
     stop();
 }
 
+void DaemonMode::setConfigSource(const std::string& path,
+                                 const std::function<void(DaemonConfig&)>& overrides) {
+    config_path = path;
+    cli_overrides = overrides;
+}
+
+// ctime() without its trailing newline
+static std::string timeString() {
+    time_t now = time(nullptr);
+    std::string str = ctime(&now);
+    if (!str.empty() && str.back() == '\n') str.pop_back();
+    return str;
+}
+
 bool DaemonMode::start() {
     if (running) return false;
     
+    // Block signals before any helper thread exists so they all inherit the
+    // mask and SIGTERM/SIGHUP are only ever seen through the signalfd
+    long interval_ms = static_cast<long>(config.interval_seconds * 1000.0 + 0.5);
+    if (interval_ms < 1) interval_ms = 1;
+    
+    if (!scheduler.start(interval_ms, config.align_to_wall_clock)) {
+        std::cerr << "Failed to start scheduler (timerfd/signalfd unavailable)" << std::endl;
+        return false;
+    }
+    
     // Open log file
-    log_stream.open(config.log_file, std::ios::app);
-    if (!log_stream) {
+    log_writer.reset(new LogWriter(config.log_file, config.log_options));
+    if (config.export_format == "binary") {
+        // Each segment restarts the dictionary so it can be read on its own
+        sample_encoder.setDelta(config.delta_options);
+        log_writer->setHeaderProvider([this]() {
+            sample_encoder.reset();
+            return SampleLogEncoder::fileHeader();
+        });
+    } else if (config.delta_options.enabled) {
+        // Likewise every text segment starts with a keyframe
+        log_delta.reset(new DeltaFilter(config.delta_options));
+        log_writer->setHeaderProvider([this]() {
+            log_delta->forceKeyframe();
+            return std::string();
+        });
+    }
+    if (!log_writer->open()) {
         std::cerr << "Failed to open log file: " << config.log_file << std::endl;
+        log_writer.reset();
+        scheduler.stop();
         return false;
     }
     
     running = true;
     
     // Log startup
-    time_t now = time(nullptr);
-    log_stream << "=== Sysreport daemon started at " << ctime(&now);
-    log_stream << "Export format: " << config.export_format << std::endl;
-    log_stream << "Interval: " << config.interval_seconds << " seconds" << std::endl;
-    log_stream.flush();
+    logLine("=== Sysreport daemon started at " + timeString());
+    logLine("Export format: " + config.export_format);
+    std::ostringstream interval;
+    interval << "Interval: " << config.interval_seconds << " seconds";
+    logLine(interval.str());
+    
+    // Start the scrape endpoint
+    if (!config.metrics_listen.empty()) {
+        metrics_server.reset(new MetricsServer(config.metrics_listen));
+        if (metrics_server->start()) {
+            logLine("Serving metrics on http://" + config.metrics_listen + "/metrics");
+        } else {
+            logLine("Failed to listen on " + config.metrics_listen);
+            metrics_server.reset();
+        }
+    }
+    
+    // Local readers (and the CLI) copy the latest sample from here
+    if (!config.shm_name.empty()) {
+        std::string error;
+        if (shm_publisher.open(config.shm_name, interval_ms, error)) {
+            logLine("Publishing snapshots to shared memory " + config.shm_name);
+        } else {
+            logLine("Shared-memory snapshot disabled: " + error);
+        }
+    }
+    
+    if (!config.history_store.empty()) {
+        // Both specs were checked with the config
+        HistoryStoreOptions options;
+        std::string error;
+        options.precision = config.history_precision;
+        options.flush_interval_seconds = config.history_flush_interval;
+        parseDuration(config.history_retention, options.retention_ms);
+        parseHistoryTiers(config.history_rollups, options.rollups, error);
+        if (history_store.open(config.history_store, options)) {
+            std::string tiers = options.retention_ms > 0 ? formatDuration(options.retention_ms) : "forever";
+            for (const HistoryTier& tier : options.rollups) {
+                tiers += ", " + formatDuration(tier.step_ms) + " rollups " +
+                         (tier.retention_ms > 0 ? formatDuration(tier.retention_ms) : "forever");
+            }
+            logLine("Recording history to " + config.history_store + " (raw " + tiers + ")");
+        } else {
+            logLine("History store disabled: " + history_store.getError());
+        }
+    }
+    
+    startAlertDispatcher();
+    
+    if (config.burst_options.enabled) {
+        burst_capture.reset(new BurstCapture(config.burst_options));
+    }
+    
+    budget.reset(new ResourceBudget(config.budget_options));
+    if (budget->limited()) {
+        std::ostringstream limits;
+        limits << "Resource budget: cpu " << config.budget_options.cpu_percent
+               << "% rss " << config.budget_options.rss_mb << " MB (0: unlimited)";
+        logLine(limits.str());
+    }
+    
+    for (const auto& sink : config.sinks) {
+        std::string error;
+        if (sinks.add(sink, error)) {
+            logLine("Sink " + sink.name + ": " + sink.type + " " + sink.format + " -> " + sink.target);
+        } else {
+            logLine("Sink " + sink.name + " disabled: " + error);
+        }
+    }
+    
+    // Rules are evaluated even without a webhook; transitions are logged
+    alert_engine.reset(new AlertEngine(effectiveAlertRules()));
+    if (!config.alert_state_file.empty() && alert_engine->loadState(config.alert_state_file)) {
+        logLine("Restored alert state: " + std::to_string(alert_engine->firingCount()) + " firing");
+    }
+    
+    if (config.watch_config) {
+        watchConfigFile(true);
+    }
     
     // Run monitoring loop
     run();
@@ -58,110 +260,506 @@ void DaemonMode::stop() {
     
     running = false;
     
-    if (log_stream.is_open()) {
-        time_t now = time(nullptr);
-        log_stream << "=== Sysreport daemon stopped at " << ctime(&now);
-        log_stream.close();
+    watchConfigFile(false);
+    
+    if (metrics_server) {
+        metrics_server->stop();
+        metrics_server.reset();
+    }
+    
+    if (alert_dispatcher) {
+        alert_dispatcher->stop();
+        alert_dispatcher.reset();
+    }
+    
+    sinks.stop();
+    shm_publisher.close();
+    history_store.close();
+    
+    if (burst_capture) {
+        burst_capture->stop();
+        logFinishedBursts();
+        burst_capture.reset();
+    }
+    
+    if (alert_engine) {
+        if (!config.alert_state_file.empty() && alert_engine->isDirty()) {
+            alert_engine->saveState(config.alert_state_file);
+        }
+        alert_engine.reset();
+    }
+    
+    if (log_writer) {
+        logLine("=== Sysreport daemon stopped at " + timeString());
+        log_writer->close();
+        log_writer.reset();
     }
+    
+    scheduler.stop();
 }
 
 bool DaemonMode::isRunning() const {
     return running;
 }
 
+void DaemonMode::logLine(const std::string& line) {
+    if (!log_writer) return;
+    if (config.export_format == "binary") {
+        log_writer->write(SampleLogEncoder::note(line), true);
+    } else {
+        log_writer->write(line);
+    }
+}
+
 void DaemonMode::run() {
+    static std::atomic<uint64_t>& skipped_counter = SelfStats::counter(
+        "daemon_skipped_ticks_total", "Daemon ticks skipped because a cycle overran its interval");
+    
+    auto last_self_stats = std::chrono::steady_clock::now();
+    
+    // Only the collection thread (and bursts it starts) is deprioritized or
+    // pinned; the metrics server and sinks keep their normal scheduling
+    std::string sched_error;
+    if (!ResourceBudget::applyScheduling(config.budget_options, sched_error)) {
+        logLine("Collector scheduling not applied: " + sched_error);
+    }
+    
     while (running) {
-        // Gather metrics
-        UtilizationInfo util = getUtilizationInfo();
-        
-        // Check for alerts
-        if (config.enable_webhooks) {
-            checkAlerts(util);
+        switch (scheduler.wait()) {
+            case SchedulerEvent::TICK:
+                if (scheduler.lastSkipped() > 0) {
+                    skipped_counter.fetch_add(scheduler.lastSkipped(), std::memory_order_relaxed);
+                    logLine("# overrun: skipped " + std::to_string(scheduler.lastSkipped()) +
+                            " tick(s), " + std::to_string(scheduler.skippedTicks()) + " total");
+                }
+                
+                collectOnce();
+                
+                // Periodically record how long sysreport itself is taking
+                if (config.self_stats_interval > 0) {
+                    auto now = std::chrono::steady_clock::now();
+                    if (now - last_self_stats >= std::chrono::seconds(config.self_stats_interval)) {
+                        logSelfStats();
+                        last_self_stats = now;
+                    }
+                }
+                break;
+                
+            case SchedulerEvent::HANGUP:
+                handleHangup();
+                break;
+                
+            case SchedulerEvent::TERMINATE:
+                stop();
+                break;
+                
+            case SchedulerEvent::FD_READY:
+                if (inotify_fd >= 0 && scheduler.readyFd() == inotify_fd && configFileChanged()) {
+                    reloadConfig();
+                }
+                break;
+                
+            case SchedulerEvent::ERROR:
+                logLine("Scheduler error, stopping");
+                stop();
+                break;
+        }
+    }
+}
+
+void DaemonMode::collectOnce() {
+    // Gather metrics, with less detail while over budget
+    CollectionOptions collect = budget ? budget->collectionOptions() : CollectionOptions();
+    UtilizationInfo util = getUtilizationInfo(collect);
+    if (collect.processes) {
+        last_processes = util.top_processes;
+    } else if (collect.top_processes > 0) {
+        util.top_processes = last_processes;
+    }
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    
+    // Before the alert check, so a burst's pre-trigger history ends with
+    // the sample that tripped it
+    if (burst_capture) {
+        logFinishedBursts();
+        burst_capture->record(util, now_ms);
+    }
+    
+    // Plugins are asked once per cycle, for both alerts and /metrics
+    std::map<std::string, std::vector<MetricData>> plugin_metrics;
+    if (plugin_manager) {
+        plugin_metrics = plugin_manager->collectAllMetrics();
+    }
+    
+    // Check for alerts (queued, never sent from this thread)
+    if (alert_engine) {
+        checkAlerts(util, plugin_manager ? &plugin_metrics : nullptr);
+    }
+    
+    // Log metrics
+    logMetrics(util);
+    
+    shm_publisher.publish(util, now_ms);
+    
+    // Stamped with the tick the sample belongs to: an exact grid costs the
+    // store one bit per timestamp, collection jitter about ten
+    if (history_store.isOpen()) {
+        long interval_ms = scheduler.getInterval();
+        int64_t tick_ms = config.align_to_wall_clock && interval_ms > 0 ? now_ms - now_ms % interval_ms : now_ms;
+        history_store.record(utilizationRegistry(util), tick_ms);
+    }
+    
+    // Hand the sample to the other sinks; each formats it on its own thread
+    sinks.publish(util, now_ms);
+    
+    // Render once per cycle; scrapes only ever copy this buffer
+    if (metrics_server) {
+        metrics.beginCycle();
+        metric_recorder.record(metrics, util);
+        recordPluginMetrics(metrics, plugin_metrics);
+        metrics.endCycle();
+        std::string exposition;
+        PrometheusExporter::exportMetrics(metrics, exposition, true);
+        metrics_server->publish(exposition);
+    }
+    
+    // Charge this cycle's work (and the helper threads') against the budget
+    if (budget && budget->update()) {
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(1)
+             << "# budget: level " << budget->getLevel() << " (cpu " << budget->cpuPercent()
+             << "%, rss " << budget->rssMb() << " MB)";
+        logLine(line.str());
+    }
+}
+
+void DaemonMode::handleHangup() {
+    // Pick up a log file moved away by an external logrotate
+    if (log_writer) {
+        log_writer->requestReopen();
+    }
+    logLine("=== SIGHUP received at " + timeString() + ", log reopened");
+    
+    if (!config_path.empty()) {
+        reloadConfig();
+    }
+}
+
+void DaemonMode::startAlertDispatcher() {
+    // Alerts are delivered from their own thread
+    if (!config.enable_webhooks) return;
+    
+    alert_dispatcher.reset(new AlertDispatcher(config.webhook_url, config.webhook_options));
+    if (alert_dispatcher->start()) {
+        logLine("Sending alerts to " + config.webhook_url);
+    } else {
+        logLine("Webhook disabled: " + alert_dispatcher->getError());
+        alert_dispatcher.reset();
+    }
+}
+
+std::vector<AlertRule> DaemonMode::effectiveAlertRules() const {
+    if (!config.alert_rules.empty()) return config.alert_rules;
+    return defaultAlertRules(config.cpu_threshold, config.memory_threshold,
+                             config.disk_threshold, config.gpu_threshold);
+}
+
+template <typename T>
+static std::string toText(const T& value) {
+    std::ostringstream oss;
+    oss << value;
+    return oss.str();
+}
+
+static bool sameLogOptions(const LogWriterOptions& a, const LogWriterOptions& b) {
+    return a.queue_capacity == b.queue_capacity && a.flush_interval_ms == b.flush_interval_ms &&
+           a.durability == b.durability && a.sync_interval_ms == b.sync_interval_ms &&
+           a.sync_every == b.sync_every && a.overflow == b.overflow &&
+           a.rotate_bytes == b.rotate_bytes && a.rotate_seconds == b.rotate_seconds &&
+           a.retention == b.retention && a.compression == b.compression;
+}
+
+static bool sameWebhookOptions(const AlertDispatcherOptions& a, const AlertDispatcherOptions& b) {
+    return a.queue_capacity == b.queue_capacity && a.timeout_ms == b.timeout_ms &&
+           a.max_retries == b.max_retries && a.retry_base_ms == b.retry_base_ms &&
+           a.retry_max_ms == b.retry_max_ms && a.repeat_interval == b.repeat_interval;
+}
+
+void DaemonMode::reloadConfig() {
+    Config file_config;
+    std::string error;
+    if (!::reloadConfig(config_path, file_config, error)) {
+        logLine("Config reload failed, keeping current settings: " + error);
+        return;
+    }
+    
+    // Built the same way as at startup, so deleted keys fall back to defaults
+    DaemonConfig next;
+    next.pid_file = config.pid_file;
+    applyConfigToDaemonConfig(file_config, next);
+    if (cli_overrides) cli_overrides(next);
+    
+    // Everything below runs between two cycles on the collection thread, so
+    // the swap is atomic with respect to sampling. Collector state (network
+    // deltas, CPU baselines) lives outside config and is untouched.
+    std::vector<std::string> changes;
+    auto note = [&changes](const std::string& what, const std::string& before,
+                           const std::string& after, bool restart) {
+        changes.push_back(what + ": " + before + " -> " + after +
+                          (restart ? " (takes effect on restart)" : ""));
+    };
+    
+    if (next.interval_seconds != config.interval_seconds) {
+        long interval_ms = static_cast<long>(next.interval_seconds * 1000.0 + 0.5);
+        if (interval_ms < 1) interval_ms = 1;
+        note("interval", toText(config.interval_seconds), toText(next.interval_seconds), false);
+        scheduler.setInterval(interval_ms);
+        shm_publisher.setInterval(interval_ms);
+        config.interval_seconds = next.interval_seconds;
+    }
+    
+    if (next.self_stats_interval != config.self_stats_interval) {
+        note("self_stats_interval", toText(config.self_stats_interval),
+             toText(next.self_stats_interval), false);
+        config.self_stats_interval = next.self_stats_interval;
+    }
+    
+    if (next.export_format != config.export_format) {
+        // A binary log cannot switch to or from text in the middle of a segment
+        bool restart = next.export_format == "binary" || config.export_format == "binary";
+        note("format", config.export_format, next.export_format, restart);
+        if (!restart) config.export_format = next.export_format;
+        // Readers of the new format need every value again
+        if (!restart && log_delta) log_delta->forceKeyframe();
+    }
+    
+    if (next.log_file != config.log_file) {
+        note("log_file", config.log_file, next.log_file, true);
+    }
+    if (!sameLogOptions(next.log_options, config.log_options)) {
+        changes.push_back("log writer settings changed (takes effect on restart)");
+    }
+    if (next.metrics_listen != config.metrics_listen) {
+        note("metrics_listen", config.metrics_listen, next.metrics_listen, true);
+    }
+    if (next.shm_name != config.shm_name) {
+        note("shm_name", config.shm_name, next.shm_name, true);
+    }
+    if (next.history_store != config.history_store ||
+        next.history_precision != config.history_precision ||
+        next.history_flush_interval != config.history_flush_interval ||
+        next.history_retention != config.history_retention ||
+        next.history_rollups != config.history_rollups) {
+        changes.push_back("history store settings changed (takes effect on restart)");
+    }
+    const BurstOptions& burst = config.burst_options;
+    const BurstOptions& next_burst = next.burst_options;
+    if (next_burst.enabled != burst.enabled || next_burst.interval_ms != burst.interval_ms ||
+        next_burst.window_seconds != burst.window_seconds ||
+        next_burst.pre_samples != burst.pre_samples ||
+        next_burst.top_processes != burst.top_processes || next_burst.dir != burst.dir) {
+        changes.push_back("burst capture settings changed (takes effect on restart)");
+    }
+    BudgetOptions& limits = config.budget_options;
+    const BudgetOptions& next_limits = next.budget_options;
+    if (next_limits.cpu_percent != limits.cpu_percent || next_limits.rss_mb != limits.rss_mb) {
+        note("budget", toText(limits.cpu_percent) + "% " + toText(limits.rss_mb) + " MB",
+             toText(next_limits.cpu_percent) + "% " + toText(next_limits.rss_mb) + " MB", false);
+        limits.cpu_percent = next_limits.cpu_percent;
+        limits.rss_mb = next_limits.rss_mb;
+        if (budget) budget->setLimits(limits.cpu_percent, limits.rss_mb);
+    }
+    if (next_limits.sched_idle != limits.sched_idle || next_limits.cpus != limits.cpus) {
+        changes.push_back("collector scheduling changed (takes effect on restart)");
+    }
+    if (next.delta_options != config.delta_options) {
+        changes.push_back("delta export settings changed (takes effect on restart)");
+    }
+    if (next.sinks != config.sinks) {
+        note("sinks", toText(config.sinks.size()), toText(next.sinks.size()), true);
+    }
+    
+    std::string old_url = config.enable_webhooks ? config.webhook_url : "";
+    std::string new_url = next.enable_webhooks ? next.webhook_url : "";
+    if (old_url != new_url || !sameWebhookOptions(next.webhook_options, config.webhook_options)) {
+        if (old_url != new_url) {
+            note("webhook", old_url.empty() ? "off" : old_url, new_url.empty() ? "off" : new_url, false);
+        } else {
+            changes.push_back("webhook settings changed");
+        }
+        // Only a changed webhook restarts the dispatcher and its connection
+        if (alert_dispatcher) {
+            alert_dispatcher->stop();
+            alert_dispatcher.reset();
         }
-        
-        // Log metrics
-        logMetrics(util);
-        
-        // Sleep for interval
-        sleep(config.interval_seconds);
+        config.enable_webhooks = next.enable_webhooks;
+        config.webhook_url = next.webhook_url;
+        config.webhook_options = next.webhook_options;
+        startAlertDispatcher();
+    }
+    
+    if (next.alert_rules != config.alert_rules) {
+        note("alert rules", toText(config.alert_rules.size()), toText(next.alert_rules.size()), false);
+        config.alert_rules = next.alert_rules;
+        std::unique_ptr<AlertEngine> engine(new AlertEngine(effectiveAlertRules()));
+        if (alert_engine) engine->adoptState(*alert_engine);
+        alert_engine = std::move(engine);
+    }
+    if (next.alert_state_file != config.alert_state_file) {
+        note("alert_state_file", config.alert_state_file, next.alert_state_file, false);
+        config.alert_state_file = next.alert_state_file;
+    }
+    
+    if (next.watch_config != config.watch_config) {
+        note("watch_config", toText(config.watch_config), toText(next.watch_config), false);
+        config.watch_config = next.watch_config;
+        watchConfigFile(config.watch_config);
+    }
+    
+    if (changes.empty()) {
+        logLine("Config reloaded from " + config_path + ", no changes");
+        return;
+    }
+    logLine("Config reloaded from " + config_path + ", " + toText(changes.size()) + " change(s):");
+    for (const auto& change : changes) {
+        logLine("#   " + change);
     }
 }
 
-void DaemonMode::checkAlerts(const UtilizationInfo& util) {
-    WebhookClient webhook(config.webhook_url);
+void DaemonMode::watchConfigFile(bool enable) {
+    if (enable == (inotify_fd >= 0)) return;
     
-    // CPU alert
-    if (util.cpu_percent >= config.cpu_threshold) {
-        webhook.sendAlert("cpu_usage", util.cpu_percent, config.cpu_threshold, "warning");
+    if (!enable) {
+        scheduler.unwatchFd(inotify_fd);
+        close(inotify_fd);
+        inotify_fd = -1;
+        return;
     }
+    if (config_path.empty()) return;
     
-    // Memory alert
-    if (util.ram_percent >= config.memory_threshold) {
-        webhook.sendAlert("memory_usage", util.ram_percent, config.memory_threshold, "warning");
+    // Watch the directory: editors usually replace the file by renaming over it
+    size_t slash = config_path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." :
+                      slash == 0 ? "/" : config_path.substr(0, slash);
+    
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0 ||
+        inotify_add_watch(inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+        !scheduler.watchFd(inotify_fd)) {
+        logLine("Cannot watch " + config_path + ": " + strerror(errno));
+        if (inotify_fd >= 0) close(inotify_fd);
+        inotify_fd = -1;
+        return;
     }
+    logLine("Watching " + config_path + " for changes");
+}
+
+bool DaemonMode::configFileChanged() {
+    size_t slash = config_path.rfind('/');
+    std::string name = slash == std::string::npos ? config_path : config_path.substr(slash + 1);
     
-    // Disk alerts
-    for (const auto& disk : util.disks) {
-        if (disk.percent >= config.disk_threshold) {
-            webhook.sendAlert("disk_usage_" + disk.mount_point, disk.percent, 
-                            config.disk_threshold, "warning");
+    alignas(struct inotify_event) char buf[4096];
+    bool changed = false;
+    ssize_t n;
+    while ((n = read(inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char* p = buf; p < buf + n; ) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+            if (event->len > 0 && name == event->name) changed = true;
+            p += sizeof(struct inotify_event) + event->len;
         }
     }
+    return changed;
+}
+
+void DaemonMode::checkAlerts(const UtilizationInfo& util,
+                             const std::map<std::string, std::vector<MetricData>>* plugin_metrics) {
+    long now = time(nullptr);
+    forEachAlertSeries(util, plugin_metrics,
+                       [this, now](const std::string& key, double value) {
+        alert_engine->observe(key, value, now);
+    });
     
-    // GPU alert
-    if (!util.gpus.empty() && util.gpus[0].available) {
-        if (util.gpus[0].utilization_percent >= config.gpu_threshold) {
-            webhook.sendAlert("gpu_usage", util.gpus[0].utilization_percent,
-                            config.gpu_threshold, "info");
+    for (const AlertEvent& event : alert_engine->takeEvents()) {
+        const AlertRule& rule = *event.rule;
+        if (event.transition) {
+            std::ostringstream line;
+            line << "# alert " << rule.name << " " << event.series << " "
+                 << AlertEngine::stateName(event.state) << " value=" << event.value;
+            logLine(line.str());
+            
+            if (burst_capture && event.state == AlertState::FIRING &&
+                burst_capture->trigger(rule.name, event.series, event.value)) {
+                logLine("# burst " + rule.name + " " + event.series + " started");
+            }
         }
+        if (alert_dispatcher) {
+            Alert alert;
+            alert.rule = rule.name;
+            alert.metric = event.series;
+            alert.value = event.value;
+            alert.threshold = event.state == AlertState::RESOLVED ? rule.clear : rule.trigger;
+            alert.severity = rule.severity;
+            alert.status = AlertEngine::stateName(event.state);
+            alert.timestamp = now;
+            alert_dispatcher->submit(alert);
+        }
+    }
+    
+    // Only transitions dirty the state, so steady operation writes nothing
+    if (alert_engine->isDirty() && !config.alert_state_file.empty()) {
+        alert_engine->saveState(config.alert_state_file);
+    }
+}
+
+void DaemonMode::logFinishedBursts() {
+    for (const auto& line : burst_capture->takeFinished()) {
+        logLine(line);
     }
 }
 
 void DaemonMode::logMetrics(const UtilizationInfo& util) {
-    std::string entry = formatLogEntry(util);
-    log_stream << entry << std::endl;
-    log_stream.flush();
+    if (config.export_format == "binary") {
+        if (!log_writer) return;
+        // Rotate before encoding: deltas are relative to the segment
+        log_writer->rotateIfDue();
+        int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        log_writer->write(sample_encoder.encode(util, now_ms), true);
+        return;
+    }
+    if (log_delta && (config.export_format == "json" || config.export_format == "influxdb")) {
+        if (!log_writer) return;
+        log_writer->rotateIfDue();
+        std::string entry = formatDeltaEntry(util);
+        if (!entry.empty()) log_writer->write(entry);
+        return;
+    }
+    logLine(formatLogEntry(util));
+}
+
+void DaemonMode::logSelfStats() {
+    logLine("=== Self stats at " + timeString());
+    for (const auto& line : SelfStats::formatLogLines()) {
+        logLine("# " + line);
+    }
 }
 
 std::string DaemonMode::formatLogEntry(const UtilizationInfo& util) {
-    if (config.export_format == "prometheus") {
-        return PrometheusExporter::exportMetrics(util);
-    } else if (config.export_format == "influxdb") {
-        return InfluxDBExporter::exportMetrics(util);
-    } else if (config.export_format == "csv") {
-        std::ostringstream oss;
-        time_t now = time(nullptr);
-        oss << now << ","
-            << std::fixed << std::setprecision(2)
-            << util.cpu_percent << ","
-            << util.ram_percent << ","
-            << util.swap_percent << ",";
-        
-        if (!util.gpus.empty() && util.gpus[0].available) {
-            oss << util.gpus[0].utilization_percent << ","
-                << util.gpus[0].temperature;
-        } else {
-            oss << "0,0";
-        }
-        
-        return oss.str();
-    } else {
-        // JSON format
-        std::ostringstream oss;
-        time_t now = time(nullptr);
-        oss << "{\"timestamp\":" << now
-            << ",\"cpu\":" << std::fixed << std::setprecision(2) << util.cpu_percent
-            << ",\"memory\":" << util.ram_percent
-            << ",\"swap\":" << util.swap_percent;
-        
-        if (!util.gpus.empty() && util.gpus[0].available) {
-            oss << ",\"gpu\":" << util.gpus[0].utilization_percent
-                << ",\"gpu_temp\":" << util.gpus[0].temperature;
-        }
-        
-        oss << "}";
-        return oss.str();
+    SELF_STATS_SCOPE(StageKind::FORMATTER, "daemon_log");
+    return formatSampleEntry(config.export_format, util, time(nullptr));
+}
+
+std::string DaemonMode::formatDeltaEntry(const UtilizationInfo& util) {
+    SELF_STATS_SCOPE(StageKind::FORMATTER, "daemon_log");
+    const MetricRegistry& sample = utilizationRegistry(util);
+    if (config.export_format == "json") {
+        return formatDeltaJson(sample, *log_delta, time(nullptr));
     }
+    std::string lines;
+    InfluxDBExporter::exportMetrics(sample, lines, "sysreport", 0, log_delta.get());
+    if (!lines.empty()) lines.pop_back();    // The writer adds the last newline
+    return lines;
 }
 
 bool DaemonMode::daemonize() {
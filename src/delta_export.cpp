@@ -0,0 +1,174 @@
+#include "delta_export.h"
+#include "json_writer.h"
+#include "self_stats.h"
+#include <fnmatch.h>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+DeltaOptions::DeltaOptions() : enabled(false), keyframe_every(60), deadband(0) {
+}
+
+bool DeltaOptions::operator==(const DeltaOptions& other) const {
+    return enabled == other.enabled && keyframe_every == other.keyframe_every &&
+           deadband == other.deadband && deadbands == other.deadbands;
+}
+
+static std::string trim(const std::string& str) {
+    size_t start = str.find_first_not_of(" \t");
+    if (start == std::string::npos) return "";
+    size_t end = str.find_last_not_of(" \t");
+    return str.substr(start, end - start + 1);
+}
+
+bool parseDeadbands(const std::string& spec, DeadbandPatterns& out, std::string& error) {
+    out.clear();
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos) comma = spec.size();
+        std::string entry = trim(spec.substr(pos, comma - pos));
+        pos = comma + 1;
+        if (entry.empty()) continue;
+
+        size_t colon = entry.rfind(':');
+        if (colon == std::string::npos) {
+            error = "deadband '" + entry + "' needs pattern:value";
+            return false;
+        }
+        std::string pattern = trim(entry.substr(0, colon));
+        std::string value = trim(entry.substr(colon + 1));
+        char* end = nullptr;
+        double deadband = strtod(value.c_str(), &end);
+        if (pattern.empty() || value.empty() || *end != '\0' || !(deadband >= 0)) {
+            error = "bad deadband '" + entry + "'";
+            return false;
+        }
+        out.emplace_back(pattern, deadband);
+    }
+    return true;
+}
+
+double deadbandFor(const DeltaOptions& options, const DeadbandPatterns& patterns,
+                   const std::string& family) {
+    for (const auto& entry : patterns) {
+        if (fnmatch(entry.first.c_str(), family.c_str(), 0) == 0) return entry.second;
+    }
+    return options.deadband;
+}
+
+DeltaFilter::DeltaFilter(const DeltaOptions& opts)
+    : options(opts), samples(0), keyframe(false), force_keyframe(false) {
+    std::string error;
+    parseDeadbands(options.deadbands, patterns, error);   // Validated with the config
+}
+
+bool DeltaFilter::begin(const MetricRegistry& metrics) {
+    keyframe = force_keyframe || samples == 0 ||
+               (options.keyframe_every > 0 && samples % options.keyframe_every == 0);
+    force_keyframe = false;
+    samples++;
+    if (family_deadbands.size() < metrics.getFamilies().size()) {
+        family_deadbands.resize(metrics.getFamilies().size(),
+                                std::numeric_limits<double>::quiet_NaN());
+    }
+    return keyframe;
+}
+
+const std::string* DeltaFilter::pass(const MetricRegistry& metrics, uint32_t handle) {
+    const MetricSeries& series = metrics.getSeries(handle);
+    double& deadband = family_deadbands[series.family];
+    if (std::isnan(deadband)) {
+        deadband = deadbandFor(options, patterns, metrics.getFamilies()[series.family].name);
+    }
+
+    auto inserted = sent.emplace(series.id, Sent());
+    Sent& last = inserted.first->second;
+    last.sample = samples;
+    if (inserted.second) {
+        last.key = seriesKey(metrics, handle);
+    } else if (!keyframe && std::fabs(series.value - last.value) <= deadband) {
+        return nullptr;
+    }
+    last.value = series.value;
+    return &last.key;
+}
+
+const std::vector<std::string>& DeltaFilter::end() {
+    removed.clear();
+    for (auto it = sent.begin(); it != sent.end(); ) {
+        if (it->second.sample != samples) {
+            removed.push_back(std::move(it->second.key));
+            it = sent.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+std::string seriesKey(const MetricRegistry& metrics, uint32_t handle) {
+    const MetricSeries& series = metrics.getSeries(handle);
+    std::string key = metrics.getFamilies()[series.family].name;
+    const MetricLabels& labels = metrics.getLabels(series.labels);
+    for (size_t i = 0; i < labels.size(); i++) {
+        key += i == 0 ? '{' : ',';
+        key += labels[i].first;
+        key += "=\"";
+        for (char c : labels[i].second) {
+            if (c == '\n') {
+                key += "\\n";
+                continue;
+            }
+            if (c == '\\' || c == '"') key += '\\';
+            key += c;
+        }
+        key += '"';
+    }
+    if (!labels.empty()) key += '}';
+    return key;
+}
+
+std::string formatDeltaJson(const MetricRegistry& metrics, DeltaFilter& filter, time_t timestamp) {
+    SELF_STATS_SCOPE(StageKind::FORMATTER, "delta_json");
+    std::string out = "{\"timestamp\":" + std::to_string(static_cast<long long>(timestamp));
+    if (filter.begin(metrics)) out += ",\"keyframe\":true";
+    out += ",\"values\":{";
+
+    bool first = true;
+    char buf[64];
+    for (const MetricFamily& family : metrics.getFamilies()) {
+        for (uint32_t handle : family.series) {
+            if (!metrics.isLive(handle)) continue;
+            const std::string* key = filter.pass(metrics, handle);
+            if (!key) continue;
+            if (!first) out += ',';
+            first = false;
+            appendJsonString(out, *key);
+            out += ':';
+            double value = metrics.getSeries(handle).value;
+            if (!std::isfinite(value)) {
+                out += "null";
+                continue;
+            }
+            std::to_chars_result result = family.integral ?
+                std::to_chars(buf, buf + sizeof(buf), std::llround(value)) :
+                std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::fixed, 2);
+            out.append(buf, result.ptr);
+        }
+    }
+    out += '}';
+
+    const std::vector<std::string>& removed = filter.end();
+    if (!removed.empty()) {
+        out += ",\"removed\":[";
+        for (size_t i = 0; i < removed.size(); i++) {
+            if (i > 0) out += ',';
+            appendJsonString(out, removed[i]);
+        }
+        out += ']';
+    }
+    out += '}';
+    return out;
+}
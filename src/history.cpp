@@ -1,4 +1,7 @@
 #include "history.h"
+#include "columnar.h"
+#include "history_tiers.h"
+#include "system_info.h"
 #include <fstream>
 #include <sstream>
 #include <algorithm>
@@ -7,155 +10,212 @@
 // Unicode sparkline characters
 static const char* SPARK_CHARS[] = {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
 
-MetricHistory::MetricHistory(size_t max_samples) 
-    : max_history(max_samples), has_baseline(false) {
+MetricHistory::MetricHistory(size_t max_samples, size_t series_limit)
+    : capacity(max_samples > 0 ? max_samples : 1), max_series(series_limit),
+      count(0), head(0), timestamps(capacity, 0), has_baseline(false) {
+    rings.reserve(std::min<size_t>(max_series, 256));
+    cpu_id = addSeries("cpu_percent");
+    ram_id = addSeries("ram_percent");
+    swap_id = addSeries("swap_percent");
+    gpu_id = addSeries("gpu_percent");
+    gpu_temp_id = addSeries("gpu_temp");
 }
 
-void MetricHistory::addSnapshot(const MetricSnapshot& snapshot) {
-    snapshots.push_back(snapshot);
+MetricHistory::SeriesId MetricHistory::addSeries(const std::string& name) {
+    auto found = by_name.find(name);
+    if (found != by_name.end()) return found->second;
+    if (names.size() >= max_series) return NO_SERIES;
     
-    // Keep only max_history samples
-    while (snapshots.size() > max_history) {
-        snapshots.pop_front();
-    }
+    SeriesId id = static_cast<SeriesId>(names.size());
+    names.push_back(name);
+    rings.emplace_back(capacity, NAN);
+    by_name.emplace(name, id);
+    return id;
 }
 
-void MetricHistory::setBaseline(const MetricSnapshot& snapshot) {
-    baseline = snapshot;
-    has_baseline = true;
+MetricHistory::SeriesId MetricHistory::findSeries(const std::string& name) const {
+    auto found = by_name.find(name);
+    return found != by_name.end() ? found->second : NO_SERIES;
 }
 
-void MetricHistory::clearBaseline() {
-    has_baseline = false;
+void MetricHistory::beginSample(int64_t timestamp_ms) {
+    head = count == 0 ? 0 : (head + 1) % capacity;
+    if (count < capacity) count++;
+    timestamps[head] = timestamp_ms;
+    for (auto& ring : rings) ring[head] = NAN;
 }
 
-bool MetricHistory::hasBaseline() const {
-    return has_baseline;
+// Keyed lookups for the map fields; the name is only built for a new key
+static MetricHistory::SeriesId keyedSeries(MetricHistory& history,
+                                           std::unordered_map<std::string, MetricHistory::SeriesId>& ids,
+                                           const char* prefix, const std::string& key) {
+    auto found = ids.find(key);
+    if (found != ids.end()) return found->second;
+    MetricHistory::SeriesId id = history.addSeries(prefix + key);
+    ids.emplace(key, id);
+    return id;
 }
 
-std::vector<double> MetricHistory::getCpuHistory(size_t count) const {
-    std::vector<double> history;
-    size_t start = snapshots.size() > count ? snapshots.size() - count : 0;
-    
-    for (size_t i = start; i < snapshots.size(); i++) {
-        history.push_back(snapshots[i].cpu_percent);
+void MetricHistory::setCores(const std::vector<double>& cores) {
+    while (core_ids.size() < cores.size()) {
+        core_ids.push_back(addSeries("cpu_core_" + std::to_string(core_ids.size())));
+    }
+    for (size_t i = 0; i < cores.size(); i++) {
+        set(core_ids[i], cores[i]);
     }
-    
-    return history;
 }
 
-std::vector<double> MetricHistory::getRamHistory(size_t count) const {
-    std::vector<double> history;
-    size_t start = snapshots.size() > count ? snapshots.size() - count : 0;
+void MetricHistory::addSnapshot(const MetricSnapshot& snapshot) {
+    beginSample(std::chrono::duration_cast<std::chrono::milliseconds>(
+        snapshot.timestamp.time_since_epoch()).count());
+    set(cpu_id, snapshot.cpu_percent);
+    set(ram_id, snapshot.ram_percent);
+    set(swap_id, snapshot.swap_percent);
+    set(gpu_id, snapshot.gpu_percent);
+    set(gpu_temp_id, snapshot.gpu_temp);
     
-    for (size_t i = start; i < snapshots.size(); i++) {
-        history.push_back(snapshots[i].ram_percent);
+    setCores(snapshot.cpu_per_core);
+    for (const auto& disk : snapshot.disk_usage) {
+        set(keyedSeries(*this, disk_ids, "disk_usage:", disk.first), disk.second);
+    }
+    for (const auto& rx : snapshot.network_rx) {
+        set(keyedSeries(*this, rx_ids, "network_rx:", rx.first), static_cast<double>(rx.second));
+    }
+    for (const auto& tx : snapshot.network_tx) {
+        set(keyedSeries(*this, tx_ids, "network_tx:", tx.first), static_cast<double>(tx.second));
     }
-    
-    return history;
 }
 
-std::vector<double> MetricHistory::getGpuHistory(size_t count) const {
-    std::vector<double> history;
-    size_t start = snapshots.size() > count ? snapshots.size() - count : 0;
+void MetricHistory::addUtilization(int64_t timestamp_ms, const UtilizationInfo& util) {
+    beginSample(timestamp_ms);
+    set(cpu_id, util.cpu_percent);
+    set(ram_id, util.ram_percent);
+    set(swap_id, util.swap_percent);
+    bool gpu = !util.gpus.empty() && util.gpus[0].available;
+    set(gpu_id, gpu ? util.gpus[0].utilization_percent : 0.0);
+    set(gpu_temp_id, gpu ? util.gpus[0].temperature : 0.0);
     
-    for (size_t i = start; i < snapshots.size(); i++) {
-        history.push_back(snapshots[i].gpu_percent);
+    setCores(util.cpu_per_core);
+    for (const auto& disk : util.disks) {
+        set(keyedSeries(*this, disk_ids, "disk_usage:", disk.mount_point), disk.percent);
+    }
+    for (const auto& net : util.network) {
+        set(keyedSeries(*this, rx_ids, "network_rx:", net.interface), static_cast<double>(net.rx_bytes));
+        set(keyedSeries(*this, tx_ids, "network_tx:", net.interface), static_cast<double>(net.tx_bytes));
     }
-    
-    return history;
 }
 
-double MetricHistory::getCpuTrend() const {
-    if (snapshots.size() < 2) return 0.0;
-    
-    // Simple linear regression over recent samples
-    size_t count = std::min(snapshots.size(), (size_t)10);
-    double sum_x = 0, sum_y = 0, sum_xy = 0, sum_xx = 0;
-    
-    for (size_t i = 0; i < count; i++) {
-        size_t idx = snapshots.size() - count + i;
-        double x = i;
-        double y = snapshots[idx].cpu_percent;
-        sum_x += x;
-        sum_y += y;
-        sum_xy += x * y;
-        sum_xx += x * x;
-    }
-    
-    double slope = (count * sum_xy - sum_x * sum_y) / (count * sum_xx - sum_x * sum_x);
-    return slope;
+void MetricHistory::setBaseline(const MetricSnapshot& snapshot) {
+    baseline = snapshot;
+    has_baseline = true;
 }
 
-double MetricHistory::getRamTrend() const {
-    if (snapshots.size() < 2) return 0.0;
-    
-    size_t count = std::min(snapshots.size(), (size_t)10);
-    double sum_x = 0, sum_y = 0, sum_xy = 0, sum_xx = 0;
-    
-    for (size_t i = 0; i < count; i++) {
-        size_t idx = snapshots.size() - count + i;
-        double x = i;
-        double y = snapshots[idx].ram_percent;
-        sum_x += x;
-        sum_y += y;
-        sum_xy += x * y;
-        sum_xx += x * x;
-    }
-    
-    double slope = (count * sum_xy - sum_x * sum_y) / (count * sum_xx - sum_x * sum_x);
-    return slope;
+void MetricHistory::clearBaseline() {
+    has_baseline = false;
 }
 
-double MetricHistory::getGpuTrend() const {
-    if (snapshots.size() < 2) return 0.0;
-    
-    size_t count = std::min(snapshots.size(), (size_t)10);
-    double sum_x = 0, sum_y = 0, sum_xy = 0, sum_xx = 0;
-    
-    for (size_t i = 0; i < count; i++) {
-        size_t idx = snapshots.size() - count + i;
+bool MetricHistory::hasBaseline() const {
+    return has_baseline;
+}
+
+template <typename T>
+static RingSpan<T> ringSpan(const T* ring, size_t capacity, size_t head, size_t count, size_t samples) {
+    size_t n = std::min(samples, count);
+    size_t start = (head + capacity + 1 - n) % capacity;
+    if (n == 0) return RingSpan<T>{ring, 0, ring, 0};
+    if (start + n <= capacity) return RingSpan<T>{ring + start, n, ring, 0};
+    return RingSpan<T>{ring + start, capacity - start, ring, n - (capacity - start)};
+}
+
+HistorySpan MetricHistory::getSeries(SeriesId id, size_t samples) const {
+    if (id >= rings.size()) return HistorySpan{nullptr, 0, nullptr, 0};
+    return ringSpan(rings[id].data(), capacity, head, count, samples);
+}
+
+RingSpan<int64_t> MetricHistory::getTimestamps(size_t samples) const {
+    return ringSpan(timestamps.data(), capacity, head, count, samples);
+}
+
+double MetricHistory::getTrend(const HistorySpan& data) {
+    double n = 0, sum_x = 0, sum_y = 0, sum_xy = 0, sum_xx = 0;
+    for (size_t i = 0; i < data.size(); i++) {
+        double y = data[i];
+        if (std::isnan(y)) continue;
         double x = i;
-        double y = snapshots[idx].gpu_percent;
+        n++;
         sum_x += x;
         sum_y += y;
         sum_xy += x * y;
         sum_xx += x * x;
     }
+    if (n < 2) return 0.0;
     
-    double slope = (count * sum_xy - sum_x * sum_y) / (count * sum_xx - sum_x * sum_x);
-    return slope;
+    // Simple linear regression
+    return (n * sum_xy - sum_x * sum_y) / (n * sum_xx - sum_x * sum_x);
 }
 
 MetricSnapshot MetricHistory::getBaseline() const {
     return baseline;
 }
 
+double MetricHistory::latest(SeriesId id) const {
+    return count > 0 && id < rings.size() ? rings[id][head] : NAN;
+}
+
 MetricSnapshot MetricHistory::getLatest() const {
-    if (snapshots.empty()) {
-        return MetricSnapshot();
+    MetricSnapshot snap = MetricSnapshot();
+    if (count == 0) {
+        return snap;
+    }
+    snap.timestamp = std::chrono::system_clock::time_point(std::chrono::milliseconds(timestamps[head]));
+    snap.cpu_percent = latest(cpu_id);
+    snap.ram_percent = latest(ram_id);
+    snap.swap_percent = latest(swap_id);
+    snap.gpu_percent = latest(gpu_id);
+    snap.gpu_temp = latest(gpu_temp_id);
+    for (SeriesId id : core_ids) snap.cpu_per_core.push_back(latest(id));
+    for (const auto& disk : disk_ids) {
+        if (!std::isnan(latest(disk.second))) snap.disk_usage[disk.first] = latest(disk.second);
+    }
+    for (const auto& rx : rx_ids) {
+        if (!std::isnan(latest(rx.second))) snap.network_rx[rx.first] = static_cast<long>(latest(rx.second));
     }
-    return snapshots.back();
+    for (const auto& tx : tx_ids) {
+        if (!std::isnan(latest(tx.second))) snap.network_tx[tx.first] = static_cast<long>(latest(tx.second));
+    }
+    return snap;
 }
 
-std::string MetricHistory::renderSparkline(const std::vector<double>& data) const {
-    if (data.empty()) return "";
-    
-    // Find min and max
-    double min_val = *std::min_element(data.begin(), data.end());
-    double max_val = *std::max_element(data.begin(), data.end());
-    
-    // Handle case where all values are the same
-    if (max_val - min_val < 0.01) {
-        return std::string(data.size(), SPARK_CHARS[4][0]);
+void MetricHistory::clear() {
+    count = 0;
+    head = 0;
+}
+
+std::string MetricHistory::renderSparkline(const HistorySpan& data) const {
+    // Find min and max, skipping samples the series had no value for
+    double min_val = INFINITY, max_val = -INFINITY;
+    for (size_t i = 0; i < data.size(); i++) {
+        if (std::isnan(data[i])) continue;
+        min_val = std::min(min_val, data[i]);
+        max_val = std::max(max_val, data[i]);
     }
+    if (min_val > max_val) return "";
     
     std::string sparkline;
-    for (double val : data) {
-        // Normalize to 0-7 range
-        int idx = static_cast<int>((val - min_val) / (max_val - min_val) * 7);
-        idx = std::max(0, std::min(7, idx));
-        sparkline += SPARK_CHARS[idx];
+    sparkline.reserve(data.size() * 3);
+    for (size_t i = 0; i < data.size(); i++) {
+        double val = data[i];
+        if (std::isnan(val)) {
+            sparkline += ' ';
+        } else if (max_val - min_val < 0.01) {
+            // Handle case where all values are the same
+            sparkline += SPARK_CHARS[4];
+        } else {
+            // Normalize to 0-7 range
+            int idx = static_cast<int>((val - min_val) / (max_val - min_val) * 7);
+            idx = std::max(0, std::min(7, idx));
+            sparkline += SPARK_CHARS[idx];
+        }
     }
     
     return sparkline;
@@ -173,18 +233,113 @@ bool MetricHistory::saveToFile(const std::string& filepath) const {
     
     file << "timestamp,cpu_percent,ram_percent,swap_percent,gpu_percent,gpu_temp\n";
     
-    for (const auto& snap : snapshots) {
-        auto epoch = std::chrono::duration_cast<std::chrono::seconds>(
-            snap.timestamp.time_since_epoch()).count();
-        
-        file << epoch << ","
-             << snap.cpu_percent << ","
-             << snap.ram_percent << ","
-             << snap.swap_percent << ","
-             << snap.gpu_percent << ","
-             << snap.gpu_temp << "\n";
+    RingSpan<int64_t> times = getTimestamps(count);
+    HistorySpan cpu = getSeries(cpu_id, count), ram = getSeries(ram_id, count),
+                swap = getSeries(swap_id, count), gpu = getSeries(gpu_id, count),
+                gpu_temp = getSeries(gpu_temp_id, count);
+    for (size_t i = 0; i < times.size(); i++) {
+        file << times[i] / 1000 << ","
+             << cpu[i] << ","
+             << ram[i] << ","
+             << swap[i] << ","
+             << gpu[i] << ","
+             << gpu_temp[i] << "\n";
+    }
+    
+    return true;
+}
+
+bool MetricHistory::exportColumnar(const std::string& filepath, const std::string& format,
+                                   std::string& error) const {
+    std::unique_ptr<ColumnarWriter> writer = createColumnarWriter(format);
+    if (!writer) {
+        error = "unknown export format '" + format + "'";
+        return false;
+    }
+    if (!writer->open(filepath, names, count)) {
+        error = writer->getError();
+        return false;
     }
     
+    RingSpan<int64_t> times = getTimestamps(count);
+    std::vector<HistorySpan> series;
+    series.reserve(rings.size());
+    for (SeriesId id = 0; id < rings.size(); id++) series.push_back(getSeries(id, count));
+    
+    std::vector<double> row(rings.size());
+    bool ok = true;
+    for (size_t i = 0; ok && i < times.size(); i++) {
+        for (size_t s = 0; s < series.size(); s++) row[s] = series[s][i];
+        ok = writer->append(times[i], row);
+    }
+    if (!writer->close() || !ok) {
+        error = writer->getError();
+        return false;
+    }
+    return true;
+}
+
+// Store key -> series of a snapshot field; the first GPU, disks by mount
+static std::string historySeriesFor(const std::string& key) {
+    static const char* const SCALARS[][2] = {
+        {"cpu_usage_percent", "cpu_percent"},
+        {"memory_usage_percent", "ram_percent"},
+        {"swap_usage_percent", "swap_percent"},
+    };
+    for (const auto& scalar : SCALARS) {
+        if (key == scalar[0]) return scalar[1];
+    }
+    static const std::string core = "cpu_core_usage_percent{core=\"";
+    static const std::string disk = "disk_usage_percent{mount=\"";
+    if (key.compare(0, core.size(), core) == 0) {
+        return "cpu_core_" + key.substr(core.size(), key.find('"', core.size()) - core.size());
+    }
+    if (key.compare(0, disk.size(), disk) == 0) {
+        return "disk_usage:" + key.substr(disk.size(), key.find('"', disk.size()) - disk.size());
+    }
+    if (key.compare(0, 31, "gpu_utilization_percent{gpu=\"0\"") == 0) return "gpu_percent";
+    if (key.compare(0, 31, "gpu_temperature_celsius{gpu=\"0\"") == 0) return "gpu_temp";
+    return "";
+}
+
+bool MetricHistory::loadFromStore(const std::string& path, int64_t range_ms, size_t points,
+                                  std::string& error) {
+    HistoryTiers store;
+    if (!store.open(path)) {
+        error = store.getError();
+        return false;
+    }
+    points = std::max<size_t>(1, std::min(points, capacity));
+    int64_t step_ms = std::max<int64_t>(1000, range_ms / static_cast<int64_t>(points));
+    int64_t to = store.lastTime();
+    int64_t from = to - step_ms * static_cast<int64_t>(points) + 1;
+
+    std::vector<SeriesId> ids;
+    std::vector<std::vector<HistoryBucket>> buckets;
+    std::vector<int64_t> starts;
+    for (const std::string& key : store.getNames()) {
+        std::string name = historySeriesFor(key);
+        if (name.empty()) continue;
+        SeriesId id = addSeries(name);
+        if (id == NO_SERIES) continue;
+        ids.push_back(id);
+        buckets.emplace_back();
+        store.read(key, from, to, step_ms, buckets.back());
+        for (const HistoryBucket& bucket : buckets.back()) starts.push_back(bucket.start_ms);
+    }
+    std::sort(starts.begin(), starts.end());
+    starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+
+    clear();
+    std::vector<size_t> next(ids.size(), 0);
+    for (int64_t start : starts) {
+        beginSample(start);
+        for (size_t i = 0; i < ids.size(); i++) {
+            size_t& at = next[i];
+            while (at < buckets[i].size() && buckets[i][at].start_ms < start) at++;
+            if (at < buckets[i].size() && buckets[i][at].start_ms == start) set(ids[i], buckets[i][at].average());
+        }
+    }
     return true;
 }
 
@@ -195,11 +350,11 @@ bool MetricHistory::loadFromFile(const std::string& filepath) {
     std::string line;
     std::getline(file, line); // Skip header
     
-    snapshots.clear();
+    clear();
     
     while (std::getline(file, line)) {
         std::istringstream iss(line);
-        MetricSnapshot snap;
+        MetricSnapshot snap = MetricSnapshot();
         
         long epoch;
         char comma;
@@ -211,10 +366,10 @@ bool MetricHistory::loadFromFile(const std::string& filepath) {
             >> snap.gpu_percent >> comma
             >> snap.gpu_temp;
         
-        snap.timestamp = std::chrono::steady_clock::time_point(
+        snap.timestamp = std::chrono::system_clock::time_point(
             std::chrono::seconds(epoch));
         
-        snapshots.push_back(snap);
+        addSnapshot(snap);
     }
     
     return true;
@@ -0,0 +1,748 @@
+#include "history_query.h"
+#include "history_tiers.h"
+#include "json_writer.h"
+#include "self_stats.h"
+#include "system_info.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <fnmatch.h>
+
+static const int64_t DAY_MS = 86400000;
+static const size_t MAX_BUCKETS = 1000000;
+
+// --- Parsing ---------------------------------------------------------------
+
+static void skipSpaces(const std::string& text, size_t& pos) {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t')) pos++;
+}
+
+static int64_t localMs(struct tm& fields) {
+    fields.tm_isdst = -1;
+    return static_cast<int64_t>(mktime(&fields)) * 1000;
+}
+
+// now, -DURATION, HH:MM[:SS] or YYYY-MM-DD[( |T)HH:MM[:SS]]
+static bool parseTime(const std::string& text, int64_t now_ms, int64_t& ms) {
+    if (text == "now") {
+        ms = now_ms;
+        return true;
+    }
+    if (!text.empty() && text[0] == '-') {
+        int64_t ago = 0;
+        if (!parseDuration(text.substr(1), ago)) return false;
+        ms = now_ms - ago;
+        return true;
+    }
+
+    struct tm fields = {};
+    int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0, used = 0;
+    const char* str = text.c_str();
+    if (sscanf(str, "%d-%d-%d%n", &year, &month, &day, &used) == 3) {
+        const char* rest = str + used;
+        if (*rest == ' ' || *rest == 'T') {
+            int time_used = 0;
+            if (sscanf(rest + 1, "%d:%d%n", &hour, &minute, &time_used) != 2) return false;
+            rest += 1 + time_used;
+            if (*rest == ':' && sscanf(rest + 1, "%d%n", &second, &time_used) == 1) rest += 1 + time_used;
+        }
+        if (*rest != '\0') return false;
+        fields.tm_year = year - 1900;
+        fields.tm_mon = month - 1;
+        fields.tm_mday = day;
+    } else if (sscanf(str, "%d:%d%n", &hour, &minute, &used) == 2) {
+        const char* rest = str + used;
+        if (*rest == ':' && sscanf(rest + 1, "%d%n", &second, &used) == 1) rest += 1 + used;
+        if (*rest != '\0') return false;
+        time_t now = static_cast<time_t>(now_ms / 1000);
+        localtime_r(&now, &fields);
+    } else {
+        return false;
+    }
+    if (hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60) return false;
+    fields.tm_hour = hour;
+    fields.tm_min = minute;
+    fields.tm_sec = second;
+    ms = localMs(fields);
+
+    // A bare time of day is the latest one that has passed
+    if (year == 0 && ms > now_ms) {
+        fields.tm_mday -= 1;
+        ms = localMs(fields);
+    }
+    return true;
+}
+
+static bool parseAggregation(const std::string& name, HistoryQuery& query) {
+    static const struct {
+        const char* name;
+        QueryAggregation aggregation;
+    } NAMES[] = {
+        {"min", QueryAggregation::MIN}, {"max", QueryAggregation::MAX},
+        {"avg", QueryAggregation::AVG}, {"sum", QueryAggregation::SUM},
+        {"count", QueryAggregation::COUNT}, {"first", QueryAggregation::FIRST},
+        {"last", QueryAggregation::LAST},
+    };
+    query.aggregation_name = name;
+    for (const auto& known : NAMES) {
+        if (name == known.name) {
+            query.aggregation = known.aggregation;
+            return true;
+        }
+    }
+    query.aggregation = QueryAggregation::PERCENTILE;
+    if (name == "median") {
+        query.percentile = 50;
+        return true;
+    }
+    char* end = nullptr;
+    if (name.size() < 2 || name[0] != 'p') return false;
+    query.percentile = strtod(name.c_str() + 1, &end);
+    return *end == '\0' && query.percentile >= 0 && query.percentile <= 100;
+}
+
+static bool parseLabels(const std::string& text, size_t& pos, HistoryQuery& query, std::string& error) {
+    pos++;  // '{'
+    while (true) {
+        skipSpaces(text, pos);
+        if (pos < text.size() && text[pos] == '}') {
+            pos++;
+            return true;
+        }
+        QueryLabelMatcher matcher;
+        size_t start = pos;
+        while (pos < text.size() && (isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '_')) pos++;
+        matcher.name = text.substr(start, pos - start);
+        skipSpaces(text, pos);
+        matcher.negate = text.compare(pos, 2, "!=") == 0;
+        if (matcher.negate) pos++;
+        if (matcher.name.empty() || pos >= text.size() || text[pos] != '=') {
+            error = "expected label=\"value\" at column " + std::to_string(pos + 1);
+            return false;
+        }
+        pos++;
+        skipSpaces(text, pos);
+        if (pos >= text.size() || text[pos] != '"') {
+            error = "expected a quoted label value at column " + std::to_string(pos + 1);
+            return false;
+        }
+        for (pos++; pos < text.size() && text[pos] != '"'; pos++) {
+            if (text[pos] == '\\' && pos + 1 < text.size()) pos++;
+            matcher.pattern += text[pos];
+        }
+        if (pos >= text.size()) {
+            error = "unterminated label value";
+            return false;
+        }
+        pos++;
+        query.labels.push_back(matcher);
+        skipSpaces(text, pos);
+        if (pos < text.size() && text[pos] == ',') pos++;
+    }
+}
+
+static bool parseRange(const std::string& range, int64_t now_ms, HistoryQuery& query, std::string& error) {
+    size_t dots = range.find("..");
+    if (dots == std::string::npos) {
+        int64_t length = 0;
+        if (!parseDuration(range, length) || length <= 0) {
+            error = "bad range '" + range + "' (want a duration or FROM..TO)";
+            return false;
+        }
+        query.from_ms = now_ms - length;
+        query.to_ms = now_ms;
+        return true;
+    }
+    std::string from = range.substr(0, dots), to = range.substr(dots + 2);
+    size_t at = 0;
+    skipSpaces(from, at);
+    from = from.substr(at, from.find_last_not_of(" \t") + 1 - at);
+    at = 0;
+    skipSpaces(to, at);
+    to = to.substr(at, to.find_last_not_of(" \t") + 1 - at);
+    int64_t end = 0;
+    if (!parseTime(from, now_ms, query.from_ms) || !parseTime(to, now_ms, end)) {
+        error = "bad time in range '" + range + "'";
+        return false;
+    }
+    // A time of day that ends a range is the first one after its start
+    while (to.find('-') == std::string::npos && to != "now" && end <= query.from_ms) end += DAY_MS;
+    if (end <= query.from_ms) {
+        error = "range '" + range + "' ends before it starts";
+        return false;
+    }
+    query.to_ms = end - 1;
+    return true;
+}
+
+bool parseHistoryQuery(const std::string& expression, int64_t now_ms, HistoryQuery& query,
+                       std::string& error) {
+    query = HistoryQuery();
+    query.expression = expression;
+    query.aggregation = QueryAggregation::AVG;
+    query.aggregation_name = "avg";
+    query.percentile = 0;
+    query.has_range = false;
+    query.from_ms = 0;
+    query.to_ms = 0;
+    query.step_ms = 0;
+
+    const std::string& text = expression;
+    size_t pos = 0;
+    skipSpaces(text, pos);
+    size_t start = pos;
+    while (pos < text.size() && (isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '_' ||
+                                 text[pos] == '.' || text[pos] == '*' || text[pos] == '?')) {
+        pos++;
+    }
+    std::string word = text.substr(start, pos - start);
+    size_t after_word = pos;
+    skipSpaces(text, pos);
+    bool call = pos < text.size() && text[pos] == '(';
+    if (call) {
+        if (!parseAggregation(word, query)) {
+            error = "unknown aggregation '" + word + "' (min, max, avg, sum, count, first, last, median, pNN)";
+            return false;
+        }
+        pos++;
+        skipSpaces(text, pos);
+        start = pos;
+        while (pos < text.size() && (isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '_' ||
+                                     text[pos] == '*' || text[pos] == '?')) {
+            pos++;
+        }
+        query.metric = text.substr(start, pos - start);
+        skipSpaces(text, pos);
+    } else {
+        query.metric = word;
+        pos = after_word;
+    }
+    if (query.metric.empty()) {
+        error = "expected a metric name at column " + std::to_string(pos + 1);
+        return false;
+    }
+    if (pos < text.size() && text[pos] == '{' && !parseLabels(text, pos, query, error)) return false;
+    if (call) {
+        skipSpaces(text, pos);
+        if (pos >= text.size() || text[pos] != ')') {
+            error = "expected ')' at column " + std::to_string(pos + 1);
+            return false;
+        }
+        pos++;
+    }
+
+    skipSpaces(text, pos);
+    if (pos < text.size() && text[pos] == '[') {
+        size_t close = text.find(']', pos);
+        if (close == std::string::npos) {
+            error = "unterminated range";
+            return false;
+        }
+        if (!parseRange(text.substr(pos + 1, close - pos - 1), now_ms, query, error)) return false;
+        query.has_range = true;
+        pos = close + 1;
+    }
+
+    skipSpaces(text, pos);
+    if (text.compare(pos, 4, "step") == 0) {
+        pos += 4;
+        skipSpaces(text, pos);
+        start = pos;
+        while (pos < text.size() && text[pos] != ' ' && text[pos] != '\t') pos++;
+        if (!parseDuration(text.substr(start, pos - start), query.step_ms) || query.step_ms < 1000) {
+            error = "bad step '" + text.substr(start, pos - start) + "' (e.g. 5m, 1d; at least 1s)";
+            return false;
+        }
+        skipSpaces(text, pos);
+    }
+    if (pos < text.size()) {
+        error = "unexpected '" + text.substr(pos) + "' at column " + std::to_string(pos + 1);
+        return false;
+    }
+    return true;
+}
+
+// --- Matching ----------------------------------------------------------------
+
+// name{label="value",...} as seriesKey() builds it
+static bool splitKey(const std::string& key, std::string& family,
+                     std::vector<std::pair<std::string, std::string>>& labels) {
+    labels.clear();
+    size_t brace = key.find('{');
+    family = key.substr(0, brace);
+    if (brace == std::string::npos) return true;
+    size_t pos = brace + 1;
+    while (pos < key.size() && key[pos] != '}') {
+        size_t equals = key.find("=\"", pos);
+        if (equals == std::string::npos) return false;
+        std::pair<std::string, std::string> label(key.substr(pos, equals - pos), "");
+        for (pos = equals + 2; pos < key.size() && key[pos] != '"'; pos++) {
+            if (key[pos] == '\\' && pos + 1 < key.size()) {
+                pos++;
+                label.second += key[pos] == 'n' ? '\n' : key[pos];
+            } else {
+                label.second += key[pos];
+            }
+        }
+        labels.push_back(std::move(label));
+        pos++;
+        if (pos < key.size() && key[pos] == ',') pos++;
+    }
+    return true;
+}
+
+static bool matches(const HistoryQuery& query, const std::string& key) {
+    std::string family;
+    std::vector<std::pair<std::string, std::string>> labels;
+    if (!splitKey(key, family, labels) || fnmatch(query.metric.c_str(), family.c_str(), 0) != 0) {
+        return false;
+    }
+    for (const QueryLabelMatcher& matcher : query.labels) {
+        const std::string* value = nullptr;
+        for (const auto& label : labels) {
+            if (label.first == matcher.name) value = &label.second;
+        }
+        bool match = fnmatch(matcher.pattern.c_str(), value ? value->c_str() : "", 0) == 0;
+        if (match == matcher.negate) return false;
+    }
+    return true;
+}
+
+// --- Execution ---------------------------------------------------------------
+
+namespace {
+
+// What one bucket has seen so far; merging two is order-independent
+// except for first/last, which keep their timestamps
+struct Partial {
+    double min;
+    double max;
+    double sum;
+    uint64_t count;
+    int64_t first_ms;
+    double first;
+    int64_t last_ms;
+    double last;
+
+    Partial()
+        : min(INFINITY), max(-INFINITY), sum(0), count(0),
+          first_ms(INT64_MAX), first(NAN), last_ms(INT64_MIN), last(NAN) {}
+
+    void add(int64_t timestamp_ms, double value) {
+        min = std::min(min, value);
+        max = std::max(max, value);
+        sum += value;
+        count++;
+        if (timestamp_ms < first_ms) {
+            first_ms = timestamp_ms;
+            first = value;
+        }
+        if (timestamp_ms >= last_ms) {
+            last_ms = timestamp_ms;
+            last = value;
+        }
+    }
+
+    void merge(const Partial& other) {
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        sum += other.sum;
+        count += other.count;
+        if (other.first_ms < first_ms) {
+            first_ms = other.first_ms;
+            first = other.first;
+        }
+        if (other.last_ms >= last_ms) {
+            last_ms = other.last_ms;
+            last = other.last;
+        }
+    }
+};
+
+// One block to decode: a raw series, or one field of a rollup tier
+struct Task {
+    size_t series;
+    int field;                  // -1 raw, else 0..3: min, max, sum, count
+    uint32_t id;
+    const HistoryStoreReader::Block* block;
+};
+
+// A task's contribution, for buckets first_bucket onwards
+struct TaskResult {
+    size_t first_bucket;
+    std::vector<Partial> partials;
+    std::vector<std::pair<uint32_t, double>> values;    // Percentiles: (bucket offset, value)
+    uint64_t samples;
+    bool intact;
+};
+
+}  // namespace
+
+static bool mergeable(QueryAggregation aggregation) {
+    return aggregation != QueryAggregation::FIRST && aggregation != QueryAggregation::LAST &&
+           aggregation != QueryAggregation::PERCENTILE;
+}
+
+// Linear interpolation between the closest ranks, as numpy's default
+static double percentileOf(std::vector<double>& values, double percentile) {
+    if (values.empty()) return NAN;
+    double rank = percentile / 100.0 * (values.size() - 1);
+    size_t below = static_cast<size_t>(rank);
+    std::nth_element(values.begin(), values.begin() + below, values.end());
+    double low = values[below];
+    if (below + 1 >= values.size()) return low;
+    double high = *std::min_element(values.begin() + below + 1, values.end());
+    return low + (high - low) * (rank - below);
+}
+
+bool runHistoryQuery(const HistoryTiers& store, const HistoryQuery& query, unsigned threads,
+                     QueryResult& result, std::string& error) {
+    SELF_STATS_SCOPE(StageKind::EXPORTER, "history_query");
+    auto started = std::chrono::steady_clock::now();
+    result = QueryResult();
+    result.blocks_total = 0;
+    result.blocks_scanned = 0;
+    result.samples = 0;
+    result.intact = true;
+
+    int64_t from = query.has_range ? query.from_ms : store.firstTime();
+    int64_t to = query.has_range ? query.to_ms : store.lastTime();
+    result.from_ms = from;
+    result.to_ms = to;
+
+    // Buckets start on local-time multiples of the step, so a day is a
+    // calendar day; without a step the range is one bucket
+    int64_t step = query.step_ms;
+    int64_t origin = from;
+    if (step > 0) {
+        time_t at = static_cast<time_t>(from / 1000);
+        struct tm local;
+        localtime_r(&at, &local);
+        int64_t offset = static_cast<int64_t>(local.tm_gmtoff) * 1000;
+        origin = from - (((from + offset) % step) + step) % step;
+    } else {
+        step = to - from + 1;
+    }
+    size_t buckets = to >= origin ? static_cast<size_t>((to - origin) / step + 1) : 0;
+    if (buckets > MAX_BUCKETS) {
+        error = "step too small for the range (" + std::to_string(buckets) + " buckets per series)";
+        return false;
+    }
+
+    // The coarsest tier whose buckets tile the query's and that reaches
+    // back far enough; only mergeable aggregations can use rollups
+    const std::vector<HistoryTier>& tiers = store.getTiers();
+    size_t tier = SIZE_MAX;
+    for (size_t i = 0; i < tiers.size(); i++) {
+        const HistoryTier& candidate = tiers[i];
+        if (!store.getReader(i)) continue;
+        if (candidate.retention_ms > 0 && from < store.lastTime() - candidate.retention_ms) continue;
+        if (candidate.step_ms > 0) {
+            bool tiles = origin % candidate.step_ms == 0 && step % candidate.step_ms == 0 &&
+                         ((to + 1) % candidate.step_ms == 0 || to >= store.lastTime());
+            if (!mergeable(query.aggregation) || !tiles) continue;
+        }
+        tier = i;
+    }
+    // Failing that, the finest rollup tier that reaches back, its edge
+    // buckets counted whole
+    result.edges_rounded = false;
+    for (size_t i = 1; tier == SIZE_MAX && mergeable(query.aggregation) && i < tiers.size(); i++) {
+        if (store.getReader(i) &&
+            (tiers[i].retention_ms == 0 || from >= store.lastTime() - tiers[i].retention_ms)) {
+            tier = i;
+            result.edges_rounded = true;
+        }
+    }
+    if (tier == SIZE_MAX) {
+        if (!mergeable(query.aggregation) || tiers[0].step_ms != 0) {
+            error = query.aggregation_name + " needs raw samples, and they are kept for " +
+                    formatDuration(tiers[0].retention_ms) + " only";
+        } else {
+            error = "no tier reaches back to the range's start with buckets that fit the step";
+        }
+        return false;
+    }
+    const HistoryStoreReader& reader = *store.getReader(tier);
+    int64_t read_from = tiers[tier].step_ms > 0
+        ? from - ((from % tiers[tier].step_ms) + tiers[tier].step_ms) % tiers[tier].step_ms : from;
+    result.tier = tiers[tier].step_ms == 0 ? "raw" : formatDuration(tiers[tier].step_ms);
+
+    // Every overlapping block of every matching series is one task
+    std::vector<Task> tasks;
+    for (const std::string& name : store.getNames()) {
+        if (!matches(query, name)) continue;
+        size_t series = result.series.size();
+        result.series.push_back(QuerySeries());
+        result.series.back().name = name;
+        for (int field = tiers[tier].step_ms == 0 ? -1 : 0; field < 4; field++) {
+            uint32_t id = reader.findSeries(field < 0 ? name : historyRollupSeries(name, field));
+            if (id == HistoryStore::NO_SERIES) continue;
+            for (const HistoryStoreReader::Block& block : reader.getBlocks(id)) {
+                result.blocks_total++;
+                if (block.last_ms < read_from || block.first_ms > to) continue;
+                tasks.push_back(Task{series, field, id, &block});
+            }
+            if (field < 0) break;
+        }
+    }
+    result.blocks_scanned = tasks.size();
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(tasks.size(), 1)));
+    result.threads = threads;
+
+    std::vector<TaskResult> outputs(tasks.size());
+    std::atomic<size_t> next(0);
+    bool keep_values = query.aggregation == QueryAggregation::PERCENTILE;
+    auto work = [&]() {
+        std::vector<int64_t> timestamps;
+        std::vector<double> values;
+        for (size_t i = next++; i < tasks.size(); i = next++) {
+            const Task& task = tasks[i];
+            TaskResult& out = outputs[i];
+            timestamps.clear();
+            values.clear();
+            out.intact = reader.readBlock(task.id, *task.block, read_from, to, timestamps, values);
+            out.samples = timestamps.size();
+            if (timestamps.empty()) continue;
+            // A rounded edge bucket starts before the range
+            for (int64_t& timestamp : timestamps) timestamp = std::max(timestamp, origin);
+            out.first_bucket = static_cast<size_t>((timestamps.front() - origin) / step);
+            size_t last_bucket = static_cast<size_t>((timestamps.back() - origin) / step);
+            if (last_bucket < out.first_bucket) out.first_bucket = 0;    // Clock stepped back mid-block
+            out.partials.resize(std::max(out.first_bucket, last_bucket) - out.first_bucket + 1);
+            if (keep_values) out.values.reserve(timestamps.size());
+            for (size_t s = 0; s < timestamps.size(); s++) {
+                double value = values[s];
+                if (std::isnan(value)) continue;
+                size_t bucket = static_cast<size_t>((timestamps[s] - origin) / step);
+                if (bucket < out.first_bucket) continue;
+                size_t offset = bucket - out.first_bucket;
+                if (offset >= out.partials.size()) out.partials.resize(offset + 1);
+                Partial& partial = out.partials[offset];
+                switch (task.field) {
+                case -1:
+                    partial.add(timestamps[s], value);
+                    if (keep_values) out.values.emplace_back(static_cast<uint32_t>(offset), value);
+                    break;
+                case 0: partial.min = std::min(partial.min, value); break;
+                case 1: partial.max = std::max(partial.max, value); break;
+                case 2: partial.sum += value; break;
+                case 3: partial.count += static_cast<uint64_t>(value); break;
+                }
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++) pool.emplace_back(work);
+    work();
+    for (auto& thread : pool) thread.join();
+
+    // Merge per series in task order, then reduce each bucket
+    std::vector<Partial> merged;
+    std::vector<std::vector<double>> samples;
+    size_t task = 0;
+    for (size_t series = 0; series < result.series.size(); series++) {
+        merged.assign(buckets, Partial());
+        if (keep_values) samples.assign(buckets, std::vector<double>());
+        for (; task < tasks.size() && tasks[task].series == series; task++) {
+            const TaskResult& out = outputs[task];
+            result.samples += out.samples;
+            result.intact = result.intact && out.intact;
+            for (size_t i = 0; i < out.partials.size() && out.first_bucket + i < buckets; i++) {
+                merged[out.first_bucket + i].merge(out.partials[i]);
+            }
+            for (const auto& value : out.values) {
+                if (out.first_bucket + value.first < buckets) samples[out.first_bucket + value.first].push_back(value.second);
+            }
+        }
+
+        QuerySeries& out = result.series[series];
+        for (size_t bucket = 0; bucket < buckets; bucket++) {
+            const Partial& partial = merged[bucket];
+            if (partial.count == 0) continue;
+            double value = NAN;
+            switch (query.aggregation) {
+            case QueryAggregation::MIN: value = partial.min; break;
+            case QueryAggregation::MAX: value = partial.max; break;
+            case QueryAggregation::AVG: value = partial.sum / partial.count; break;
+            case QueryAggregation::SUM: value = partial.sum; break;
+            case QueryAggregation::COUNT: value = static_cast<double>(partial.count); break;
+            case QueryAggregation::FIRST: value = partial.first; break;
+            case QueryAggregation::LAST: value = partial.last; break;
+            case QueryAggregation::PERCENTILE: value = percentileOf(samples[bucket], query.percentile); break;
+            }
+            out.timestamps.push_back(query.step_ms > 0 ? origin + static_cast<int64_t>(bucket) * step : from);
+            out.values.push_back(value);
+        }
+    }
+
+    result.elapsed_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - started).count();
+    return true;
+}
+
+// --- Output ------------------------------------------------------------------
+
+// Up to 6 decimals, without trailing zeros
+static std::string formatValue(double value) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), std::fabs(value) < 1e15 ? "%.6f" : "%.6g", value);
+    std::string text = buf;
+    if (text.find('.') != std::string::npos && text.find('e') == std::string::npos) {
+        text.erase(text.find_last_not_of('0') + 1);
+        if (text.back() == '.') text.pop_back();
+    }
+    return text;
+}
+
+// Unix seconds, with milliseconds only when there are any
+static std::string formatSeconds(int64_t ms) {
+    char buf[32];
+    if (ms % 1000 == 0) {
+        snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(ms / 1000));
+    } else {
+        snprintf(buf, sizeof(buf), "%.3f", ms / 1000.0);
+    }
+    return buf;
+}
+
+static void appendCsvField(std::string& out, const std::string& field) {
+    if (field.find_first_of(",\"\n") == std::string::npos) {
+        out += field;
+        return;
+    }
+    out += '"';
+    for (char c : field) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+std::string formatQueryResult(const HistoryQuery& query, const QueryResult& result,
+                              const std::string& format) {
+    std::string out;
+    if (format == "json") {
+        JsonWriter json(out, true);
+        json.beginObject();
+        json.member("query", query.expression);
+        json.member("aggregation", query.aggregation_name);
+        json.memberInteger("from", result.from_ms / 1000);
+        json.memberInteger("to", (result.to_ms + 1) / 1000);
+        json.memberInteger("step", query.step_ms / 1000);
+        json.member("tier", result.tier);
+        json.member("edges_rounded", result.edges_rounded);
+        json.memberInteger("blocks_scanned", static_cast<long long>(result.blocks_scanned));
+        json.memberInteger("samples", static_cast<long long>(result.samples));
+        json.memberNumber("elapsed_ms", result.elapsed_ms, 3);
+        json.key("series");
+        json.beginArray();
+        for (const QuerySeries& series : result.series) {
+            json.beginObject();
+            json.member("name", series.name);
+            json.key("values");
+            json.beginArray();
+            for (size_t i = 0; i < series.values.size(); i++) {
+                json.beginArray(true);
+                if (series.timestamps[i] % 1000 == 0) {
+                    json.integer(series.timestamps[i] / 1000);
+                } else {
+                    json.number(series.timestamps[i] / 1000.0, 3);
+                }
+                json.number(series.values[i]);
+                json.endArray();
+            }
+            json.endArray();
+            json.endObject();
+        }
+        json.endArray();
+        json.endObject();
+        out += '\n';
+        return out;
+    }
+
+    if (format == "csv") {
+        out += "timestamp,series,value\n";
+        for (const QuerySeries& series : result.series) {
+            for (size_t i = 0; i < series.values.size(); i++) {
+                out += formatSeconds(series.timestamps[i]);
+                out += ',';
+                appendCsvField(out, series.name);
+                out += ',';
+                out += formatValue(series.values[i]);
+                out += '\n';
+            }
+        }
+        return out;
+    }
+
+    // Text: one line per series, or a block of buckets per series
+    size_t width = 0;
+    for (const QuerySeries& series : result.series) width = std::max(width, series.name.size());
+    for (const QuerySeries& series : result.series) {
+        if (query.step_ms == 0) {
+            out += series.name;
+            out.append(width - series.name.size() + 2, ' ');
+            out += series.values.empty() ? std::string("-") : formatValue(series.values[0]);
+            out += '\n';
+            continue;
+        }
+        out += series.name + "\n";
+        for (size_t i = 0; i < series.values.size(); i++) {
+            out += "  " + getTimestamp(static_cast<time_t>(series.timestamps[i] / 1000)) + "  " +
+                   formatValue(series.values[i]) + "\n";
+        }
+    }
+    char summary[256];
+    snprintf(summary, sizeof(summary),
+             "%s .. %s, %zu series from %s%s%s: %zu of %zu blocks, %llu samples, %u thread(s), %.1f ms\n",
+             getTimestamp(static_cast<time_t>(result.from_ms / 1000)).c_str(),
+             getTimestamp(static_cast<time_t>((result.to_ms + 1) / 1000)).c_str(),
+             result.series.size(), result.tier.c_str(), result.tier == "raw" ? " samples" : " rollups",
+             result.edges_rounded ? " (edge buckets whole)" : "",
+             result.blocks_scanned, result.blocks_total, static_cast<unsigned long long>(result.samples),
+             result.threads, result.elapsed_ms);
+    out += "(";
+    out += std::string(summary, strlen(summary) - 1);
+    out += ")\n";
+    return out;
+}
+
+int queryHistoryStore(const std::string& store_path, const std::string& expression,
+                      const std::string& format, unsigned threads) {
+    HistoryTiers store;
+    if (!store.open(store_path)) {
+        std::cerr << "Error: " << store.getError() << std::endl;
+        return 1;
+    }
+    HistoryQuery query;
+    std::string error;
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (!parseHistoryQuery(expression, now_ms, query, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    QueryResult result;
+    if (!runHistoryQuery(store, query, threads, result, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    if (result.series.empty()) {
+        std::cerr << "Error: no stored series matches '" << query.metric << "'" << std::endl;
+        return 1;
+    }
+    std::cout << formatQueryResult(query, result, format);
+    if (!result.intact) {
+        std::cerr << "Warning: " << store_path << ": skipped blocks that failed their checksum" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,916 @@
+#include "history_store.h"
+#include "delta_export.h"
+#include "metric_registry.h"
+#include "self_stats.h"
+#include "system_info.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+static const char FILE_MAGIC[8] = {'S', 'Y', 'S', 'R', 'T', 'S', 'D', 'B'};
+static const uint32_t STORE_VERSION = 1;
+static const uint32_t BLOCK_MAGIC = 0x4b4c4253;         // "SBLK"
+static const uint8_t KIND_NAMES = 1;
+static const uint8_t KIND_DATA = 2;
+static const size_t HEADER_BYTES = 40;
+static const size_t PAYLOAD_BYTES = HistoryStore::BLOCK_SIZE - HEADER_BYTES;
+static const size_t PAYLOAD_BITS = PAYLOAD_BYTES * 8;
+// Worst case: 4 + 64 timestamp bits, 2 + 5 + 6 + 64 value bits
+static const size_t MAX_SAMPLE_BITS = 145;
+static const uint8_t NO_WINDOW = 0xff;
+static const size_t MAX_TIERS = 8;
+static const char* const ROLLUP_FIELDS[4] = {"@min", "@max", "@sum", "@count"};
+
+static void putU32(uint8_t* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+static void putU64(uint8_t* p, uint64_t value) {
+    for (int i = 0; i < 8; i++) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) value = value << 8 | p[i];
+    return value;
+}
+
+static uint64_t getU64(const uint8_t* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = value << 8 | p[i];
+    return value;
+}
+
+// Over the header up to the checksum field, then the used payload
+static uint32_t blockCrc(const uint8_t* block, size_t payload_bytes) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, block, 36);
+    crc = crc32(crc, block + HEADER_BYTES, static_cast<uInt>(payload_bytes));
+    return static_cast<uint32_t>(crc);
+}
+
+// A block whose header and payload are as written: not torn
+static bool dataBlockIntact(const uint8_t* header) {
+    uint32_t payload_bits = getU32(header + 32);
+    return payload_bits <= PAYLOAD_BITS && blockCrc(header, (payload_bits + 7) / 8) == getU32(header + 36);
+}
+
+// MSB-first bit stream into a zeroed payload
+static void putBits(uint8_t* payload, size_t& pos, uint64_t value, int count) {
+    while (count > 0) {
+        int room = 8 - static_cast<int>(pos & 7);
+        int take = count < room ? count : room;
+        uint8_t chunk = static_cast<uint8_t>((value >> (count - take)) & ((1u << take) - 1));
+        payload[pos >> 3] |= static_cast<uint8_t>(chunk << (room - take));
+        pos += take;
+        count -= take;
+    }
+}
+
+// Reads up to 64 bits at once from a big-endian word at the current byte;
+// within the last 9 bytes of the payload area it goes byte by byte
+class BitReader {
+private:
+    const uint8_t* payload;
+    size_t pos;
+    size_t end;
+
+public:
+    BitReader(const uint8_t* data, size_t bits) : payload(data), pos(0), end(bits) {}
+
+    bool has(int count) const { return pos + count <= end; }
+
+    uint64_t bits(int count) {
+        size_t byte = pos >> 3;
+        int shift = static_cast<int>(pos & 7);
+        if (byte + 9 <= PAYLOAD_BYTES) {
+            uint64_t word;
+            memcpy(&word, payload + byte, sizeof(word));
+            word = __builtin_bswap64(word) << shift;
+            if (shift + count > 64) word |= payload[byte + 8] >> (8 - shift);
+            pos += count;
+            return count == 64 ? word : word >> (64 - count);
+        }
+        uint64_t value = 0;
+        while (count > 0) {
+            int room = 8 - static_cast<int>(pos & 7);
+            int take = count < room ? count : room;
+            value = value << take | ((payload[pos >> 3] >> (room - take)) & ((1u << take) - 1));
+            pos += take;
+            count -= take;
+        }
+        return value;
+    }
+};
+
+static std::string trimmed(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) return "";
+    return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+}
+
+static const struct {
+    const char* suffix;
+    int64_t ms;
+} DURATION_UNITS[] = {
+    {"y", 365LL * 86400000}, {"w", 7LL * 86400000}, {"d", 86400000},
+    {"h", 3600000}, {"m", 60000}, {"s", 1000}, {"ms", 1},
+};
+
+bool parseDuration(const std::string& text, int64_t& ms) {
+    std::string value = trimmed(text);
+    char* end = nullptr;
+    double number = strtod(value.c_str(), &end);
+    if (value.empty() || end == value.c_str() || !(number >= 0)) return false;
+    std::string unit = end;
+    int64_t scale = unit.empty() ? 1000 : 0;
+    for (const auto& known : DURATION_UNITS) {
+        if (unit == known.suffix) scale = known.ms;
+    }
+    if (scale == 0 || number * scale > 1e17) return false;
+    ms = static_cast<int64_t>(std::llround(number * scale));
+    return true;
+}
+
+std::string formatDuration(int64_t ms) {
+    if (ms == 0) return "0s";
+    for (const auto& known : DURATION_UNITS) {
+        if (ms % known.ms == 0) return std::to_string(ms / known.ms) + known.suffix;
+    }
+    return std::to_string(ms) + "ms";
+}
+
+bool parseHistoryTiers(const std::string& spec, std::vector<HistoryTier>& tiers, std::string& error) {
+    tiers.clear();
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos) comma = spec.size();
+        std::string entry = trimmed(spec.substr(pos, comma - pos));
+        pos = comma + 1;
+        if (entry.empty()) continue;
+
+        size_t colon = entry.find(':');
+        HistoryTier tier = {0, 0};
+        if (!parseDuration(entry.substr(0, colon), tier.step_ms) || tier.step_ms < 1000 ||
+            (colon != std::string::npos && !parseDuration(entry.substr(colon + 1), tier.retention_ms))) {
+            error = "bad rollup tier '" + entry + "' (want step:retention, e.g. 1m:7d)";
+            return false;
+        }
+        if (!tiers.empty() && tier.step_ms <= tiers.back().step_ms) {
+            error = "rollup tiers must be in ascending steps";
+            return false;
+        }
+        tiers.push_back(tier);
+    }
+    if (tiers.size() >= MAX_TIERS) {
+        error = "at most " + std::to_string(MAX_TIERS - 1) + " rollup tiers";
+        return false;
+    }
+    return true;
+}
+
+std::string historyTierPath(const std::string& base, const HistoryTier& tier) {
+    return tier.step_ms == 0 ? base : base + "." + formatDuration(tier.step_ms);
+}
+
+std::string historyRollupSeries(const std::string& key, int field) {
+    return key + ROLLUP_FIELDS[field];
+}
+
+HistoryStore::HistoryStore()
+    : fd(-1), next_slot(0), next_tag(0), retention_ms(0), newest_ms(INT64_MIN), precision(2),
+      flush_interval_ms(10000), last_flush_ms(0) {
+}
+
+HistoryStore::~HistoryStore() {
+    close();
+}
+
+bool HistoryStore::open(const std::string& file, const HistoryStoreOptions& options) {
+    close();
+    precision = options.precision;
+    flush_interval_ms = static_cast<int64_t>(options.flush_interval_seconds > 0
+                                             ? options.flush_interval_seconds : 1) * 1000;
+    last_flush_ms = 0;
+    retention_ms = options.retention_ms;
+    rollups.clear();
+
+    std::vector<HistoryTier> tiers(1, HistoryTier{0, options.retention_ms});
+    tiers.insert(tiers.end(), options.rollups.begin(), options.rollups.end());
+    if (!openFile(file, tiers)) return false;
+
+    for (const HistoryTier& tier : options.rollups) {
+        Rollup rollup;
+        rollup.tier = tier;
+        rollup.store.reset(new HistoryStore());
+        rollup.store->precision = precision;
+        rollup.store->retention_ms = tier.retention_ms;
+        if (!rollup.store->openFile(historyTierPath(file, tier), std::vector<HistoryTier>(1, tier))) {
+            error = rollup.store->getError();
+            rollups.clear();
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        rollups.push_back(std::move(rollup));
+    }
+    return true;
+}
+
+bool HistoryStore::openFile(const std::string& file, const std::vector<HistoryTier>& tiers) {
+    series_table.clear();
+    by_name.clear();
+    unnamed.clear();
+    by_registry_id.clear();
+    free_slots.clear();
+    unsynced_free.clear();
+    expiring.clear();
+    newest_ms = INT64_MIN;
+
+    fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = "cannot open " + file + ": " + strerror(errno);
+        return false;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        error = file + " is in use by another process";
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    // The header is rewritten on every open: the tiers follow the config
+    struct stat st;
+    fstat(fd, &st);
+    bool fresh = st.st_size == 0;
+    HistoryStoreReader existing;
+    if (!fresh && !existing.open(file)) {
+        error = existing.getError();
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    std::vector<uint8_t> header(BLOCK_SIZE, 0);
+    memcpy(header.data(), FILE_MAGIC, 8);
+    putU32(&header[8], STORE_VERSION);
+    putU32(&header[12], static_cast<uint32_t>(BLOCK_SIZE));
+    putU32(&header[16], static_cast<uint32_t>(tiers.size()));
+    for (size_t i = 0; i < tiers.size() && i < MAX_TIERS; i++) {
+        putU64(&header[20 + 16 * i], static_cast<uint64_t>(tiers[i].step_ms));
+        putU64(&header[28 + 16 * i], static_cast<uint64_t>(tiers[i].retention_ms));
+    }
+    if (!writeAt(0, header.data(), header.size())) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    if (fresh) {
+        next_slot = 1;
+        return true;
+    }
+
+    // Continue an existing store: same series ids, new blocks after the
+    // last one (a torn trailing block is overwritten). Every data block
+    // already there is complete as far as this run goes and expires in
+    // order of its last sample; the older copies of blocks left open are
+    // free.
+    for (const auto& known : existing.getSeries()) {
+        addSeries(known.name, known.decimals);
+    }
+    for (uint32_t id = 0; id < existing.getSeries().size(); id++) {
+        for (const auto& block : existing.getBlocks(id)) {
+            expiring.emplace_back(block.last_ms, block.offset);
+            if (block.twin != 0) free_slots.push_back(block.twin);
+        }
+    }
+    std::sort(expiring.begin(), expiring.end());
+    if (existing.sampleCount() > 0) newest_ms = existing.lastTime();
+    next_slot = static_cast<uint64_t>(st.st_size) / BLOCK_SIZE;
+    releaseExpired();
+    return true;
+}
+
+HistoryStore::SeriesId HistoryStore::series(const std::string& name, int decimals) {
+    auto found = by_name.find(name);
+    if (found != by_name.end()) return found->second;
+
+    SeriesId id = addSeries(name, decimals);
+    unnamed.push_back(id);
+    return id;
+}
+
+HistoryStore::SeriesId HistoryStore::addSeries(const std::string& name, int decimals) {
+    SeriesId id = static_cast<SeriesId>(series_table.size());
+    series_table.push_back(Series());
+    Series& series = series_table.back();
+    series.name = name;
+    series.decimals = decimals;
+    series.scale = std::pow(10.0, decimals);
+    series.block.data.assign(BLOCK_SIZE, 0);
+    series.block.bits = 0;
+    series.block.count = 0;
+    series.block.current = -1;
+    series.block.dirty = false;
+    if (!name.empty()) by_name.emplace(name, id);
+    return id;
+}
+
+void HistoryStore::append(SeriesId id, int64_t timestamp_ms, double value) {
+    if (fd < 0 || id >= series_table.size()) return;
+    Series& series = series_table[id];
+    OpenBlock& block = series.block;
+
+    double stored = series.decimals >= 0 ? std::round(value * series.scale) : value;
+    uint64_t bits;
+    memcpy(&bits, &stored, sizeof(bits));
+
+    // A full block is sealed; so is one the clock stepped back on, which
+    // keeps every block's timestamps ascending
+    if (block.count > 0 && (block.bits + MAX_SAMPLE_BITS > PAYLOAD_BITS || timestamp_ms < block.last_ms)) {
+        writeBlock(id, true);
+        expiring.emplace_back(block.last_ms, block.slots[block.current]);
+        unsynced_free.push_back(block.slots[1 - block.current]);
+        std::fill(block.data.begin(), block.data.end(), 0);
+        block.bits = 0;
+        block.count = 0;
+        block.dirty = false;
+    }
+
+    uint8_t* payload = block.data.data() + HEADER_BYTES;
+    if (block.count == 0) {
+        block.slots[0] = reserveSlot();
+        block.slots[1] = reserveSlot();
+        block.current = -1;
+        block.tag = next_tag++;
+        putBits(payload, block.bits, static_cast<uint64_t>(timestamp_ms), 64);
+        putBits(payload, block.bits, bits, 64);
+        block.first_ms = timestamp_ms;
+        block.last_delta = 0;
+        block.leading = NO_WINDOW;
+        block.trailing = 0;
+    } else {
+        // Timestamps: the change in interval, nearly always 0 (one bit)
+        int64_t delta = timestamp_ms - block.last_ms;
+        int64_t dod = delta - block.last_delta;
+        if (dod == 0) {
+            putBits(payload, block.bits, 0, 1);
+        } else if (dod >= -63 && dod <= 64) {
+            putBits(payload, block.bits, 0x2, 2);
+            putBits(payload, block.bits, static_cast<uint64_t>(dod + 63), 7);
+        } else if (dod >= -255 && dod <= 256) {
+            putBits(payload, block.bits, 0x6, 3);
+            putBits(payload, block.bits, static_cast<uint64_t>(dod + 255), 9);
+        } else if (dod >= -2047 && dod <= 2048) {
+            putBits(payload, block.bits, 0xe, 4);
+            putBits(payload, block.bits, static_cast<uint64_t>(dod + 2047), 12);
+        } else {
+            putBits(payload, block.bits, 0xf, 4);
+            putBits(payload, block.bits, static_cast<uint64_t>(dod), 64);
+        }
+        block.last_delta = delta;
+
+        // Values: XOR with the previous one, stored as its meaningful bits,
+        // reusing the previous leading/trailing-zero window when it fits
+        uint64_t diff = bits ^ block.last_value;
+        if (diff == 0) {
+            putBits(payload, block.bits, 0, 1);
+        } else {
+            int leading = std::min(__builtin_clzll(diff), 31);
+            int trailing = __builtin_ctzll(diff);
+            if (block.leading != NO_WINDOW && leading >= block.leading && trailing >= block.trailing) {
+                putBits(payload, block.bits, 0x2, 2);
+                putBits(payload, block.bits, diff >> block.trailing, 64 - block.leading - block.trailing);
+            } else {
+                int meaningful = 64 - leading - trailing;
+                putBits(payload, block.bits, 0x3, 2);
+                putBits(payload, block.bits, static_cast<uint64_t>(leading), 5);
+                putBits(payload, block.bits, static_cast<uint64_t>(meaningful & 63), 6);
+                putBits(payload, block.bits, diff >> trailing, meaningful);
+                block.leading = static_cast<uint8_t>(leading);
+                block.trailing = static_cast<uint8_t>(trailing);
+            }
+        }
+    }
+    block.last_value = bits;
+    block.last_ms = timestamp_ms;
+    block.count++;
+    block.dirty = true;
+    if (timestamp_ms > newest_ms) newest_ms = timestamp_ms;
+
+    if (!std::isnan(value)) {
+        for (Rollup& rollup : rollups) rollUp(rollup, id, timestamp_ms, value);
+    }
+}
+
+void HistoryStore::rollUp(Rollup& rollup, SeriesId id, int64_t timestamp_ms, double value) {
+    if (id >= rollup.buckets.size()) {
+        rollup.buckets.resize(series_table.size(), Bucket{0, 0, 0, 0, 0});
+        rollup.ids.resize(series_table.size(), {{NO_SERIES, NO_SERIES, NO_SERIES, NO_SERIES}});
+    }
+    int64_t step = rollup.tier.step_ms;
+    int64_t start = timestamp_ms - ((timestamp_ms % step) + step) % step;
+    Bucket& bucket = rollup.buckets[id];
+    if (bucket.count > 0 && bucket.start_ms != start) emitBucket(rollup, id);
+    if (bucket.count == 0) {
+        bucket.start_ms = start;
+        bucket.min = value;
+        bucket.max = value;
+        bucket.sum = 0;
+    }
+    bucket.min = std::min(bucket.min, value);
+    bucket.max = std::max(bucket.max, value);
+    bucket.sum += value;
+    bucket.count++;
+}
+
+void HistoryStore::emitBucket(Rollup& rollup, SeriesId id) {
+    Bucket& bucket = rollup.buckets[id];
+    std::array<SeriesId, 4>& ids = rollup.ids[id];
+    if (ids[0] == NO_SERIES) {
+        const Series& source = series_table[id];
+        for (int field = 0; field < 4; field++) {
+            ids[field] = rollup.store->series(historyRollupSeries(source.name, field),
+                                                 field == 3 ? 0 : source.decimals);
+        }
+    }
+    rollup.store->append(ids[0], bucket.start_ms, bucket.min);
+    rollup.store->append(ids[1], bucket.start_ms, bucket.max);
+    rollup.store->append(ids[2], bucket.start_ms, bucket.sum);
+    rollup.store->append(ids[3], bucket.start_ms, bucket.count);
+    bucket.count = 0;
+}
+
+void HistoryStore::record(const MetricRegistry& metrics, int64_t timestamp_ms) {
+    if (fd < 0) return;
+    SELF_STATS_SCOPE(StageKind::EXPORTER, "history_store");
+    const std::vector<MetricFamily>& families = metrics.getFamilies();
+    for (const MetricFamily& family : families) {
+        // Top-process series come and go with every pid
+        if (family.group == "process") continue;
+        for (uint32_t handle : family.series) {
+            if (!metrics.isLive(handle)) continue;
+            const MetricSeries& sample = metrics.getSeries(handle);
+            auto cached = by_registry_id.find(sample.id);
+            SeriesId id;
+            if (cached != by_registry_id.end()) {
+                id = cached->second;
+            } else {
+                id = series(seriesKey(metrics, handle), family.integral ? 0 : precision);
+                by_registry_id.emplace(sample.id, id);
+            }
+            append(id, timestamp_ms, sample.value);
+        }
+    }
+
+    if (last_flush_ms == 0) last_flush_ms = timestamp_ms;
+    if (timestamp_ms - last_flush_ms >= flush_interval_ms) {
+        flush();
+        last_flush_ms = timestamp_ms;
+    }
+}
+
+uint64_t HistoryStore::reserveSlot() {
+    if (!free_slots.empty()) {
+        uint64_t offset = free_slots.back();
+        free_slots.pop_back();
+        return offset;
+    }
+    return next_slot++ * BLOCK_SIZE;
+}
+
+// Blocks are queued roughly in time order as they fill, so the scan stops
+// at the first one still inside retention
+void HistoryStore::releaseExpired() {
+    if (retention_ms <= 0 || newest_ms == INT64_MIN) return;
+    while (!expiring.empty() && expiring.front().first < newest_ms - retention_ms) {
+        free_slots.push_back(expiring.front().second);
+        expiring.pop_front();
+    }
+}
+
+bool HistoryStore::writeAt(uint64_t offset, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            error = std::string("write failed: ") + strerror(errno);
+            return false;
+        }
+        data += written;
+        offset += written;
+        length -= written;
+    }
+    return true;
+}
+
+bool HistoryStore::writeNames() {
+    if (unnamed.empty()) return true;
+
+    std::vector<uint8_t> block(BLOCK_SIZE, 0);
+    size_t used = 0;
+    uint32_t entries = 0;
+    auto emit = [&]() {
+        putU32(&block[0], BLOCK_MAGIC);
+        block[4] = KIND_NAMES;
+        block[5] = 1;
+        putU32(&block[12], entries);
+        putU32(&block[32], static_cast<uint32_t>(used * 8));
+        putU32(&block[36], blockCrc(block.data(), used));
+        bool ok = writeAt(reserveSlot(), block.data(), block.size());
+        std::fill(block.begin(), block.end(), 0);
+        used = 0;
+        entries = 0;
+        return ok;
+    };
+
+    bool ok = true;
+    for (SeriesId id : unnamed) {
+        const Series& series = series_table[id];
+        size_t length = std::min<size_t>(series.name.size(), PAYLOAD_BYTES - 7);
+        if (used + 7 + length > PAYLOAD_BYTES) ok = emit() && ok;
+        uint8_t* entry = &block[HEADER_BYTES + used];
+        putU32(entry, id);
+        entry[4] = static_cast<uint8_t>(static_cast<int8_t>(series.decimals));
+        entry[5] = static_cast<uint8_t>(length);
+        entry[6] = static_cast<uint8_t>(length >> 8);
+        memcpy(entry + 7, series.name.data(), length);
+        used += 7 + length;
+        entries++;
+    }
+    if (entries > 0) ok = emit() && ok;
+    unnamed.clear();
+
+    // Names reach the disk before any data block that refers to them
+    return ok && fdatasync(fd) == 0;
+}
+
+bool HistoryStore::writeBlock(SeriesId id, bool sealed) {
+    if (!writeNames()) return false;
+    OpenBlock& block = series_table[id].block;
+    uint8_t* header = block.data.data();
+    putU32(&header[0], BLOCK_MAGIC);
+    header[4] = KIND_DATA;
+    header[5] = sealed ? 1 : 0;
+    header[6] = static_cast<uint8_t>(block.tag);
+    header[7] = static_cast<uint8_t>(block.tag >> 8);
+    putU32(&header[8], id);
+    putU32(&header[12], block.count);
+    putU64(&header[16], static_cast<uint64_t>(block.first_ms));
+    putU64(&header[24], static_cast<uint64_t>(block.last_ms));
+    putU32(&header[32], static_cast<uint32_t>(block.bits));
+    putU32(&header[36], blockCrc(header, (block.bits + 7) / 8));
+
+    // Never over the newest copy: if this write tears, that one stands
+    int slot = block.current == 0 ? 1 : 0;
+    if (!writeAt(block.slots[slot], header, BLOCK_SIZE)) return false;
+    block.current = slot;
+    return true;
+}
+
+bool HistoryStore::flush() {
+    if (fd < 0) return false;
+    bool ok = writeNames();
+    for (SeriesId id = 0; id < series_table.size(); id++) {
+        OpenBlock& block = series_table[id].block;
+        if (!block.dirty) continue;
+        ok = writeBlock(id, false) && ok;
+        block.dirty = false;
+    }
+    if (fdatasync(fd) == 0) {
+        // Sealed copies are on disk: the slots of their older copies can go
+        free_slots.insert(free_slots.end(), unsynced_free.begin(), unsynced_free.end());
+        unsynced_free.clear();
+    } else {
+        ok = false;
+    }
+    releaseExpired();
+    for (Rollup& rollup : rollups) ok = rollup.store->flush() && ok;
+    return ok;
+}
+
+void HistoryStore::close() {
+    if (fd < 0) return;
+    for (Rollup& rollup : rollups) {
+        for (SeriesId id = 0; id < rollup.buckets.size(); id++) {
+            if (rollup.buckets[id].count > 0) emitBucket(rollup, id);
+        }
+    }
+    flush();
+    for (Rollup& rollup : rollups) rollup.store->close();
+    rollups.clear();
+    ::close(fd);
+    fd = -1;
+}
+
+HistoryStoreReader::HistoryStoreReader()
+    : fd(-1), data(nullptr), size(0), total_samples(0), total_blocks(0), first_ms(0), last_ms(0) {
+}
+
+HistoryStoreReader::~HistoryStoreReader() {
+    close();
+}
+
+void HistoryStoreReader::close() {
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+    if (fd >= 0) ::close(fd);
+    data = nullptr;
+    fd = -1;
+    size = 0;
+}
+
+bool HistoryStoreReader::open(const std::string& file) {
+    close();
+    tiers.clear();
+    series.clear();
+    by_name.clear();
+    blocks.clear();
+    total_samples = 0;
+    total_blocks = 0;
+
+    fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "cannot open " + file + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size = static_cast<size_t>(st.st_size);
+    if (size < HistoryStore::BLOCK_SIZE) {
+        error = file + ": not a sysreport history store";
+        close();
+        return false;
+    }
+    void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        error = "cannot map " + file + ": " + strerror(errno);
+        size = 0;
+        close();
+        return false;
+    }
+    data = static_cast<const uint8_t*>(map);
+    if (memcmp(data, FILE_MAGIC, 8) != 0 || getU32(data + 8) != STORE_VERSION ||
+        getU32(data + 12) != HistoryStore::BLOCK_SIZE) {
+        error = file + ": not a sysreport history store (or an unsupported version)";
+        close();
+        return false;
+    }
+    uint32_t tier_count = std::min<uint32_t>(getU32(data + 16), MAX_TIERS);
+    for (uint32_t i = 0; i < tier_count; i++) {
+        tiers.push_back(HistoryTier{static_cast<int64_t>(getU64(data + 20 + 16 * i)),
+                                    static_cast<int64_t>(getU64(data + 28 + 16 * i))});
+    }
+    if (tiers.empty()) tiers.push_back(HistoryTier{0, 0});
+
+    // Only the headers are read here; payloads are checked when decoded.
+    // Unwritten slots (zeros) and torn names blocks are skipped.
+    size_t slots = size / HistoryStore::BLOCK_SIZE;
+    for (size_t slot = 1; slot < slots; slot++) {
+        uint64_t offset = slot * HistoryStore::BLOCK_SIZE;
+        const uint8_t* header = data + offset;
+        if (getU32(header) != BLOCK_MAGIC) continue;
+        uint32_t id = getU32(header + 8);
+        uint32_t count = getU32(header + 12);
+        uint32_t payload_bits = getU32(header + 32);
+        if (payload_bits > PAYLOAD_BITS) continue;
+
+        if (header[4] == KIND_NAMES) {
+            size_t used = payload_bits / 8;
+            if (blockCrc(header, used) != getU32(header + 36)) continue;
+            const uint8_t* entry = header + HEADER_BYTES;
+            const uint8_t* end = entry + used;
+            for (uint32_t i = 0; i < count && entry + 7 <= end; i++) {
+                uint32_t series_id = getU32(entry);
+                size_t length = entry[5] | entry[6] << 8;
+                if (entry + 7 + length > end || series_id >= (1u << 24)) break;
+                if (series_id >= series.size()) series.resize(series_id + 1, Series{"", 0, 0});
+                series[series_id].name.assign(reinterpret_cast<const char*>(entry + 7), length);
+                series[series_id].decimals = static_cast<int8_t>(entry[4]);
+                by_name[series[series_id].name] = series_id;
+                entry += 7 + length;
+            }
+        } else if (header[4] == KIND_DATA && count > 0 && id < (1u << 24)) {
+            if (id >= blocks.size()) blocks.resize(id + 1);
+            Block block;
+            block.offset = offset;
+            block.twin = 0;
+            block.tag = static_cast<uint16_t>(header[6] | header[7] << 8);
+            block.count = count;
+            block.payload_bits = payload_bits;
+            block.first_ms = static_cast<int64_t>(getU64(header + 16));
+            block.last_ms = static_cast<int64_t>(getU64(header + 24));
+            blocks[id].push_back(block);
+        }
+    }
+
+    size_t count = std::max(series.size(), blocks.size());
+    series.resize(count, Series{"", 0, 0});
+    blocks.resize(count);
+    bool any = false;
+    for (size_t id = 0; id < count; id++) {
+        // The two copies of a block written while it was open share its
+        // first_ms and tag: keep the fuller one that passes its CRC
+        std::sort(blocks[id].begin(), blocks[id].end(), [](const Block& a, const Block& b) {
+            if (a.first_ms != b.first_ms) return a.first_ms < b.first_ms;
+            if (a.tag != b.tag) return a.tag < b.tag;
+            return a.count > b.count;
+        });
+        std::vector<Block> kept;
+        for (const Block& block : blocks[id]) {
+            Block* copy = kept.empty() ? nullptr : &kept.back();
+            if (!copy || copy->first_ms != block.first_ms || copy->tag != block.tag) {
+                kept.push_back(block);
+            } else if (!dataBlockIntact(data + copy->offset) && dataBlockIntact(data + block.offset)) {
+                Block older = block;
+                older.twin = copy->offset;
+                *copy = older;
+            } else {
+                copy->twin = block.offset;
+            }
+        }
+        blocks[id].swap(kept);
+        for (const Block& block : blocks[id]) {
+            series[id].samples += block.count;
+            total_samples += block.count;
+            total_blocks++;
+            if (!any || block.first_ms < first_ms) first_ms = block.first_ms;
+            if (!any || block.last_ms > last_ms) last_ms = block.last_ms;
+            any = true;
+        }
+    }
+    return true;
+}
+
+uint32_t HistoryStoreReader::findSeries(const std::string& name) const {
+    auto found = by_name.find(name);
+    return found != by_name.end() ? found->second : HistoryStore::NO_SERIES;
+}
+
+bool HistoryStoreReader::readBlock(uint32_t id, const Block& block, int64_t from_ms, int64_t to_ms,
+                                   std::vector<int64_t>& timestamps, std::vector<double>& values) const {
+    if (block.last_ms < from_ms || block.first_ms > to_ms) return true;
+
+    // The header as it is now: an open block may have grown since open(),
+    // into either copy, and an expired one may have been replaced
+    auto isBlock = [&](const uint8_t* header) {
+        return getU32(header) == BLOCK_MAGIC && header[4] == KIND_DATA && getU32(header + 8) == id &&
+               static_cast<int64_t>(getU64(header + 16)) == block.first_ms &&
+               (header[6] | header[7] << 8) == block.tag;
+    };
+    const uint8_t* header = data + block.offset;
+    if (block.twin != 0) {
+        const uint8_t* twin = data + block.twin;
+        bool intact = isBlock(header) && dataBlockIntact(header);
+        if (isBlock(twin) && dataBlockIntact(twin) && (!intact || getU32(twin + 12) > getU32(header + 12))) {
+            header = twin;
+        }
+    }
+    if (!isBlock(header)) return true;
+    uint32_t count = getU32(header + 12);
+    uint32_t payload_bits = getU32(header + 32);
+    if (count == 0 || payload_bits > PAYLOAD_BITS ||
+        blockCrc(header, (payload_bits + 7) / 8) != getU32(header + 36)) {
+        return false;
+    }
+
+    int decimals = series[id].decimals;
+    double scale = std::pow(10.0, decimals);
+    BitReader in(header + HEADER_BYTES, payload_bits);
+    if (!in.has(128)) return false;
+    int64_t timestamp = static_cast<int64_t>(in.bits(64));
+    uint64_t bits = in.bits(64);
+    int64_t delta = 0;
+    int leading = 0, meaningful = 0, trailing = 0;
+
+    for (uint32_t i = 0; ; ) {
+        if (timestamp > to_ms) break;
+        if (timestamp >= from_ms) {
+            double stored;
+            memcpy(&stored, &bits, sizeof(stored));
+            timestamps.push_back(timestamp);
+            values.push_back(decimals >= 0 ? stored / scale : stored);
+        }
+        if (++i == count) break;
+
+        if (!in.has(1)) return false;
+        if (in.bits(1) != 0) {
+            int64_t dod;
+            if (!in.has(1)) return false;
+            if (in.bits(1) == 0) {
+                if (!in.has(7)) return false;
+                dod = static_cast<int64_t>(in.bits(7)) - 63;
+            } else {
+                if (!in.has(1)) return false;
+                if (in.bits(1) == 0) {
+                    if (!in.has(9)) return false;
+                    dod = static_cast<int64_t>(in.bits(9)) - 255;
+                } else {
+                    if (!in.has(1)) return false;
+                    if (in.bits(1) == 0) {
+                        if (!in.has(12)) return false;
+                        dod = static_cast<int64_t>(in.bits(12)) - 2047;
+                    } else {
+                        if (!in.has(64)) return false;
+                        dod = static_cast<int64_t>(in.bits(64));
+                    }
+                }
+            }
+            delta += dod;
+        }
+        timestamp += delta;
+
+        if (!in.has(1)) return false;
+        if (in.bits(1) != 0) {
+            if (!in.has(1)) return false;
+            if (in.bits(1) != 0) {
+                if (!in.has(11)) return false;
+                leading = static_cast<int>(in.bits(5));
+                meaningful = static_cast<int>(in.bits(6));
+                if (meaningful == 0) meaningful = 64;
+                trailing = 64 - leading - meaningful;
+                if (trailing < 0) return false;
+            } else if (meaningful == 0) {
+                return false;
+            }
+            if (!in.has(meaningful)) return false;
+            bits ^= in.bits(meaningful) << trailing;
+        }
+    }
+    return true;
+}
+
+bool HistoryStoreReader::read(uint32_t id, int64_t from_ms, int64_t to_ms,
+                              std::vector<int64_t>& timestamps, std::vector<double>& values) const {
+    if (id >= blocks.size()) return true;
+    bool ok = true;
+    for (const Block& block : blocks[id]) {
+        if (block.first_ms > to_ms) break;
+        if (!readBlock(id, block, from_ms, to_ms, timestamps, values)) ok = false;
+    }
+    return ok;
+}
+
+bool isHistoryStore(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[8];
+    return file.read(magic, sizeof(magic)) && memcmp(magic, FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+int inspectHistoryStore(const std::string& path) {
+    HistoryStoreReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Error: " << reader.getError() << std::endl;
+        return 1;
+    }
+    uint64_t payload_bits = 0;
+    for (size_t id = 0; id < reader.getSeries().size(); id++) {
+        for (const auto& block : reader.getBlocks(static_cast<uint32_t>(id))) {
+            payload_bits += block.payload_bits;
+        }
+    }
+
+    uint64_t samples = reader.sampleCount();
+    std::cout << path << ": " << reader.getSeries().size() << " series, " << samples
+              << " sample(s) in " << reader.blockCount() << " block(s), " << reader.fileSize() << " bytes\n";
+    if (samples > 0) {
+        char line[160];
+        snprintf(line, sizeof(line), "  %.2f bytes/sample on disk, %.2f compressed\n",
+                 static_cast<double>(reader.fileSize()) / samples, payload_bits / 8.0 / samples);
+        std::cout << line;
+        std::cout << "  " << getTimestamp(reader.firstTime() / 1000) << " .. "
+                  << getTimestamp(reader.lastTime() / 1000) << "\n";
+    }
+
+    // The tiers this file keeps: its own first, then its rollup files
+    const std::vector<HistoryTier>& tiers = reader.getTiers();
+    for (size_t i = 0; i < tiers.size(); i++) {
+        const HistoryTier& tier = tiers[i];
+        std::cout << "  " << (tier.step_ms == 0 ? std::string("raw samples") : formatDuration(tier.step_ms) + " rollup")
+                  << ", kept " << (tier.retention_ms == 0 ? std::string("forever") : formatDuration(tier.retention_ms));
+        if (i > 0) {
+            std::string tier_path = historyTierPath(path, tier);
+            HistoryStoreReader rollup;
+            if (rollup.open(tier_path)) {
+                std::cout << ": " << tier_path << ", " << rollup.sampleCount() / 4 << " bucket(s), "
+                          << rollup.fileSize() << " bytes";
+            } else {
+                std::cout << ": " << tier_path << " missing";
+            }
+        }
+        std::cout << "\n";
+    }
+    for (const auto& series : reader.getSeries()) {
+        std::cout << "  " << (series.name.empty() ? "(unnamed)" : series.name) << ": "
+                  << series.samples << "\n";
+    }
+    return 0;
+}
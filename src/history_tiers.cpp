@@ -0,0 +1,151 @@
+#include "history_tiers.h"
+#include <algorithm>
+
+static int64_t alignDown(int64_t timestamp_ms, int64_t step_ms) {
+    return timestamp_ms - ((timestamp_ms % step_ms) + step_ms) % step_ms;
+}
+
+HistoryTiers::HistoryTiers() : first_ms(0), last_ms(0) {
+}
+
+bool HistoryTiers::open(const std::string& file) {
+    tiers.clear();
+    readers.clear();
+    names.clear();
+    first_ms = 0;
+    last_ms = 0;
+
+    std::unique_ptr<HistoryStoreReader> base(new HistoryStoreReader());
+    if (!base->open(file)) {
+        error = base->getError();
+        return false;
+    }
+    tiers = base->getTiers();
+    readers.push_back(std::move(base));
+    for (size_t i = 1; i < tiers.size(); i++) {
+        std::unique_ptr<HistoryStoreReader> tier(new HistoryStoreReader());
+        if (!tier->open(historyTierPath(file, tiers[i]))) tier.reset();
+        readers.push_back(std::move(tier));
+    }
+
+    // Source series: the raw store's, or a lone tier's without the suffix
+    const std::string suffix = historyRollupSeries("", 0);
+    for (const auto& series : readers[0]->getSeries()) {
+        if (tiers[0].step_ms == 0) {
+            if (!series.name.empty()) names.push_back(series.name);
+        } else if (series.name.size() > suffix.size() &&
+                   series.name.compare(series.name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            names.push_back(series.name.substr(0, series.name.size() - suffix.size()));
+        }
+    }
+
+    bool any = false;
+    for (const auto& reader : readers) {
+        if (!reader || reader->sampleCount() == 0) continue;
+        if (!any || reader->firstTime() < first_ms) first_ms = reader->firstTime();
+        if (!any || reader->lastTime() > last_ms) last_ms = reader->lastTime();
+        any = true;
+    }
+    return true;
+}
+
+size_t HistoryTiers::pick(int64_t step_ms, int64_t from_ms) const {
+    auto reaches = [&](size_t i) {
+        return readers[i] && (tiers[i].retention_ms == 0 || from_ms >= last_ms - tiers[i].retention_ms);
+    };
+    size_t best = SIZE_MAX;
+    for (size_t i = 0; i < tiers.size(); i++) {
+        bool fits = tiers[i].step_ms == 0 || (step_ms > 0 && step_ms % tiers[i].step_ms == 0);
+        if (fits && reaches(i)) best = i;
+    }
+    if (best != SIZE_MAX) return best;
+    for (size_t i = 0; i < tiers.size(); i++) {
+        if (reaches(i)) return i;
+    }
+    for (size_t i = tiers.size(); i-- > 1; ) {
+        if (readers[i]) return i;
+    }
+    return 0;
+}
+
+bool HistoryTiers::read(const std::string& name, int64_t from_ms, int64_t to_ms, int64_t step_ms,
+                        std::vector<HistoryBucket>& buckets, size_t* tier_used) const {
+    size_t tier = pick(step_ms, from_ms);
+    if (tier_used) *tier_used = tier;
+    return readTier(tier, name, from_ms, to_ms, step_ms, buckets);
+}
+
+bool HistoryTiers::readTier(size_t tier, const std::string& name, int64_t from_ms, int64_t to_ms,
+                            int64_t step_ms, std::vector<HistoryBucket>& buckets) const {
+    const HistoryStoreReader* reader = tier < readers.size() ? readers[tier].get() : nullptr;
+    if (!reader) return true;
+    auto bucketStart = [step_ms](int64_t timestamp_ms) {
+        return step_ms > 0 ? alignDown(timestamp_ms, step_ms) : timestamp_ms;
+    };
+
+    std::vector<HistoryBucket> found;
+    bool ok = true;
+    if (tiers[tier].step_ms == 0) {
+        uint32_t id = reader->findSeries(name);
+        if (id == HistoryStore::NO_SERIES) return true;
+        std::vector<int64_t> timestamps;
+        std::vector<double> values;
+        ok = reader->read(id, from_ms, to_ms, timestamps, values);
+        found.reserve(timestamps.size());
+        for (size_t i = 0; i < timestamps.size(); i++) {
+            if (std::isnan(values[i])) continue;
+            found.push_back(HistoryBucket{bucketStart(timestamps[i]), values[i], values[i], values[i], 1});
+        }
+    } else {
+        uint32_t ids[4];
+        for (int field = 0; field < 4; field++) {
+            ids[field] = reader->findSeries(historyRollupSeries(name, field));
+            if (ids[field] == HistoryStore::NO_SERIES) return true;
+        }
+        // A tier bucket that starts before from_ms still covers it
+        int64_t tier_from = alignDown(from_ms, tiers[tier].step_ms);
+        std::vector<int64_t> timestamps[4];
+        std::vector<double> values[4];
+        for (int field = 0; field < 4; field++) {
+            ok = reader->read(ids[field], tier_from, to_ms, timestamps[field], values[field]) && ok;
+        }
+
+        // The four fields are appended together; after a damaged block
+        // they no longer line up, so join on the timestamps
+        size_t at[4] = {0, 0, 0, 0};
+        found.reserve(timestamps[0].size());
+        for (; at[0] < timestamps[0].size(); at[0]++) {
+            int64_t timestamp = timestamps[0][at[0]];
+            bool complete = true;
+            for (int field = 1; field < 4; field++) {
+                size_t& i = at[field];
+                while (i < timestamps[field].size() && timestamps[field][i] < timestamp) i++;
+                complete = complete && i < timestamps[field].size() && timestamps[field][i] == timestamp;
+            }
+            if (!complete) continue;
+            uint64_t count = static_cast<uint64_t>(values[3][at[3]]);
+            found.push_back(HistoryBucket{bucketStart(timestamp), values[0][at[0]], values[1][at[1]],
+                                          values[2][at[2]], count});
+            for (int field = 1; field < 4; field++) at[field]++;
+        }
+    }
+
+    // Blocks come in time order, so this only moves the rare bucket after
+    // a clock step; equal starts (coarser steps, restarts) are merged
+    std::stable_sort(found.begin(), found.end(), [](const HistoryBucket& a, const HistoryBucket& b) {
+        return a.start_ms < b.start_ms;
+    });
+    size_t merged_from = buckets.size();
+    for (const HistoryBucket& bucket : found) {
+        if (buckets.size() > merged_from && buckets.back().start_ms == bucket.start_ms) {
+            HistoryBucket& last = buckets.back();
+            last.min = std::min(last.min, bucket.min);
+            last.max = std::max(last.max, bucket.max);
+            last.sum += bucket.sum;
+            last.count += bucket.count;
+        } else {
+            buckets.push_back(bucket);
+        }
+    }
+    return ok;
+}
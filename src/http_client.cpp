@@ -0,0 +1,387 @@
+#include "http_client.h"
+#include "cli.h"
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+static long monotonicMillis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static std::string toLower(std::string str) {
+    std::transform(str.begin(), str.end(), str.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return str;
+}
+
+static std::string trimSpaces(const std::string& str) {
+    size_t first = str.find_first_not_of(" \t");
+    if (first == std::string::npos) return "";
+    size_t last = str.find_last_not_of(" \t");
+    return str.substr(first, last - first + 1);
+}
+
+bool HttpUrl::parse(const std::string& url) {
+    const std::string scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) != 0) return false;
+
+    size_t host_start = scheme.size();
+    size_t path_start = url.find('/', host_start);
+    std::string authority = url.substr(host_start, path_start == std::string::npos
+                                                       ? std::string::npos
+                                                       : path_start - host_start);
+    path = path_start == std::string::npos ? "/" : url.substr(path_start);
+    port = 80;
+
+    std::string port_str;
+    if (!authority.empty() && authority[0] == '[') {
+        size_t close = authority.find(']');
+        if (close == std::string::npos) return false;
+        host = authority.substr(1, close - 1);
+        if (close + 1 < authority.size()) {
+            if (authority[close + 1] != ':') return false;
+            port_str = authority.substr(close + 2);
+        }
+    } else {
+        size_t colon = authority.rfind(':');
+        host = authority.substr(0, colon);
+        if (colon != std::string::npos) port_str = authority.substr(colon + 1);
+    }
+
+    if (!port_str.empty()) {
+        try {
+            port = std::stoi(port_str);
+        } catch (...) {
+            return false;
+        }
+    }
+    return !host.empty() && port > 0 && port < 65536;
+}
+
+std::string HttpUrl::hostHeader() const {
+    std::string h = host.find(':') != std::string::npos ? "[" + host + "]" : host;
+    if (port != 80) h += ":" + std::to_string(port);
+    return h;
+}
+
+HttpClient::HttpClient(const std::string& target_url, int timeout)
+    : valid(false), timeout_ms(timeout), fd(-1), reused(false), resolved_at(0) {
+    valid = url.parse(target_url);
+    if (!valid) {
+        last_error = target_url.compare(0, 8, "https://") == 0
+                         ? "https URLs are not supported"
+                         : "invalid URL: " + target_url;
+    }
+}
+
+HttpClient::~HttpClient() {
+    disconnect();
+}
+
+void HttpClient::disconnect() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    reused = false;
+}
+
+bool HttpClient::post(const std::string& body, const std::string& content_type,
+                      HttpResponse& response, const std::vector<std::string>& extra_headers) {
+    if (!valid) return false;
+
+    std::string head;
+    head.reserve(256);
+    head += "POST " + url.path + " HTTP/1.1\r\n";
+    head += "Host: " + url.hostHeader() + "\r\n";
+    head += "User-Agent: " + PROGRAM_NAME + "/" + VERSION + "\r\n";
+    head += "Content-Type: " + content_type + "\r\n";
+    head += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    for (const auto& header : extra_headers) {
+        head += header + "\r\n";
+    }
+    head += "\r\n";
+
+    // A kept-alive connection may have been closed by the server while idle;
+    // that shows up as a failure before any response byte arrives, and is
+    // retried once on a fresh connection
+    bool response_started = false;
+    if (attempt(head, body, response, response_started)) return true;
+    if (!reused || response_started) return false;
+
+    disconnect();
+    return attempt(head, body, response, response_started);
+}
+
+bool HttpClient::attempt(const std::string& head, const std::string& body,
+                         HttpResponse& response, bool& response_started) {
+    long deadline = monotonicMillis() + timeout_ms;
+    response_started = false;
+
+    if (fd < 0 && !connectSocket(deadline)) return false;
+
+    bool was_reused = reused;
+    bool keep_alive = false;
+    if (!sendAll(head, body, deadline) ||
+        !readResponse(response, keep_alive, response_started, deadline)) {
+        close(fd);
+        fd = -1;
+        reused = was_reused;   // Lets post() know a retry is worthwhile
+        return false;
+    }
+
+    if (keep_alive) {
+        reused = true;
+    } else {
+        disconnect();
+    }
+    return true;
+}
+
+bool HttpClient::resolve() {
+    long now = monotonicMillis() / 1000;
+    if (!addresses.empty() && now - resolved_at < DNS_CACHE_SECONDS) return true;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+
+    struct addrinfo* result = nullptr;
+    std::string service = std::to_string(url.port);
+    int rc = getaddrinfo(url.host.c_str(), service.c_str(), &hints, &result);
+    if (rc != 0) {
+        last_error = "cannot resolve " + url.host + ": " + gai_strerror(rc);
+        // Keep serving stale addresses rather than failing on a DNS blip
+        return !addresses.empty();
+    }
+
+    addresses.clear();
+    address_lengths.clear();
+    for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+        struct sockaddr_storage ss;
+        memset(&ss, 0, sizeof(ss));
+        memcpy(&ss, ai->ai_addr, ai->ai_addrlen);
+        addresses.push_back(ss);
+        address_lengths.push_back(ai->ai_addrlen);
+    }
+    freeaddrinfo(result);
+    resolved_at = now;
+    return !addresses.empty();
+}
+
+bool HttpClient::connectSocket(long deadline_ms) {
+    if (!resolve()) return false;
+
+    for (size_t i = 0; i < addresses.size(); i++) {
+        const struct sockaddr* addr = reinterpret_cast<const struct sockaddr*>(&addresses[i]);
+        int sock = socket(addr->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sock < 0) continue;
+
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if (connect(sock, addr, address_lengths[i]) != 0 && errno != EINPROGRESS) {
+            last_error = std::string("connect: ") + strerror(errno);
+            close(sock);
+            continue;
+        }
+
+        fd = sock;
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (!waitFor(POLLOUT, deadline_ms) ||
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+            if (err != 0) last_error = std::string("connect: ") + strerror(err);
+            close(sock);
+            fd = -1;
+            continue;
+        }
+        reused = false;
+        return true;
+    }
+
+    // Every cached address failed: resolve again next time
+    addresses.clear();
+    return false;
+}
+
+bool HttpClient::waitFor(short events, long deadline_ms) {
+    for (;;) {
+        long remaining = deadline_ms - monotonicMillis();
+        if (remaining <= 0) {
+            last_error = "timed out";
+            return false;
+        }
+        struct pollfd pfd = {fd, events, 0};
+        int rc = poll(&pfd, 1, static_cast<int>(remaining));
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            last_error = std::string("poll: ") + strerror(errno);
+            return false;
+        }
+        if (rc == 0) {
+            last_error = "timed out";
+            return false;
+        }
+        return true;
+    }
+}
+
+bool HttpClient::sendAll(const std::string& head, const std::string& body, long deadline_ms) {
+    struct iovec iov[2];
+    iov[0].iov_base = const_cast<char*>(head.data());
+    iov[0].iov_len = head.size();
+    iov[1].iov_base = const_cast<char*>(body.data());
+    iov[1].iov_len = body.size();
+
+    int idx = 0;
+    while (idx < 2) {
+        if (iov[idx].iov_len == 0) {
+            idx++;
+            continue;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov[idx];
+        msg.msg_iovlen = 2 - idx;
+        ssize_t w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!waitFor(POLLOUT, deadline_ms)) return false;
+                continue;
+            }
+            last_error = std::string("send: ") + strerror(errno);
+            return false;
+        }
+        size_t left = w;
+        while (idx < 2 && left >= iov[idx].iov_len) {
+            left -= iov[idx].iov_len;
+            idx++;
+        }
+        if (idx < 2) {
+            iov[idx].iov_base = static_cast<char*>(iov[idx].iov_base) + left;
+            iov[idx].iov_len -= left;
+        }
+    }
+    return true;
+}
+
+bool HttpClient::fill(std::string& buffer, long deadline_ms) {
+    char chunk[4096];
+    for (;;) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n > 0) {
+            buffer.append(chunk, n);
+            if (buffer.size() > MAX_RESPONSE_BYTES) {
+                last_error = "response too large";
+                return false;
+            }
+            return true;
+        }
+        if (n == 0) {
+            last_error = "connection closed by server";
+            return false;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (!waitFor(POLLIN, deadline_ms)) return false;
+            continue;
+        }
+        last_error = std::string("recv: ") + strerror(errno);
+        return false;
+    }
+}
+
+bool HttpClient::readResponse(HttpResponse& response, bool& keep_alive,
+                              bool& response_started, long deadline_ms) {
+    std::string buffer;
+    size_t header_end;
+    for (;;) {
+        header_end = buffer.find("\r\n\r\n");
+        if (header_end != std::string::npos) break;
+        if (!fill(buffer, deadline_ms)) return false;
+        response_started = true;
+    }
+
+    // Status line: HTTP/1.x CODE REASON
+    size_t line_end = buffer.find("\r\n");
+    std::string status_line = buffer.substr(0, line_end);
+    if (status_line.compare(0, 5, "HTTP/") != 0) {
+        last_error = "malformed status line";
+        return false;
+    }
+    size_t sp = status_line.find(' ');
+    response.status = sp == std::string::npos ? 0 : atoi(status_line.c_str() + sp + 1);
+    keep_alive = status_line.compare(0, 8, "HTTP/1.1") == 0;
+
+    long content_length = -1;
+    bool chunked = false;
+    size_t pos = line_end + 2;
+    while (pos < header_end) {
+        size_t eol = buffer.find("\r\n", pos);
+        std::string line = buffer.substr(pos, eol - pos);
+        pos = eol + 2;
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = toLower(trimSpaces(line.substr(0, colon)));
+        std::string value = toLower(trimSpaces(line.substr(colon + 1)));
+        if (name == "content-length") {
+            content_length = atol(value.c_str());
+        } else if (name == "transfer-encoding") {
+            chunked = value.find("chunked") != std::string::npos;
+        } else if (name == "connection") {
+            if (value == "close") keep_alive = false;
+            else if (value == "keep-alive") keep_alive = true;
+        }
+    }
+
+    std::string rest = buffer.substr(header_end + 4);
+    response.body.clear();
+
+    if (chunked) {
+        for (;;) {
+            size_t eol;
+            while ((eol = rest.find("\r\n")) == std::string::npos) {
+                if (!fill(rest, deadline_ms)) return false;
+            }
+            long size = strtol(rest.c_str(), nullptr, 16);
+            if (size < 0) {
+                last_error = "malformed chunk";
+                return false;
+            }
+            rest.erase(0, eol + 2);
+            while (rest.size() < static_cast<size_t>(size) + 2) {
+                if (!fill(rest, deadline_ms)) return false;
+            }
+            if (size == 0) break;  // Trailers are not used by webhook receivers
+            response.body.append(rest, 0, size);
+            rest.erase(0, size + 2);
+        }
+    } else if (content_length >= 0) {
+        while (rest.size() < static_cast<size_t>(content_length)) {
+            if (!fill(rest, deadline_ms)) return false;
+        }
+        response.body = rest.substr(0, content_length);
+    } else if (response.status == 204 || response.status == 304) {
+        // No body by definition
+    } else {
+        // Body runs to end of connection
+        keep_alive = false;
+        while (fill(rest, deadline_ms)) {}
+        response.body = rest;
+    }
+    return true;
+}
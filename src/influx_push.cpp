@@ -0,0 +1,241 @@
+#include "influx_push.h"
+#include "exporters.h"
+#include "metric_registry.h"
+#include "metrics_server.h"
+#include "self_stats.h"
+#include <netdb.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+static int64_t monotonicMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Split "udp://host:port" (host may be a bracketed IPv6 literal)
+static bool parseUdpUrl(const std::string& url, std::string& host, std::string& port) {
+    if (url.compare(0, 6, "udp://") != 0) return false;
+    std::string rest = url.substr(6);
+    if (!rest.empty() && rest.back() == '/') rest.pop_back();
+
+    size_t colon;
+    if (!rest.empty() && rest[0] == '[') {
+        size_t close = rest.find(']');
+        if (close == std::string::npos || close + 1 >= rest.size() || rest[close + 1] != ':') return false;
+        host = rest.substr(1, close - 1);
+        colon = close + 1;
+    } else {
+        colon = rest.rfind(':');
+        if (colon == std::string::npos) return false;
+        host = rest.substr(0, colon);
+    }
+    port = rest.substr(colon + 1);
+    return !host.empty() && !port.empty() &&
+           port.find_first_not_of("0123456789") == std::string::npos;
+}
+
+bool InfluxPushSink::supportsUrl(const std::string& url) {
+    std::string host, port;
+    if (parseUdpUrl(url, host, port)) return true;
+    HttpUrl http;
+    return http.parse(url);
+}
+
+InfluxPushSink::InfluxPushSink(const SinkOptions& opts)
+    : options(opts),
+      use_udp(false),
+      udp_fd(-1),
+      udp_addr_len(0),
+      buffered_lines(0),
+      batch_started_ms(0),
+      retry_at_ms(0),
+      backoff_ms(0) {
+    memset(&udp_addr, 0, sizeof(udp_addr));
+    if (options.delta.enabled) delta.reset(new DeltaFilter(options.delta));
+}
+
+InfluxPushSink::~InfluxPushSink() {
+    close();
+}
+
+bool InfluxPushSink::open(std::string& error) {
+    if (parseUdpUrl(options.target, udp_host, udp_port)) {
+        use_udp = true;
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        struct addrinfo* result = nullptr;
+        int rc = getaddrinfo(udp_host.c_str(), udp_port.c_str(), &hints, &result);
+        if (rc != 0 || !result) {
+            error = "cannot resolve " + udp_host + ": " + gai_strerror(rc);
+            return false;
+        }
+        memcpy(&udp_addr, result->ai_addr, result->ai_addrlen);
+        udp_addr_len = result->ai_addrlen;
+        udp_fd = socket(result->ai_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        freeaddrinfo(result);
+        if (udp_fd < 0) {
+            error = std::string("socket: ") + strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    client.reset(new HttpClient(options.target, options.timeout_ms));
+    if (!client->isValid()) {
+        error = "influxdb sinks need a udp:// or http:// URL";
+        client.reset();
+        return false;
+    }
+    return true;
+}
+
+void InfluxPushSink::write(const SinkSample& sample) {
+    size_t old_size = buffer.size();
+    if (delta) {
+        InfluxDBExporter::exportMetrics(utilizationRegistry(sample.util), buffer, "sysreport",
+                                        static_cast<long>(sample.timestamp_ms) * 1000000L,
+                                        delta.get());
+    } else {
+        InfluxDBExporter::exportMetrics(sample.util, buffer, "sysreport",
+                                        static_cast<long>(sample.timestamp_ms) * 1000000L);
+    }
+    buffered_lines += std::count(buffer.begin() + old_size, buffer.end(), '\n');
+
+    int64_t now = monotonicMillis();
+    if (batch_started_ms == 0) batch_started_ms = now;
+    if (buffered_lines >= options.batch_size ||
+        now - batch_started_ms >= static_cast<int64_t>(options.batch_age_seconds * 1000)) {
+        flush(now);
+    }
+    if (!use_udp) {
+        retryHttp(now);
+    }
+}
+
+void InfluxPushSink::close() {
+    if (!buffer.empty() && (udp_fd >= 0 || client)) {
+        flush(monotonicMillis());
+    }
+    if (udp_fd >= 0) {
+        ::close(udp_fd);
+        udp_fd = -1;
+    }
+    if (client) {
+        client->disconnect();
+        client.reset();
+    }
+}
+
+void InfluxPushSink::flush(int64_t now_ms) {
+    if (buffer.empty()) return;
+    std::string lines;
+    lines.swap(buffer);
+    buffered_lines = 0;
+    batch_started_ms = 0;
+
+    if (use_udp) {
+        sendUdp(lines);
+    } else {
+        sendHttp(std::move(lines), now_ms);
+    }
+}
+
+void InfluxPushSink::sendUdp(const std::string& lines) {
+    static std::atomic<uint64_t>& sent = SelfStats::counter(
+        "influxdb_datagrams_sent_total", "Line-protocol datagrams sent over UDP");
+    static std::atomic<uint64_t>& dropped = SelfStats::counter(
+        "influxdb_datagrams_dropped_total", "Line-protocol datagrams dropped because the socket would block or failed");
+
+    SELF_STATS_SCOPE(StageKind::EXPORTER, "influxdb_udp");
+    // Pack whole lines; a datagram never splits a point
+    size_t start = 0;
+    while (start < lines.size()) {
+        size_t end = start;
+        while (end < lines.size()) {
+            size_t eol = lines.find('\n', end);
+            size_t next = eol == std::string::npos ? lines.size() : eol + 1;
+            if (next - start > MAX_DATAGRAM && end > start) break;
+            end = next;
+        }
+        ssize_t n = sendto(udp_fd, lines.data() + start, end - start, MSG_DONTWAIT | MSG_NOSIGNAL,
+                           reinterpret_cast<struct sockaddr*>(&udp_addr), udp_addr_len);
+        if (n < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            if (delta) delta->forceKeyframe();
+        } else {
+            sent.fetch_add(1, std::memory_order_relaxed);
+        }
+        start = end;
+    }
+}
+
+void InfluxPushSink::sendHttp(std::string body, int64_t now_ms) {
+    static std::atomic<uint64_t>& lost = SelfStats::counter(
+        "influxdb_batches_lost_total", "InfluxDB batches discarded after the retry queue overflowed");
+
+    if (options.gzip) {
+        std::string compressed;
+        if (gzipCompress(body, compressed, 1)) body.swap(compressed);
+    }
+
+    // Keep delivery in order: new batches wait behind ones being retried
+    if (retry_queue.empty() && now_ms >= retry_at_ms && postHttp(body) != 0) return;
+
+    retry_queue.push_back(std::move(body));
+    if (retry_queue.size() > MAX_RETRY_BATCHES) {
+        retry_queue.pop_front();
+        lost.fetch_add(1, std::memory_order_relaxed);
+        if (delta) delta->forceKeyframe();
+    }
+}
+
+void InfluxPushSink::retryHttp(int64_t now_ms) {
+    while (!retry_queue.empty() && now_ms >= retry_at_ms) {
+        if (postHttp(retry_queue.front()) == 0) break;
+        retry_queue.pop_front();
+    }
+}
+
+int InfluxPushSink::postHttp(const std::string& body) {
+    static std::atomic<uint64_t>& sent = SelfStats::counter(
+        "influxdb_batches_sent_total", "InfluxDB batches accepted by the /write endpoint");
+    static std::atomic<uint64_t>& rejected = SelfStats::counter(
+        "influxdb_batches_rejected_total", "InfluxDB batches refused with a non-retryable status");
+    static std::atomic<uint64_t>& failed = SelfStats::counter(
+        "influxdb_failures_total", "InfluxDB writes that failed and will be retried");
+
+    std::vector<std::string> headers;
+    if (options.gzip) headers.push_back("Content-Encoding: gzip");
+
+    HttpResponse response;
+    bool transport_ok;
+    {
+        SELF_STATS_SCOPE(StageKind::EXPORTER, "influxdb_http");
+        transport_ok = client->post(body, "text/plain; charset=utf-8", response, headers);
+    }
+    int status = transport_ok ? response.status : 0;
+
+    if (status >= 200 && status < 300) {
+        sent.fetch_add(1, std::memory_order_relaxed);
+        backoff_ms = 0;
+        retry_at_ms = 0;
+        return 1;
+    }
+    // Bad line protocol or auth problems do not fix themselves
+    if (status >= 400 && status < 500 && status != 408 && status != 429) {
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        if (delta) delta->forceKeyframe();
+        return -1;
+    }
+
+    failed.fetch_add(1, std::memory_order_relaxed);
+    backoff_ms = backoff_ms == 0 ? 1000 : std::min(backoff_ms * 2, 60000);
+    retry_at_ms = monotonicMillis() + backoff_ms;
+    return 0;
+}
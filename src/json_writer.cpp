@@ -0,0 +1,135 @@
+#include "json_writer.h"
+#include <charconv>
+#include <cmath>
+
+void appendJsonString(std::string& out, const std::string& str) {
+    static const char HEX[] = "0123456789abcdef";
+    out += '"';
+    size_t run = 0;     // Start of the pending run of characters needing no escape
+    for (size_t i = 0; i < str.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(str[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out.append(str, run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: {
+                char escaped[6] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xf]};
+                out.append(escaped, sizeof(escaped));
+            }
+        }
+    }
+    out.append(str, run, std::string::npos);
+    out += '"';
+}
+
+JsonWriter::JsonWriter(std::string& buffer, bool pretty_print)
+    : out(buffer), pretty(pretty_print), after_key(false) {
+}
+
+void JsonWriter::newline(size_t depth) {
+    out += '\n';
+    out.append(depth * 2, ' ');
+}
+
+// Comma and layout before a key, or before a value that has no key
+void JsonWriter::separate() {
+    if (after_key) {
+        after_key = false;
+        return;
+    }
+    if (stack.empty()) return;
+    Level& level = stack.back();
+    if (!level.empty) out += ',';
+    if (pretty) {
+        if (level.inline_items) {
+            if (!level.empty) out += ' ';
+        } else {
+            newline(stack.size());
+        }
+    }
+    level.empty = false;
+}
+
+void JsonWriter::beginObject(bool inline_items) {
+    separate();
+    out += '{';
+    // Everything inside an inline container is inline too
+    bool parent_inline = !stack.empty() && stack.back().inline_items;
+    stack.push_back(Level{inline_items || parent_inline, true});
+}
+
+void JsonWriter::beginArray(bool inline_items) {
+    separate();
+    out += '[';
+    bool parent_inline = !stack.empty() && stack.back().inline_items;
+    stack.push_back(Level{inline_items || parent_inline, true});
+}
+
+void JsonWriter::close(char bracket) {
+    Level level = stack.back();
+    stack.pop_back();
+    if (pretty && !level.empty && !level.inline_items) newline(stack.size());
+    out += bracket;
+}
+
+void JsonWriter::endObject() {
+    close('}');
+}
+
+void JsonWriter::endArray() {
+    close(']');
+}
+
+void JsonWriter::key(const std::string& name) {
+    separate();
+    appendJsonString(out, name);
+    out += pretty ? ": " : ":";
+    after_key = true;
+}
+
+void JsonWriter::value(const std::string& str) {
+    separate();
+    appendJsonString(out, str);
+}
+
+void JsonWriter::value(const char* str) {
+    value(std::string(str));
+}
+
+void JsonWriter::value(bool flag) {
+    separate();
+    out += flag ? "true" : "false";
+}
+
+void JsonWriter::integer(long long number) {
+    separate();
+    char buf[24];
+    std::to_chars_result result = std::to_chars(buf, buf + sizeof(buf), number);
+    out.append(buf, result.ptr);
+}
+
+void JsonWriter::number(double number, int decimals) {
+    separate();
+    if (!std::isfinite(number)) {
+        out += "null";
+        return;
+    }
+    char buf[64];
+    std::to_chars_result result = std::to_chars(buf, buf + sizeof(buf), number,
+                                                std::chars_format::fixed, decimals);
+    if (result.ec != std::errc()) {
+        // Too wide for fixed notation; still a valid JSON number
+        result = std::to_chars(buf, buf + sizeof(buf), number);
+    }
+    out.append(buf, result.ptr);
+}
+
+void JsonWriter::null() {
+    separate();
+    out += "null";
+}
@@ -5,15 +5,58 @@
 #include <iomanip>
 #include <unistd.h>
 #include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <csignal>
+#include <stdexcept>
 #include "cli.h"
 #include "system_info.h"
 #include "config.h"
 #include "tui.h"
 #include "history.h"
 #include "exporters.h"
+#include "metric_registry.h"
 #include "daemon.h"
 #include "plugin.h"
 #include "security.h"
+#include "self_stats.h"
+#include "sample_log.h"
+#include "shm_snapshot.h"
+#include "columnar.h"
+#include "history_store.h"
+#include "history_query.h"
+
+// Set by SIGHUP in watch mode; the loop reloads the config between refreshes
+static volatile sig_atomic_t reload_requested = 0;
+
+static void requestReload(int) {
+    reload_requested = 1;
+}
+
+// A running daemon's latest sample is as good as a new one and skips the
+// CPU measurement sleep and GPU probes; --fresh always samples locally
+static UtilizationInfo sampleUtilization(const Config& config, bool fresh) {
+    if (!fresh && !config.shm_name.empty()) {
+        UtilizationInfo util;
+        std::string reason;
+        if (readDaemonSnapshot(config.shm_name, DaemonConfig().pid_file, util, reason)) {
+            return util;
+        }
+    }
+    return getUtilizationInfo();
+}
+
+// One sample and the loaded plugins' numeric metrics, for the outputs
+// rendered from the registry (Prometheus, InfluxDB, JSON, CSV)
+static void recordMetrics(MetricRegistry& metrics, UtilizationMetrics& recorder,
+                          const UtilizationInfo& util, PluginManager& plugins) {
+    metrics.beginCycle();
+    recorder.record(metrics, util);
+    if (!plugins.getLoadedPlugins().empty()) {
+        recordPluginMetrics(metrics, plugins.collectAllMetrics());
+    }
+    metrics.endCycle();
+}
 
 int main(int argc, char* argv[]) {
     // Parse command line arguments
@@ -80,39 +123,193 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
-    // Handle daemon mode
-    if (hasFlag(args, "--daemon")) {
-        DaemonConfig daemon_cfg;
+    // Load configuration file
+    std::string config_path = getOptionValue(args, "--config");
+    Config config = loadConfig(config_path);
+    
+    // Replay a binary daemon log through the regular formatters
+    if (!args.empty() && args[0] == "replay") {
+        if (args.size() < 2 || args[1].empty() || args[1][0] == '-') {
+            std::cerr << "Usage: sysreport replay FILE [-f FORMAT] [--realtime]" << std::endl;
+            return 1;
+        }
         
-        // Get daemon options
-        std::string log_file = getOptionValue(args, "--daemon-log");
-        if (!log_file.empty()) {
-            daemon_cfg.log_file = log_file;
+        std::string format = getOptionValue(args, "-f");
+        if (format.empty()) format = getOptionValue(args, "--format");
+        if (format.empty()) format = "text";
+        if (format != "text" && format != "json" && format != "ndjson" && format != "csv" &&
+            format != "prometheus" && format != "influxdb") {
+            std::cerr << "Error: Invalid replay format '" << format
+                      << "'. Use text, json, ndjson, csv, prometheus or influxdb." << std::endl;
+            return 1;
         }
         
-        std::string interval_str = getOptionValue(args, "--daemon-interval");
-        if (!interval_str.empty()) {
+        DisplayOptions opts;
+        applyConfigToDisplayOptions(config, opts);
+        opts.cpu_only = hasFlag(args, "--cpu-only");
+        opts.memory_only = hasFlag(args, "--memory-only");
+        opts.disk_only = hasFlag(args, "--disk-only");
+        opts.network_only = hasFlag(args, "--network-only");
+        opts.process_only = hasFlag(args, "--process-only");
+        if (hasFlag(args, "--no-color")) opts.use_colors = false;
+        
+        return replaySampleLog(args[1], format, hasFlag(args, "--realtime"), opts);
+    }
+    
+    // Convert a binary daemon log or history store to Arrow IPC or Parquet,
+    // or describe a file
+    if (!args.empty() && args[0] == "export") {
+        std::string inspect_file = getOptionValue(args, "--inspect");
+        if (!inspect_file.empty()) {
+            return isHistoryStore(inspect_file) ? inspectHistoryStore(inspect_file)
+                                                : inspectColumnarFile(inspect_file);
+        }
+        
+        std::string out_file = getOptionValue(args, "-o");
+        if (out_file.empty()) out_file = getOptionValue(args, "--output");
+        if (args.size() < 2 || args[1].empty() || args[1][0] == '-' || out_file.empty()) {
+            std::cerr << "Usage: sysreport export FILE -o OUT [--format arrow|parquet] [--batch-rows N] [--step D]\n"
+                      << "       sysreport export --inspect FILE" << std::endl;
+            return 1;
+        }
+        
+        std::string format = getOptionValue(args, "--format");
+        if (format.empty()) format = columnarFormatFor(out_file);
+        if (format != "arrow" && format != "parquet") {
+            std::cerr << "Error: Invalid export format '" << format << "'. Use arrow or parquet." << std::endl;
+            return 1;
+        }
+        
+        size_t batch_rows = 4096;
+        std::string batch_str = getOptionValue(args, "--batch-rows");
+        if (!batch_str.empty()) {
             try {
-                daemon_cfg.interval_seconds = std::stoi(interval_str);
-            } catch (...) {}
+                long rows = std::stol(batch_str);
+                if (rows < 1) throw std::out_of_range("batch rows");
+                batch_rows = static_cast<size_t>(rows);
+            } catch (...) {
+                printError("Invalid batch size: " + batch_str);
+                return 1;
+            }
+        }
+        
+        int64_t step_ms = 0;
+        std::string step_str = getOptionValue(args, "--step");
+        if (!step_str.empty() && (!parseDuration(step_str, step_ms) || step_ms < 1000)) {
+            printError("Invalid step: " + step_str + " (e.g. 1m, at least 1s)");
+            return 1;
+        }
+        
+        if (isHistoryStore(args[1])) {
+            return exportHistoryStore(args[1], out_file, format, batch_rows, step_ms);
+        }
+        if (step_ms > 0) {
+            printError("--step needs a history store");
+            return 1;
+        }
+        return exportSampleLog(args[1], out_file, format, batch_rows);
+    }
+    
+    // Aggregate a range of the daemon's history store
+    if (!args.empty() && args[0] == "query") {
+        if (args.size() < 2 || args[1].empty() || args[1][0] == '-') {
+            std::cerr << "Usage: sysreport query 'AGG(SELECTOR)[RANGE] step D' [--store FILE]\n"
+                      << "                       [-f text|json|csv] [--threads N]\n"
+                      << "  e.g. sysreport query 'p95(cpu_usage_percent)[02:00..03:00]'\n"
+                      << "       sysreport query 'max(memory_usage_percent)[7d] step 1d'" << std::endl;
+            return 1;
+        }
+        
+        std::string store_file = getOptionValue(args, "--store");
+        if (store_file.empty()) store_file = config.history_store;
+        if (store_file.empty()) {
+            printError("No history store: set [daemon] history_store or pass --store FILE");
+            return 1;
+        }
+        
+        std::string format = getOptionValue(args, "-f");
+        if (format.empty()) format = getOptionValue(args, "--format");
+        if (format.empty()) format = "text";
+        if (format != "text" && format != "json" && format != "csv") {
+            std::cerr << "Error: Invalid query format '" << format << "'. Use text, json or csv." << std::endl;
+            return 1;
+        }
+        
+        unsigned threads = 0;
+        std::string threads_str = getOptionValue(args, "--threads");
+        if (!threads_str.empty()) {
+            try {
+                int count = std::stoi(threads_str);
+                if (count < 1) throw std::out_of_range("threads");
+                threads = static_cast<unsigned>(count);
+            } catch (...) {
+                printError("Invalid thread count: " + threads_str);
+                return 1;
+            }
         }
         
-        std::string webhook_url = getOptionValue(args, "--webhook");
-        if (!webhook_url.empty()) {
-            daemon_cfg.enable_webhooks = true;
-            daemon_cfg.webhook_url = webhook_url;
+        return queryHistoryStore(store_file, args[1], format, threads);
+    }
+    
+    // Handle daemon mode
+    if (hasFlag(args, "--daemon")) {
+        // The same check a SIGHUP reload applies: a config either runs or is refused
+        std::string config_error;
+        if (!validateConfig(config, config_error)) {
+            std::cerr << "Error: invalid configuration: " << config_error << std::endl;
+            return 1;
         }
         
-        // Determine export format
-        if (hasFlag(args, "--prometheus")) {
-            daemon_cfg.export_format = "prometheus";
-        } else if (hasFlag(args, "--influxdb")) {
-            daemon_cfg.export_format = "influxdb";
-        } else if (hasFlag(args, "-f") || hasFlag(args, "--format")) {
-            daemon_cfg.export_format = getOptionValue(args, "-f");
-            if (daemon_cfg.export_format.empty()) {
-                daemon_cfg.export_format = getOptionValue(args, "--format");
+        // Command-line options win over the config file, also after a reload
+        auto apply_cli = [&args](DaemonConfig& daemon_cfg) {
+            std::string log_file = getOptionValue(args, "--daemon-log");
+            if (!log_file.empty()) {
+                daemon_cfg.log_file = log_file;
+            }
+            
+            std::string interval_str = getOptionValue(args, "--daemon-interval");
+            if (!interval_str.empty()) {
+                try {
+                    double interval = std::stod(interval_str);
+                    if (interval > 0) {
+                        daemon_cfg.interval_seconds = interval;
+                    }
+                } catch (...) {}
+            }
+            
+            std::string webhook_url = getOptionValue(args, "--webhook");
+            if (!webhook_url.empty()) {
+                daemon_cfg.enable_webhooks = true;
+                daemon_cfg.webhook_url = webhook_url;
+            }
+            
+            std::string metrics_listen = getOptionValue(args, "--metrics-listen");
+            if (!metrics_listen.empty()) {
+                daemon_cfg.metrics_listen = metrics_listen;
+            }
+            
+            // Determine export format
+            if (hasFlag(args, "--prometheus")) {
+                daemon_cfg.export_format = "prometheus";
+            } else if (hasFlag(args, "--influxdb")) {
+                daemon_cfg.export_format = "influxdb";
+            } else if (hasFlag(args, "-f") || hasFlag(args, "--format")) {
+                daemon_cfg.export_format = getOptionValue(args, "-f");
+                if (daemon_cfg.export_format.empty()) {
+                    daemon_cfg.export_format = getOptionValue(args, "--format");
+                }
             }
+        };
+        
+        DaemonConfig daemon_cfg;
+        applyConfigToDaemonConfig(config, daemon_cfg);
+        apply_cli(daemon_cfg);
+        
+        // The daemon chdirs to /, so remember the config file by absolute path
+        std::string reload_path = config_path.empty() ? getDefaultConfigPath() : config_path;
+        char resolved[PATH_MAX];
+        if (!reload_path.empty() && realpath(reload_path.c_str(), resolved)) {
+            reload_path = resolved;
         }
         
         // Daemonize process
@@ -126,6 +323,10 @@ int main(int argc, char* argv[]) {
         
         // Start daemon
         DaemonMode daemon(daemon_cfg);
+        daemon.setConfigSource(reload_path, apply_cli);
+        if (!plugin_manager.getLoadedPlugins().empty()) {
+            daemon.setPluginManager(&plugin_manager);
+        }
         daemon.start();
         
         // Remove PID file on exit
@@ -134,17 +335,25 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
+    bool fresh = hasFlag(args, "--fresh");
+    MetricRegistry metrics;
+    UtilizationMetrics metric_recorder;
+    
     // Handle Prometheus export
     if (hasFlag(args, "--prometheus")) {
-        UtilizationInfo util = getUtilizationInfo();
-        std::cout << PrometheusExporter::exportMetrics(util);
+        recordMetrics(metrics, metric_recorder, sampleUtilization(config, fresh), plugin_manager);
+        std::string out;
+        PrometheusExporter::exportMetrics(metrics, out, true);
+        std::cout << out;
         return 0;
     }
     
     // Handle InfluxDB export
     if (hasFlag(args, "--influxdb")) {
-        UtilizationInfo util = getUtilizationInfo();
-        std::cout << InfluxDBExporter::exportMetrics(util);
+        recordMetrics(metrics, metric_recorder, sampleUtilization(config, fresh), plugin_manager);
+        std::string out;
+        InfluxDBExporter::exportMetrics(metrics, out, "sysreport", 0);
+        std::cout << out;
         return 0;
     }
     
@@ -170,10 +379,6 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
-    // Load configuration file
-    std::string config_path = getOptionValue(args, "--config");
-    Config config = loadConfig(config_path);
-    
     // Setup display options from config
     DisplayOptions opts;
     applyConfigToDisplayOptions(config, opts);
@@ -227,12 +432,17 @@ int main(int argc, char* argv[]) {
         opts.show_alerts = true;
     }
     
+    // Self-instrumentation
+    bool show_self_stats = hasFlag(args, "--self-stats");
+    
     // History options
     opts.show_history = hasFlag(args, "--history");
     opts.show_baseline_comparison = hasFlag(args, "--baseline");
     
     std::string save_baseline_file = getOptionValue(args, "--save-baseline");
+    std::string export_history_file = getOptionValue(args, "--export-history");
     std::string load_baseline_file = getOptionValue(args, "--load-baseline");
+    std::string history_range = getOptionValue(args, "--history-range");
     
     // Get format
     opts.format = getOptionValue(args, "-f");
@@ -244,8 +454,9 @@ int main(int argc, char* argv[]) {
     }
     
     // Validate format
-    if (opts.format != "text" && opts.format != "json" && opts.format != "csv") {
-        printError("Invalid format: " + opts.format + ". Use text, json, or csv.");
+    if (opts.format != "text" && opts.format != "json" && opts.format != "ndjson" &&
+        opts.format != "csv") {
+        printError("Invalid format: " + opts.format + ". Use text, json, ndjson, or csv.");
         return 1;
     }
     
@@ -295,9 +506,64 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    // Seed the sparklines with the daemon's stored history: the range as
+    // 20 bucket averages from the rollup tier that fits
+    if (!history_range.empty()) {
+        int64_t range_ms = 0;
+        std::string store_file = getOptionValue(args, "--history-store");
+        if (store_file.empty()) store_file = config.history_store;
+        if (!parseDuration(history_range, range_ms) || range_ms < 1000) {
+            printError("Invalid history range: " + history_range + " (e.g. 1h, 7d)");
+            return 1;
+        }
+        if (store_file.empty()) {
+            printError("--history-range needs [daemon] history_store or --history-store FILE");
+            return 1;
+        }
+        std::string error;
+        if (!history.loadFromStore(store_file, range_ms, 20, error)) {
+            std::cerr << "Warning: Could not read history from " << store_file << ": " << error << "\n";
+        }
+        opts.show_history = true;
+    }
+    
+    // SIGHUP re-reads the config file; no SA_RESTART so it also cuts the
+    // sleep short and the new settings show up immediately
+    if (watch_mode) {
+        struct sigaction sa = {};
+        sa.sa_handler = requestReload;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGHUP, &sa, nullptr);
+    }
+    
     // Main loop
     int iteration = 0;
+    std::string output;   // Reused between refreshes
     do {
+        if (reload_requested) {
+            reload_requested = 0;
+            std::string error;
+            if (reloadConfig(config_path, config, error)) {
+                // Only settings not pinned by a command-line flag follow the file
+                if (interval_str.empty()) interval = config.default_interval;
+                if (opts.format == "text" && !hasFlag(args, "--no-color") &&
+                    !hasFlag(args, "-c") && !hasFlag(args, "--color")) {
+                    opts.use_colors = config.use_colors;
+                }
+                if (!hasFlag(args, "-p") && !hasFlag(args, "--progress")) {
+                    opts.show_progress_bars = config.show_progress_bars;
+                }
+                if (!hasFlag(args, "-t") && !hasFlag(args, "--timestamp")) {
+                    opts.show_timestamp = config.show_timestamp;
+                }
+                if (!hasFlag(args, "--alerts")) {
+                    opts.show_alerts = config.show_alerts;
+                }
+            } else {
+                std::cerr << "Config reload failed, keeping current settings: " << error << std::endl;
+            }
+        }
+        
         // Clear screen in watch mode (text format only)
         if (watch_mode && opts.format == "text") {
             std::cout << "\033[2J\033[H"; // Clear screen and move cursor to top
@@ -312,48 +578,67 @@ int main(int argc, char* argv[]) {
         }
         
         if (opts.show_dynamic) {
-            util = getUtilizationInfo();
+            util = sampleUtilization(config, fresh);
         }
         
-        // Create snapshot for history
-        if (opts.show_history || opts.show_baseline_comparison || !save_baseline_file.empty()) {
-            MetricSnapshot snapshot;
-            snapshot.timestamp = std::chrono::steady_clock::now();
-            snapshot.cpu_percent = util.cpu_percent;
-            snapshot.ram_percent = util.ram_percent;
-            snapshot.swap_percent = util.swap_percent;
-            
-            // GPU if available
-            if (!util.gpus.empty() && util.gpus[0].available) {
-                snapshot.gpu_percent = util.gpus[0].utilization_percent;
-                snapshot.gpu_temp = util.gpus[0].temperature;
-            } else {
-                snapshot.gpu_percent = 0.0;
-                snapshot.gpu_temp = 0.0;
-            }
-            
-            history.addSnapshot(snapshot);
+        // Record the sample into history
+        if (opts.show_history || opts.show_baseline_comparison || !save_baseline_file.empty() ||
+            !export_history_file.empty()) {
+            history.addUtilization(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count(), util);
             
             // Save baseline on first iteration if requested
             if (!save_baseline_file.empty() && iteration == 0) {
-                history.setBaseline(snapshot);
+                history.setBaseline(history.getLatest());
+            }
+            
+            // Rewritten every sample so a stopped watch leaves a complete file
+            if (!export_history_file.empty()) {
+                std::string error;
+                if (!history.exportColumnar(export_history_file,
+                                            columnarFormatFor(export_history_file), error)) {
+                    printError("Cannot export history to " + export_history_file + ": " + error);
+                    return 1;
+                }
             }
         }
         
         // Store history in opts for display
         opts.metric_history = &history;
         
+        // JSON and CSV carry plugin metrics in the registry; text appends them
+        bool json = opts.format == "json" || opts.format == "ndjson";
+        bool structured = json || opts.format == "csv";
+        if (structured && opts.show_dynamic) {
+            recordMetrics(metrics, metric_recorder, util, plugin_manager);
+            opts.metrics = &metrics;
+        }
+        
         // Format output
-        std::string output = formatOutput(hw, util, opts);
+        if (json) {
+            output.clear();
+            appendJson(output, hw, util, opts);
+        } else {
+            output = formatOutput(hw, util, opts);
+        }
         
         // Add plugin metrics if any plugins are loaded
-        if (plugin_manager.getLoadedPlugins().size() > 0) {
+        if (!structured && plugin_manager.getLoadedPlugins().size() > 0) {
             output += plugin_manager.formatPluginMetrics(opts.use_colors);
         }
         
-        // Write to file or stdout
+        // Append sysreport's own timings (text only; other formats go to stderr)
+        if (show_self_stats) {
+            if (opts.format == "text") {
+                output += "\n" + SelfStats::formatText(opts.use_colors);
+            } else {
+                std::cerr << SelfStats::formatText(false);
+            }
+        }
+        
+        // Write to file or stdout; ndjson files collect one line per sample
         if (!output_file.empty()) {
-            std::ofstream file(output_file);
+            std::ofstream file(output_file, opts.format == "ndjson" ? std::ios::app : std::ios::trunc);
             if (!file) {
                 printError("Cannot write to file: " + output_file);
                 return 1;
@@ -366,6 +651,8 @@ int main(int argc, char* argv[]) {
             }
         } else {
             std::cout << output;
+            // Each sample reaches a pipe as soon as it is taken
+            if (watch_mode) std::cout.flush();
         }
         
         // Sleep in watch mode
@@ -0,0 +1,433 @@
+#include "metric_registry.h"
+#include "plugin.h"
+#include <cctype>
+#include <cstdlib>
+
+const uint32_t MetricRegistry::NO_LABELS;
+const uint32_t MetricRegistry::NONE;
+
+MetricRegistry::MetricRegistry() : cycle(0), epoch(0), next_id(0) {
+    label_sets.push_back(MetricLabels());
+    label_index[""] = NO_LABELS;
+}
+
+uint32_t MetricRegistry::family(const std::string& name, MetricType type, const std::string& unit,
+                                const std::string& help, const std::string& group,
+                                const std::string& field, bool integral,
+                                FieldFormat field_format) {
+    auto it = family_index.find(name);
+    if (it != family_index.end()) return it->second;
+    MetricFamily f;
+    f.name = name;
+    f.type = type;
+    f.unit = unit;
+    f.help = help;
+    f.group = group;
+    f.field = field;
+    f.integral = integral;
+    f.field_format = field_format;
+    uint32_t id = static_cast<uint32_t>(families.size());
+    families.push_back(f);
+    family_index[name] = id;
+    return id;
+}
+
+// Index key of a label set: every name and value NUL-terminated
+static void encodeLabels(const MetricLabels& set, std::string& out) {
+    out.clear();
+    for (const auto& label : set) {
+        out += label.first;
+        out += '\0';
+        out += label.second;
+        out += '\0';
+    }
+}
+
+uint32_t MetricRegistry::labels(const MetricLabels& set) {
+    encodeLabels(set, scratch);
+    auto it = label_index.find(scratch);
+    if (it != label_index.end()) return it->second;
+    uint32_t id = static_cast<uint32_t>(label_sets.size());
+    label_sets.push_back(set);
+    label_index[scratch] = id;
+    return id;
+}
+
+uint32_t MetricRegistry::series(uint32_t family, uint32_t labels) {
+    uint64_t key = static_cast<uint64_t>(family) << 32 | labels;
+    auto it = series_index.find(key);
+    if (it != series_index.end()) return it->second;
+    MetricSeries s = {next_id++, family, labels, 0.0, 0};
+    uint32_t handle = static_cast<uint32_t>(all_series.size());
+    all_series.push_back(s);
+    series_index[key] = handle;
+    families[family].series.push_back(handle);
+    return handle;
+}
+
+uint32_t MetricRegistry::findSeries(uint32_t family, uint32_t labels) const {
+    auto it = series_index.find(static_cast<uint64_t>(family) << 32 | labels);
+    return it == series_index.end() ? NONE : it->second;
+}
+
+void MetricRegistry::forEachPoint(
+    const std::function<void(const std::string& group, const MetricLabels& labels,
+                             const std::vector<uint32_t>& series)>& fn) const {
+    // Groups in the order their first family was registered
+    std::vector<const std::string*> groups;
+    for (const auto& f : families) {
+        bool known = false;
+        for (const std::string* g : groups) known = known || *g == f.group;
+        if (!known) groups.push_back(&f.group);
+    }
+
+    std::vector<uint32_t> group_families;
+    std::vector<uint32_t> label_order;
+    std::vector<char> seen;
+    std::vector<uint32_t> fields;
+    for (const std::string* group : groups) {
+        group_families.clear();
+        label_order.clear();
+        seen.assign(label_sets.size(), 0);
+        for (uint32_t f = 0; f < families.size(); f++) {
+            if (families[f].group != *group) continue;
+            group_families.push_back(f);
+            for (uint32_t handle : families[f].series) {
+                uint32_t labels = all_series[handle].labels;
+                if (isLive(handle) && !seen[labels]) {
+                    seen[labels] = 1;
+                    label_order.push_back(labels);
+                }
+            }
+        }
+        for (uint32_t labels : label_order) {
+            fields.clear();
+            for (uint32_t f : group_families) {
+                uint32_t handle = findSeries(f, labels);
+                if (handle != NONE && isLive(handle)) fields.push_back(handle);
+            }
+            fn(*group, label_sets[labels], fields);
+        }
+    }
+}
+
+void MetricRegistry::endCycle() {
+    size_t live = 0;
+    for (const auto& s : all_series) {
+        if (s.updated == cycle) live++;
+    }
+    size_t dead = all_series.size() - live;
+    // Processes come and go every cycle; don't let their series pile up
+    if (dead > 64 && dead > live) compact();
+}
+
+void MetricRegistry::compact() {
+    std::vector<uint32_t> label_map(label_sets.size(), NONE);
+    std::vector<MetricLabels> kept_labels;
+    kept_labels.push_back(MetricLabels());
+    label_map[NO_LABELS] = NO_LABELS;
+    label_index.clear();
+    label_index[""] = NO_LABELS;
+
+    std::vector<MetricSeries> kept_series;
+    series_index.clear();
+    for (auto& f : families) f.series.clear();
+
+    // Series in the old handle order, so each family keeps its ordering
+    for (const auto& s : all_series) {
+        if (s.updated != cycle) continue;
+        if (label_map[s.labels] == NONE) {
+            label_map[s.labels] = static_cast<uint32_t>(kept_labels.size());
+            kept_labels.push_back(label_sets[s.labels]);
+        }
+        MetricSeries moved = s;
+        moved.labels = label_map[s.labels];
+        uint32_t handle = static_cast<uint32_t>(kept_series.size());
+        kept_series.push_back(moved);
+        series_index[static_cast<uint64_t>(moved.family) << 32 | moved.labels] = handle;
+        families[moved.family].series.push_back(handle);
+    }
+    label_sets.swap(kept_labels);
+    all_series.swap(kept_series);
+    for (size_t i = 1; i < label_sets.size(); i++) {
+        encodeLabels(label_sets[i], scratch);
+        label_index[scratch] = static_cast<uint32_t>(i);
+    }
+    epoch++;
+}
+
+// UtilizationInfo families, in export order
+enum MetricKind {
+    SCALAR,
+    CORE,
+    DISK,
+    NET,
+    GPU,
+    TEMP,
+    FAN,
+    PROCESS
+};
+
+// Scalar families, in the order they appear in the table below
+enum ScalarMetric {
+    CPU_USAGE,
+    LOAD_1,
+    LOAD_5,
+    LOAD_15,
+    UPTIME,
+    MEMORY_USAGE,
+    MEMORY_USED,
+    MEMORY_AVAILABLE,
+    SWAP_USAGE,
+    SWAP_USED,
+    SWAP_AVAILABLE,
+    BATTERY_CHARGE,
+    BATTERY_CHARGING,
+    BATTERY_CAPACITY,
+    BATTERY_TIME,
+    SCALAR_COUNT
+};
+
+struct FamilySpec {
+    MetricKind kind;
+    const char* name;
+    MetricType type;
+    const char* unit;
+    const char* help;
+    const char* group;
+    const char* field;
+    bool integral;
+    FieldFormat field_format = FieldFormat::VALUE;
+};
+
+static const FamilySpec UTILIZATION_FAMILIES[] = {
+    {SCALAR, "cpu_usage_percent", MetricType::GAUGE, "percent", "CPU usage percentage", "cpu", "cpu_percent", false},
+    {SCALAR, "cpu_load_average_1m", MetricType::GAUGE, "", "Load average over 1 minute", "cpu", "load_1m", false},
+    {SCALAR, "cpu_load_average_5m", MetricType::GAUGE, "", "Load average over 5 minutes", "cpu", "load_5m", false},
+    {SCALAR, "cpu_load_average_15m", MetricType::GAUGE, "", "Load average over 15 minutes", "cpu", "load_15m", false},
+    {CORE, "cpu_core_usage_percent", MetricType::GAUGE, "percent", "Per-core CPU usage percentage", "cpu", "usage_percent", false},
+    {SCALAR, "system_uptime_seconds", MetricType::GAUGE, "seconds", "Seconds since boot", "system", "uptime_seconds", true},
+    {SCALAR, "memory_usage_percent", MetricType::GAUGE, "percent", "Memory usage percentage", "memory", "usage_percent", false},
+    {SCALAR, "memory_used_bytes", MetricType::GAUGE, "bytes", "Memory used in bytes", "memory", "used_bytes", true},
+    {SCALAR, "memory_available_bytes", MetricType::GAUGE, "bytes", "Memory available in bytes", "memory", "available_bytes", true},
+    {SCALAR, "swap_usage_percent", MetricType::GAUGE, "percent", "Swap usage percentage", "swap", "usage_percent", false},
+    {SCALAR, "swap_used_bytes", MetricType::GAUGE, "bytes", "Swap used in bytes", "swap", "used_bytes", true},
+    {SCALAR, "swap_available_bytes", MetricType::GAUGE, "bytes", "Swap available in bytes", "swap", "available_bytes", true},
+    {DISK, "disk_usage_percent", MetricType::GAUGE, "percent", "Disk usage percentage", "disk", "usage_percent", false},
+    {DISK, "disk_used_bytes", MetricType::GAUGE, "bytes", "Disk space used in bytes", "disk", "used_bytes", true},
+    {DISK, "disk_available_bytes", MetricType::GAUGE, "bytes", "Disk space available in bytes", "disk", "available_bytes", true},
+    {DISK, "disk_total_bytes", MetricType::GAUGE, "bytes", "Disk size in bytes", "disk", "total_bytes", true},
+    {NET, "network_rx_bytes_total", MetricType::COUNTER, "bytes", "Network received bytes", "network", "rx_bytes", true},
+    {NET, "network_tx_bytes_total", MetricType::COUNTER, "bytes", "Network transmitted bytes", "network", "tx_bytes", true},
+    {NET, "network_rx_mbps", MetricType::GAUGE, "mbps", "Network receive rate in megabits per second", "network", "rx_mbps", false},
+    {NET, "network_tx_mbps", MetricType::GAUGE, "mbps", "Network transmit rate in megabits per second", "network", "tx_mbps", false},
+    {GPU, "gpu_utilization_percent", MetricType::GAUGE, "percent", "GPU utilization percentage", "gpu", "utilization_percent", false},
+    {GPU, "gpu_temperature_celsius", MetricType::GAUGE, "celsius", "GPU temperature in celsius", "gpu", "temperature", false},
+    {GPU, "gpu_memory_used_bytes", MetricType::GAUGE, "bytes", "GPU memory used in bytes", "gpu", "memory_used_mb", true, FieldFormat::MEGABYTES},
+    {GPU, "gpu_memory_total_bytes", MetricType::GAUGE, "bytes", "GPU memory size in bytes", "gpu", "memory_total_mb", true, FieldFormat::MEGABYTES},
+    {SCALAR, "battery_charge_percent", MetricType::GAUGE, "percent", "Battery charge percentage", "battery", "charge_percent", false},
+    {SCALAR, "battery_charging", MetricType::GAUGE, "", "Battery charging status (1=charging, 0=discharging)", "battery", "charging", true, FieldFormat::BOOLEAN},
+    {SCALAR, "battery_capacity_percent", MetricType::GAUGE, "percent", "Battery full capacity relative to its design", "battery", "capacity_percent", false},
+    {SCALAR, "battery_time_remaining_seconds", MetricType::GAUGE, "seconds", "Estimated battery time remaining", "battery", "time_remaining_seconds", true},
+    {TEMP, "cpu_temperature_celsius", MetricType::GAUGE, "celsius", "CPU temperature in celsius", "temperature", "celsius", false},
+    {FAN, "fan_speed_rpm", MetricType::GAUGE, "rpm", "Fan speed in revolutions per minute", "fan", "speed_rpm", true},
+    {PROCESS, "process_memory_bytes", MetricType::GAUGE, "bytes", "Resident memory of the top processes", "process", "memory_bytes", true},
+    {PROCESS, "process_cpu_percent", MetricType::GAUGE, "percent", "CPU usage of the top processes", "process", "cpu_percent", false},
+};
+
+static const char* const CORE_LABELS[] = {"core"};
+static const char* const DISK_LABELS[] = {"mount", "device"};
+static const char* const NET_LABELS[] = {"interface"};
+static const char* const GPU_LABELS[] = {"gpu", "name", "vendor"};
+static const char* const TEMP_LABELS[] = {"sensor"};
+static const char* const FAN_LABELS[] = {"fan"};
+static const char* const PROCESS_LABELS[] = {"pid", "name"};
+
+static const double MB = 1024.0 * 1024.0;
+static const double GB = 1024.0 * 1024.0 * 1024.0;
+
+UtilizationMetrics::UtilizationMetrics() : epoch(0), registered(false), registry(nullptr) {
+}
+
+void UtilizationMetrics::registerFamilies(MetricRegistry& metrics) {
+    scalar_families.clear();
+    std::vector<uint32_t>* by_kind[] = {&scalar_families, &core_families, &disk_families,
+                                        &net_families, &gpu_families, &temp_families,
+                                        &fan_families, &process_families};
+    for (auto* families : by_kind) families->clear();
+    for (const FamilySpec& spec : UTILIZATION_FAMILIES) {
+        uint32_t id = metrics.family(spec.name, spec.type, spec.unit, spec.help,
+                                     spec.group, spec.field, spec.integral, spec.field_format);
+        by_kind[spec.kind]->push_back(id);
+    }
+    registered = true;
+}
+
+uint32_t UtilizationMetrics::scalar(size_t index) {
+    if (scalar_handles[index] == MetricRegistry::NONE) {
+        scalar_handles[index] = registry->series(scalar_families[index]);
+    }
+    return scalar_handles[index];
+}
+
+UtilizationMetrics::Entity& UtilizationMetrics::entity(std::vector<Entity>& slots, size_t index,
+                                                       const std::vector<uint32_t>& families,
+                                                       const char* const* names) {
+    if (slots.size() <= index) slots.resize(index + 1);
+    Entity& e = slots[index];
+    if (e.handles.empty() || e.key != key) {
+        MetricLabels set;
+        for (size_t i = 0; i < key.size(); i++) {
+            set.emplace_back(names[i], key[i]);
+        }
+        uint32_t labels = registry->labels(set);
+        e.handles.clear();
+        for (uint32_t family : families) {
+            e.handles.push_back(registry->series(family, labels));
+        }
+        e.key = key;
+    }
+    return e;
+}
+
+void UtilizationMetrics::record(MetricRegistry& metrics, const UtilizationInfo& util) {
+    // Handles are only good for the registry and epoch they came from
+    if (registry != &metrics || !registered) {
+        registry = &metrics;
+        registerFamilies(metrics);
+        epoch = metrics.getEpoch() + 1;
+    }
+    if (epoch != metrics.getEpoch()) {
+        epoch = metrics.getEpoch();
+        scalar_handles.assign(SCALAR_COUNT, MetricRegistry::NONE);
+        for (auto* slots : {&cores, &disks, &nets, &gpus, &temps, &fans, &processes}) {
+            slots->clear();
+        }
+    }
+
+    metrics.set(scalar(CPU_USAGE), util.cpu_percent);
+    metrics.set(scalar(LOAD_1), util.load_avg_1);
+    metrics.set(scalar(LOAD_5), util.load_avg_5);
+    metrics.set(scalar(LOAD_15), util.load_avg_15);
+    metrics.set(scalar(UPTIME), util.uptime_seconds);
+    metrics.set(scalar(MEMORY_USAGE), util.ram_percent);
+    metrics.set(scalar(MEMORY_USED), util.used_ram_mb * MB);
+    metrics.set(scalar(MEMORY_AVAILABLE), util.available_ram_mb * MB);
+
+    // Swap only when the host has any
+    if (util.used_swap_mb + util.available_swap_mb > 0) {
+        metrics.set(scalar(SWAP_USAGE), util.swap_percent);
+        metrics.set(scalar(SWAP_USED), util.used_swap_mb * MB);
+        metrics.set(scalar(SWAP_AVAILABLE), util.available_swap_mb * MB);
+    }
+
+    key.resize(1);
+    for (size_t i = 0; i < util.cpu_per_core.size(); i++) {
+        key[0] = std::to_string(i);
+        metrics.set(entity(cores, i, core_families, CORE_LABELS).handles[0], util.cpu_per_core[i]);
+    }
+
+    key.resize(2);
+    for (size_t i = 0; i < util.disks.size(); i++) {
+        const DiskInfo& disk = util.disks[i];
+        key[0] = disk.mount_point;
+        key[1] = disk.device;
+        const Entity& e = entity(disks, i, disk_families, DISK_LABELS);
+        metrics.set(e.handles[0], disk.percent);
+        metrics.set(e.handles[1], disk.used_gb * GB);
+        metrics.set(e.handles[2], disk.available_gb * GB);
+        metrics.set(e.handles[3], disk.total_gb * GB);
+    }
+
+    key.resize(1);
+    for (size_t i = 0; i < util.network.size(); i++) {
+        const NetworkInfo& net = util.network[i];
+        key[0] = net.interface;
+        const Entity& e = entity(nets, i, net_families, NET_LABELS);
+        metrics.set(e.handles[0], net.rx_bytes);
+        metrics.set(e.handles[1], net.tx_bytes);
+        metrics.set(e.handles[2], net.rx_mbps);
+        metrics.set(e.handles[3], net.tx_mbps);
+    }
+
+    key.resize(3);
+    for (size_t i = 0; i < util.gpus.size(); i++) {
+        const GPUInfo& gpu = util.gpus[i];
+        if (!gpu.available) continue;
+        key[0] = std::to_string(i);
+        key[1] = gpu.name;
+        key[2] = gpu.vendor;
+        const Entity& e = entity(gpus, i, gpu_families, GPU_LABELS);
+        metrics.set(e.handles[0], gpu.utilization_percent);
+        metrics.set(e.handles[1], gpu.temperature);
+        metrics.set(e.handles[2], gpu.memory_used_mb * MB);
+        metrics.set(e.handles[3], gpu.memory_total_mb * MB);
+    }
+
+    if (util.battery.present) {
+        metrics.set(scalar(BATTERY_CHARGE), util.battery.percent);
+        metrics.set(scalar(BATTERY_CHARGING), util.battery.charging ? 1 : 0);
+        metrics.set(scalar(BATTERY_CAPACITY), util.battery.capacity_percent);
+        if (util.battery.time_remaining_minutes >= 0) {
+            metrics.set(scalar(BATTERY_TIME), util.battery.time_remaining_minutes * 60.0);
+        }
+    }
+
+    key.resize(1);
+    for (size_t i = 0; i < util.temperatures.size(); i++) {
+        key[0] = std::to_string(i);
+        metrics.set(entity(temps, i, temp_families, TEMP_LABELS).handles[0], util.temperatures[i]);
+    }
+
+    for (size_t i = 0; i < util.fans.size(); i++) {
+        key[0] = util.fans[i].label;
+        metrics.set(entity(fans, i, fan_families, FAN_LABELS).handles[0], util.fans[i].rpm);
+    }
+
+    key.resize(2);
+    for (size_t i = 0; i < util.top_processes.size(); i++) {
+        const ProcessInfo& proc = util.top_processes[i];
+        key[0] = std::to_string(proc.pid);
+        key[1] = proc.name;
+        const Entity& e = entity(processes, i, process_families, PROCESS_LABELS);
+        metrics.set(e.handles[0], proc.mem_mb * MB);
+        metrics.set(e.handles[1], proc.cpu_percent);
+    }
+}
+
+// Lowercase [a-z0-9_], like the built-in names
+static std::string metricName(const std::string& name) {
+    std::string out;
+    for (unsigned char c : name) {
+        out += isalnum(c) ? static_cast<char>(tolower(c)) : '_';
+    }
+    return out;
+}
+
+void recordPluginMetrics(MetricRegistry& metrics,
+                         const std::map<std::string, std::vector<MetricData>>& plugin_metrics) {
+    for (const auto& plugin : plugin_metrics) {
+        uint32_t labels = metrics.labels({{"plugin", plugin.first}});
+        for (const auto& metric : plugin.second) {
+            const char* begin = metric.value.c_str();
+            char* end = nullptr;
+            double value = strtod(begin, &end);
+            while (end && isspace(static_cast<unsigned char>(*end))) end++;
+            if (end == begin || *end != '\0') continue;  // Not (only) a number
+            std::string field = metricName(metric.name);
+            uint32_t family = metrics.family("plugin_" + field, MetricType::GAUGE, metric.unit,
+                                             metric.description.empty() ? metric.name : metric.description,
+                                             "plugin", field);
+            metrics.set(metrics.series(family, labels), value);
+        }
+    }
+}
+
+const MetricRegistry& utilizationRegistry(const UtilizationInfo& util) {
+    static thread_local MetricRegistry metrics;
+    static thread_local UtilizationMetrics recorder;
+    metrics.beginCycle();
+    recorder.record(metrics, util);
+    metrics.endCycle();
+    return metrics;
+}
@@ -0,0 +1,460 @@
+#include "metrics_server.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+#include <zlib.h>
+
+static const char* CONTENT_TYPE_METRICS = "text/plain; version=0.0.4; charset=utf-8";
+static const char* CONTENT_TYPE_TEXT = "text/plain; charset=utf-8";
+
+static const std::string INDEX_BODY = "sysreport exporter\nMetrics are served at /metrics\n";
+static const std::string NOT_FOUND_BODY = "Not found\n";
+static const std::string NOT_READY_BODY = "No metrics collected yet\n";
+static const std::string BAD_REQUEST_BODY = "Bad request\n";
+static const std::string NOT_ALLOWED_BODY = "Method not allowed\n";
+static const std::string TOO_LARGE_BODY = "Request header too large\n";
+
+static long monotonicSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static std::string toLower(std::string str) {
+    std::transform(str.begin(), str.end(), str.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return str;
+}
+
+static std::string trimSpaces(const std::string& str) {
+    size_t first = str.find_first_not_of(" \t");
+    if (first == std::string::npos) return "";
+    size_t last = str.find_last_not_of(" \t");
+    return str.substr(first, last - first + 1);
+}
+
+bool gzipCompress(const std::string& input, std::string& output, int level) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // 15 window bits + 16 selects the gzip wrapper
+    if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    output.resize(deflateBound(&zs, input.size()));
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    zs.avail_in = input.size();
+    zs.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    zs.avail_out = output.size();
+
+    int ret = deflate(&zs, Z_FINISH);
+    output.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+MetricsServer::MetricsServer(const std::string& listen_address)
+    : address(listen_address), listen_fd(-1), epoll_fd(-1), wake_fd(-1), running(false) {
+}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start() {
+    if (running) return false;
+
+    // Split "host:port"; an empty host or "*" binds every address
+    std::string host, port;
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos) {
+        port = address;
+    } else {
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+    }
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    if (host == "*") host.clear();
+    if (port.empty()) return false;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0) {
+        return false;
+    }
+
+    for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 128) == 0) {
+            listen_fd = fd;
+            break;
+        }
+        close(fd);
+    }
+    freeaddrinfo(result);
+    if (listen_fd < 0) return false;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0) {
+        stop();
+        return false;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+    ev.data.fd = wake_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+
+    running = true;
+    worker = std::thread(&MetricsServer::serve, this);
+    return true;
+}
+
+void MetricsServer::stop() {
+    if (running.exchange(false)) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    for (auto& entry : connections) {
+        close(entry.first);
+    }
+    connections.clear();
+
+    if (listen_fd >= 0) close(listen_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+    if (wake_fd >= 0) close(wake_fd);
+    listen_fd = epoll_fd = wake_fd = -1;
+}
+
+void MetricsServer::publish(const std::string& body) {
+    auto next = std::make_shared<MetricsPayload>();
+    next->body = body;
+    if (!gzipCompress(next->body, next->gzip_body)) {
+        next->gzip_body.clear();
+    }
+    std::atomic_store(&payload, std::shared_ptr<const MetricsPayload>(std::move(next)));
+}
+
+void MetricsServer::serve() {
+    std::vector<struct epoll_event> events(64);
+    long last_sweep = monotonicSeconds();
+
+    while (running) {
+        int n = epoll_wait(epoll_fd, events.data(), events.size(), 1000);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == wake_fd) {
+                continue;
+            }
+            if (fd == listen_fd) {
+                acceptConnections();
+                continue;
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                closeConnection(fd);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                handleWritable(fd);
+            }
+            if ((events[i].events & EPOLLIN) && connections.count(fd)) {
+                handleReadable(fd);
+            }
+        }
+
+        long now = monotonicSeconds();
+        if (now != last_sweep) {
+            expireIdle(now);
+            last_sweep = now;
+        }
+    }
+}
+
+void MetricsServer::acceptConnections() {
+    for (;;) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        if (connections.size() >= MAX_CONNECTIONS) {
+            close(fd);
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            continue;
+        }
+
+        Connection& conn = connections[fd];
+        conn.body = nullptr;
+        conn.sent = 0;
+        conn.close_after = false;
+        conn.last_active = monotonicSeconds();
+    }
+}
+
+void MetricsServer::handleReadable(int fd) {
+    Connection& conn = connections[fd];
+    char buf[4096];
+
+    for (;;) {
+        ssize_t r = read(fd, buf, sizeof(buf));
+        if (r > 0) {
+            conn.in.append(buf, r);
+            if (conn.in.size() > MAX_REQUEST_BYTES) break;
+            continue;
+        }
+        if (r == 0) {
+            // Peer closed; finish anything already queued then drop
+            conn.close_after = true;
+            break;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        closeConnection(fd);
+        return;
+    }
+
+    conn.last_active = monotonicSeconds();
+    if (!processRequests(fd, conn)) {
+        closeConnection(fd);
+    }
+}
+
+void MetricsServer::handleWritable(int fd) {
+    auto it = connections.find(fd);
+    if (it == connections.end()) return;
+
+    if (!flush(fd, it->second)) {
+        closeConnection(fd);
+        return;
+    }
+    // Output drained; continue with any pipelined requests
+    if (it->second.header.empty() && !processRequests(fd, it->second)) {
+        closeConnection(fd);
+    }
+}
+
+// Returns false when the connection should be closed
+bool MetricsServer::processRequests(int fd, Connection& conn) {
+    while (conn.header.empty()) {
+        size_t end = conn.in.find("\r\n\r\n");
+        if (end == std::string::npos) {
+            if (conn.in.size() > MAX_REQUEST_BYTES) {
+                conn.close_after = true;
+                queueResponse(conn, 431, "Request Header Fields Too Large", false, false,
+                              CONTENT_TYPE_TEXT, &TOO_LARGE_BODY);
+                if (!flush(fd, conn)) return false;
+                break;
+            }
+            return !conn.close_after;
+        }
+
+        std::string head = conn.in.substr(0, end);
+        conn.in.erase(0, end + 4);
+
+        // Request line
+        size_t line_end = head.find("\r\n");
+        std::string request_line = head.substr(0, line_end);
+        size_t sp1 = request_line.find(' ');
+        size_t sp2 = sp1 == std::string::npos ? std::string::npos : request_line.find(' ', sp1 + 1);
+        if (sp1 == std::string::npos || sp2 == std::string::npos) {
+            conn.close_after = true;
+            queueResponse(conn, 400, "Bad Request", false, false, CONTENT_TYPE_TEXT, &BAD_REQUEST_BODY);
+            if (!flush(fd, conn)) return false;
+            break;
+        }
+        std::string method = request_line.substr(0, sp1);
+        std::string target = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+        std::string version = request_line.substr(sp2 + 1);
+
+        // Headers we care about
+        bool keep_alive = (version == "HTTP/1.1");
+        bool accepts_gzip = false;
+        size_t pos = line_end == std::string::npos ? head.size() : line_end + 2;
+        while (pos < head.size()) {
+            size_t next = head.find("\r\n", pos);
+            if (next == std::string::npos) next = head.size();
+            std::string line = head.substr(pos, next - pos);
+            pos = next + 2;
+
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            std::string name = toLower(trimSpaces(line.substr(0, colon)));
+            std::string value = toLower(trimSpaces(line.substr(colon + 1)));
+
+            if (name == "connection") {
+                if (value.find("close") != std::string::npos) keep_alive = false;
+                else if (value.find("keep-alive") != std::string::npos) keep_alive = true;
+            } else if (name == "accept-encoding") {
+                accepts_gzip = value.find("gzip") != std::string::npos &&
+                               value.find("gzip;q=0") == std::string::npos;
+            } else if (name == "content-length" && value != "0") {
+                // Request bodies are not supported; we cannot resync the stream
+                keep_alive = false;
+            }
+        }
+        conn.close_after = conn.close_after || !keep_alive;
+
+        size_t query = target.find('?');
+        std::string path = target.substr(0, query);
+        bool head_only = (method == "HEAD");
+
+        if (method != "GET" && !head_only) {
+            conn.close_after = true;
+            queueResponse(conn, 405, "Method Not Allowed", false, false, CONTENT_TYPE_TEXT, &NOT_ALLOWED_BODY);
+        } else if (path == "/metrics") {
+            std::shared_ptr<const MetricsPayload> current = std::atomic_load(&payload);
+            if (!current) {
+                queueResponse(conn, 503, "Service Unavailable", head_only, false,
+                              CONTENT_TYPE_TEXT, &NOT_READY_BODY);
+            } else {
+                bool use_gzip = accepts_gzip && !current->gzip_body.empty();
+                conn.payload = current;
+                queueResponse(conn, 200, "OK", head_only, use_gzip, CONTENT_TYPE_METRICS,
+                              use_gzip ? &current->gzip_body : &current->body);
+            }
+        } else if (path == "/") {
+            queueResponse(conn, 200, "OK", head_only, false, CONTENT_TYPE_TEXT, &INDEX_BODY);
+        } else {
+            queueResponse(conn, 404, "Not Found", head_only, false, CONTENT_TYPE_TEXT, &NOT_FOUND_BODY);
+        }
+
+        if (!flush(fd, conn)) return false;
+        if (!conn.header.empty()) break;  // Socket full; resume on EPOLLOUT
+        if (conn.close_after) return false;
+    }
+
+    // Wait for writability only while a response is pending
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | (conn.header.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+
+    return conn.header.empty() ? !conn.close_after : true;
+}
+
+void MetricsServer::queueResponse(Connection& conn, int status, const std::string& reason,
+                                  bool head_only, bool gzip, const std::string& content_type,
+                                  const std::string* body) {
+    std::string& header = conn.header;
+    header.clear();
+    header += "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+    header += "Content-Type: " + content_type + "\r\n";
+    header += "Content-Length: " + std::to_string(body ? body->size() : 0) + "\r\n";
+    if (gzip) {
+        header += "Content-Encoding: gzip\r\n";
+    }
+    header += "Vary: Accept-Encoding\r\n";
+    header += conn.close_after ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+    header += "\r\n";
+
+    conn.body = head_only ? nullptr : body;
+    conn.sent = 0;
+}
+
+// Write as much of the pending response as the socket takes.
+// Returns false on a hard error.
+bool MetricsServer::flush(int fd, Connection& conn) {
+    while (!conn.header.empty()) {
+        size_t body_size = conn.body ? conn.body->size() : 0;
+        size_t total = conn.header.size() + body_size;
+
+        struct iovec iov[2];
+        int iovcnt = 0;
+        if (conn.sent < conn.header.size()) {
+            iov[iovcnt].iov_base = const_cast<char*>(conn.header.data()) + conn.sent;
+            iov[iovcnt].iov_len = conn.header.size() - conn.sent;
+            iovcnt++;
+        }
+        if (body_size > 0) {
+            size_t body_off = conn.sent > conn.header.size() ? conn.sent - conn.header.size() : 0;
+            iov[iovcnt].iov_base = const_cast<char*>(conn.body->data()) + body_off;
+            iov[iovcnt].iov_len = body_size - body_off;
+            iovcnt++;
+        }
+
+        // MSG_NOSIGNAL: a client that went away must not SIGPIPE the daemon
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        ssize_t w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        conn.sent += w;
+        if (conn.sent >= total) {
+            conn.header.clear();
+            conn.body = nullptr;
+            conn.payload.reset();
+            conn.sent = 0;
+        }
+    }
+    return true;
+}
+
+void MetricsServer::closeConnection(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+}
+
+void MetricsServer::expireIdle(long now) {
+    std::vector<int> idle;
+    for (const auto& entry : connections) {
+        if (now - entry.second.last_active > IDLE_TIMEOUT_SECONDS) {
+            idle.push_back(entry.first);
+        }
+    }
+    for (int fd : idle) {
+        closeConnection(fd);
+    }
+}
@@ -0,0 +1,664 @@
+#include "parquet.h"
+#include "self_stats.h"
+#include <cmath>
+#include <cstring>
+
+// parquet.thrift enums
+static const int32_t PAGE_DATA = 0;
+static const int32_t TYPE_INT64 = 2;
+static const int32_t TYPE_DOUBLE = 5;
+static const int32_t REPETITION_REQUIRED = 0;
+static const int32_t REPETITION_OPTIONAL = 1;
+static const int32_t REPETITION_REPEATED = 2;
+static const int32_t ENCODING_PLAIN = 0;
+static const int32_t ENCODING_RLE = 3;
+static const int32_t CONVERTED_TIMESTAMP_MILLIS = 9;
+static const int32_t CODEC_UNCOMPRESSED = 0;
+
+// Thrift compact protocol, just the parts the Parquet footer and page
+// headers use
+class ThriftWriter {
+private:
+    std::string& out;
+    std::vector<int16_t> last_ids;
+    int16_t last_id;
+
+public:
+    enum Type : uint8_t {
+        BOOL_TRUE = 1, BOOL_FALSE = 2, I32 = 5, I64 = 6, BINARY = 8, LIST = 9, STRUCT = 12
+    };
+
+    explicit ThriftWriter(std::string& buffer) : out(buffer), last_id(0) {}
+
+    void beginStruct() {
+        last_ids.push_back(last_id);
+        last_id = 0;
+    }
+
+    void endStruct() {
+        out += '\0';
+        last_id = last_ids.back();
+        last_ids.pop_back();
+    }
+
+    void i32(int16_t id, int32_t value) {
+        field(id, I32);
+        varint(zigzag(value));
+    }
+
+    void i64(int16_t id, int64_t value) {
+        field(id, I64);
+        varint(zigzag(value));
+    }
+
+    void boolean(int16_t id, bool value) {
+        field(id, value ? BOOL_TRUE : BOOL_FALSE);
+    }
+
+    void binary(int16_t id, const std::string& value) {
+        field(id, BINARY);
+        string(value);
+    }
+
+    // Followed by the struct's fields and endStruct()
+    void structField(int16_t id) {
+        field(id, STRUCT);
+        beginStruct();
+    }
+
+    // Followed by size elements: beginStruct()...endStruct(), element(), string()
+    void listField(int16_t id, Type element_type, size_t size) {
+        field(id, LIST);
+        if (size < 15) {
+            out += static_cast<char>(size << 4 | element_type);
+        } else {
+            out += static_cast<char>(0xf0 | element_type);
+            varint(size);
+        }
+    }
+
+    void element(int32_t value) { varint(zigzag(value)); }
+
+    void string(const std::string& value) {
+        varint(value.size());
+        out += value;
+    }
+
+private:
+    void field(int16_t id, Type type) {
+        if (id > last_id && id - last_id <= 15) {
+            out += static_cast<char>((id - last_id) << 4 | type);
+        } else {
+            out += static_cast<char>(type);
+            varint(zigzag(id));
+        }
+        last_id = id;
+    }
+
+    static uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+};
+
+// Thrift compact protocol reader for the same structs. Unknown fields are
+// skipped; running off the end sets failed and yields zeros.
+class ThriftReader {
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+    std::vector<int16_t> last_ids;
+    int16_t last_id;
+
+public:
+    bool failed;
+
+    ThriftReader(const std::string& buffer, size_t offset = 0)
+        : data(reinterpret_cast<const uint8_t*>(buffer.data())), size(buffer.size()), pos(offset),
+          last_id(0), failed(false) {}
+
+    size_t position() const { return pos; }
+
+    void beginStruct() {
+        last_ids.push_back(last_id);
+        last_id = 0;
+    }
+
+    // Next field of the current struct; false at its end (the struct is left)
+    bool field(int16_t& id, uint8_t& type) {
+        uint8_t header = byte();
+        if (header == 0 || failed) {
+            if (!last_ids.empty()) {
+                last_id = last_ids.back();
+                last_ids.pop_back();
+            }
+            return false;
+        }
+        type = header & 0x0f;
+        id = (header >> 4) != 0 ? static_cast<int16_t>(last_id + (header >> 4))
+                                : static_cast<int16_t>(unzigzag(varint()));
+        last_id = id;
+        return true;
+    }
+
+    int64_t integer() { return unzigzag(varint()); }
+
+    std::string binary() {
+        uint64_t length = varint();
+        if (length > size - pos) {
+            failed = true;
+            return std::string();
+        }
+        std::string value(reinterpret_cast<const char*>(data + pos), length);
+        pos += length;
+        return value;
+    }
+
+    void list(size_t& count, uint8_t& element_type) {
+        uint8_t header = byte();
+        element_type = header & 0x0f;
+        count = header >> 4;
+        if (count == 15) count = varint();
+    }
+
+    void skip(uint8_t type) {
+        switch (type) {
+        case 1: case 2: break;                      // Bool, in the field header
+        case 3: byte(); break;
+        case 4: case 5: case 6: varint(); break;
+        case 7: advance(8); break;
+        case 8: binary(); break;
+        case 9: case 10: {
+            size_t count;
+            uint8_t element;
+            list(count, element);
+            for (size_t i = 0; i < count && !failed; i++) skipElement(element);
+            break;
+        }
+        case 11: {
+            uint64_t count = varint();
+            uint8_t types = count > 0 ? byte() : 0;
+            for (uint64_t i = 0; i < count && !failed; i++) {
+                skipElement(types >> 4);
+                skipElement(types & 0x0f);
+            }
+            break;
+        }
+        case 12: {
+            beginStruct();
+            int16_t id;
+            uint8_t field_type;
+            while (field(id, field_type)) skip(field_type);
+            break;
+        }
+        default:
+            failed = true;
+        }
+    }
+
+private:
+    // List elements: bools take a byte of their own
+    void skipElement(uint8_t type) {
+        if (type == 1 || type == 2) {
+            byte();
+        } else {
+            skip(type);
+        }
+    }
+
+    uint8_t byte() {
+        if (pos >= size) {
+            failed = true;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    void advance(size_t count) {
+        if (count > size - pos) {
+            failed = true;
+            pos = size;
+        } else {
+            pos += count;
+        }
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            value |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) break;
+        }
+        return value;
+    }
+
+    static int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+};
+
+static void putU32(std::string& out, uint32_t value) {
+    char bytes[4] = {static_cast<char>(value), static_cast<char>(value >> 8),
+                     static_cast<char>(value >> 16), static_cast<char>(value >> 24)};
+    out.append(bytes, 4);
+}
+
+bool ParquetWriter::writeHeader() {
+    row_groups.clear();
+    return write("PAR1", 4);
+}
+
+// Page header and the page buffer's contents
+bool ParquetWriter::writePage(Chunk& chunk, size_t rows) {
+    std::string header;
+    ThriftWriter thrift(header);
+    thrift.beginStruct();
+    thrift.i32(1, PAGE_DATA);
+    thrift.i32(2, static_cast<int32_t>(page.size()));
+    thrift.i32(3, static_cast<int32_t>(page.size()));
+    thrift.structField(5);
+    thrift.i32(1, static_cast<int32_t>(rows));
+    thrift.i32(2, ENCODING_PLAIN);
+    thrift.i32(3, ENCODING_RLE);
+    thrift.i32(4, ENCODING_RLE);
+    thrift.endStruct();
+    thrift.endStruct();
+
+    chunk.offset = static_cast<int64_t>(bytes_written);
+    chunk.size = static_cast<int64_t>(header.size() + page.size());
+    chunk.values = static_cast<int64_t>(rows);
+    return write(header.data(), header.size()) && write(page.data(), page.size());
+}
+
+bool ParquetWriter::writeBatch() {
+    SELF_STATS_SCOPE(StageKind::EXPORTER, "parquet_row_group");
+    const size_t rows = timestamps.size();
+    RowGroup group;
+    group.rows = static_cast<int64_t>(rows);
+    group.chunks.resize(columns.size() + 1);
+
+    // Required timestamps: just the values
+    page.assign(reinterpret_cast<const char*>(timestamps.data()), rows * 8);
+    if (!writePage(group.chunks[0], rows)) return false;
+
+    // Optional series: definition levels (1 = present) as one bit-packed
+    // run of the RLE hybrid encoding, then the present values
+    const size_t groups = (rows + 7) / 8;
+    for (size_t c = 0; c < columns.size(); c++) {
+        const std::vector<double>& column = columns[c];
+        page.clear();
+        std::string levels;
+        for (uint64_t header = groups << 1 | 1; ; header >>= 7) {
+            if (header < 0x80) {
+                levels += static_cast<char>(header);
+                break;
+            }
+            levels += static_cast<char>((header & 0x7f) | 0x80);
+        }
+        size_t bits_at = levels.size();
+        levels.resize(bits_at + groups, '\0');
+        for (size_t row = 0; row < rows; row++) {
+            if (!std::isnan(column[row])) levels[bits_at + row / 8] |= static_cast<char>(1u << (row % 8));
+        }
+        putU32(page, static_cast<uint32_t>(levels.size()));
+        page += levels;
+        for (double value : column) {
+            if (!std::isnan(value)) page.append(reinterpret_cast<const char*>(&value), 8);
+        }
+        if (!writePage(group.chunks[c + 1], rows)) return false;
+    }
+    row_groups.push_back(std::move(group));
+    return true;
+}
+
+bool ParquetWriter::writeTrailer() {
+    std::string footer;
+    ThriftWriter thrift(footer);
+    int64_t total_rows = 0;
+    for (const auto& group : row_groups) total_rows += group.rows;
+
+    thrift.beginStruct();
+    thrift.i32(1, 1);
+
+    thrift.listField(2, ThriftWriter::STRUCT, names.size() + 2);
+    thrift.beginStruct();
+    thrift.binary(4, "schema");
+    thrift.i32(5, static_cast<int32_t>(names.size() + 1));
+    thrift.endStruct();
+
+    thrift.beginStruct();
+    thrift.i32(1, TYPE_INT64);
+    thrift.i32(3, REPETITION_REQUIRED);
+    thrift.binary(4, "timestamp");
+    thrift.i32(6, CONVERTED_TIMESTAMP_MILLIS);
+    thrift.structField(10);         // LogicalType
+    thrift.structField(8);          // TIMESTAMP
+    thrift.boolean(1, true);        // isAdjustedToUTC
+    thrift.structField(2);          // unit
+    thrift.structField(1);          // MILLIS
+    thrift.endStruct();
+    thrift.endStruct();
+    thrift.endStruct();
+    thrift.endStruct();
+    thrift.endStruct();
+
+    for (const auto& name : names) {
+        thrift.beginStruct();
+        thrift.i32(1, TYPE_DOUBLE);
+        thrift.i32(3, REPETITION_OPTIONAL);
+        thrift.binary(4, name);
+        thrift.endStruct();
+    }
+
+    thrift.i64(3, total_rows);
+
+    thrift.listField(4, ThriftWriter::STRUCT, row_groups.size());
+    for (const auto& group : row_groups) {
+        thrift.beginStruct();
+        thrift.listField(1, ThriftWriter::STRUCT, group.chunks.size());
+        int64_t group_bytes = 0;
+        for (size_t c = 0; c < group.chunks.size(); c++) {
+            const Chunk& chunk = group.chunks[c];
+            group_bytes += chunk.size;
+            thrift.beginStruct();
+            thrift.i64(2, chunk.offset);
+            thrift.structField(3);      // ColumnMetaData
+            thrift.i32(1, c == 0 ? TYPE_INT64 : TYPE_DOUBLE);
+            thrift.listField(2, ThriftWriter::I32, 2);
+            thrift.element(ENCODING_PLAIN);
+            thrift.element(ENCODING_RLE);
+            thrift.listField(3, ThriftWriter::BINARY, 1);
+            thrift.string(c == 0 ? std::string("timestamp") : names[c - 1]);
+            thrift.i32(4, CODEC_UNCOMPRESSED);
+            thrift.i64(5, chunk.values);
+            thrift.i64(6, chunk.size);
+            thrift.i64(7, chunk.size);
+            thrift.i64(9, chunk.offset);
+            thrift.endStruct();
+            thrift.endStruct();
+        }
+        thrift.i64(2, group_bytes);
+        thrift.i64(3, group.rows);
+        thrift.endStruct();
+    }
+
+    thrift.binary(6, "sysreport");
+    thrift.endStruct();
+
+    putU32(footer, static_cast<uint32_t>(footer.size()));
+    footer += "PAR1";
+    return write(footer.data(), footer.size());
+}
+
+ParquetReader::ParquetReader() : next_group(0), rows(0) {
+}
+
+bool ParquetReader::open(const std::string& path) {
+    schema.clear();
+    row_groups.clear();
+    next_group = 0;
+    rows = 0;
+    error.clear();
+
+    in.open(path, std::ios::binary);
+    if (!in.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+    in.seekg(0, std::ios::end);
+    int64_t file_size = static_cast<int64_t>(in.tellg());
+    char magic[4] = {0, 0, 0, 0};
+    char tail[8];
+    in.seekg(0);
+    in.read(magic, 4);
+    if (file_size < 12 || memcmp(magic, "PAR1", 4) != 0) {
+        error = path + " is not a Parquet file";
+        return false;
+    }
+    in.seekg(file_size - 8);
+    in.read(tail, 8);
+    uint32_t length = static_cast<uint8_t>(tail[0]) | static_cast<uint8_t>(tail[1]) << 8 |
+                      static_cast<uint8_t>(tail[2]) << 16 | static_cast<uint32_t>(static_cast<uint8_t>(tail[3])) << 24;
+    if (!in || memcmp(tail + 4, "PAR1", 4) != 0 || length > file_size - 12) {
+        error = path + ": truncated (no footer)";
+        return false;
+    }
+
+    std::string footer(length, '\0');
+    in.seekg(file_size - 8 - length);
+    in.read(&footer[0], length);
+    if (!in || !readFooter(footer)) {
+        if (error.empty()) error = path + ": unreadable footer";
+        return false;
+    }
+    for (const RowGroup& group : row_groups) {
+        for (const Chunk& chunk : group.chunks) {
+            if (chunk.offset < 4 || chunk.size < 0 || chunk.offset + chunk.size > file_size - 8 - length) {
+                error = path + ": column chunk outside the file";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ParquetReader::readFooter(const std::string& footer) {
+    ThriftReader thrift(footer);
+    int16_t id;
+    uint8_t type;
+    thrift.beginStruct();
+    while (thrift.field(id, type)) {
+        if (id == 2 && type == 9) {
+            // Schema: the root, then one leaf per column
+            size_t count;
+            uint8_t element;
+            thrift.list(count, element);
+            for (size_t i = 0; i < count && !thrift.failed; i++) {
+                int32_t column_type = -1, repetition = REPETITION_REQUIRED, children = 0;
+                std::string name;
+                thrift.beginStruct();
+                while (thrift.field(id, type)) {
+                    if (id == 1 && type == 5) column_type = static_cast<int32_t>(thrift.integer());
+                    else if (id == 3 && type == 5) repetition = static_cast<int32_t>(thrift.integer());
+                    else if (id == 4 && type == 8) name = thrift.binary();
+                    else if (id == 5 && type == 5) children = static_cast<int32_t>(thrift.integer());
+                    else thrift.skip(type);
+                }
+                if (i == 0) continue;
+                if (children > 0 || repetition == REPETITION_REPEATED ||
+                    (column_type != TYPE_INT64 && column_type != TYPE_DOUBLE)) {
+                    error = "column " + name + ": only flat INT64 and DOUBLE columns are supported";
+                    return false;
+                }
+                schema.push_back(Column{name, column_type == TYPE_INT64, repetition == REPETITION_OPTIONAL});
+            }
+        } else if (id == 3 && type == 6) {
+            rows = thrift.integer();
+        } else if (id == 4 && type == 9) {
+            size_t count;
+            uint8_t element;
+            thrift.list(count, element);
+            for (size_t g = 0; g < count && !thrift.failed; g++) {
+                RowGroup group = {0, {}};
+                thrift.beginStruct();
+                while (thrift.field(id, type)) {
+                    if (id == 1 && type == 9) {
+                        size_t chunks;
+                        thrift.list(chunks, element);
+                        for (size_t c = 0; c < chunks && !thrift.failed; c++) {
+                            Chunk chunk = {0, 0, CODEC_UNCOMPRESSED};
+                            int64_t dictionary_offset = 0;
+                            thrift.beginStruct();
+                            while (thrift.field(id, type)) {
+                                if (id != 3 || type != 12) {
+                                    thrift.skip(type);
+                                    continue;
+                                }
+                                thrift.beginStruct();     // ColumnMetaData
+                                while (thrift.field(id, type)) {
+                                    if (id == 4 && type == 5) chunk.codec = static_cast<int32_t>(thrift.integer());
+                                    else if (id == 7 && type == 6) chunk.size = thrift.integer();
+                                    else if (id == 9 && type == 6) chunk.offset = thrift.integer();
+                                    else if (id == 11 && type == 6) dictionary_offset = thrift.integer();
+                                    else thrift.skip(type);
+                                }
+                            }
+                            if (dictionary_offset > 0 && dictionary_offset < chunk.offset) {
+                                chunk.offset = dictionary_offset;
+                            }
+                            group.chunks.push_back(chunk);
+                        }
+                    } else if (id == 3 && type == 6) {
+                        group.rows = thrift.integer();
+                    } else {
+                        thrift.skip(type);
+                    }
+                }
+                row_groups.push_back(std::move(group));
+            }
+        } else {
+            thrift.skip(type);
+        }
+        if (thrift.failed) break;
+    }
+    if (thrift.failed) return false;
+    for (const RowGroup& group : row_groups) {
+        if (group.chunks.size() != schema.size()) {
+            error = "row group column count differs from the schema";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParquetReader::readChunk(const Column& column, const Chunk& chunk, int64_t rows_in_group,
+                              std::vector<int64_t>* ints, std::vector<double>* doubles) {
+    auto fail = [&](const std::string& what) {
+        error = "column " + column.name + ": " + what;
+        return false;
+    };
+    if (chunk.codec != CODEC_UNCOMPRESSED) return fail("compressed column chunks are not supported");
+    buffer.resize(static_cast<size_t>(chunk.size));
+    in.seekg(chunk.offset);
+    in.read(&buffer[0], chunk.size);
+    if (!in) return fail("short read");
+
+    int64_t decoded = 0;
+    size_t pos = 0;
+    std::vector<uint8_t> levels;
+    while (pos < buffer.size() && decoded < rows_in_group) {
+        ThriftReader thrift(buffer, pos);
+        int16_t id;
+        uint8_t type;
+        int32_t page_type = -1, page_size = -1, count = 0, encoding = -1;
+        thrift.beginStruct();
+        while (thrift.field(id, type)) {
+            if (id == 1 && type == 5) page_type = static_cast<int32_t>(thrift.integer());
+            else if (id == 3 && type == 5) page_size = static_cast<int32_t>(thrift.integer());
+            else if (id == 5 && type == 12) {
+                thrift.beginStruct();
+                while (thrift.field(id, type)) {
+                    if (id == 1 && type == 5) count = static_cast<int32_t>(thrift.integer());
+                    else if (id == 2 && type == 5) encoding = static_cast<int32_t>(thrift.integer());
+                    else thrift.skip(type);
+                }
+            } else {
+                thrift.skip(type);
+            }
+        }
+        pos = thrift.position();
+        if (thrift.failed || page_size < 0 || static_cast<size_t>(page_size) > buffer.size() - pos) {
+            return fail("bad page header");
+        }
+        if (page_type != PAGE_DATA || encoding != ENCODING_PLAIN) {
+            return fail("only PLAIN data pages (v1) are supported");
+        }
+        const uint8_t* page = reinterpret_cast<const uint8_t*>(buffer.data()) + pos;
+        const uint8_t* end = page + page_size;
+        pos += page_size;
+
+        // Definition levels: the RLE/bit-packed hybrid at bit width 1
+        levels.assign(count, 1);
+        if (column.nullable) {
+            if (end - page < 4) return fail("truncated levels");
+            uint32_t length = page[0] | page[1] << 8 | page[2] << 16 | static_cast<uint32_t>(page[3]) << 24;
+            page += 4;
+            if (length > static_cast<size_t>(end - page)) return fail("truncated levels");
+            const uint8_t* level = page;
+            const uint8_t* levels_end = page + length;
+            page = levels_end;
+            int32_t at = 0;
+            while (at < count && level < levels_end) {
+                uint64_t header = 0;
+                for (int shift = 0; level < levels_end && shift < 64; shift += 7) {
+                    uint8_t b = *level++;
+                    header |= static_cast<uint64_t>(b & 0x7f) << shift;
+                    if (!(b & 0x80)) break;
+                }
+                if (header & 1) {
+                    for (uint64_t group = 0; group < header >> 1 && level < levels_end; group++, level++) {
+                        for (int bit = 0; bit < 8 && at < count; bit++) levels[at++] = (*level >> bit) & 1;
+                    }
+                } else {
+                    uint8_t value = level < levels_end ? *level++ & 1 : 0;
+                    for (uint64_t run = 0; run < header >> 1 && at < count; run++) levels[at++] = value;
+                }
+            }
+            if (at < count) return fail("truncated levels");
+        }
+
+        for (int32_t i = 0; i < count; i++) {
+            uint64_t bits = 0;
+            if (levels[i]) {
+                if (end - page < 8) return fail("truncated values");
+                memcpy(&bits, page, 8);
+                page += 8;
+            }
+            if (ints) {
+                ints->push_back(levels[i] ? static_cast<int64_t>(bits) : 0);
+            } else {
+                double value;
+                memcpy(&value, &bits, 8);
+                doubles->push_back(levels[i] ? value : NAN);
+            }
+        }
+        decoded += count;
+    }
+    if (decoded != rows_in_group) {
+        return fail(std::to_string(decoded) + " value(s) for " + std::to_string(rows_in_group) + " row(s)");
+    }
+    return true;
+}
+
+bool ParquetReader::next(std::vector<int64_t>& timestamps, std::vector<std::vector<double>>& values) {
+    if (!error.empty() || next_group >= row_groups.size()) return false;
+    const RowGroup& group = row_groups[next_group++];
+    timestamps.clear();
+    values.clear();
+    std::vector<int64_t> ignored;
+    bool have_timestamps = false;
+    for (size_t c = 0; c < schema.size(); c++) {
+        const Column& column = schema[c];
+        bool ok;
+        if (column.timestamp) {
+            ignored.clear();
+            ok = readChunk(column, group.chunks[c], group.rows, have_timestamps ? &ignored : &timestamps, nullptr);
+            have_timestamps = true;
+        } else {
+            values.emplace_back();
+            values.back().reserve(group.rows);
+            ok = readChunk(column, group.chunks[c], group.rows, nullptr, &values.back());
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
@@ -0,0 +1,392 @@
+#include "remote_write.h"
+#include "exporters.h"
+#include "self_stats.h"
+#include "snappy.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+static int64_t monotonicMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void parsePrometheusText(const std::string& text,
+                         const std::function<void(const std::string& name,
+                                                  const PromLabels& labels,
+                                                  double value)>& fn) {
+    PromLabels labels;
+    std::string name;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string::npos) eol = text.size();
+        const char* p = text.data() + pos;
+        const char* end = text.data() + eol;
+        pos = eol + 1;
+
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        if (p == end || *p == '#') continue;
+
+        const char* name_start = p;
+        while (p < end && *p != '{' && *p != ' ') p++;
+        name.assign(name_start, p);
+        labels.clear();
+
+        if (p < end && *p == '{') {
+            p++;
+            while (p < end && *p != '}') {
+                const char* key_start = p;
+                while (p < end && *p != '=') p++;
+                std::string key(key_start, p);
+                if (p + 1 >= end || p[1] != '"') break;
+                p += 2;
+
+                std::string value;
+                while (p < end && *p != '"') {
+                    if (*p == '\\' && p + 1 < end) {
+                        p++;
+                        value += *p == 'n' ? '\n' : *p;
+                    } else {
+                        value += *p;
+                    }
+                    p++;
+                }
+                labels.emplace_back(key, value);
+                if (p < end) p++;          // Closing quote
+                if (p < end && *p == ',') p++;
+            }
+            if (p < end) p++;              // Closing brace
+        }
+
+        while (p < end && *p == ' ') p++;
+        if (p == end) continue;
+        std::string number(p, end);
+        char* number_end = nullptr;
+        double value = strtod(number.c_str(), &number_end);
+        if (number_end == number.c_str()) continue;
+        fn(name, labels, value);
+    }
+}
+
+static void appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+// Length-delimited protobuf field (wire type 2)
+static void appendBytesField(std::string& out, int field, const std::string& bytes) {
+    out += static_cast<char>((field << 3) | 2);
+    appendVarint(out, bytes.size());
+    out += bytes;
+}
+
+RemoteWriteBatch::RemoteWriteBatch(const PromLabels& extra)
+    : extra_labels(extra), sample_count(0) {
+}
+
+void RemoteWriteBatch::addExposition(const std::string& text, int64_t timestamp_ms) {
+    parsePrometheusText(text, [this, timestamp_ms](const std::string& name,
+                                                   const PromLabels& labels, double value) {
+        add(name, labels, value, timestamp_ms);
+    });
+}
+
+void RemoteWriteBatch::add(const std::string& name, const PromLabels& labels, double value,
+                           int64_t timestamp_ms) {
+    // Remote write requires labels sorted by name; exposition labels win
+    // over the extra ones (e.g. a plugin setting its own instance)
+    PromLabels all;
+    all.reserve(labels.size() + extra_labels.size() + 1);
+    all.emplace_back("__name__", name);
+    all.insert(all.end(), labels.begin(), labels.end());
+    for (const auto& extra : extra_labels) {
+        bool present = false;
+        for (const auto& label : labels) {
+            if (label.first == extra.first) present = true;
+        }
+        if (!present) all.push_back(extra);
+    }
+    std::sort(all.begin(), all.end());
+
+    std::string encoded;
+    for (const auto& label : all) {
+        std::string message;
+        appendBytesField(message, 1, label.first);
+        appendBytesField(message, 2, label.second);
+        appendBytesField(encoded, 1, message);
+    }
+
+    auto it = index.find(encoded);
+    if (it == index.end()) {
+        it = index.emplace(encoded, series.size()).first;
+        series.push_back(Series{encoded, {}});
+    }
+    series[it->second].samples.emplace_back(value, timestamp_ms);
+    sample_count++;
+}
+
+void RemoteWriteBatch::clear() {
+    series.clear();
+    index.clear();
+    sample_count = 0;
+}
+
+std::string RemoteWriteBatch::encode() const {
+    std::string request;
+    std::string timeseries;
+    std::string sample;
+    for (const auto& entry : series) {
+        timeseries = entry.labels;
+        for (const auto& point : entry.samples) {
+            sample.clear();
+            // Sample { double value = 1; int64 timestamp = 2; }
+            sample += static_cast<char>((1 << 3) | 1);
+            uint64_t bits;
+            memcpy(&bits, &point.first, sizeof(bits));
+            for (int i = 0; i < 8; i++) sample += static_cast<char>((bits >> (8 * i)) & 0xff);
+            sample += static_cast<char>(2 << 3);
+            appendVarint(sample, static_cast<uint64_t>(point.second));
+            appendBytesField(timeseries, 2, sample);
+        }
+        appendBytesField(request, 1, timeseries);
+    }
+    return request;
+}
+
+static bool makeDirs(const std::string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        if (slash == std::string::npos) return true;
+    }
+}
+
+DiskSpool::DiskSpool(const std::string& directory, uint64_t max_size_bytes)
+    : dir(directory), max_bytes(max_size_bytes), total_bytes(0), sequence(0) {
+}
+
+bool DiskSpool::open(std::string& error) {
+    if (!makeDirs(dir)) {
+        error = "cannot create " + dir + ": " + strerror(errno);
+        return false;
+    }
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        error = "cannot read " + dir + ": " + strerror(errno);
+        return false;
+    }
+
+    std::vector<std::string> names;
+    while (struct dirent* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+            unlink((dir + "/" + name).c_str());   // Interrupted write
+        } else if (name.size() > 3 && name.compare(name.size() - 3, 3, ".rw") == 0) {
+            names.push_back(name);
+        }
+    }
+    closedir(d);
+
+    // Zero-padded sequence numbers sort in write order
+    std::sort(names.begin(), names.end());
+    for (const auto& name : names) {
+        struct stat st;
+        if (stat((dir + "/" + name).c_str(), &st) != 0) continue;
+        files.emplace_back(name, static_cast<uint64_t>(st.st_size));
+        total_bytes += st.st_size;
+        sequence = std::max<uint64_t>(sequence, strtoull(name.c_str(), nullptr, 10));
+    }
+    return true;
+}
+
+bool DiskSpool::push(const std::string& payload) {
+    static std::atomic<uint64_t>& evicted = SelfStats::counter(
+        "remote_write_spool_evicted_total", "Spooled remote-write batches dropped to stay within spool_max_mb");
+
+    char name[32];
+    snprintf(name, sizeof(name), "%020llu.rw", static_cast<unsigned long long>(++sequence));
+    std::string path = dir + "/" + name;
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(payload.data(), payload.size());
+        if (!out.good()) {
+            out.close();
+            unlink(tmp_path.c_str());
+            return false;
+        }
+    }
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    files.emplace_back(name, payload.size());
+    total_bytes += payload.size();
+
+    while (total_bytes > max_bytes && files.size() > 1) {
+        pop();
+        evicted.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+bool DiskSpool::front(std::string& payload) const {
+    if (files.empty()) return false;
+    std::ifstream in(dir + "/" + files.front().first, std::ios::binary);
+    if (!in.is_open()) return false;
+    std::ostringstream oss;
+    oss << in.rdbuf();
+    payload = oss.str();
+    return true;
+}
+
+void DiskSpool::pop() {
+    if (files.empty()) return;
+    unlink((dir + "/" + files.front().first).c_str());
+    total_bytes -= files.front().second;
+    files.pop_front();
+}
+
+static PromLabels hostLabels() {
+    char hostname[256];
+    PromLabels labels;
+    labels.emplace_back("job", "sysreport");
+    if (gethostname(hostname, sizeof(hostname)) == 0) {
+        hostname[sizeof(hostname) - 1] = '\0';
+        labels.emplace_back("instance", hostname);
+    }
+    return labels;
+}
+
+RemoteWriteSink::RemoteWriteSink(const SinkOptions& opts)
+    : options(opts),
+      client(opts.target, opts.timeout_ms),
+      batch(hostLabels()),
+      spool(opts.spool_dir.empty() ? "/var/lib/sysreport/spool/" + opts.name : opts.spool_dir,
+            static_cast<uint64_t>(opts.spool_max_mb * 1024 * 1024)),
+      batch_started_ms(0),
+      retry_at_ms(0),
+      backoff_ms(0) {
+}
+
+bool RemoteWriteSink::open(std::string& error) {
+    if (!client.isValid()) {
+        error = "invalid remote-write URL: " + options.target;
+        return false;
+    }
+    if (!spool.open(error)) return false;
+    return true;
+}
+
+void RemoteWriteSink::write(const SinkSample& sample) {
+    {
+        SELF_STATS_SCOPE(StageKind::FORMATTER, "remote_write");
+        batch.addExposition(PrometheusExporter::exportMetrics(sample.util), sample.timestamp_ms);
+    }
+
+    int64_t now = monotonicMillis();
+    if (batch_started_ms == 0) batch_started_ms = now;
+    if (batch.sampleCount() >= options.batch_size ||
+        now - batch_started_ms >= static_cast<int64_t>(options.batch_age_seconds * 1000)) {
+        flushBatch(now);
+    }
+    drainSpool(now);
+}
+
+void RemoteWriteSink::close() {
+    // Whatever is not delivered now is replayed from the spool next start
+    int64_t now = monotonicMillis();
+    flushBatch(now);
+    drainSpool(now);
+    client.disconnect();
+}
+
+void RemoteWriteSink::flushBatch(int64_t now_ms) {
+    static std::atomic<uint64_t>& spooled = SelfStats::counter(
+        "remote_write_batches_spooled_total", "Remote-write batches written to the disk spool");
+    static std::atomic<uint64_t>& lost = SelfStats::counter(
+        "remote_write_batches_lost_total", "Remote-write batches lost because the spool could not be written");
+
+    if (batch.empty()) return;
+    std::string payload;
+    {
+        SELF_STATS_SCOPE(StageKind::FORMATTER, "remote_write_encode");
+        snappyCompress(batch.encode()).swap(payload);
+    }
+    batch.clear();
+    batch_started_ms = 0;
+
+    // Send straight away only if nothing older is waiting
+    if (spool.empty() && now_ms >= retry_at_ms && send(payload) != 0) return;
+
+    if (spool.push(payload)) {
+        spooled.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        lost.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void RemoteWriteSink::drainSpool(int64_t now_ms) {
+    std::string payload;
+    for (int i = 0; i < MAX_REPLAY_PER_CYCLE && !spool.empty() && now_ms >= retry_at_ms; i++) {
+        if (!spool.front(payload)) {
+            spool.pop();   // Unreadable; skip it rather than stall forever
+            continue;
+        }
+        if (send(payload) == 0) break;
+        spool.pop();
+    }
+}
+
+int RemoteWriteSink::send(const std::string& payload) {
+    static std::atomic<uint64_t>& sent = SelfStats::counter(
+        "remote_write_batches_sent_total", "Remote-write batches accepted by the endpoint");
+    static std::atomic<uint64_t>& rejected = SelfStats::counter(
+        "remote_write_batches_rejected_total", "Remote-write batches refused with a non-retryable status");
+    static std::atomic<uint64_t>& failed = SelfStats::counter(
+        "remote_write_failures_total", "Remote-write attempts that failed and will be retried");
+
+    static const std::vector<std::string> headers = {
+        "Content-Encoding: snappy",
+        "X-Prometheus-Remote-Write-Version: 0.1.0"
+    };
+
+    HttpResponse response;
+    bool transport_ok;
+    {
+        SELF_STATS_SCOPE(StageKind::EXPORTER, "remote_write");
+        transport_ok = client.post(payload, "application/x-protobuf", response, headers);
+    }
+    int status = transport_ok ? response.status : 0;
+
+    if (status >= 200 && status < 300) {
+        sent.fetch_add(1, std::memory_order_relaxed);
+        backoff_ms = 0;
+        retry_at_ms = 0;
+        return 1;
+    }
+    // Per the remote-write spec only 5xx and 429 are worth retrying
+    if (status >= 400 && status < 500 && status != 429) {
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+
+    failed.fetch_add(1, std::memory_order_relaxed);
+    backoff_ms = backoff_ms == 0 ? 1000 : std::min(backoff_ms * 2, 60000);
+    retry_at_ms = monotonicMillis() + backoff_ms;
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include "resource_budget.h"
+#include "self_stats.h"
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+BudgetOptions::BudgetOptions()
+    : cpu_percent(0), rss_mb(0), sched_idle(false) {
+}
+
+static uint64_t processCpuMicros() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return static_cast<uint64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static double residentMb() {
+    std::ifstream statm("/proc/self/statm");
+    long size = 0, resident = 0;
+    if (!(statm >> size >> resident)) return 0;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024.0) / 1024.0;
+}
+
+// "0,2-3" -> CPUs 0, 2 and 3
+static bool parseCpuList(const std::string& list, cpu_set_t& set) {
+    CPU_ZERO(&set);
+    std::istringstream iss(list);
+    std::string item;
+    bool any = false;
+    while (std::getline(iss, item, ',')) {
+        const char* start = item.c_str();
+        char* end;
+        long first = strtol(start, &end, 10);
+        if (end == start) return false;
+        long last = first;
+        if (*end == '-') {
+            start = end + 1;
+            last = strtol(start, &end, 10);
+            if (end == start) return false;
+        }
+        if (*end != '\0' || first < 0 || last < first || last >= CPU_SETSIZE) return false;
+        for (long cpu = first; cpu <= last; cpu++) CPU_SET(cpu, &set);
+        any = true;
+    }
+    return any;
+}
+
+ResourceBudget::ResourceBudget(const BudgetOptions& opts)
+    : options(opts),
+      level(0),
+      over_cycles(0),
+      under_cycles(0),
+      cycle(0),
+      measured(false),
+      last_cpu_us(0),
+      cpu_percent(0),
+      rss_mb(0) {
+}
+
+void ResourceBudget::setLimits(double cpu_limit, double rss_limit) {
+    options.cpu_percent = cpu_limit;
+    options.rss_mb = rss_limit;
+    if (!limited()) {
+        level = 0;
+        over_cycles = under_cycles = 0;
+    }
+}
+
+bool ResourceBudget::update() {
+    static std::atomic<double>& cpu_gauge = SelfStats::gauge(
+        "self_cpu_percent", "CPU used by sysreport over the last cycle, percent of one core");
+    static std::atomic<double>& rss_gauge = SelfStats::gauge(
+        "self_rss_bytes", "Resident memory of the sysreport daemon");
+    static std::atomic<double>& level_gauge = SelfStats::gauge(
+        "budget_level", "Collection degradation level (0: full, 3: minimal)");
+    static std::atomic<uint64_t>& changes = SelfStats::counter(
+        "budget_level_changes_total", "Times the daemon changed its degradation level");
+
+    cycle++;
+    uint64_t cpu_us = processCpuMicros();
+    auto now = std::chrono::steady_clock::now();
+    rss_mb = residentMb();
+    if (measured) {
+        double wall_us = std::chrono::duration<double, std::micro>(now - last_time).count();
+        cpu_percent = wall_us > 0 ? (cpu_us - last_cpu_us) / wall_us * 100.0 : 0.0;
+    }
+    measured = true;
+    last_cpu_us = cpu_us;
+    last_time = now;
+
+    cpu_gauge.store(cpu_percent, std::memory_order_relaxed);
+    rss_gauge.store(rss_mb * 1024 * 1024, std::memory_order_relaxed);
+    if (!limited()) {
+        level_gauge.store(level, std::memory_order_relaxed);
+        return false;
+    }
+
+    bool cpu_over = options.cpu_percent > 0 && cpu_percent > options.cpu_percent;
+    bool rss_over = options.rss_mb > 0 && rss_mb > options.rss_mb;
+    bool cpu_under = options.cpu_percent <= 0 || cpu_percent < options.cpu_percent * 0.7;
+    bool rss_under = options.rss_mb <= 0 || rss_mb < options.rss_mb * 0.7;
+
+    int previous = level;
+    if (cpu_over || rss_over) {
+        under_cycles = 0;
+        if (++over_cycles >= ESCALATE_AFTER && level < MAX_LEVEL) {
+            level++;
+            over_cycles = 0;
+        }
+    } else if (cpu_under && rss_under) {
+        over_cycles = 0;
+        if (++under_cycles >= RELAX_AFTER && level > 0) {
+            level--;
+            under_cycles = 0;
+        }
+    } else {
+        // Between 70% and 100%: hold the current level
+        over_cycles = under_cycles = 0;
+    }
+
+    level_gauge.store(level, std::memory_order_relaxed);
+    if (level != previous) {
+        changes.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+CollectionOptions ResourceBudget::collectionOptions() const {
+    CollectionOptions collect;
+    if (level >= 1) {
+        // cycle counts completed cycles, so this is the upcoming one
+        collect.processes = cycle % SLOW_PROCESS_EVERY == 0;
+        collect.top_processes = 3;
+    }
+    if (level >= 2) {
+        collect.per_core = false;
+        collect.gpus = false;
+        collect.sensors = false;
+    }
+    if (level >= 3) {
+        collect.processes = false;
+        collect.top_processes = 0;
+    }
+    return collect;
+}
+
+bool ResourceBudget::applyScheduling(const BudgetOptions& opts, std::string& error) {
+    if (!opts.cpus.empty()) {
+        cpu_set_t set;
+        if (!parseCpuList(opts.cpus, set)) {
+            error = "invalid CPU list '" + opts.cpus + "'";
+            return false;
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            error = std::string("sched_setaffinity: ") + strerror(errno);
+            return false;
+        }
+    }
+    if (opts.sched_idle) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        if (sched_setscheduler(0, SCHED_IDLE, &param) != 0) {
+            error = std::string("SCHED_IDLE: ") + strerror(errno);
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,797 @@
+#include "sample_log.h"
+#include "exporters.h"
+#include "self_stats.h"
+#include "delta_export.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <chrono>
+#include <thread>
+#include <iostream>
+
+static const char SAMPLE_LOG_MAGIC[8] = {'S', 'Y', 'S', 'R', 'P', 'T', 'B', 'L'};
+static const size_t RECORD_HEADER_BYTES = 5;   // u8 type + u32 length
+static const size_t SAMPLE_ENTRY_BYTES = 12;   // u32 id + i64 delta
+static const uint32_t MAX_SERIES = 1u << 20;
+static const int64_t MAX_VECTOR = 65536;
+
+// Every value UtilizationInfo carries. Names are part of the file format:
+// append new fields, never renumber or rename existing ones.
+enum Field {
+    F_CPU_PERCENT, F_RAM_USED, F_RAM_AVAILABLE, F_RAM_PERCENT,
+    F_SWAP_USED, F_SWAP_AVAILABLE, F_SWAP_PERCENT,
+    F_LOAD_1, F_LOAD_5, F_LOAD_15, F_UPTIME,
+    F_CORE_COUNT, F_CORE_PERCENT,
+    F_DISK_COUNT, F_DISK_MOUNT, F_DISK_DEVICE, F_DISK_TOTAL, F_DISK_USED,
+    F_DISK_AVAILABLE, F_DISK_PERCENT,
+    F_NET_COUNT, F_NET_INTERFACE, F_NET_RX_BYTES, F_NET_TX_BYTES,
+    F_NET_RX_MBPS, F_NET_TX_MBPS,
+    F_PROC_COUNT, F_PROC_PID, F_PROC_NAME, F_PROC_CPU, F_PROC_MEM,
+    F_TEMP_COUNT, F_TEMP,
+    F_GPU_COUNT, F_GPU_NAME, F_GPU_VENDOR, F_GPU_UTIL, F_GPU_MEM_USED,
+    F_GPU_MEM_TOTAL, F_GPU_TEMP, F_GPU_AVAILABLE,
+    F_BAT_PRESENT, F_BAT_CHARGING, F_BAT_PERCENT, F_BAT_CAPACITY,
+    F_BAT_STATUS, F_BAT_TIME,
+    F_FAN_COUNT, F_FAN_LABEL, F_FAN_RPM,
+    FIELD_COUNT
+};
+
+static const double MB = 1024.0 * 1024.0;
+static const double GB = MB * 1024.0;
+
+struct FieldSpec {
+    const char* group;   // nullptr for scalars, else "group[i].member"
+    const char* member;
+    const char* metric;  // Registry family it is exported as (for deadbands)
+    double scale;        // Stored unit -> that family's unit
+};
+
+static const FieldSpec FIELDS[FIELD_COUNT] = {
+    {nullptr, "cpu_percent", "cpu_usage_percent", 1},
+    {nullptr, "ram_used_mb", "memory_used_bytes", MB},
+    {nullptr, "ram_available_mb", "memory_available_bytes", MB},
+    {nullptr, "ram_percent", "memory_usage_percent", 1},
+    {nullptr, "swap_used_mb", "swap_used_bytes", MB},
+    {nullptr, "swap_available_mb", "swap_available_bytes", MB},
+    {nullptr, "swap_percent", "swap_usage_percent", 1},
+    {nullptr, "load_1", "cpu_load_average_1m", 1},
+    {nullptr, "load_5", "cpu_load_average_5m", 1},
+    {nullptr, "load_15", "cpu_load_average_15m", 1},
+    {nullptr, "uptime_seconds", "system_uptime_seconds", 1},
+    {nullptr, "core_count", nullptr, 1},
+    {"core", "percent", "cpu_core_usage_percent", 1},
+    {nullptr, "disk_count", nullptr, 1},
+    {"disk", "mount", nullptr, 1},
+    {"disk", "device", nullptr, 1},
+    {"disk", "total_gb", "disk_total_bytes", GB},
+    {"disk", "used_gb", "disk_used_bytes", GB},
+    {"disk", "available_gb", "disk_available_bytes", GB},
+    {"disk", "percent", "disk_usage_percent", 1},
+    {nullptr, "net_count", nullptr, 1},
+    {"net", "interface", nullptr, 1},
+    {"net", "rx_bytes", "network_rx_bytes_total", 1},
+    {"net", "tx_bytes", "network_tx_bytes_total", 1},
+    {"net", "rx_mbps", "network_rx_mbps", 1},
+    {"net", "tx_mbps", "network_tx_mbps", 1},
+    {nullptr, "proc_count", nullptr, 1},
+    {"proc", "pid", nullptr, 1},
+    {"proc", "name", nullptr, 1},
+    {"proc", "cpu_percent", "process_cpu_percent", 1},
+    {"proc", "mem_mb", "process_memory_bytes", MB},
+    {nullptr, "temp_count", nullptr, 1},
+    {"temp", "celsius", "cpu_temperature_celsius", 1},
+    {nullptr, "gpu_count", nullptr, 1},
+    {"gpu", "name", nullptr, 1},
+    {"gpu", "vendor", nullptr, 1},
+    {"gpu", "percent", "gpu_utilization_percent", 1},
+    {"gpu", "mem_used_mb", "gpu_memory_used_bytes", MB},
+    {"gpu", "mem_total_mb", "gpu_memory_total_bytes", MB},
+    {"gpu", "celsius", "gpu_temperature_celsius", 1},
+    {"gpu", "available", nullptr, 1},
+    {nullptr, "battery_present", nullptr, 1},
+    {nullptr, "battery_charging", nullptr, 1},
+    {nullptr, "battery_percent", "battery_charge_percent", 1},
+    {nullptr, "battery_capacity_percent", "battery_capacity_percent", 1},
+    {nullptr, "battery_status", nullptr, 1},
+    {nullptr, "battery_minutes_remaining", "battery_time_remaining_seconds", 60},
+    {nullptr, "fan_count", nullptr, 1},
+    {"fan", "label", nullptr, 1},
+    {"fan", "rpm", "fan_speed_rpm", 1},
+};
+
+static std::string seriesName(int field, uint32_t index) {
+    const FieldSpec& spec = FIELDS[field];
+    if (!spec.group) return spec.member;
+    return std::string(spec.group) + "[" + std::to_string(index) + "]." + spec.member;
+}
+
+// Inverse of seriesName(); field is -1 for names this build does not know
+static void parseSeriesName(const std::string& name, int& field, uint32_t& index) {
+    field = -1;
+    index = 0;
+
+    std::string group, member = name;
+    size_t open = name.find('[');
+    if (open != std::string::npos) {
+        size_t close = name.find("].", open);
+        if (close == std::string::npos) return;
+        group = name.substr(0, open);
+        member = name.substr(close + 2);
+        try {
+            index = static_cast<uint32_t>(std::stoul(name.substr(open + 1, close - open - 1)));
+        } catch (...) {
+            return;
+        }
+    }
+
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        const FieldSpec& spec = FIELDS[f];
+        if (member != spec.member) continue;
+        if (group.empty() ? spec.group == nullptr : (spec.group && group == spec.group)) {
+            field = f;
+            return;
+        }
+    }
+}
+
+static void putU8(std::string& out, uint8_t v) {
+    out.push_back(static_cast<char>(v));
+}
+
+static void putU16(std::string& out, uint16_t v) {
+    out.push_back(static_cast<char>(v & 0xff));
+    out.push_back(static_cast<char>(v >> 8));
+}
+
+static void putU32(char* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<char>((v >> (8 * i)) & 0xff);
+}
+
+static void putU32(std::string& out, uint32_t v) {
+    char buf[4];
+    putU32(buf, v);
+    out.append(buf, 4);
+}
+
+static void putI64(char* p, int64_t value) {
+    uint64_t v = static_cast<uint64_t>(value);
+    for (int i = 0; i < 8; i++) p[i] = static_cast<char>((v >> (8 * i)) & 0xff);
+}
+
+static void putI64(std::string& out, int64_t v) {
+    char buf[8];
+    putI64(buf, v);
+    out.append(buf, 8);
+}
+
+static uint16_t getU16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static int64_t getI64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return static_cast<int64_t>(v);
+}
+
+static void putRecordHeader(std::string& out, SampleRecordType type, size_t length) {
+    putU8(out, static_cast<uint8_t>(type));
+    putU32(out, static_cast<uint32_t>(length));
+}
+
+// ---------------------------------------------------------------------------
+// Encoder
+
+SampleLogEncoder::SampleLogEncoder()
+    : entry_count(0), deadbands(FIELD_COUNT, 0), keyframe_every(0), samples(0) {
+}
+
+void SampleLogEncoder::setDelta(const DeltaOptions& options) {
+    deadbands.assign(FIELD_COUNT, 0);
+    keyframe_every = 0;
+    if (!options.enabled) return;
+
+    DeadbandPatterns patterns;
+    std::string error;
+    parseDeadbands(options.deadbands, patterns, error);
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        // Counts, identities and flags always go out exactly
+        if (!FIELDS[f].metric) continue;
+        deadbands[f] = deadbandFor(options, patterns, FIELDS[f].metric) / FIELDS[f].scale;
+    }
+    keyframe_every = options.keyframe_every;
+}
+
+void SampleLogEncoder::reset() {
+    ids.clear();
+    last_values.clear();
+    last_texts.clear();
+}
+
+std::string SampleLogEncoder::fileHeader() {
+    char host[256] = {0};
+    gethostname(host, sizeof(host) - 1);
+    size_t host_len = strlen(host);
+
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::string out;
+    putRecordHeader(out, SampleRecordType::HEADER, sizeof(SAMPLE_LOG_MAGIC) + 2 + 2 + 8 + host_len);
+    out.append(SAMPLE_LOG_MAGIC, sizeof(SAMPLE_LOG_MAGIC));
+    putU16(out, SAMPLE_LOG_VERSION);
+    putU16(out, 0);
+    putI64(out, now_ms);
+    out.append(host, host_len);
+    return out;
+}
+
+std::string SampleLogEncoder::note(const std::string& text) {
+    std::string out;
+    putRecordHeader(out, SampleRecordType::NOTE, text.size());
+    out += text;
+    return out;
+}
+
+uint32_t SampleLogEncoder::seriesId(int field, uint32_t index, SampleSeriesKind kind, bool& fresh) {
+    uint64_t key = (static_cast<uint64_t>(field) << 32) | index;
+    auto it = ids.find(key);
+    fresh = it == ids.end();
+    if (!fresh) return it->second;
+
+    uint32_t id = static_cast<uint32_t>(last_values.size());
+    ids.emplace(key, id);
+    last_values.push_back(0);
+    last_texts.emplace_back();
+
+    std::string name = seriesName(field, index);
+    putRecordHeader(out, SampleRecordType::SERIES, 4 + 1 + name.size());
+    putU32(out, id);
+    putU8(out, static_cast<uint8_t>(kind));
+    out += name;
+    return id;
+}
+
+void SampleLogEncoder::integer(int field, uint32_t index, int64_t value) {
+    bool fresh;
+    uint32_t id = seriesId(field, index, SampleSeriesKind::INT, fresh);
+    int64_t delta = value - last_values[id];
+    // A series just defined (first sample, keyframe) always gets its absolute value
+    if (!fresh && (delta == 0 || std::llabs(delta) <= deadbands[field])) return;
+    last_values[id] = value;
+
+    size_t pos = entries.size();
+    entries.resize(pos + SAMPLE_ENTRY_BYTES);
+    putU32(&entries[pos], id);
+    putI64(&entries[pos + 4], delta);
+    entry_count++;
+}
+
+void SampleLogEncoder::number(int field, uint32_t index, double value) {
+    if (!std::isfinite(value)) value = 0;
+    bool fresh;
+    uint32_t id = seriesId(field, index, SampleSeriesKind::MILLI, fresh);
+    int64_t scaled = std::llround(value * 1000.0);
+    int64_t delta = scaled - last_values[id];
+    if (!fresh && (delta == 0 || std::llabs(delta) <= deadbands[field] * 1000.0)) return;
+    last_values[id] = scaled;
+
+    size_t pos = entries.size();
+    entries.resize(pos + SAMPLE_ENTRY_BYTES);
+    putU32(&entries[pos], id);
+    putI64(&entries[pos + 4], delta);
+    entry_count++;
+}
+
+void SampleLogEncoder::text(int field, uint32_t index, const std::string& value) {
+    bool fresh;
+    uint32_t id = seriesId(field, index, SampleSeriesKind::TEXT, fresh);
+    if (value == last_texts[id]) return;    // New series read back as ""
+    last_texts[id] = value;
+
+    putRecordHeader(out, SampleRecordType::TEXT, 4 + value.size());
+    putU32(out, id);
+    out += value;
+}
+
+std::string SampleLogEncoder::encode(const UtilizationInfo& util, int64_t timestamp_ms) {
+    SELF_STATS_SCOPE(StageKind::FORMATTER, "binary_log");
+
+    out.clear();
+
+    // A keyframe starts over as if in a new segment: readers drop their
+    // series at the header and get every value again, absolute
+    if (keyframe_every > 0 && samples > 0 && samples % keyframe_every == 0) {
+        reset();
+        out = fileHeader();
+    }
+    samples++;
+
+    entries.clear();
+    entry_count = 0;
+
+    number(F_CPU_PERCENT, 0, util.cpu_percent);
+    integer(F_RAM_USED, 0, util.used_ram_mb);
+    integer(F_RAM_AVAILABLE, 0, util.available_ram_mb);
+    number(F_RAM_PERCENT, 0, util.ram_percent);
+    integer(F_SWAP_USED, 0, util.used_swap_mb);
+    integer(F_SWAP_AVAILABLE, 0, util.available_swap_mb);
+    number(F_SWAP_PERCENT, 0, util.swap_percent);
+    number(F_LOAD_1, 0, util.load_avg_1);
+    number(F_LOAD_5, 0, util.load_avg_5);
+    number(F_LOAD_15, 0, util.load_avg_15);
+    integer(F_UPTIME, 0, util.uptime_seconds);
+
+    integer(F_CORE_COUNT, 0, util.cpu_per_core.size());
+    for (uint32_t i = 0; i < util.cpu_per_core.size(); i++) {
+        number(F_CORE_PERCENT, i, util.cpu_per_core[i]);
+    }
+
+    integer(F_DISK_COUNT, 0, util.disks.size());
+    for (uint32_t i = 0; i < util.disks.size(); i++) {
+        const DiskInfo& disk = util.disks[i];
+        text(F_DISK_MOUNT, i, disk.mount_point);
+        text(F_DISK_DEVICE, i, disk.device);
+        integer(F_DISK_TOTAL, i, disk.total_gb);
+        integer(F_DISK_USED, i, disk.used_gb);
+        integer(F_DISK_AVAILABLE, i, disk.available_gb);
+        number(F_DISK_PERCENT, i, disk.percent);
+    }
+
+    integer(F_NET_COUNT, 0, util.network.size());
+    for (uint32_t i = 0; i < util.network.size(); i++) {
+        const NetworkInfo& net = util.network[i];
+        text(F_NET_INTERFACE, i, net.interface);
+        integer(F_NET_RX_BYTES, i, net.rx_bytes);
+        integer(F_NET_TX_BYTES, i, net.tx_bytes);
+        number(F_NET_RX_MBPS, i, net.rx_mbps);
+        number(F_NET_TX_MBPS, i, net.tx_mbps);
+    }
+
+    integer(F_PROC_COUNT, 0, util.top_processes.size());
+    for (uint32_t i = 0; i < util.top_processes.size(); i++) {
+        const ProcessInfo& proc = util.top_processes[i];
+        integer(F_PROC_PID, i, proc.pid);
+        text(F_PROC_NAME, i, proc.name);
+        number(F_PROC_CPU, i, proc.cpu_percent);
+        integer(F_PROC_MEM, i, proc.mem_mb);
+    }
+
+    integer(F_TEMP_COUNT, 0, util.temperatures.size());
+    for (uint32_t i = 0; i < util.temperatures.size(); i++) {
+        number(F_TEMP, i, util.temperatures[i]);
+    }
+
+    integer(F_GPU_COUNT, 0, util.gpus.size());
+    for (uint32_t i = 0; i < util.gpus.size(); i++) {
+        const GPUInfo& gpu = util.gpus[i];
+        text(F_GPU_NAME, i, gpu.name);
+        text(F_GPU_VENDOR, i, gpu.vendor);
+        number(F_GPU_UTIL, i, gpu.utilization_percent);
+        number(F_GPU_MEM_USED, i, gpu.memory_used_mb);
+        number(F_GPU_MEM_TOTAL, i, gpu.memory_total_mb);
+        number(F_GPU_TEMP, i, gpu.temperature);
+        integer(F_GPU_AVAILABLE, i, gpu.available ? 1 : 0);
+    }
+
+    integer(F_BAT_PRESENT, 0, util.battery.present ? 1 : 0);
+    if (util.battery.present) {
+        integer(F_BAT_CHARGING, 0, util.battery.charging ? 1 : 0);
+        number(F_BAT_PERCENT, 0, util.battery.percent);
+        number(F_BAT_CAPACITY, 0, util.battery.capacity_percent);
+        text(F_BAT_STATUS, 0, util.battery.status);
+        integer(F_BAT_TIME, 0, util.battery.time_remaining_minutes);
+    }
+
+    integer(F_FAN_COUNT, 0, util.fans.size());
+    for (uint32_t i = 0; i < util.fans.size(); i++) {
+        text(F_FAN_LABEL, i, util.fans[i].label);
+        integer(F_FAN_RPM, i, util.fans[i].rpm);
+    }
+
+    putRecordHeader(out, SampleRecordType::SAMPLE, 8 + 4 + entries.size());
+    putI64(out, timestamp_ms);
+    putU32(out, entry_count);
+    out.append(entries.data(), entries.size());
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+
+SampleLogReader::SampleLogReader()
+    : fd(-1), data(nullptr), size(0), offset(0) {
+}
+
+SampleLogReader::~SampleLogReader() {
+    close();
+}
+
+bool SampleLogReader::open(const std::string& path) {
+    close();
+    error.clear();
+
+    size_t len = path.size();
+    if (len > 3 && path.compare(len - 3, 3, ".gz") == 0) {
+        // Rotated segments are gzip-compressed; inflate them into memory
+        gzFile gz = gzopen(path.c_str(), "rb");
+        if (!gz) {
+            error = "cannot open file";
+            return false;
+        }
+        char buffer[64 * 1024];
+        int n;
+        while ((n = gzread(gz, buffer, sizeof(buffer))) > 0) {
+            inflated.append(buffer, n);
+        }
+        gzclose(gz);
+        data = reinterpret_cast<const uint8_t*>(inflated.data());
+        size = inflated.size();
+    } else {
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            error = "cannot open file";
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            error = "cannot stat file";
+            close();
+            return false;
+        }
+        size = static_cast<size_t>(st.st_size);
+        if (size > 0) {
+            void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map == MAP_FAILED) {
+                error = "mmap failed";
+                close();
+                return false;
+            }
+            madvise(map, size, MADV_SEQUENTIAL);
+            data = static_cast<const uint8_t*>(map);
+        }
+    }
+
+    if (size < RECORD_HEADER_BYTES + sizeof(SAMPLE_LOG_MAGIC) ||
+        data[0] != static_cast<uint8_t>(SampleRecordType::HEADER) ||
+        memcmp(data + RECORD_HEADER_BYTES, SAMPLE_LOG_MAGIC, sizeof(SAMPLE_LOG_MAGIC)) != 0) {
+        error = "not a sysreport binary log";
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SampleLogReader::close() {
+    if (fd >= 0) {
+        if (data && size > 0) munmap(const_cast<uint8_t*>(data), size);
+        ::close(fd);
+        fd = -1;
+    }
+    inflated.clear();
+    data = nullptr;
+    size = 0;
+    offset = 0;
+    series.clear();
+}
+
+bool SampleLogReader::next(UtilizationInfo& util, int64_t& timestamp_ms,
+                           std::vector<std::string>* notes) {
+    while (offset + RECORD_HEADER_BYTES <= size) {
+        uint8_t type = data[offset];
+        uint32_t length = getU32(data + offset + 1);
+        if (length > size - offset - RECORD_HEADER_BYTES) {
+            return false;  // Truncated tail: the writer is mid-batch or crashed
+        }
+        const uint8_t* p = data + offset + RECORD_HEADER_BYTES;
+        size_t at = offset;
+        offset += RECORD_HEADER_BYTES + length;
+
+        switch (static_cast<SampleRecordType>(type)) {
+            case SampleRecordType::HEADER: {
+                if (length < sizeof(SAMPLE_LOG_MAGIC) + 12 ||
+                    memcmp(p, SAMPLE_LOG_MAGIC, sizeof(SAMPLE_LOG_MAGIC)) != 0) {
+                    error = "bad header at offset " + std::to_string(at);
+                    return false;
+                }
+                uint16_t version = getU16(p + 8);
+                if (version > SAMPLE_LOG_VERSION) {
+                    error = "unsupported format version " + std::to_string(version);
+                    return false;
+                }
+                hostname.assign(reinterpret_cast<const char*>(p) + 20, length - 20);
+                series.clear();
+                break;
+            }
+            case SampleRecordType::SERIES: {
+                if (length < 5) {
+                    error = "bad series record at offset " + std::to_string(at);
+                    return false;
+                }
+                uint32_t id = getU32(p);
+                if (id >= MAX_SERIES) {
+                    error = "series id out of range at offset " + std::to_string(at);
+                    return false;
+                }
+                if (id >= series.size()) series.resize(id + 1);
+
+                Series& s = series[id];
+                s.name.assign(reinterpret_cast<const char*>(p) + 5, length - 5);
+                s.kind = static_cast<SampleSeriesKind>(p[4]);
+                s.value = 0;
+                s.text.clear();
+                s.defined = true;
+                parseSeriesName(s.name, s.field, s.index);
+                break;
+            }
+            case SampleRecordType::TEXT: {
+                if (length < 4 || getU32(p) >= series.size()) {
+                    error = "bad text record at offset " + std::to_string(at);
+                    return false;
+                }
+                series[getU32(p)].text.assign(reinterpret_cast<const char*>(p) + 4, length - 4);
+                break;
+            }
+            case SampleRecordType::SAMPLE: {
+                if (length < 12) {
+                    error = "bad sample record at offset " + std::to_string(at);
+                    return false;
+                }
+                uint32_t count = getU32(p + 8);
+                if (length != 12 + static_cast<uint64_t>(count) * SAMPLE_ENTRY_BYTES) {
+                    error = "bad sample record at offset " + std::to_string(at);
+                    return false;
+                }
+                timestamp_ms = getI64(p);
+
+                const uint8_t* entry = p + 12;
+                for (uint32_t i = 0; i < count; i++, entry += SAMPLE_ENTRY_BYTES) {
+                    uint32_t id = getU32(entry);
+                    if (id >= series.size()) {
+                        error = "undefined series in sample at offset " + std::to_string(at);
+                        return false;
+                    }
+                    series[id].value += getI64(entry + 4);
+                }
+                build(util);
+                return true;
+            }
+            case SampleRecordType::NOTE:
+                if (notes) notes->emplace_back(reinterpret_cast<const char*>(p), length);
+                break;
+            default:
+                error = "unknown record type " + std::to_string(type) +
+                        " at offset " + std::to_string(at);
+                return false;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> SampleLogReader::seriesNames() const {
+    std::vector<std::string> names;
+    names.reserve(series.size());
+    for (const auto& s : series) {
+        names.push_back(s.name);
+    }
+    return names;
+}
+
+void SampleLogReader::build(UtilizationInfo& util) const {
+    util = UtilizationInfo();
+    util.battery.time_remaining_minutes = -1;
+
+    // Vector lengths first, so element series have somewhere to land
+    for (const auto& s : series) {
+        if (!s.defined || s.field < 0) continue;
+        size_t n = static_cast<size_t>(std::max<int64_t>(0, std::min(s.value, MAX_VECTOR)));
+        switch (s.field) {
+            case F_CORE_COUNT: util.cpu_per_core.resize(n); break;
+            case F_DISK_COUNT: util.disks.resize(n); break;
+            case F_NET_COUNT: util.network.resize(n); break;
+            case F_PROC_COUNT: util.top_processes.resize(n); break;
+            case F_TEMP_COUNT: util.temperatures.resize(n); break;
+            case F_GPU_COUNT: util.gpus.resize(n); break;
+            case F_FAN_COUNT: util.fans.resize(n); break;
+            default: break;
+        }
+    }
+
+    for (const auto& s : series) {
+        if (!s.defined || s.field < 0) continue;
+        double d = s.kind == SampleSeriesKind::MILLI ? s.value / 1000.0 : static_cast<double>(s.value);
+        long l = static_cast<long>(s.value);
+        uint32_t i = s.index;
+
+        switch (s.field) {
+            case F_CPU_PERCENT: util.cpu_percent = d; break;
+            case F_RAM_USED: util.used_ram_mb = l; break;
+            case F_RAM_AVAILABLE: util.available_ram_mb = l; break;
+            case F_RAM_PERCENT: util.ram_percent = d; break;
+            case F_SWAP_USED: util.used_swap_mb = l; break;
+            case F_SWAP_AVAILABLE: util.available_swap_mb = l; break;
+            case F_SWAP_PERCENT: util.swap_percent = d; break;
+            case F_LOAD_1: util.load_avg_1 = d; break;
+            case F_LOAD_5: util.load_avg_5 = d; break;
+            case F_LOAD_15: util.load_avg_15 = d; break;
+            case F_UPTIME:
+                util.uptime_seconds = l;
+                util.uptime = formatUptime(l);
+                break;
+
+            case F_CORE_PERCENT:
+                if (i < util.cpu_per_core.size()) util.cpu_per_core[i] = d;
+                break;
+
+            case F_DISK_MOUNT:
+                if (i < util.disks.size()) util.disks[i].mount_point = s.text;
+                break;
+            case F_DISK_DEVICE:
+                if (i < util.disks.size()) util.disks[i].device = s.text;
+                break;
+            case F_DISK_TOTAL:
+                if (i < util.disks.size()) util.disks[i].total_gb = l;
+                break;
+            case F_DISK_USED:
+                if (i < util.disks.size()) util.disks[i].used_gb = l;
+                break;
+            case F_DISK_AVAILABLE:
+                if (i < util.disks.size()) util.disks[i].available_gb = l;
+                break;
+            case F_DISK_PERCENT:
+                if (i < util.disks.size()) util.disks[i].percent = d;
+                break;
+
+            case F_NET_INTERFACE:
+                if (i < util.network.size()) util.network[i].interface = s.text;
+                break;
+            case F_NET_RX_BYTES:
+                if (i < util.network.size()) util.network[i].rx_bytes = l;
+                break;
+            case F_NET_TX_BYTES:
+                if (i < util.network.size()) util.network[i].tx_bytes = l;
+                break;
+            case F_NET_RX_MBPS:
+                if (i < util.network.size()) util.network[i].rx_mbps = d;
+                break;
+            case F_NET_TX_MBPS:
+                if (i < util.network.size()) util.network[i].tx_mbps = d;
+                break;
+
+            case F_PROC_PID:
+                if (i < util.top_processes.size()) util.top_processes[i].pid = static_cast<int>(l);
+                break;
+            case F_PROC_NAME:
+                if (i < util.top_processes.size()) util.top_processes[i].name = s.text;
+                break;
+            case F_PROC_CPU:
+                if (i < util.top_processes.size()) util.top_processes[i].cpu_percent = d;
+                break;
+            case F_PROC_MEM:
+                if (i < util.top_processes.size()) util.top_processes[i].mem_mb = l;
+                break;
+
+            case F_TEMP:
+                if (i < util.temperatures.size()) util.temperatures[i] = d;
+                break;
+
+            case F_GPU_NAME:
+                if (i < util.gpus.size()) util.gpus[i].name = s.text;
+                break;
+            case F_GPU_VENDOR:
+                if (i < util.gpus.size()) util.gpus[i].vendor = s.text;
+                break;
+            case F_GPU_UTIL:
+                if (i < util.gpus.size()) util.gpus[i].utilization_percent = d;
+                break;
+            case F_GPU_MEM_USED:
+                if (i < util.gpus.size()) util.gpus[i].memory_used_mb = d;
+                break;
+            case F_GPU_MEM_TOTAL:
+                if (i < util.gpus.size()) util.gpus[i].memory_total_mb = d;
+                break;
+            case F_GPU_TEMP:
+                if (i < util.gpus.size()) util.gpus[i].temperature = d;
+                break;
+            case F_GPU_AVAILABLE:
+                if (i < util.gpus.size()) util.gpus[i].available = l != 0;
+                break;
+
+            case F_BAT_PRESENT: util.battery.present = l != 0; break;
+            case F_BAT_CHARGING: util.battery.charging = l != 0; break;
+            case F_BAT_PERCENT: util.battery.percent = d; break;
+            case F_BAT_CAPACITY: util.battery.capacity_percent = d; break;
+            case F_BAT_STATUS: util.battery.status = s.text; break;
+            case F_BAT_TIME: util.battery.time_remaining_minutes = static_cast<int>(l); break;
+
+            case F_FAN_LABEL:
+                if (i < util.fans.size()) util.fans[i].label = s.text;
+                break;
+            case F_FAN_RPM:
+                if (i < util.fans.size()) util.fans[i].rpm = static_cast<int>(l);
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Replay
+
+int replaySampleLog(const std::string& path, const std::string& format,
+                    bool realtime, const DisplayOptions& display) {
+    SampleLogReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Error: cannot read " << path << ": " << reader.getError() << std::endl;
+        return 1;
+    }
+
+    DisplayOptions opts = display;
+    opts.format = format;
+    opts.show_static = false;
+    opts.show_dynamic = true;
+    HardwareInfo hw = HardwareInfo();
+
+    UtilizationInfo util;
+    int64_t timestamp_ms = 0;
+    int64_t previous_ms = -1;
+    std::vector<std::string> notes;
+    size_t samples = 0;
+
+    while (reader.next(util, timestamp_ms, &notes)) {
+        // Daemon notes go to stderr so stdout stays machine-readable
+        for (const auto& note : notes) {
+            std::cerr << note << "\n";
+        }
+        notes.clear();
+
+        if (realtime && previous_ms >= 0 && timestamp_ms > previous_ms) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timestamp_ms - previous_ms));
+        }
+        previous_ms = timestamp_ms;
+
+        if (format == "prometheus") {
+            std::cout << PrometheusExporter::exportMetrics(util, false);
+        } else if (format == "influxdb") {
+            std::cout << InfluxDBExporter::exportMetrics(util, "sysreport", timestamp_ms * 1000000L);
+        } else {
+            if (format == "text") {
+                time_t seconds = static_cast<time_t>(timestamp_ms / 1000);
+                std::string when = ctime(&seconds);
+                if (!when.empty() && when.back() == '\n') when.pop_back();
+                std::cout << "=== " << when << " ===\n";
+            }
+            opts.sample_time = static_cast<time_t>(timestamp_ms / 1000);
+            std::cout << formatOutput(hw, util, opts);
+            // ndjson is already one line per sample
+            if (format != "ndjson") std::cout << "\n";
+        }
+        if (realtime) std::cout.flush();
+        samples++;
+    }
+    for (const auto& note : notes) {
+        std::cerr << note << "\n";
+    }
+    std::cout.flush();
+
+    if (!reader.getError().empty()) {
+        std::cerr << "Warning: stopped after " << samples << " sample(s): "
+                  << reader.getError() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "scheduler.h"
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include <ctime>
+#include <cerrno>
+#include <algorithm>
+
+static const long NANOS_PER_MS = 1000000L;
+static const long NANOS_PER_SEC = 1000000000L;
+
+static int64_t toNanos(const struct timespec& ts) {
+    return static_cast<int64_t>(ts.tv_sec) * NANOS_PER_SEC + ts.tv_nsec;
+}
+
+static struct timespec fromNanos(int64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = ns / NANOS_PER_SEC;
+    ts.tv_nsec = ns % NANOS_PER_SEC;
+    return ts;
+}
+
+Scheduler::Scheduler()
+    : epoll_fd(-1), timer_fd(-1), signal_fd(-1), interval_ms(0), align(true),
+      mask_saved(false), tick_count(0), skipped_total(0), skipped_last(0),
+      ready_fd(-1) {
+    sigemptyset(&old_mask);
+}
+
+Scheduler::~Scheduler() {
+    stop();
+}
+
+bool Scheduler::start(long interval, bool align_to_wall_clock) {
+    if (interval <= 0) return false;
+
+    interval_ms = interval;
+    align = align_to_wall_clock;
+
+    // Route termination and reload signals through a signalfd
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGHUP);
+    if (sigprocmask(SIG_BLOCK, &mask, &old_mask) != 0) {
+        return false;
+    }
+    mask_saved = true;
+
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (signal_fd < 0 || timer_fd < 0 || epoll_fd < 0) {
+        stop();
+        return false;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = signal_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev);
+    ev.data.fd = timer_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev);
+
+    if (!armTimer()) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void Scheduler::stop() {
+    if (epoll_fd >= 0) close(epoll_fd);
+    if (timer_fd >= 0) close(timer_fd);
+    if (signal_fd >= 0) close(signal_fd);
+    epoll_fd = timer_fd = signal_fd = -1;
+    watched_fds.clear();
+
+    if (mask_saved) {
+        sigprocmask(SIG_SETMASK, &old_mask, nullptr);
+        mask_saved = false;
+    }
+}
+
+bool Scheduler::setInterval(long interval) {
+    if (interval <= 0) return false;
+    interval_ms = interval;
+    return timer_fd < 0 || armTimer();
+}
+
+bool Scheduler::armTimer() {
+    int64_t period_ns = static_cast<int64_t>(interval_ms) * NANOS_PER_MS;
+
+    struct timespec mono_now, wall_now;
+    clock_gettime(CLOCK_MONOTONIC, &mono_now);
+    clock_gettime(CLOCK_REALTIME, &wall_now);
+
+    // Offset to the next wall-clock multiple of the period, applied to the
+    // monotonic clock so later wall-clock steps cannot disturb the cadence
+    int64_t offset_ns = period_ns;
+    if (align) {
+        int64_t wall_ns = toNanos(wall_now);
+        offset_ns = period_ns - (wall_ns % period_ns);
+    }
+
+    struct itimerspec spec;
+    spec.it_value = fromNanos(toNanos(mono_now) + offset_ns);
+    spec.it_interval = fromNanos(period_ns);
+
+    return timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) == 0;
+}
+
+bool Scheduler::watchFd(int fd) {
+    if (epoll_fd < 0 || fd < 0) return false;
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) return false;
+
+    watched_fds.push_back(fd);
+    return true;
+}
+
+void Scheduler::unwatchFd(int fd) {
+    auto it = std::find(watched_fds.begin(), watched_fds.end(), fd);
+    if (it == watched_fds.end()) return;
+
+    if (epoll_fd >= 0) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    watched_fds.erase(it);
+}
+
+SchedulerEvent Scheduler::wait() {
+    if (epoll_fd < 0) return SchedulerEvent::ERROR;
+
+    ready_fd = -1;
+    for (;;) {
+        struct epoll_event events[4];
+        int n = epoll_wait(epoll_fd, events, 4, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return SchedulerEvent::ERROR;
+        }
+
+        // Signals take priority so shutdown is never delayed by a tick
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd != signal_fd) continue;
+
+            struct signalfd_siginfo info;
+            if (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+                if (info.ssi_signo == SIGHUP) return SchedulerEvent::HANGUP;
+                return SchedulerEvent::TERMINATE;
+            }
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == timer_fd) {
+                uint64_t expirations = 0;
+                if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+                    continue;
+                }
+                // More than one expiry means the previous cycle overran
+                skipped_last = expirations > 1 ? expirations - 1 : 0;
+                skipped_total += skipped_last;
+                tick_count++;
+                return SchedulerEvent::TICK;
+            }
+            if (fd != signal_fd) {
+                ready_fd = fd;
+                return SchedulerEvent::FD_READY;
+            }
+        }
+    }
+}
@@ -0,0 +1,314 @@
+#include "self_stats.h"
+#include "format.h"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+
+// Bucket upper bounds: 10us .. 10s, roughly 1-2.5-5 per decade
+const uint64_t LatencyHistogram::BUCKET_BOUNDS_NS[LatencyHistogram::NUM_BUCKETS] = {
+    10000ULL, 25000ULL, 50000ULL,
+    100000ULL, 250000ULL, 500000ULL,
+    1000000ULL, 2500000ULL, 5000000ULL,
+    10000000ULL, 25000000ULL, 50000000ULL,
+    100000000ULL, 250000000ULL, 500000000ULL,
+    1000000000ULL, 2500000000ULL, 5000000000ULL,
+    10000000000ULL
+};
+
+LatencyHistogram::LatencyHistogram() : samples(0), total_ns(0), max_ns(0) {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds) {
+    size_t idx = 0;
+    while (idx < NUM_BUCKETS && nanoseconds > BUCKET_BOUNDS_NS[idx]) {
+        idx++;
+    }
+    buckets[idx].fetch_add(1, std::memory_order_relaxed);
+    samples.fetch_add(1, std::memory_order_relaxed);
+    total_ns.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t prev = max_ns.load(std::memory_order_relaxed);
+    while (nanoseconds > prev &&
+           !max_ns.compare_exchange_weak(prev, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::count() const {
+    return samples.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::sumNs() const {
+    return total_ns.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::maxNs() const {
+    return max_ns.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::bucketCount(size_t i) const {
+    if (i > NUM_BUCKETS) return 0;
+    return buckets[i].load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::quantileNs(double q) const {
+    uint64_t total = count();
+    if (total == 0) return 0;
+
+    uint64_t rank = static_cast<uint64_t>(q * total);
+    if (rank >= total) rank = total - 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        seen += bucketCount(i);
+        if (seen > rank) {
+            // Never report more than the slowest sample actually seen
+            return std::min(BUCKET_BOUNDS_NS[i], maxNs());
+        }
+    }
+    return maxNs();
+}
+
+// SelfStats registry
+
+std::mutex& SelfStats::registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<SelfStats::Entry>& SelfStats::registry() {
+    static std::vector<Entry> entries;
+    return entries;
+}
+
+LatencyHistogram& SelfStats::histogram(StageKind kind, const std::string& name) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    for (const auto& entry : registry()) {
+        if (entry.kind == kind && entry.name == name) {
+            return *entry.hist;
+        }
+    }
+    // Intentionally never freed: references are cached in function-local statics
+    LatencyHistogram* hist = new LatencyHistogram();
+    registry().push_back({kind, name, hist});
+    return *hist;
+}
+
+std::vector<SelfStats::CounterEntry>& SelfStats::counterRegistry() {
+    static std::vector<CounterEntry> entries;
+    return entries;
+}
+
+std::atomic<uint64_t>& SelfStats::counter(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    for (const auto& entry : counterRegistry()) {
+        if (entry.name == name) {
+            return *entry.value;
+        }
+    }
+    std::atomic<uint64_t>* value = new std::atomic<uint64_t>(0);
+    counterRegistry().push_back({name, help, value});
+    return *value;
+}
+
+std::vector<SelfStats::GaugeEntry>& SelfStats::gaugeRegistry() {
+    static std::vector<GaugeEntry> entries;
+    return entries;
+}
+
+std::atomic<double>& SelfStats::gauge(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    for (const auto& entry : gaugeRegistry()) {
+        if (entry.name == name) {
+            return *entry.value;
+        }
+    }
+    std::atomic<double>* value = new std::atomic<double>(0);
+    gaugeRegistry().push_back({name, help, value});
+    return *value;
+}
+
+std::vector<SelfStats::GaugeEntry> SelfStats::snapshotGauges() {
+    std::vector<GaugeEntry> entries;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        entries = gaugeRegistry();
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const GaugeEntry& a, const GaugeEntry& b) { return a.name < b.name; });
+    return entries;
+}
+
+std::vector<SelfStats::CounterEntry> SelfStats::snapshotCounters() {
+    std::vector<CounterEntry> entries;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        entries = counterRegistry();
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const CounterEntry& a, const CounterEntry& b) { return a.name < b.name; });
+    return entries;
+}
+
+std::vector<SelfStats::Entry> SelfStats::snapshotEntries() {
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        entries = registry();
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry& a, const Entry& b) {
+                         if (a.kind != b.kind) return a.kind < b.kind;
+                         return a.name < b.name;
+                     });
+    return entries;
+}
+
+const char* SelfStats::kindName(StageKind kind) {
+    switch (kind) {
+        case StageKind::COLLECTOR: return "collector";
+        case StageKind::FORMATTER: return "formatter";
+        case StageKind::EXPORTER: return "exporter";
+    }
+    return "stage";
+}
+
+static std::string formatSeconds(uint64_t ns) {
+    std::ostringstream oss;
+    oss << std::setprecision(9) << (ns / 1e9);
+    return oss.str();
+}
+
+static std::string formatMillis(uint64_t ns) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3) << (ns / 1e6);
+    return oss.str();
+}
+
+std::string SelfStats::exportPrometheus() {
+    std::vector<Entry> entries = snapshotEntries();
+    std::ostringstream oss;
+
+    bool have_family = false;
+    StageKind current_kind = StageKind::COLLECTOR;
+    for (const auto& entry : entries) {
+        if (entry.hist->count() == 0) continue;
+
+        std::string kind = kindName(entry.kind);
+        std::string family = "sysreport_" + kind + "_duration_seconds";
+        if (!have_family || entry.kind != current_kind) {
+            oss << "\n# HELP " << family << " Time spent in each sysreport " << kind << "\n";
+            oss << "# TYPE " << family << " histogram\n";
+            have_family = true;
+            current_kind = entry.kind;
+        }
+
+        std::string label = kind + "=\"" + entry.name + "\"";
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < LatencyHistogram::NUM_BUCKETS; b++) {
+            cumulative += entry.hist->bucketCount(b);
+            oss << family << "_bucket{" << label << ",le=\""
+                << formatSeconds(LatencyHistogram::BUCKET_BOUNDS_NS[b]) << "\"} "
+                << cumulative << "\n";
+        }
+        cumulative += entry.hist->bucketCount(LatencyHistogram::NUM_BUCKETS);
+        oss << family << "_bucket{" << label << ",le=\"+Inf\"} " << cumulative << "\n";
+        oss << family << "_sum{" << label << "} " << formatSeconds(entry.hist->sumNs()) << "\n";
+        oss << family << "_count{" << label << "} " << entry.hist->count() << "\n";
+    }
+
+    for (const auto& entry : snapshotCounters()) {
+        std::string family = "sysreport_" + entry.name;
+        oss << "\n# HELP " << family << " " << entry.help << "\n";
+        oss << "# TYPE " << family << " counter\n";
+        oss << family << " " << entry.value->load(std::memory_order_relaxed) << "\n";
+    }
+
+    for (const auto& entry : snapshotGauges()) {
+        std::string family = "sysreport_" + entry.name;
+        oss << "\n# HELP " << family << " " << entry.help << "\n";
+        oss << "# TYPE " << family << " gauge\n";
+        char value[32];
+        snprintf(value, sizeof(value), "%.10g", entry.value->load(std::memory_order_relaxed));
+        oss << family << " " << value << "\n";
+    }
+
+    return oss.str();
+}
+
+std::string SelfStats::formatText(bool use_colors) {
+    std::vector<Entry> entries = snapshotEntries();
+    std::ostringstream oss;
+
+    oss << createSeparator("SELF STATS") << "\n";
+
+    Table table;
+    table.addColumn("Stage");
+    table.addColumn("Name");
+    table.addColumn("Calls", true);
+    table.addColumn("Mean ms", true);
+    table.addColumn("p50 ms", true);
+    table.addColumn("p95 ms", true);
+    table.addColumn("Max ms", true);
+
+    size_t rows = 0;
+    for (const auto& entry : entries) {
+        uint64_t calls = entry.hist->count();
+        if (calls == 0) continue;
+
+        table.addRow({
+            kindName(entry.kind),
+            entry.name,
+            std::to_string(calls),
+            formatMillis(entry.hist->sumNs() / calls),
+            formatMillis(entry.hist->quantileNs(0.50)),
+            formatMillis(entry.hist->quantileNs(0.95)),
+            formatMillis(entry.hist->maxNs())
+        });
+        rows++;
+    }
+
+    if (rows == 0) {
+        oss << "No timings recorded\n";
+    } else {
+        oss << table.render(use_colors);
+    }
+
+    for (const auto& entry : snapshotCounters()) {
+        oss << entry.name << ": " << entry.value->load(std::memory_order_relaxed) << "\n";
+    }
+    for (const auto& entry : snapshotGauges()) {
+        oss << entry.name << ": " << entry.value->load(std::memory_order_relaxed) << "\n";
+    }
+
+    return oss.str();
+}
+
+std::vector<std::string> SelfStats::formatLogLines() {
+    std::vector<std::string> lines;
+    for (const auto& entry : snapshotEntries()) {
+        uint64_t calls = entry.hist->count();
+        if (calls == 0) continue;
+
+        std::ostringstream oss;
+        oss << kindName(entry.kind) << "=" << entry.name
+            << " calls=" << calls
+            << " mean_ms=" << formatMillis(entry.hist->sumNs() / calls)
+            << " p95_ms=" << formatMillis(entry.hist->quantileNs(0.95))
+            << " max_ms=" << formatMillis(entry.hist->maxNs());
+        lines.push_back(oss.str());
+    }
+    for (const auto& entry : snapshotCounters()) {
+        lines.push_back("counter=" + entry.name + " value=" +
+                        std::to_string(entry.value->load(std::memory_order_relaxed)));
+    }
+    for (const auto& entry : snapshotGauges()) {
+        std::ostringstream oss;
+        oss << "gauge=" << entry.name << " value=" << entry.value->load(std::memory_order_relaxed);
+        lines.push_back(oss.str());
+    }
+    return lines;
+}
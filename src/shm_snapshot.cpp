@@ -0,0 +1,320 @@
+#include "shm_snapshot.h"
+#include "self_stats.h"
+#include <signal.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+template <size_t N>
+static void copyText(char (&dest)[N], const std::string& src) {
+    size_t len = std::min(src.size(), N - 1);
+    memcpy(dest, src.data(), len);
+    memset(dest + len, 0, N - len);
+}
+
+template <size_t N>
+static std::string readText(const char (&src)[N]) {
+    return std::string(src, strnlen(src, N));
+}
+
+static uint32_t clampCount(size_t size, size_t limit) {
+    return static_cast<uint32_t>(std::min(size, limit));
+}
+
+void utilizationToSnapshot(const UtilizationInfo& util, struct sysreport_shm_snapshot& snap) {
+    snap.cpu_percent = util.cpu_percent;
+    snap.used_ram_mb = util.used_ram_mb;
+    snap.available_ram_mb = util.available_ram_mb;
+    snap.ram_percent = util.ram_percent;
+    snap.used_swap_mb = util.used_swap_mb;
+    snap.available_swap_mb = util.available_swap_mb;
+    snap.swap_percent = util.swap_percent;
+    snap.uptime_seconds = util.uptime_seconds;
+    snap.load_avg_1 = util.load_avg_1;
+    snap.load_avg_5 = util.load_avg_5;
+    snap.load_avg_15 = util.load_avg_15;
+
+    snap.battery.present = util.battery.present;
+    snap.battery.charging = util.battery.charging;
+    snap.battery.percent = util.battery.percent;
+    snap.battery.capacity_percent = util.battery.capacity_percent;
+    copyText(snap.battery.status, util.battery.status);
+    snap.battery.time_remaining_minutes = util.battery.time_remaining_minutes;
+
+    snap.core_count = clampCount(util.cpu_per_core.size(), SYSREPORT_SHM_MAX_CORES);
+    for (uint32_t i = 0; i < snap.core_count; i++) {
+        snap.cpu_per_core[i] = util.cpu_per_core[i];
+    }
+
+    snap.disk_count = clampCount(util.disks.size(), SYSREPORT_SHM_MAX_DISKS);
+    for (uint32_t i = 0; i < snap.disk_count; i++) {
+        const DiskInfo& disk = util.disks[i];
+        struct sysreport_shm_disk& out = snap.disks[i];
+        copyText(out.mount_point, disk.mount_point);
+        copyText(out.device, disk.device);
+        out.total_gb = disk.total_gb;
+        out.used_gb = disk.used_gb;
+        out.available_gb = disk.available_gb;
+        out.percent = disk.percent;
+    }
+
+    snap.net_count = clampCount(util.network.size(), SYSREPORT_SHM_MAX_NETS);
+    for (uint32_t i = 0; i < snap.net_count; i++) {
+        const NetworkInfo& net = util.network[i];
+        struct sysreport_shm_net& out = snap.network[i];
+        copyText(out.interface, net.interface);
+        out.rx_bytes = net.rx_bytes;
+        out.tx_bytes = net.tx_bytes;
+        out.rx_mbps = net.rx_mbps;
+        out.tx_mbps = net.tx_mbps;
+    }
+
+    snap.process_count = clampCount(util.top_processes.size(), SYSREPORT_SHM_MAX_PROCESSES);
+    for (uint32_t i = 0; i < snap.process_count; i++) {
+        const ProcessInfo& proc = util.top_processes[i];
+        struct sysreport_shm_process& out = snap.top_processes[i];
+        copyText(out.name, proc.name);
+        out.pid = proc.pid;
+        out.reserved = 0;
+        out.cpu_percent = proc.cpu_percent;
+        out.mem_mb = proc.mem_mb;
+    }
+
+    snap.temp_count = clampCount(util.temperatures.size(), SYSREPORT_SHM_MAX_TEMPS);
+    for (uint32_t i = 0; i < snap.temp_count; i++) {
+        snap.temperatures[i] = util.temperatures[i];
+    }
+
+    snap.gpu_count = clampCount(util.gpus.size(), SYSREPORT_SHM_MAX_GPUS);
+    for (uint32_t i = 0; i < snap.gpu_count; i++) {
+        const GPUInfo& gpu = util.gpus[i];
+        struct sysreport_shm_gpu& out = snap.gpus[i];
+        copyText(out.name, gpu.name);
+        copyText(out.vendor, gpu.vendor);
+        out.utilization_percent = gpu.utilization_percent;
+        out.memory_used_mb = gpu.memory_used_mb;
+        out.memory_total_mb = gpu.memory_total_mb;
+        out.temperature = gpu.temperature;
+        out.available = gpu.available;
+        out.reserved = 0;
+    }
+
+    snap.fan_count = clampCount(util.fans.size(), SYSREPORT_SHM_MAX_FANS);
+    for (uint32_t i = 0; i < snap.fan_count; i++) {
+        copyText(snap.fans[i].label, util.fans[i].label);
+        snap.fans[i].rpm = util.fans[i].rpm;
+        snap.fans[i].reserved = 0;
+    }
+}
+
+UtilizationInfo snapshotToUtilization(const struct sysreport_shm_snapshot& snap) {
+    UtilizationInfo util;
+    util.cpu_percent = snap.cpu_percent;
+    util.used_ram_mb = snap.used_ram_mb;
+    util.available_ram_mb = snap.available_ram_mb;
+    util.ram_percent = snap.ram_percent;
+    util.used_swap_mb = snap.used_swap_mb;
+    util.available_swap_mb = snap.available_swap_mb;
+    util.swap_percent = snap.swap_percent;
+    util.uptime_seconds = snap.uptime_seconds;
+    util.uptime = formatUptime(snap.uptime_seconds);
+    util.load_avg_1 = snap.load_avg_1;
+    util.load_avg_5 = snap.load_avg_5;
+    util.load_avg_15 = snap.load_avg_15;
+
+    util.battery.present = snap.battery.present != 0;
+    util.battery.charging = snap.battery.charging != 0;
+    util.battery.percent = snap.battery.percent;
+    util.battery.capacity_percent = snap.battery.capacity_percent;
+    util.battery.status = readText(snap.battery.status);
+    util.battery.time_remaining_minutes = snap.battery.time_remaining_minutes;
+
+    // Counts come from another process; never trust them past the arrays
+    uint32_t cores = std::min<uint32_t>(snap.core_count, SYSREPORT_SHM_MAX_CORES);
+    util.cpu_per_core.assign(snap.cpu_per_core, snap.cpu_per_core + cores);
+
+    for (uint32_t i = 0; i < std::min<uint32_t>(snap.disk_count, SYSREPORT_SHM_MAX_DISKS); i++) {
+        const struct sysreport_shm_disk& in = snap.disks[i];
+        DiskInfo disk;
+        disk.mount_point = readText(in.mount_point);
+        disk.device = readText(in.device);
+        disk.total_gb = in.total_gb;
+        disk.used_gb = in.used_gb;
+        disk.available_gb = in.available_gb;
+        disk.percent = in.percent;
+        util.disks.push_back(disk);
+    }
+
+    for (uint32_t i = 0; i < std::min<uint32_t>(snap.net_count, SYSREPORT_SHM_MAX_NETS); i++) {
+        const struct sysreport_shm_net& in = snap.network[i];
+        NetworkInfo net;
+        net.interface = readText(in.interface);
+        net.rx_bytes = in.rx_bytes;
+        net.tx_bytes = in.tx_bytes;
+        net.rx_mbps = in.rx_mbps;
+        net.tx_mbps = in.tx_mbps;
+        util.network.push_back(net);
+    }
+
+    for (uint32_t i = 0; i < std::min<uint32_t>(snap.process_count, SYSREPORT_SHM_MAX_PROCESSES); i++) {
+        const struct sysreport_shm_process& in = snap.top_processes[i];
+        ProcessInfo proc;
+        proc.pid = in.pid;
+        proc.name = readText(in.name);
+        proc.cpu_percent = in.cpu_percent;
+        proc.mem_mb = in.mem_mb;
+        util.top_processes.push_back(proc);
+    }
+
+    uint32_t temps = std::min<uint32_t>(snap.temp_count, SYSREPORT_SHM_MAX_TEMPS);
+    util.temperatures.assign(snap.temperatures, snap.temperatures + temps);
+
+    for (uint32_t i = 0; i < std::min<uint32_t>(snap.gpu_count, SYSREPORT_SHM_MAX_GPUS); i++) {
+        const struct sysreport_shm_gpu& in = snap.gpus[i];
+        GPUInfo gpu;
+        gpu.name = readText(in.name);
+        gpu.vendor = readText(in.vendor);
+        gpu.utilization_percent = in.utilization_percent;
+        gpu.memory_used_mb = in.memory_used_mb;
+        gpu.memory_total_mb = in.memory_total_mb;
+        gpu.temperature = in.temperature;
+        gpu.available = in.available != 0;
+        util.gpus.push_back(gpu);
+    }
+
+    for (uint32_t i = 0; i < std::min<uint32_t>(snap.fan_count, SYSREPORT_SHM_MAX_FANS); i++) {
+        FanInfo fan;
+        fan.label = readText(snap.fans[i].label);
+        fan.rpm = snap.fans[i].rpm;
+        util.fans.push_back(fan);
+    }
+    return util;
+}
+
+static bool processAlive(pid_t pid) {
+    // EPERM: alive, just owned by someone else (a root daemon)
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+bool readDaemonSnapshot(const std::string& segment_name, const std::string& pid_file,
+                        UtilizationInfo& util, std::string& reason) {
+    SELF_STATS_SCOPE(StageKind::COLLECTOR, "daemon_snapshot");
+
+    struct sysreport_shm* shm = sysreport_shm_attach(segment_name.c_str());
+    if (!shm) {
+        reason = "no snapshot segment " + segment_name;
+        return false;
+    }
+
+    pid_t writer = shm->writer_pid;
+    struct sysreport_shm_snapshot snap;
+    int rc = sysreport_shm_read(shm, &snap);
+    sysreport_shm_detach(shm);
+
+    if (rc != 0) {
+        reason = "no snapshot published yet";
+        return false;
+    }
+    // A crashed daemon leaves its segment behind
+    if (!processAlive(writer)) {
+        reason = "daemon " + std::to_string(writer) + " is not running";
+        return false;
+    }
+    // Another instance may publish under the same name; only trust ours
+    std::ifstream pid_in(pid_file);
+    long pid_from_file = 0;
+    if (pid_in >> pid_from_file && pid_from_file != writer) {
+        reason = "segment written by pid " + std::to_string(writer) + ", " + pid_file +
+                 " names " + std::to_string(pid_from_file);
+        return false;
+    }
+
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    int64_t age_ms = now_ms - snap.timestamp_ms;
+    if (age_ms > 2 * snap.interval_ms + 1000) {
+        reason = "snapshot is " + std::to_string(age_ms / 1000) + "s old";
+        return false;
+    }
+
+    util = snapshotToUtilization(snap);
+    return true;
+}
+
+ShmPublisher::ShmPublisher() : shm(nullptr), interval_ms(0) {
+}
+
+ShmPublisher::~ShmPublisher() {
+    close();
+}
+
+bool ShmPublisher::open(const std::string& segment_name, int64_t cadence_ms, std::string& error) {
+    if (shm) return true;
+    if (segment_name.empty() || segment_name[0] != '/' ||
+        segment_name.find('/', 1) != std::string::npos) {
+        error = "shared memory name must look like /name";
+        return false;
+    }
+
+    // A fresh segment every start: a reader still mapping a crashed daemon's
+    // segment keeps its old copy instead of seeing it resized underneath
+    shm_unlink(segment_name.c_str());
+    int fd = shm_open(segment_name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = "shm_open " + segment_name + ": " + strerror(errno);
+        return false;
+    }
+    // Readers are unprivileged, so the mode must not be narrowed by umask
+    fchmod(fd, 0644);
+    if (ftruncate(fd, sizeof(struct sysreport_shm)) != 0) {
+        error = std::string("ftruncate: ") + strerror(errno);
+        ::close(fd);
+        shm_unlink(segment_name.c_str());
+        return false;
+    }
+    void* map = mmap(nullptr, sizeof(struct sysreport_shm), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        error = std::string("mmap: ") + strerror(errno);
+        shm_unlink(segment_name.c_str());
+        return false;
+    }
+
+    shm = static_cast<struct sysreport_shm*>(map);
+    shm->version = SYSREPORT_SHM_VERSION;
+    shm->size = sizeof(struct sysreport_shm);
+    shm->writer_pid = getpid();
+    __atomic_store_n(&shm->sequence, 0, __ATOMIC_RELAXED);
+    // Magic last: a reader that sees it sees a complete header
+    __atomic_store_n(&shm->magic, SYSREPORT_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    name = segment_name;
+    interval_ms = cadence_ms;
+    staged.reset(new struct sysreport_shm_snapshot());
+    return true;
+}
+
+void ShmPublisher::close() {
+    if (!shm) return;
+    munmap(shm, sizeof(struct sysreport_shm));
+    shm_unlink(name.c_str());
+    shm = nullptr;
+}
+
+void ShmPublisher::publish(const UtilizationInfo& util, int64_t timestamp_ms) {
+    if (!shm) return;
+    SELF_STATS_SCOPE(StageKind::EXPORTER, "shm");
+
+    utilizationToSnapshot(util, *staged);
+    staged->timestamp_ms = timestamp_ms;
+    staged->interval_ms = interval_ms;
+
+    uint64_t sequence = __atomic_load_n(&shm->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&shm->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&shm->snapshot, staged.get(), sizeof(struct sysreport_shm_snapshot));
+    __atomic_store_n(&shm->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
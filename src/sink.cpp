@@ -0,0 +1,343 @@
+#include "sink.h"
+#include "exporters.h"
+#include "influx_push.h"
+#include "log_writer.h"
+#include "metrics_server.h"
+#include "remote_write.h"
+#include "sample_log.h"
+#include "self_stats.h"
+#include <atomic>
+#include <future>
+#include <iomanip>
+#include <sstream>
+
+SinkOptions::SinkOptions()
+    : type("file"),
+      format("json"),
+      interval_seconds(0),
+      queue_size(16),
+      batch_size(2000),
+      batch_age_seconds(10),
+      timeout_ms(5000),
+      spool_max_mb(64),
+      gzip(true) {
+}
+
+bool SinkOptions::operator==(const SinkOptions& other) const {
+    return name == other.name && type == other.type && format == other.format &&
+           target == other.target && interval_seconds == other.interval_seconds &&
+           queue_size == other.queue_size && batch_size == other.batch_size &&
+           batch_age_seconds == other.batch_age_seconds && timeout_ms == other.timeout_ms &&
+           spool_dir == other.spool_dir && spool_max_mb == other.spool_max_mb &&
+           gzip == other.gzip && delta == other.delta;
+}
+
+std::string formatSampleEntry(const std::string& format, const UtilizationInfo& util,
+                              time_t timestamp) {
+    if (format == "prometheus") {
+        return PrometheusExporter::exportMetrics(util);
+    } else if (format == "influxdb") {
+        return InfluxDBExporter::exportMetrics(util);
+    } else if (format == "csv") {
+        std::ostringstream oss;
+        oss << timestamp << ","
+            << std::fixed << std::setprecision(2)
+            << util.cpu_percent << ","
+            << util.ram_percent << ","
+            << util.swap_percent << ",";
+
+        if (!util.gpus.empty() && util.gpus[0].available) {
+            oss << util.gpus[0].utilization_percent << ","
+                << util.gpus[0].temperature;
+        } else {
+            oss << "0,0";
+        }
+
+        return oss.str();
+    } else {
+        // JSON format
+        std::ostringstream oss;
+        oss << "{\"timestamp\":" << timestamp
+            << ",\"cpu\":" << std::fixed << std::setprecision(2) << util.cpu_percent
+            << ",\"memory\":" << util.ram_percent
+            << ",\"swap\":" << util.swap_percent;
+
+        if (!util.gpus.empty() && util.gpus[0].available) {
+            oss << ",\"gpu\":" << util.gpus[0].utilization_percent
+                << ",\"gpu_temp\":" << util.gpus[0].temperature;
+        }
+
+        oss << "}";
+        return oss.str();
+    }
+}
+
+// Appends samples to a file through its own LogWriter, so file sinks get
+// the same batching and rotation as the daemon log
+class FileSink : public Sink {
+private:
+    SinkOptions options;
+    std::unique_ptr<LogWriter> writer;
+    SampleLogEncoder encoder;
+    DeltaFilter delta;
+
+public:
+    explicit FileSink(const SinkOptions& opts) : options(opts), delta(opts.delta) {
+        encoder.setDelta(options.delta);
+    }
+
+    bool open(std::string& error) override {
+        writer.reset(new LogWriter(options.target));
+        if (options.format == "binary") {
+            writer->setHeaderProvider([this]() {
+                encoder.reset();
+                return SampleLogEncoder::fileHeader();
+            });
+        } else if (options.delta.enabled) {
+            // Every segment starts with a keyframe so it can be read on its own
+            writer->setHeaderProvider([this]() {
+                delta.forceKeyframe();
+                return std::string();
+            });
+        }
+        if (!writer->open()) {
+            error = "cannot open " + options.target;
+            writer.reset();
+            return false;
+        }
+        return true;
+    }
+
+    void write(const SinkSample& sample) override {
+        if (options.format == "binary") {
+            writer->rotateIfDue();
+            writer->write(encoder.encode(sample.util, sample.timestamp_ms), true);
+        } else if (options.delta.enabled) {
+            writeDelta(sample);
+        } else {
+            writer->write(formatSampleEntry(options.format, sample.util,
+                                            static_cast<time_t>(sample.timestamp_ms / 1000)));
+        }
+    }
+
+    void close() override {
+        if (writer) {
+            writer->close();
+            writer.reset();
+        }
+    }
+
+private:
+    void writeDelta(const SinkSample& sample) {
+        writer->rotateIfDue();    // A new segment must see the keyframe flag first
+        const MetricRegistry& metrics = utilizationRegistry(sample.util);
+        if (options.format == "json") {
+            writer->write(formatDeltaJson(metrics, delta,
+                                          static_cast<time_t>(sample.timestamp_ms / 1000)));
+            return;
+        }
+        std::string lines;
+        InfluxDBExporter::exportMetrics(metrics, lines, "sysreport",
+                                        static_cast<long>(sample.timestamp_ms) * 1000000L, &delta);
+        if (lines.empty()) return;
+        lines.pop_back();         // LogWriter adds the newline
+        writer->write(lines);
+    }
+};
+
+// Serves the latest sample as a Prometheus exposition on its own address
+class HttpSink : public Sink {
+private:
+    SinkOptions options;
+    std::unique_ptr<MetricsServer> server;
+
+public:
+    explicit HttpSink(const SinkOptions& opts) : options(opts) {}
+
+    bool open(std::string& error) override {
+        server.reset(new MetricsServer(options.target));
+        if (!server->start()) {
+            error = "cannot listen on " + options.target;
+            server.reset();
+            return false;
+        }
+        return true;
+    }
+
+    void write(const SinkSample& sample) override {
+        server->publish(PrometheusExporter::exportMetrics(sample.util));
+    }
+
+    void close() override {
+        if (server) {
+            server->stop();
+            server.reset();
+        }
+    }
+};
+
+std::unique_ptr<Sink> createSink(const SinkOptions& options, std::string& error) {
+    if (options.target.empty()) {
+        error = "no destination";
+        return nullptr;
+    }
+    if (options.delta.enabled && !(options.type == "influxdb" ||
+                                   (options.type == "file" && (options.format == "json" ||
+                                                               options.format == "influxdb" ||
+                                                               options.format == "binary")))) {
+        error = "delta needs a json, influxdb or binary file sink, or an influxdb sink";
+        return nullptr;
+    }
+    if (options.type == "file") {
+        if (options.format != "json" && options.format != "csv" && options.format != "prometheus" &&
+            options.format != "influxdb" && options.format != "binary") {
+            error = "unsupported format '" + options.format + "'";
+            return nullptr;
+        }
+        return std::unique_ptr<Sink>(new FileSink(options));
+    }
+    if (options.type == "http") {
+        if (options.format != "prometheus") {
+            error = "http sinks only serve prometheus";
+            return nullptr;
+        }
+        return std::unique_ptr<Sink>(new HttpSink(options));
+    }
+    if (options.type == "remote_write") {
+        HttpUrl url;
+        if (!url.parse(options.target)) {
+            error = "remote_write needs an http:// URL";
+            return nullptr;
+        }
+        return std::unique_ptr<Sink>(new RemoteWriteSink(options));
+    }
+    if (options.type == "influxdb") {
+        if (!InfluxPushSink::supportsUrl(options.target)) {
+            error = "influxdb needs a udp://host:port or http:// URL";
+            return nullptr;
+        }
+        return std::unique_ptr<Sink>(new InfluxPushSink(options));
+    }
+    error = "unknown sink type '" + options.type + "'";
+    return nullptr;
+}
+
+SinkWorker::SinkWorker(const SinkOptions& opts, std::unique_ptr<Sink> sink_impl)
+    : options(opts),
+      sink(std::move(sink_impl)),
+      histogram(&SelfStats::histogram(StageKind::EXPORTER, "sink_" + opts.name)),
+      stopping(false),
+      last_accepted_ms(0) {
+    if (options.queue_size == 0) options.queue_size = 1;
+}
+
+SinkWorker::~SinkWorker() {
+    stop();
+}
+
+bool SinkWorker::start(std::string& error) {
+    if (worker.joinable()) return false;
+
+    std::promise<std::string> opened;
+    std::future<std::string> result = opened.get_future();
+    stopping = false;
+    worker = std::thread([this, &opened]() {
+        std::string open_error;
+        if (!sink->open(open_error)) {
+            opened.set_value(open_error.empty() ? "open failed" : open_error);
+            return;
+        }
+        opened.set_value("");
+        run();
+        sink->close();
+    });
+
+    error = result.get();
+    if (!error.empty()) {
+        worker.join();
+        return false;
+    }
+    return true;
+}
+
+void SinkWorker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void SinkWorker::submit(const std::shared_ptr<const SinkSample>& sample) {
+    static std::atomic<uint64_t>& dropped = SelfStats::counter(
+        "sink_samples_dropped_total", "Samples discarded because a sink's queue was full");
+
+    // Small tolerance so a 10s sink on a 5s daemon doesn't slip to 15s
+    int64_t interval_ms = static_cast<int64_t>(options.interval_seconds * 1000.0);
+    if (interval_ms > 0 && last_accepted_ms != 0 &&
+        sample->timestamp_ms - last_accepted_ms < interval_ms - interval_ms / 10) {
+        return;
+    }
+    last_accepted_ms = sample->timestamp_ms;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (queue.size() >= options.queue_size) {
+            queue.pop_front();
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        queue.push_back(sample);
+    }
+    cv.notify_one();
+}
+
+void SinkWorker::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [this]() { return stopping || !queue.empty(); });
+        if (queue.empty()) break;   // Stopping and fully drained
+
+        std::shared_ptr<const SinkSample> sample = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+        {
+            ScopedTimer timer(*histogram);
+            sink->write(*sample);
+        }
+        lock.lock();
+    }
+}
+
+SinkFanout::~SinkFanout() {
+    stop();
+}
+
+bool SinkFanout::add(const SinkOptions& options, std::string& error) {
+    std::unique_ptr<Sink> sink = createSink(options, error);
+    if (!sink) return false;
+
+    std::unique_ptr<SinkWorker> worker(new SinkWorker(options, std::move(sink)));
+    if (!worker->start(error)) return false;
+    workers.push_back(std::move(worker));
+    return true;
+}
+
+void SinkFanout::publish(const UtilizationInfo& util, int64_t timestamp_ms) {
+    if (workers.empty()) return;
+
+    // One copy per cycle, however many sinks there are
+    std::shared_ptr<const SinkSample> sample(new SinkSample{util, timestamp_ms});
+    for (auto& worker : workers) {
+        worker->submit(sample);
+    }
+}
+
+void SinkFanout::stop() {
+    for (auto& worker : workers) {
+        worker->stop();
+    }
+    workers.clear();
+}
@@ -0,0 +1,112 @@
+#include "snappy.h"
+#include <cstdint>
+#include <cstring>
+
+static const size_t BLOCK_SIZE = 1 << 16;   // Copies never reach back further
+static const int HASH_BITS = 14;
+
+static inline uint32_t load32(const char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t hash32(uint32_t bytes) {
+    return (bytes * 0x1e35a7bd) >> (32 - HASH_BITS);
+}
+
+static void appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+static void emitLiteral(std::string& out, const char* p, size_t len) {
+    size_t n = len - 1;
+    if (n < 60) {
+        out += static_cast<char>(n << 2);
+    } else if (n < 256) {
+        out += static_cast<char>(60 << 2);
+        out += static_cast<char>(n);
+    } else {
+        // Blocks are at most 64KB, so two length bytes always suffice
+        out += static_cast<char>(61 << 2);
+        out += static_cast<char>(n & 0xff);
+        out += static_cast<char>(n >> 8);
+    }
+    out.append(p, len);
+}
+
+// One copy element, 4 <= len <= 64
+static void emitCopyElement(std::string& out, size_t offset, size_t len) {
+    if (len <= 11 && offset < 2048) {
+        out += static_cast<char>(1 | ((len - 4) << 2) | ((offset >> 8) << 5));
+        out += static_cast<char>(offset & 0xff);
+    } else {
+        out += static_cast<char>(2 | ((len - 1) << 2));
+        out += static_cast<char>(offset & 0xff);
+        out += static_cast<char>(offset >> 8);
+    }
+}
+
+static void emitCopy(std::string& out, size_t offset, size_t len) {
+    // Split long matches so no piece is shorter than 4 bytes
+    while (len >= 68) {
+        emitCopyElement(out, offset, 64);
+        len -= 64;
+    }
+    if (len > 64) {
+        emitCopyElement(out, offset, 60);
+        len -= 60;
+    }
+    emitCopyElement(out, offset, len);
+}
+
+static void compressBlock(const char* base, size_t size, std::string& out, uint16_t* table) {
+    if (size < 15) {
+        emitLiteral(out, base, size);
+        return;
+    }
+
+    memset(table, 0, sizeof(uint16_t) << HASH_BITS);
+    size_t ip = 0;
+    size_t literal_start = 0;
+    while (ip + 4 <= size) {
+        uint32_t bytes = load32(base + ip);
+        uint32_t h = hash32(bytes);
+        size_t candidate = table[h];
+        table[h] = static_cast<uint16_t>(ip);
+
+        if (candidate >= ip || load32(base + candidate) != bytes) {
+            ip++;
+            continue;
+        }
+
+        size_t len = 4;
+        while (ip + len < size && base[candidate + len] == base[ip + len]) len++;
+
+        if (ip > literal_start) {
+            emitLiteral(out, base + literal_start, ip - literal_start);
+        }
+        emitCopy(out, ip - candidate, len);
+        ip += len;
+        literal_start = ip;
+    }
+    if (literal_start < size) {
+        emitLiteral(out, base + literal_start, size - literal_start);
+    }
+}
+
+void snappyCompress(const char* data, size_t size, std::string& out) {
+    out.clear();
+    out.reserve(size / 2 + 32);
+    appendVarint(out, size);
+
+    uint16_t table[1 << HASH_BITS];
+    for (size_t offset = 0; offset < size; offset += BLOCK_SIZE) {
+        size_t block = size - offset < BLOCK_SIZE ? size - offset : BLOCK_SIZE;
+        compressBlock(data + offset, block, out, table);
+    }
+}
@@ -1,6 +1,9 @@
 #include "system_info.h"
 #include "format.h"
 #include "history.h"
+#include "self_stats.h"
+#include "metric_registry.h"
+#include "json_writer.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -15,6 +18,10 @@
 #include <dirent.h>
 #include <chrono>
 #include <map>
+#include <unordered_map>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
 
 // ANSI color codes
 const std::string COLOR_RESET = "\033[0m";
@@ -40,8 +47,8 @@ std::string trim(const std::string& str) {
     return str.substr(first, last - first + 1);
 }
 
-std::string getTimestamp() {
-    time_t now = time(nullptr);
+std::string getTimestamp(time_t when) {
+    time_t now = when != 0 ? when : time(nullptr);
     char buf[64];
     strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&now));
     return std::string(buf);
@@ -68,6 +75,7 @@ std::string getProgressBar(double percent, int width) {
 }
 
 std::vector<DiskInfo> getDiskInfo() {
+    SELF_STATS_SCOPE(StageKind::COLLECTOR, "disk");
     std::vector<DiskInfo> disks;
     std::ifstream mounts("/proc/mounts");
     std::string line;
@@ -182,10 +190,12 @@ HardwareInfo getHardwareInfo() {
     return info;
 }
 
-std::vector<ProcessInfo> getTopProcesses(int count = 5) {
-    std::vector<ProcessInfo> processes;
+std::vector<ProcessTimes> readProcessTimes() {
+    SELF_STATS_SCOPE(StageKind::COLLECTOR, "processes");
+    std::vector<ProcessTimes> processes;
     DIR* dir = opendir("/proc");
     if (!dir) return processes;
+    static const long long page_size = sysconf(_SC_PAGESIZE);
     
     struct dirent* entry;
     while ((entry = readdir(dir)) != nullptr) {
@@ -197,7 +207,6 @@ std::vector<ProcessInfo> getTopProcesses(int count = 5) {
         
         int pid = std::stoi(name);
         std::string stat_path = "/proc/" + name + "/stat";
-        std::string cmdline_path = "/proc/" + name + "/cmdline";
         
         std::ifstream stat_file(stat_path);
         if (!stat_file) continue;
@@ -205,43 +214,81 @@ std::vector<ProcessInfo> getTopProcesses(int count = 5) {
         std::string stat_line;
         std::getline(stat_file, stat_line);
         
-        // Parse process name and memory
+        // Parse process name; the name may itself contain spaces and parentheses
         size_t start = stat_line.find('(');
         size_t end = stat_line.rfind(')');
         if (start == std::string::npos || end == std::string::npos) continue;
         
         std::string proc_name = stat_line.substr(start + 1, end - start - 1);
         
-        // Get memory from statm
+        // utime and stime are fields 14 and 15; the first after the name is field 3
+        std::istringstream fields(stat_line.substr(end + 1));
+        std::string skipped;
+        for (int field = 3; field < 14 && fields >> skipped; field++) {}
+        unsigned long long utime = 0, stime = 0;
+        if (!(fields >> utime >> stime)) continue;
+        
+        // Resident set from statm (the second field; the first is virtual size)
         std::string statm_path = "/proc/" + name + "/statm";
         std::ifstream statm_file(statm_path);
-        long pages;
-        if (statm_file >> pages) {
-            ProcessInfo proc;
+        long size_pages, resident_pages;
+        if (statm_file >> size_pages >> resident_pages) {
+            ProcessTimes proc;
             proc.pid = pid;
             proc.name = proc_name;
-            proc.mem_mb = pages * 4 / 1024; // Assuming 4KB pages
-            proc.cpu_percent = 0.0; // Simplified - would need time delta for accurate CPU%
-            
-            if (proc.mem_mb > 0) {
-                processes.push_back(proc);
-            }
+            proc.mem_mb = static_cast<long>(resident_pages * page_size / (1024 * 1024));
+            proc.cpu_ticks = utime + stime;
+            processes.push_back(proc);
         }
     }
     closedir(dir);
+    return processes;
+}
+
+std::vector<ProcessInfo> rankProcesses(const std::vector<ProcessTimes>& earlier,
+                                       const std::vector<ProcessTimes>& later,
+                                       double elapsed_seconds, size_t count, bool by_cpu) {
+    static const double ticks_per_second = static_cast<double>(sysconf(_SC_CLK_TCK));
+    std::unordered_map<int, unsigned long long> before;
+    before.reserve(earlier.size());
+    for (const ProcessTimes& proc : earlier) {
+        before[proc.pid] = proc.cpu_ticks;
+    }
     
-    // Sort by memory and take top N
-    std::sort(processes.begin(), processes.end(), 
-              [](const ProcessInfo& a, const ProcessInfo& b) { return a.mem_mb > b.mem_mb; });
+    std::vector<ProcessInfo> processes;
+    processes.reserve(later.size());
+    for (const ProcessTimes& proc : later) {
+        // A process missing from the earlier scan started in between
+        auto it = before.find(proc.pid);
+        unsigned long long start = it != before.end() && it->second <= proc.cpu_ticks ? it->second : 0;
+        ProcessInfo info;
+        info.pid = proc.pid;
+        info.name = proc.name;
+        info.mem_mb = proc.mem_mb;
+        info.cpu_percent = elapsed_seconds > 0 ?
+            (proc.cpu_ticks - start) / ticks_per_second / elapsed_seconds * 100.0 : 0.0;
+        if (by_cpu ? info.cpu_percent > 0 : info.mem_mb > 0) {
+            processes.push_back(info);
+        }
+    }
     
-    if (processes.size() > (size_t)count) {
+    std::sort(processes.begin(), processes.end(), [by_cpu](const ProcessInfo& a, const ProcessInfo& b) {
+        if (by_cpu && a.cpu_percent != b.cpu_percent) return a.cpu_percent > b.cpu_percent;
+        return a.mem_mb > b.mem_mb;
+    });
+    if (processes.size() > count) {
         processes.resize(count);
     }
-    
     return processes;
 }
 
+std::vector<ProcessInfo> getTopProcesses(int count) {
+    // One scan has no CPU delta, so cpu_percent stays 0
+    return rankProcesses({}, readProcessTimes(), 0.0, static_cast<size_t>(std::max(count, 0)), false);
+}
+
 std::vector<double> getPerCoreUsage() {
+    SELF_STATS_SCOPE(StageKind::COLLECTOR, "cpu_per_core");
     std::vector<double> usage;
     std::ifstream stat1("/proc/stat");
     std::string line;
@@ -292,6 +339,7 @@ std::vector<double> getPerCoreUsage() {
 }
 
 std::vector<double> getTemperatures() {
+    SELF_STATS_SCOPE(StageKind::COLLECTOR, "temperatures");
     std::vector<double> temps;
     
     // Try to read from thermal zones
@@ -373,6 +421,7 @@ GPUInfo getAmdGPU() {
 
 // Get all GPUs
 std::vector<GPUInfo> getGPUs() {
+    SELF_STATS_SCOPE(StageKind::COLLECTOR, "gpu");
     std::vector<GPUInfo> gpus;
     
     // Try NVIDIA
@@ -392,6 +441,7 @@ std::vector<GPUInfo> getGPUs() {
 
 // Get battery information
 BatteryInfo getBatteryInfo() {
+    SELF_STATS_SCOPE(StageKind::COLLECTOR, "battery");
     BatteryInfo battery;
     battery.present = false;
     battery.time_remaining_minutes = -1;
@@ -433,6 +483,7 @@ BatteryInfo getBatteryInfo() {
 
 // Get fan speeds
 std::vector<FanInfo> getFanSpeeds() {
+    SELF_STATS_SCOPE(StageKind::COLLECTOR, "fans");
     std::vector<FanInfo> fans;
     
     // Look in hwmon directories
@@ -467,10 +518,10 @@ std::vector<FanInfo> getFanSpeeds() {
     return fans;
 }
 
-UtilizationInfo getUtilizationInfo() {
-    UtilizationInfo info;
+// Get RAM and swap usage
+static void collectMemory(UtilizationInfo& info) {
+    SELF_STATS_SCOPE(StageKind::COLLECTOR, "memory");
     
-    // Get RAM usage
     std::ifstream meminfo("/proc/meminfo");
     std::string line;
     long mem_total = 0, mem_available = 0, swap_total = 0, swap_free = 0;
@@ -502,11 +553,13 @@ UtilizationInfo getUtilizationInfo() {
     info.available_swap_mb = swap_free;
     info.used_swap_mb = swap_total - swap_free;
     info.swap_percent = swap_total > 0 ? (double)(swap_total - swap_free) / swap_total * 100.0 : 0.0;
+}
+
+// Get overall CPU usage (samples /proc/stat 100ms apart)
+static void collectCpu(UtilizationInfo& info) {
+    SELF_STATS_SCOPE(StageKind::COLLECTOR, "cpu");
     
-    // Get disk usage
-    info.disks = getDiskInfo();
-    
-    // Get CPU usage (overall)
+    std::string line;
     std::ifstream stat1("/proc/stat");
     std::getline(stat1, line);
     long user1, nice1, system1, idle1;
@@ -527,29 +580,41 @@ UtilizationInfo getUtilizationInfo() {
     long total_delta = total2 - total1;
     
     info.cpu_percent = total_delta > 0 ? (1.0 - (double)idle_delta / total_delta) * 100.0 : 0.0;
+}
+
+// "3d 4h 12m" style uptime
+std::string formatUptime(long seconds) {
+    long days = seconds / 86400;
+    long hours = (seconds % 86400) / 3600;
+    long minutes = (seconds % 3600) / 60;
     
-    // Get per-core usage
-    info.cpu_per_core = getPerCoreUsage();
+    std::ostringstream oss;
+    if (days > 0) oss << days << "d ";
+    if (hours > 0 || days > 0) oss << hours << "h ";
+    oss << minutes << "m";
+    return oss.str();
+}
+
+// Get uptime and load averages
+static void collectUptime(UtilizationInfo& info) {
+    SELF_STATS_SCOPE(StageKind::COLLECTOR, "uptime");
     
-    // Get uptime
     struct sysinfo si;
     if (sysinfo(&si) == 0) {
-        long days = si.uptime / 86400;
-        long hours = (si.uptime % 86400) / 3600;
-        long minutes = (si.uptime % 3600) / 60;
-        
-        std::ostringstream oss;
-        if (days > 0) oss << days << "d ";
-        if (hours > 0 || days > 0) oss << hours << "h ";
-        oss << minutes << "m";
-        info.uptime = oss.str();
+        info.uptime_seconds = si.uptime;
+        info.uptime = formatUptime(si.uptime);
         
         info.load_avg_1 = si.loads[0] / 65536.0;
         info.load_avg_5 = si.loads[1] / 65536.0;
         info.load_avg_15 = si.loads[2] / 65536.0;
     }
+}
+
+// Get network stats (with speed calculation)
+static void collectNetwork(UtilizationInfo& info) {
+    SELF_STATS_SCOPE(StageKind::COLLECTOR, "network");
     
-    // Get network stats (with speed calculation)
+    std::string line;
     static std::map<std::string, std::pair<long, long>> prev_net_stats; // interface -> (rx, tx)
     static auto last_net_time = std::chrono::steady_clock::now();
     
@@ -595,26 +660,79 @@ UtilizationInfo getUtilizationInfo() {
     }
     
     last_net_time = current_time;
+}
+
+CpuTimes readCpuTimes() {
+    CpuTimes times = {0, 0};
+    std::ifstream stat("/proc/stat");
+    std::string line;
+    std::getline(stat, line);
+    long user, nice, system, idle;
+    if (sscanf(line.c_str(), "cpu %ld %ld %ld %ld", &user, &nice, &system, &idle) == 4) {
+        times.busy = user + nice + system;
+        times.total = user + nice + system + idle;
+    }
+    return times;
+}
+
+UtilizationInfo getQuickUtilizationInfo() {
+    UtilizationInfo info = UtilizationInfo();
+    collectMemory(info);
+    collectUptime(info);
+    return info;
+}
+
+UtilizationInfo getUtilizationInfo(const CollectionOptions& collect) {
+    UtilizationInfo info = UtilizationInfo();
+    info.battery.present = false;
+    info.battery.time_remaining_minutes = -1;
     
-    // Get top processes
-    info.top_processes = getTopProcesses(5);
+    // Get RAM usage
+    collectMemory(info);
     
-    // Get temperatures
-    info.temperatures = getTemperatures();
+    // Get disk usage
+    info.disks = getDiskInfo();
     
-    // Get GPU information
-    info.gpus = getGPUs();
+    // Get CPU usage (overall)
+    collectCpu(info);
     
-    // Get battery information
-    info.battery = getBatteryInfo();
+    // Get per-core usage
+    if (collect.per_core) {
+        info.cpu_per_core = getPerCoreUsage();
+    }
     
-    // Get fan speeds
-    info.fans = getFanSpeeds();
+    // Get uptime
+    collectUptime(info);
+    
+    // Get network stats
+    collectNetwork(info);
+    
+    // Get top processes
+    if (collect.processes && collect.top_processes > 0) {
+        info.top_processes = getTopProcesses(collect.top_processes);
+    }
+    
+    // Get GPU information
+    if (collect.gpus) {
+        info.gpus = getGPUs();
+    }
+    
+    if (collect.sensors) {
+        // Get temperatures
+        info.temperatures = getTemperatures();
+        
+        // Get battery information
+        info.battery = getBatteryInfo();
+        
+        // Get fan speeds
+        info.fans = getFanSpeeds();
+    }
     
     return info;
 }
 
 std::string formatAsText(const HardwareInfo& hw, const UtilizationInfo& util, const DisplayOptions& opts) {
+    SELF_STATS_SCOPE(StageKind::FORMATTER, "text");
     std::ostringstream oss;
     int term_width = getTerminalWidth();
     
@@ -918,63 +1036,176 @@ std::string formatAsText(const HardwareInfo& hw, const UtilizationInfo& util, co
     return oss.str();
 }
 
-std::string formatAsJson(const HardwareInfo& hw, const UtilizationInfo& util, const DisplayOptions& opts) {
-    std::ostringstream oss;
-    oss << "{\n";
-    
-    if (opts.show_timestamp) {
-        oss << "  \"timestamp\": \"" << getTimestamp() << "\",\n";
+// Quoted only when it has to be (RFC 4180)
+static std::string csvField(const std::string& str) {
+    if (str.find_first_of(",\"\n\r") == std::string::npos) return str;
+    std::string out = "\"";
+    for (char c : str) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+static void appendValue(std::string& out, const MetricFamily& family, double value) {
+    char buf[64];
+    std::to_chars_result result;
+    if (family.field_format == FieldFormat::BOOLEAN) {
+        out += value != 0 ? "true" : "false";
+        return;
+    } else if (family.field_format == FieldFormat::MEGABYTES) {
+        value /= 1024.0 * 1024.0;
+    }
+    if (!std::isfinite(value)) {
+        out += family.integral ? "0" : "null";
+        return;
+    } else if (family.integral && family.field_format == FieldFormat::VALUE) {
+        result = std::to_chars(buf, buf + sizeof(buf), std::llround(value));
+    } else {
+        result = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::fixed, 2);
+    }
+    out.append(buf, result.ptr);
+}
+
+// Registry points the fixed json/csv utilization layout already carries;
+// every other group (per-core CPU, network, GPU, processes, plugins...)
+// follows it
+static bool inFixedLayout(const std::string& group, const MetricLabels& labels) {
+    if (group == "memory" || group == "swap" || group == "disk") return true;
+    return group == "cpu" && labels.empty();
+}
+
+static void appendJsonFields(JsonWriter& json, const MetricRegistry& metrics,
+                             const std::vector<uint32_t>& series) {
+    for (uint32_t handle : series) {
+        const MetricSeries& s = metrics.getSeries(handle);
+        const MetricFamily& family = metrics.getFamilies()[s.family];
+        json.key(family.field);
+        if (family.field_format == FieldFormat::BOOLEAN) {
+            json.value(s.value != 0);
+        } else if (family.field_format == FieldFormat::MEGABYTES) {
+            json.number(s.value / (1024.0 * 1024.0));
+        } else if (!family.integral) {
+            json.number(s.value);
+        } else {
+            json.integer(std::isfinite(s.value) ? std::llround(s.value) : 0);
+        }
+    }
+}
+
+void appendJson(std::string& out, const HardwareInfo& hw, const UtilizationInfo& util,
+                const DisplayOptions& opts) {
+    SELF_STATS_SCOPE(StageKind::FORMATTER, "json");
+    // ndjson is the same document on one line, always timestamped
+    bool ndjson = opts.format == "ndjson";
+    JsonWriter json(out, !ndjson);
+    json.beginObject();
+    
+    if (opts.show_timestamp || ndjson) {
+        json.member("timestamp", getTimestamp(opts.sample_time));
     }
     
     if (opts.show_static) {
-        oss << "  \"hardware\": {\n";
-        oss << "    \"os\": \"" << hw.os_info << "\",\n";
-        oss << "    \"cpu_model\": \"" << hw.cpu_model << "\",\n";
-        oss << "    \"cpu_cores\": " << hw.cpu_cores << ",\n";
-        oss << "    \"total_ram_mb\": " << hw.total_ram_mb << ",\n";
-        oss << "    \"total_swap_mb\": " << hw.total_swap_mb << ",\n";
-        oss << "    \"disks\": [\n";
-        for (size_t i = 0; i < hw.disks.size(); i++) {
-            oss << "      {\"mount\": \"" << hw.disks[i].mount_point << "\", ";
-            oss << "\"device\": \"" << hw.disks[i].device << "\", ";
-            oss << "\"total_gb\": " << hw.disks[i].total_gb << "}";
-            if (i < hw.disks.size() - 1) oss << ",";
-            oss << "\n";
+        json.key("hardware");
+        json.beginObject();
+        json.member("os", hw.os_info);
+        json.member("cpu_model", hw.cpu_model);
+        json.memberInteger("cpu_cores", hw.cpu_cores);
+        json.memberInteger("total_ram_mb", hw.total_ram_mb);
+        json.memberInteger("total_swap_mb", hw.total_swap_mb);
+        json.key("disks");
+        json.beginArray();
+        for (const auto& disk : hw.disks) {
+            json.beginObject(true);
+            json.member("mount", disk.mount_point);
+            json.member("device", disk.device);
+            json.memberInteger("total_gb", disk.total_gb);
+            json.endObject();
         }
-        oss << "    ]\n";
-        oss << "  }";
-        if (opts.show_dynamic) oss << ",";
-        oss << "\n";
+        json.endArray();
+        json.key("network_interfaces");
+        json.beginArray(true);
+        for (const auto& name : hw.network_interfaces) {
+            json.value(name);
+        }
+        json.endArray();
+        json.endObject();
     }
     
     if (opts.show_dynamic) {
-        oss << "  \"utilization\": {\n";
-        oss << "    \"cpu_percent\": " << std::fixed << std::setprecision(1) << util.cpu_percent << ",\n";
-        oss << "    \"load_avg\": [" << util.load_avg_1 << ", " << util.load_avg_5 << ", " << util.load_avg_15 << "],\n";
-        oss << "    \"uptime\": \"" << util.uptime << "\",\n";
-        oss << "    \"used_ram_mb\": " << util.used_ram_mb << ",\n";
-        oss << "    \"available_ram_mb\": " << util.available_ram_mb << ",\n";
-        oss << "    \"ram_percent\": " << util.ram_percent << ",\n";
-        oss << "    \"used_swap_mb\": " << util.used_swap_mb << ",\n";
-        oss << "    \"swap_percent\": " << util.swap_percent << ",\n";
-        oss << "    \"disks\": [\n";
-        for (size_t i = 0; i < util.disks.size(); i++) {
-            oss << "      {\"mount\": \"" << util.disks[i].mount_point << "\", ";
-            oss << "\"used_gb\": " << util.disks[i].used_gb << ", ";
-            oss << "\"available_gb\": " << util.disks[i].available_gb << ", ";
-            oss << "\"percent\": " << util.disks[i].percent << "}";
-            if (i < util.disks.size() - 1) oss << ",";
-            oss << "\n";
+        json.key("utilization");
+        json.beginObject();
+        json.memberNumber("cpu_percent", util.cpu_percent, 1);
+        json.key("load_avg");
+        json.beginArray(true);
+        json.number(util.load_avg_1, 1);
+        json.number(util.load_avg_5, 1);
+        json.number(util.load_avg_15, 1);
+        json.endArray();
+        json.member("uptime", util.uptime);
+        json.memberInteger("used_ram_mb", util.used_ram_mb);
+        json.memberInteger("available_ram_mb", util.available_ram_mb);
+        json.memberNumber("ram_percent", util.ram_percent, 1);
+        json.memberInteger("used_swap_mb", util.used_swap_mb);
+        json.memberNumber("swap_percent", util.swap_percent, 1);
+        json.key("disks");
+        json.beginArray();
+        for (const auto& disk : util.disks) {
+            json.beginObject(true);
+            json.member("mount", disk.mount_point);
+            json.memberInteger("used_gb", disk.used_gb);
+            json.memberInteger("available_gb", disk.available_gb);
+            json.memberNumber("percent", disk.percent, 1);
+            json.endObject();
         }
-        oss << "    ]\n";
-        oss << "  }\n";
+        json.endArray();
+        
+        // The other registry groups alongside: an object for a group
+        // without labels, an array of points (labels, then fields) otherwise
+        const MetricRegistry& metrics = opts.metrics ? *opts.metrics : utilizationRegistry(util);
+        const std::string* open_group = nullptr;
+        metrics.forEachPoint([&](const std::string& group, const MetricLabels& labels,
+                                 const std::vector<uint32_t>& series) {
+            if (inFixedLayout(group, labels)) return;
+            if (open_group && (*open_group != group || labels.empty())) {
+                json.endArray();
+                open_group = nullptr;
+            }
+            if (labels.empty()) {
+                json.key(group);
+                json.beginObject(true);
+                appendJsonFields(json, metrics, series);
+                json.endObject();
+                return;
+            }
+            if (!open_group) {
+                json.key(group);
+                json.beginArray();
+                open_group = &group;
+            }
+            json.beginObject(true);
+            for (const auto& label : labels) {
+                json.member(label.first, label.second);
+            }
+            appendJsonFields(json, metrics, series);
+            json.endObject();
+        });
+        if (open_group) json.endArray();
+        json.endObject();
     }
     
-    oss << "}\n";
-    return oss.str();
+    json.endObject();
+    out += '\n';
+}
+
+std::string formatAsJson(const HardwareInfo& hw, const UtilizationInfo& util, const DisplayOptions& opts) {
+    std::string out;
+    appendJson(out, hw, util, opts);
+    return out;
 }
 
 std::string formatAsCsv(const HardwareInfo& hw, const UtilizationInfo& util, const DisplayOptions& opts) {
+    SELF_STATS_SCOPE(StageKind::FORMATTER, "csv");
     std::ostringstream oss;
     
     if (opts.show_timestamp) {
@@ -984,8 +1215,8 @@ std::string formatAsCsv(const HardwareInfo& hw, const UtilizationInfo& util, con
     oss << "Category,Metric,Value,Unit\n";
     
     if (opts.show_static) {
-        oss << "Hardware,OS," << hw.os_info << ",\n";
-        oss << "Hardware,CPU Model," << hw.cpu_model << ",\n";
+        oss << "Hardware,OS," << csvField(hw.os_info) << ",\n";
+        oss << "Hardware,CPU Model," << csvField(hw.cpu_model) << ",\n";
         oss << "Hardware,CPU Cores," << hw.cpu_cores << ",count\n";
         oss << "Hardware,Total RAM," << hw.total_ram_mb << ",MB\n";
         oss << "Hardware,Total Swap," << hw.total_swap_mb << ",MB\n";
@@ -996,7 +1227,7 @@ std::string formatAsCsv(const HardwareInfo& hw, const UtilizationInfo& util, con
         oss << "Utilization,Load Avg 1min," << util.load_avg_1 << ",\n";
         oss << "Utilization,Load Avg 5min," << util.load_avg_5 << ",\n";
         oss << "Utilization,Load Avg 15min," << util.load_avg_15 << ",\n";
-        oss << "Utilization,Uptime," << util.uptime << ",\n";
+        oss << "Utilization,Uptime," << csvField(util.uptime) << ",\n";
         oss << "Utilization,RAM Used," << util.used_ram_mb << ",MB\n";
         oss << "Utilization,RAM Available," << util.available_ram_mb << ",MB\n";
         oss << "Utilization,RAM Usage," << util.ram_percent << ",%\n";
@@ -1005,17 +1236,43 @@ std::string formatAsCsv(const HardwareInfo& hw, const UtilizationInfo& util, con
             oss << "Utilization,Swap Usage," << util.swap_percent << ",%\n";
         }
         for (const auto& disk : util.disks) {
-            oss << "Disk " << disk.mount_point << ",Used," << disk.used_gb << ",GB\n";
-            oss << "Disk " << disk.mount_point << ",Available," << disk.available_gb << ",GB\n";
-            oss << "Disk " << disk.mount_point << ",Usage," << disk.percent << ",%\n";
+            std::string category = csvField("Disk " + disk.mount_point);
+            oss << category << ",Used," << disk.used_gb << ",GB\n";
+            oss << category << ",Available," << disk.available_gb << ",GB\n";
+            oss << category << ",Usage," << disk.percent << ",%\n";
         }
+        
+        // The other registry groups follow; the category is the group plus
+        // its labels, e.g. "network interface=eth0"
+        const MetricRegistry& metrics = opts.metrics ? *opts.metrics : utilizationRegistry(util);
+        std::string rows;
+        std::string category;
+        metrics.forEachPoint([&](const std::string& group, const MetricLabels& labels,
+                                 const std::vector<uint32_t>& series) {
+            if (inFixedLayout(group, labels)) return;
+            category = group;
+            for (const auto& label : labels) {
+                category += " " + label.first + "=" + label.second;
+            }
+            category = csvField(category);
+            for (uint32_t handle : series) {
+                const MetricSeries& s = metrics.getSeries(handle);
+                const MetricFamily& family = metrics.getFamilies()[s.family];
+                rows += category + "," + csvField(family.field) + ",";
+                appendValue(rows, family, s.value);
+                rows += ",";
+                rows += family.field_format == FieldFormat::MEGABYTES ? "MB" : csvField(family.unit);
+                rows += "\n";
+            }
+        });
+        oss << rows;
     }
     
     return oss.str();
 }
 
 std::string formatOutput(const HardwareInfo& hw, const UtilizationInfo& util, const DisplayOptions& opts) {
-    if (opts.format == "json") {
+    if (opts.format == "json" || opts.format == "ndjson") {
         return formatAsJson(hw, util, opts);
     } else if (opts.format == "csv") {
         return formatAsCsv(hw, util, opts);